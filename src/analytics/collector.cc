@@ -374,6 +374,11 @@ public:
         vector<GeneratorSummaryInfo> generators;
         vsc->Analytics()->GetCollector()->GetGeneratorSummaryInfo(generators);
         resp->set_generators(generators);
+        // Database write batching statistics
+        GenDb::DbBatchStats db_batch_stats;
+        if (vsc->Analytics()->GetDbHandler()->GetBatchStats(db_batch_stats)) {
+            resp->set_db_batch_stats(db_batch_stats);
+        }
         // Send the response
         resp->set_context(req->context());
         resp->Response();
@@ -151,6 +151,15 @@ bool DbHandler::GetStats(uint64_t &queue_count, uint64_t &enqueues) const {
     return dbif_->Db_GetQueueStats(queue_count, enqueues);
 }
 
+bool DbHandler::GetBatchStats(GenDb::DbBatchStats &stats) const {
+    return dbif_->Db_GetBatchStats(stats);
+}
+
+void DbHandler::SetBatchLimits(size_t max_columns, size_t max_outstanding,
+        uint64_t max_latency_usecs) {
+    dbif_->Db_SetBatchLimits(max_columns, max_outstanding, max_latency_usecs);
+}
+
 inline bool DbHandler::AllowMessageTableInsert(std::string& message_type) {
     return message_type != "FlowDataIpv4Object";
 }
@@ -76,6 +76,9 @@ public:
 
     bool FlowTableInsert(const RuleMsg& rmsg);
     bool GetStats(uint64_t &queue_count, uint64_t &enqueues) const;
+    bool GetBatchStats(GenDb::DbBatchStats &stats) const;
+    void SetBatchLimits(size_t max_columns, size_t max_outstanding,
+            uint64_t max_latency_usecs);
 
     GenDb::GenDbIf *get_dbif() {
         return dbif_.get();
@@ -226,6 +226,17 @@ int main(int argc, char *argv[])
          "cassandra server list")
         ("analytics-data-ttl", opt::value<int>()->default_value(g_viz_constants.AnalyticsTTL),
             "global TTL(hours) for analytics data")
+        ("db-batch-max-columns",
+         opt::value<size_t>()->default_value(GenDb::GenDbIf::kBatchMaxColumns),
+         "Maximum number of columns per database write batch")
+        ("db-batch-max-outstanding",
+         opt::value<size_t>()->default_value(
+             GenDb::GenDbIf::kBatchMaxOutstanding),
+         "Maximum number of database write batches in flight")
+        ("db-batch-max-latency-usecs",
+         opt::value<uint64_t>()->default_value(
+             GenDb::GenDbIf::kBatchMaxLatencyUsecs),
+         "Target duration(usecs) of a database write run, 0 for unbounded")
         ("discovery-server", opt::value<string>(),
          "IP address of Discovery Server")
         ("discovery-port",
@@ -270,6 +281,16 @@ int main(int argc, char *argv[])
         exit(0);
     }
 
+    size_t db_batch_max_columns =
+        var_map["db-batch-max-columns"].as<size_t>();
+    size_t db_batch_max_outstanding =
+        var_map["db-batch-max-outstanding"].as<size_t>();
+    if (db_batch_max_columns == 0 || db_batch_max_outstanding == 0) {
+        cout << "db-batch-max-columns and db-batch-max-outstanding must be "
+            "positive" << endl;
+        exit(-1);
+    }
+
     Collector::SetProgramName(argv[0]);
     if (var_map["log-file"].as<string>() == default_log_file) {
         LoggingInit();
@@ -315,6 +336,10 @@ int main(int argc, char *argv[])
             dup,
             var_map["analytics-data-ttl"].as<int>());
 
+    analytics.GetDbHandler()->SetBatchLimits(db_batch_max_columns,
+            db_batch_max_outstanding,
+            var_map["db-batch-max-latency-usecs"].as<uint64_t>());
+
 #if 0
     // initialize python/c++ API
     Py_InitializeEx(0);
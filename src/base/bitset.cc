@@ -5,48 +5,217 @@
 #include "base/bitset.h"
 
 #include <cassert>
+#include <algorithm>
 #include <string>
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 //
-// Provides the same functionality as ffsl.  Needed as ffsl is not supported
-// on all platforms. Note that the positions are numbered 1 through 64, with
-// a return value of 0 indicating that there are no set bits.
+// Vector kernels.  A BlockVector holds kVectorBlocks consecutive blocks and
+// the loops below process as many blocks as possible a vector at a time and
+// the remainder one block at a time.  Loads and stores are unaligned since
+// the inline blocks are only 8 byte aligned.
 //
-static int find_first_set64(uint64_t value) {
-    int bit;
+#if defined(__AVX2__)
+#define BITSET_VECTOR 1
+typedef __m256i BlockVector;
+static const size_t kVectorBlocks = 4;
+
+static inline BlockVector vector_load(const uint64_t *src) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+}
+
+static inline void vector_store(uint64_t *dst, BlockVector value) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), value);
+}
+
+static inline BlockVector vector_and(BlockVector lhs, BlockVector rhs) {
+    return _mm256_and_si256(lhs, rhs);
+}
+
+static inline BlockVector vector_or(BlockVector lhs, BlockVector rhs) {
+    return _mm256_or_si256(lhs, rhs);
+}
+
+// Note that the intrinsic complements its first argument.
+static inline BlockVector vector_andnot(BlockVector lhs, BlockVector rhs) {
+    return _mm256_andnot_si256(rhs, lhs);
+}
+
+static inline bool vector_zero(BlockVector value) {
+    return _mm256_testz_si256(value, value);
+}
+#elif defined(__SSE2__)
+#define BITSET_VECTOR 1
+typedef __m128i BlockVector;
+static const size_t kVectorBlocks = 2;
+
+static inline BlockVector vector_load(const uint64_t *src) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+}
+
+static inline void vector_store(uint64_t *dst, BlockVector value) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), value);
+}
+
+static inline BlockVector vector_and(BlockVector lhs, BlockVector rhs) {
+    return _mm_and_si128(lhs, rhs);
+}
+
+static inline BlockVector vector_or(BlockVector lhs, BlockVector rhs) {
+    return _mm_or_si128(lhs, rhs);
+}
 
-    int lower = value;
-    if ((bit = ffs(lower)) > 0)
-        return bit;
+// Note that the intrinsic complements its first argument.
+static inline BlockVector vector_andnot(BlockVector lhs, BlockVector rhs) {
+    return _mm_andnot_si128(rhs, lhs);
+}
 
-    int upper = value >> 32;
-    if ((bit = ffs(upper)) > 0)
-        return 32 + bit;
+// SSE2 has no ptest, compare all the bytes against 0 instead.
+static inline bool vector_zero(BlockVector value) {
+    __m128i cmp = _mm_cmpeq_epi8(value, _mm_setzero_si128());
+    return _mm_movemask_epi8(cmp) == 0xffff;
+}
+#endif
 
-    return 0;
+//
+// Implement (dst = lhs & rhs) for count blocks.  dst may be lhs or rhs.
+//
+static inline void and_blocks(uint64_t *dst, const uint64_t *lhs,
+                              const uint64_t *rhs, size_t count) {
+    size_t idx = 0;
+#if defined(BITSET_VECTOR)
+    for (; idx + kVectorBlocks <= count; idx += kVectorBlocks) {
+        vector_store(dst + idx,
+            vector_and(vector_load(lhs + idx), vector_load(rhs + idx)));
+    }
+#endif
+    for (; idx < count; idx++) {
+        dst[idx] = lhs[idx] & rhs[idx];
+    }
 }
 
-static int find_first_clear64(uint64_t value) {
-    return find_first_set64(~value);
+//
+// Implement (dst = lhs | rhs) for count blocks.  dst may be lhs or rhs.
+//
+static inline void or_blocks(uint64_t *dst, const uint64_t *lhs,
+                             const uint64_t *rhs, size_t count) {
+    size_t idx = 0;
+#if defined(BITSET_VECTOR)
+    for (; idx + kVectorBlocks <= count; idx += kVectorBlocks) {
+        vector_store(dst + idx,
+            vector_or(vector_load(lhs + idx), vector_load(rhs + idx)));
+    }
+#endif
+    for (; idx < count; idx++) {
+        dst[idx] = lhs[idx] | rhs[idx];
+    }
 }
 
 //
-// Return the number of set bits. K&R method.
+// Implement (dst = lhs & ~rhs) for count blocks.  dst may be lhs or rhs.
 //
-static int num_bits_set(uint64_t value) {
-    int count = 0;
-    while (value != 0) {
-        value &= value - 1;
-        count++;
+static inline void andnot_blocks(uint64_t *dst, const uint64_t *lhs,
+                                 const uint64_t *rhs, size_t count) {
+    size_t idx = 0;
+#if defined(BITSET_VECTOR)
+    for (; idx + kVectorBlocks <= count; idx += kVectorBlocks) {
+        vector_store(dst + idx,
+            vector_andnot(vector_load(lhs + idx), vector_load(rhs + idx)));
+    }
+#endif
+    for (; idx < count; idx++) {
+        dst[idx] = lhs[idx] & ~rhs[idx];
+    }
+}
+
+//
+// Return (lhs & rhs != 0) for count blocks.
+//
+static inline bool and_any(const uint64_t *lhs, const uint64_t *rhs,
+                           size_t count) {
+    size_t idx = 0;
+#if defined(BITSET_VECTOR)
+    for (; idx + kVectorBlocks <= count; idx += kVectorBlocks) {
+        if (!vector_zero(
+                vector_and(vector_load(lhs + idx), vector_load(rhs + idx))))
+            return true;
+    }
+#endif
+    for (; idx < count; idx++) {
+        if (lhs[idx] & rhs[idx])
+            return true;
+    }
+    return false;
+}
+
+//
+// Return (lhs & ~rhs != 0) for count blocks.
+//
+static inline bool andnot_any(const uint64_t *lhs, const uint64_t *rhs,
+                              size_t count) {
+    size_t idx = 0;
+#if defined(BITSET_VECTOR)
+    for (; idx + kVectorBlocks <= count; idx += kVectorBlocks) {
+        if (!vector_zero(
+                vector_andnot(vector_load(lhs + idx), vector_load(rhs + idx))))
+            return true;
+    }
+#endif
+    for (; idx < count; idx++) {
+        if (lhs[idx] & ~rhs[idx])
+            return true;
+    }
+    return false;
+}
+
+//
+// Return the index of the first non zero block at or after idx, or count if
+// there is none.
+//
+static inline size_t find_nonzero_block(const uint64_t *blocks, size_t idx,
+                                        size_t count) {
+#if defined(BITSET_VECTOR)
+    for (; idx + kVectorBlocks <= count; idx += kVectorBlocks) {
+        if (!vector_zero(vector_load(blocks + idx)))
+            break;
+    }
+#endif
+    for (; idx < count; idx++) {
+        if (blocks[idx] != 0)
+            return idx;
     }
     return count;
 }
 
+//
+// Return the number of set bits in count blocks.  The builtin is a single
+// instruction when the compiler targets popcnt.
+//
+static inline size_t count_blocks(const uint64_t *blocks, size_t count) {
+    size_t bits = 0;
+    for (size_t idx = 0; idx < count; idx++) {
+        bits += __builtin_popcountll(blocks[idx]);
+    }
+    return bits;
+}
+
+//
+// Return the offset of the lowest set bit of a non zero block.
+//
+static inline size_t first_set64(uint64_t value) {
+    return __builtin_ctzll(value);
+}
+
 // Position pos is w.r.t the entire bitset, starts at 0.
-// Index    idx is the block number i.e. the index in the vector, starts at 0.
+// Index    idx is the block number i.e. the index in the array, starts at 0.
 // Offset   offset is w.r.t a given 64 bit block, starts at 0.
 static inline size_t block_index(size_t pos) {
     return pos / 64;
@@ -61,25 +230,71 @@ static inline size_t bit_position(size_t idx, size_t offset) {
 }
 
 const size_t BitSet::npos;
+const size_t BitSet::kInlineBlocks;
+
+BitSet::BitSet() : size_(0), capacity_(kInlineBlocks) {
+}
+
+BitSet::BitSet(const BitSet &rhs) : size_(0), capacity_(kInlineBlocks) {
+    resize(rhs.size_);
+    memcpy(blocks(), rhs.blocks(), rhs.size_ * sizeof(uint64_t));
+}
+
+BitSet::~BitSet() {
+    if (!is_inline())
+        delete [] heap_;
+}
+
+//
+// The heap array, if any, is kept when the rhs fits in it.
+//
+BitSet &BitSet::operator=(const BitSet &rhs) {
+    if (this == &rhs)
+        return *this;
+    size_ = 0;
+    resize(rhs.size_);
+    memcpy(blocks(), rhs.blocks(), rhs.size_ * sizeof(uint64_t));
+    return *this;
+}
+
+//
+// Change the number of blocks in use.  New blocks are 0.  The blocks move to
+// a heap array, at least twice as large as the current one, when they don't
+// fit in the current storage.  The storage never shrinks.
+//
+void BitSet::resize(size_t size) {
+    if (size > capacity_) {
+        size_t capacity = std::max(size, 2 * static_cast<size_t>(capacity_));
+        uint64_t *heap = new uint64_t[capacity];
+        memcpy(heap, blocks(), size_ * sizeof(uint64_t));
+        if (!is_inline())
+            delete [] heap_;
+        heap_ = heap;
+        capacity_ = capacity;
+    }
+    if (size > size_)
+        memset(blocks() + size_, 0, (size - size_) * sizeof(uint64_t));
+    size_ = size;
+}
 
 //
-// Set bit at given position, growing the vector if needed.
+// Set bit at given position, growing the array if needed.
 //
 BitSet &BitSet::set(size_t pos) {
     size_t idx = block_index(pos);
-    if (idx >= blocks_.size())
-        blocks_.resize(idx + 1);
-    blocks_[idx] |= 1LL << block_offset(pos);
+    if (idx >= size_)
+        resize(idx + 1);
+    blocks()[idx] |= 1ULL << block_offset(pos);
     return *this;
 }
 
 //
-// Reset bit at given position, shrinking the vector if possible.
+// Reset bit at given position, shrinking the array if possible.
 //
 BitSet &BitSet::reset(size_t pos) {
     size_t idx = block_index(pos);
-    if (idx < blocks_.size()) {
-        blocks_[idx] &= ~(1LL << block_offset(pos));
+    if (idx < size_) {
+        blocks()[idx] &= ~(1ULL << block_offset(pos));
         compact();
     }
     return *this;
@@ -88,8 +303,8 @@ BitSet &BitSet::reset(size_t pos) {
 // Test bit at given position.
 bool BitSet::test(size_t pos) const {
     size_t idx = block_index(pos);
-    if (idx < blocks_.size()) {
-        return ((blocks_[idx] & (1LL << block_offset(pos))) != 0);
+    if (idx < size_) {
+        return ((blocks()[idx] & (1ULL << block_offset(pos))) != 0);
     } else {
         return false;
     }
@@ -99,73 +314,53 @@ bool BitSet::test(size_t pos) const {
 // Shortcut to reset all bits in the bitset.
 //
 void BitSet::clear() {
-    blocks_.resize(0);
+    size_ = 0;
 }
 
 //
 // Return true if there are no bits in the bitset.
 //
 bool BitSet::empty() const {
-    return (blocks_.size() == 0);
+    return (size_ == 0);
 }
 
 //
 // Return true if no bits are set.
 //
 bool BitSet::none() const {
-    return (blocks_.size() == 0);
+    return (size_ == 0);
 }
 
 //
 // Return true at least one bit is set.
 //
 bool BitSet::any() const {
-    return (blocks_.size() != 0);
+    return (size_ != 0);
 }
 
 //
 // Return the raw number of bits in the bitset. Simply depends on the number
-// of blocks in the vector.
+// of blocks in use.
 //
 size_t BitSet::size() const {
-    return blocks_.size() * 64;
+    return size_ * 64;
 }
 
 //
 // Return total number of set bits.
 //
 size_t BitSet::count() const {
-    size_t count = 0;
-    for (size_t idx = 0; idx < blocks_.size(); idx++) {
-        count += num_bits_set(blocks_[idx]);
-    }
-    return count;
+    return count_blocks(blocks(), size_);
 }
 
 //
-// Shrink the underlying vector as much as possible.  All trailing blocks
-// that are 0 can be removed.
-//
-// Note that the for loop does not handle idx 0 since the loop  variable
-// is unsigned.
+// Shrink the blocks in use as much as possible.  All trailing blocks that
+// are 0 can be removed.
 //
 void BitSet::compact() {
-    if (blocks_.size() == 0)
-        return;
-
-    for (size_t idx = blocks_.size() - 1; idx > 0; idx--) {
-        if (blocks_[idx] != 0) {
-            blocks_.resize(idx + 1);
-            return;
-        }
-    }
-
-    if (blocks_[0] != 0) {
-        blocks_.resize(1);
-        return;
-    }
-
-    blocks_.clear();
+    const uint64_t *data = blocks();
+    while (size_ != 0 && data[size_ - 1] == 0)
+        size_--;
 }
 
 //
@@ -173,101 +368,88 @@ void BitSet::compact() {
 // after any compaction is done or in cases where no compaction is needed.
 //
 void BitSet::check_invariants() {
-    size_t mysize = blocks_.size();
-    if (mysize != 0)
-        assert(blocks_[mysize -1] != 0);
+    if (size_ != 0)
+        assert(blocks()[size_ - 1] != 0);
 }
 
 //
-// Return the position of the first set bit.  Needs to compensate for the
-// return value convention used by find_first_set64.
+// Return the position of the first set bit.
 //
 size_t BitSet::find_first() const {
-    for (size_t idx = 0; idx < blocks_.size(); idx++) {
-        int bit = find_first_set64(blocks_[idx]);
-        if (bit > 0)
-            return bit_position(idx, bit - 1);
-    }
+    const uint64_t *data = blocks();
+    size_t idx = find_nonzero_block(data, 0, size_);
+    if (idx < size_)
+        return bit_position(idx, first_set64(data[idx]));
     return BitSet::npos;
 }
 
 //
-// Return the position of the next set bit.  Needs to compensate for the
-// return value convention used by find_first_set64.
+// Return the position of the next set bit.
 //
 size_t BitSet::find_next(size_t pos) const {
     size_t idx = block_index(pos);
 
-    // If the block index is beyond the vector, we're done.
-    if (idx >= blocks_.size())
+    // If the block index is beyond the array, we're done.
+    if (idx >= size_)
         return BitSet::npos;
 
     // If the offset is not 63, clear out the bits from 0 through offset
     // and look for the first set bit.
+    const uint64_t *data = blocks();
     if (block_offset(pos) < 63) {
-        uint64_t temp = blocks_[idx] & ~((1LL << (block_offset(pos) + 1)) - 1);
-        int bit = find_first_set64(temp);
-        if (bit > 0)
-            return bit_position(idx, bit - 1);
+        uint64_t temp = data[idx] & ~((2ULL << block_offset(pos)) - 1);
+        if (temp != 0)
+            return bit_position(idx, first_set64(temp));
     }
 
     // Go through all blocks after the start block for the pos and see if
     // there's a set bit.
-    for (idx++; idx < blocks_.size(); idx++) {
-        int bit = find_first_set64(blocks_[idx]);
-        if (bit > 0)
-            return bit_position(idx, bit - 1);
-    }
+    idx = find_nonzero_block(data, idx + 1, size_);
+    if (idx < size_)
+        return bit_position(idx, first_set64(data[idx]));
     return BitSet::npos;
 }
 
 //
 // Return the position of the first clear bit.  It could be beyond the last
-// block in the vector. This is fine as we automatically grow the vector if
+// block in the array. This is fine as we automatically grow the array if
 // needed from set().
 //
-// Need to compensate for return value convention used by find_first_clear64.
-//
 size_t BitSet::find_first_clear() const {
-    for (size_t idx = 0; idx < blocks_.size(); idx++) {
-        int bit = find_first_clear64(blocks_[idx]);
-        if (bit > 0) {
-            return bit_position(idx, bit - 1);
-        }
+    const uint64_t *data = blocks();
+    for (size_t idx = 0; idx < size_; idx++) {
+        if (~data[idx] != 0)
+            return bit_position(idx, first_set64(~data[idx]));
     }
     return size();
 }
 
 //
 // Return the position of the next clear bit.  It could be beyond the last
-// block in the vector. This is fine as we automatically grow the vector if
+// block in the array. This is fine as we automatically grow the array if
 // needed from set().
 //
-// Need to compensate for return value convention used by find_first_clear64.
-//
 size_t BitSet::find_next_clear(size_t pos) const {
     size_t idx = block_index(pos);
 
-    // If the block index is beyond the vector, we're done.
-    if (idx >= blocks_.size())
+    // If the block index is beyond the array, we're done.
+    if (idx >= size_)
         return pos + 1;
 
     // If the offset is not 63, set all the bits from 0 through offset and
     // look for the first clear bit.
+    const uint64_t *data = blocks();
     if (block_offset(pos) < 63) {
-        uint64_t temp = blocks_[idx] | ((1LL << (block_offset(pos) + 1)) - 1);
-        int bit = find_first_clear64(temp);
-        if (bit > 0)
-            return bit_position(idx, bit - 1);
+        uint64_t temp = data[idx] | ((2ULL << block_offset(pos)) - 1);
+        if (~temp != 0)
+            return bit_position(idx, first_set64(~temp));
     }
 
     // Go through all blocks after the start block for the pos and see if
     // there's a clear bit.
-    for (idx++; idx < blocks_.size(); idx++) {
-        int bit = find_first_clear64(blocks_[idx]);
-        if (bit > 0) {
-            return bit_position(idx, bit - 1);
-        }
+    for (idx++; idx < size_; idx++) {
+        if (~data[idx] != 0)
+            return bit_position(idx, first_set64(~data[idx]));
     }
     return size();
 }
@@ -276,28 +458,20 @@ size_t BitSet::find_next_clear(size_t pos) const {
 // Return (*this & rhs != 0).
 //
 bool BitSet::intersects(const BitSet &rhs) const {
-    size_t minsize = std::min(blocks_.size(), rhs.blocks_.size());
-    for (size_t idx = 0; idx < minsize; idx++) {
-        if (blocks_[idx] & rhs.blocks_[idx])
-            return true;
-    }
-    return false;
+    size_t minsize = std::min(size_, rhs.size_);
+    return and_any(blocks(), rhs.blocks(), minsize);
 }
 
 //
 // Return (*this == rhs).
 //
-// Note that it's fine to first compare the number of blocks in the vectors
-// since we always shrink the vectors whenever possible.
+// Note that it's fine to first compare the number of blocks in use since we
+// always shrink the sets whenever possible.
 //
 bool BitSet::operator==(const BitSet &rhs) const {
-    if (blocks_.size() != rhs.blocks_.size())
+    if (size_ != rhs.size_)
         return false;
-    for (size_t idx = 0; idx < blocks_.size(); idx++) {
-        if (blocks_[idx] != rhs.blocks_[idx])
-            return false;
-    }
-    return true;
+    return memcmp(blocks(), rhs.blocks(), size_ * sizeof(uint64_t)) == 0;
 }
 
 //
@@ -320,27 +494,13 @@ BitSet BitSet::operator&(const BitSet &rhs) const {
 //
 // Return (*this | rhs).
 //
+// The larger set is copied and the smaller one merged into the copy.
+//
 BitSet BitSet::operator|(const BitSet &rhs) const {
-    BitSet temp;
-    size_t minsize = std::min(blocks_.size(), rhs.blocks_.size());
-    size_t maxsize = std::max(blocks_.size(), rhs.blocks_.size());
-    temp.blocks_.resize(maxsize);
-
-    // Process common blocks.
-    for (size_t idx = 0; idx < minsize; idx++) {
-        temp.blocks_[idx] = blocks_[idx] | rhs.blocks_[idx];
-    }
-
-    // Process blocks that exist in LHS only. It's a noop if RHS is bigger.
-    for (size_t idx = minsize; idx < blocks_.size(); idx++) {
-        temp.blocks_[idx] = blocks_[idx];
-    }
-
-    // Process blocks that exist in RHS only. It's a noop if LHS is bigger.
-    for (size_t idx = minsize; idx < rhs.blocks_.size(); idx++) {
-        temp.blocks_[idx] = rhs.blocks_[idx];
-    }
-
+    const BitSet &larger = size_ >= rhs.size_ ? *this : rhs;
+    const BitSet &smaller = size_ >= rhs.size_ ? rhs : *this;
+    BitSet temp(larger);
+    or_blocks(temp.blocks(), temp.blocks(), smaller.blocks(), smaller.size_);
     temp.check_invariants();
     return temp;
 }
@@ -348,17 +508,13 @@ BitSet BitSet::operator|(const BitSet &rhs) const {
 //
 // Implement (*this &= rhs).
 //
-// Note that we can't simply resize the vector to minsize since we may be
-// able to shrink it even more depending on the values in the blocks.
+// Note that we can't simply shrink to minsize since we may be able to
+// shrink even more depending on the values in the blocks.
 //
 BitSet &BitSet::operator&=(const BitSet &rhs) {
-    size_t minsize = std::min(blocks_.size(), rhs.blocks_.size());
-    for (size_t idx = 0; idx < minsize; idx++) {
-        blocks_[idx] &= rhs.blocks_[idx];
-    }
-    for (size_t idx = minsize; idx < blocks_.size(); idx++) {
-        blocks_[idx] = 0;
-    }
+    size_t minsize = std::min(size_, rhs.size_);
+    and_blocks(blocks(), blocks(), rhs.blocks(), minsize);
+    size_ = minsize;
     compact();
     check_invariants();
     return *this;
@@ -367,15 +523,13 @@ BitSet &BitSet::operator&=(const BitSet &rhs) {
 //
 // Implement (*this |= rhs).
 //
-// Note that we grow the vector only once instead of doing it multiple
+// Note that we grow the array only once instead of doing it multiple
 // times.
 //
 BitSet &BitSet::operator|=(const BitSet &rhs) {
-    if (blocks_.size() < rhs.blocks_.size())
-        blocks_.resize(rhs.blocks_.size());
-    for (size_t idx = 0; idx < rhs.blocks_.size(); idx++) {
-        blocks_[idx] |= rhs.blocks_[idx];
-    }
+    if (size_ < rhs.size_)
+        resize(rhs.size_);
+    or_blocks(blocks(), blocks(), rhs.blocks(), rhs.size_);
     check_invariants();
     return *this;
 }
@@ -392,10 +546,8 @@ void BitSet::Set(const BitSet &rhs) {
 // Implement (*this &= ~rhs).
 //
 void BitSet::Reset(const BitSet &rhs) {
-    size_t minsize = std::min(blocks_.size(), rhs.blocks_.size());
-    for (size_t idx = 0; idx < minsize; idx++) {
-        blocks_[idx] &= ~rhs.blocks_[idx];
-    }
+    size_t minsize = std::min(size_, rhs.size_);
+    andnot_blocks(blocks(), blocks(), rhs.blocks(), minsize);
     compact();
     check_invariants();
 }
@@ -403,20 +555,30 @@ void BitSet::Reset(const BitSet &rhs) {
 //
 // Implement (*this = lhs & ~rhs).
 //
-// Note that we won't enter the second for loop at all if lhs is not bigger
-// than rhs.  Need to compact only for this case, but it is cheap enough to
-// try (and do nothing) when lhs is bigger than rhs.
+// Blocks of lhs beyond the end of rhs are copied as is.  Need to compact
+// only when lhs is not bigger than rhs, but it is cheap enough to try (and
+// do nothing) when lhs is bigger than rhs.
+//
+// Note that this may be lhs or rhs.
 //
 void BitSet::BuildComplement(const BitSet &lhs, const BitSet &rhs) {
-    blocks_.clear();
-    blocks_.resize(lhs.blocks_.size());
-    size_t minsize = std::min(blocks_.size(), rhs.blocks_.size());
-    for (size_t idx = 0; idx < minsize; idx++) {
-        blocks_[idx] = lhs.blocks_[idx] & ~rhs.blocks_[idx];
+    if (this == &rhs && this != &lhs) {
+        BitSet temp;
+        temp.BuildComplement(lhs, rhs);
+        *this = temp;
+        return;
     }
-    for (size_t idx = minsize; idx < lhs.blocks_.size(); idx++) {
-        blocks_[idx] = lhs.blocks_[idx];
+
+    size_t lhs_size = lhs.size_;
+    size_t minsize = std::min(lhs.size_, rhs.size_);
+    if (this != &lhs) {
+        size_ = 0;
+        resize(lhs_size);
+        memcpy(blocks() + minsize, lhs.blocks() + minsize,
+               (lhs_size - minsize) * sizeof(uint64_t));
     }
+    andnot_blocks(blocks(), lhs.blocks(), rhs.blocks(), minsize);
+    size_ = lhs_size;
     compact();
     check_invariants();
 }
@@ -424,33 +586,17 @@ void BitSet::BuildComplement(const BitSet &lhs, const BitSet &rhs) {
 //
 // Implement (*this = lhs & rhs).
 //
-// We avoid the need to compact or to resize multiple times by building
-// the blocks in reverse order.
-//
-// Note that the for loop does not handle idx 0 since the loop  variable
-// is unsigned.
+// Note that this may be lhs or rhs.
 //
 void BitSet::BuildIntersection(const BitSet &lhs, const BitSet &rhs) {
-    blocks_.clear();
-    size_t minsize = std::min(lhs.blocks_.size(), rhs.blocks_.size());
-
-    if (minsize == 0)
-        return;
-
-    for (size_t idx = minsize - 1; idx > 0; idx--) {
-        if (lhs.blocks_[idx] & rhs.blocks_[idx]) {
-            if (blocks_.size() == 0)
-                blocks_.resize(idx + 1);
-            blocks_[idx] = lhs.blocks_[idx] & rhs.blocks_[idx];
-        }
-    }
-
-    if (lhs.blocks_[0] & rhs.blocks_[0]) {
-        if (blocks_.size() == 0)
-            blocks_.resize(1);
-        blocks_[0] = lhs.blocks_[0] & rhs.blocks_[0];
+    size_t minsize = std::min(lhs.size_, rhs.size_);
+    if (this != &lhs && this != &rhs) {
+        size_ = 0;
+        resize(minsize);
     }
-
+    and_blocks(blocks(), lhs.blocks(), rhs.blocks(), minsize);
+    size_ = minsize;
+    compact();
     check_invariants();
 }
 
@@ -458,13 +604,9 @@ void BitSet::BuildIntersection(const BitSet &lhs, const BitSet &rhs) {
 // Return true if *this contains rhs.  Implemented as (rhs & ~*this != 0).
 //
 bool BitSet::Contains(const BitSet &rhs) const {
-    if (blocks_.size() < rhs.blocks_.size())
+    if (size_ < rhs.size_)
         return false;
-    for (size_t idx = 0; idx < rhs.blocks_.size(); idx++) {
-        if (rhs.blocks_[idx] & ~blocks_[idx])
-            return false;
-    }
-    return true;
+    return !andnot_any(rhs.blocks(), blocks(), rhs.size_);
 }
 
 //
@@ -494,7 +636,7 @@ string BitSet::ToString() const {
 // is unsigned.
 //
 void BitSet::FromString(string str) {
-    blocks_.clear();
+    clear();
 
     if (str.length() == 0)
         return;
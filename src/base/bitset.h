@@ -7,17 +7,29 @@
 
 #include <inttypes.h>
 #include <string>
-#include <vector>
 
 //
 // BitSet automatically resizes the bit set when needed and allows for
 // logical operations between bitsets of different sizes.  Implemented
-// using a vector of uint64_t as the underlying storage.
+// using an array of uint64_t blocks as the underlying storage.
+//
+// Sets of up to kInlineBlocks blocks, which covers the peer and client sets
+// of most deployments, keep the blocks in the object itself and are never
+// allocated on the heap. Larger sets move the blocks to a heap array that
+// is kept, like the capacity of a vector, when the set shrinks.
+//
+// The operations between sets use SIMD instructions when the compiler
+// targets them (SSE2 or AVX2), and plain 64 bit operations otherwise.
 //
 class BitSet {
 public:
     static const size_t npos = static_cast<size_t>(-1);
 
+    BitSet();
+    BitSet(const BitSet &rhs);
+    ~BitSet();
+    BitSet &operator=(const BitSet &rhs);
+
     BitSet &set(size_t pos);
     BitSet &reset(size_t pos);
     bool test(size_t pos) const;
@@ -51,10 +63,22 @@ public:
 private:
     friend class BitSetTest;
 
+    static const size_t kInlineBlocks = 4;
+
+    bool is_inline() const { return capacity_ <= kInlineBlocks; }
+    uint64_t *blocks() { return is_inline() ? inline_ : heap_; }
+    const uint64_t *blocks() const { return is_inline() ? inline_ : heap_; }
+
+    void resize(size_t size);
     void compact();
     void check_invariants();
 
-    std::vector<uint64_t> blocks_;
+    uint32_t size_;         // blocks in use
+    uint32_t capacity_;     // blocks available
+    union {
+        uint64_t inline_[kInlineBlocks];
+        uint64_t *heap_;
+    };
 };
 
 #endif
@@ -9,14 +9,27 @@
 // that drains the queue. The dequeue task runs a maximum of kMaxIterations
 // before yielding.
 //
+// With SetBatchCallback(), the dequeue task hands the entries to the client
+// in batches instead of one at a time.
+//
+// With set_target_latency_usecs(), the number of entries processed before
+// yielding adapts to the observed cost per entry, so that each run of the
+// dequeue task takes about the target latency.
+//
+// SetHighWaterMark() and SetLowWaterMark() notify the client when the queue
+// length crosses the marks, so that producers can be throttled.
+//
 #ifndef __QUEUE_TASK_H__
 #define __QUEUE_TASK_H__
 
+#include <limits>
+#include <vector>
 #include <tbb/atomic.h>
 #include <tbb/concurrent_queue.h>
 #include <tbb/mutex.h>
 
 #include "base/task.h"
+#include "base/util.h"
 
 template <typename QueueEntryT, typename QueueT>
 class QueueTaskRunner : public Task {
@@ -25,25 +38,50 @@ public:
         : Task(queue->GetTaskId(), queue->GetTaskInstance()), queue_(queue) {
     }
 
-    bool RunQueue() {
+    // Returns the number of entries processed.
+    size_t RunQueue(size_t max_entries) {
         QueueEntryT entry = QueueEntryT();
         size_t count = 0;
         
-        while (queue_->Dequeue(&entry)) {
+        while (count < max_entries && queue_->Dequeue(&entry)) {
+            count++;
             // Process the entry
             if (!queue_->GetCallback()(entry)) {
                 break;
             }
+        }
+        return count;
+    }
+
+    // Returns the number of entries processed.
+    size_t RunQueueBatch(size_t max_entries) {
+        typename QueueT::EntryList batch;
+        size_t count = 0;
 
-            if (++count == queue_->max_iterations_) {
-                return queue_->RunnerDone();
+        while (count < max_entries) {
+            size_t batch_size = queue_->max_batch_size_;
+            if (batch_size > max_entries - count) {
+                batch_size = max_entries - count;
+            }
+            batch.clear();
+            QueueEntryT entry = QueueEntryT();
+            while (batch.size() < batch_size && queue_->Dequeue(&entry)) {
+                batch.push_back(entry);
+            }
+            if (batch.empty()) {
+                break;
+            }
+            count += batch.size();
+            queue_->batches_++;
+            // Process the batch
+            if (!queue_->GetBatchCallback()(batch)) {
+                break;
+            }
+            if (batch.size() < batch_size) {
+                break;
             }
         }
-        
-        // Running is done if queue_ is empty
-        // While notification is being run, its possible that more entries
-        // are added into queue_
-        return queue_->RunnerDone();
+        return count;
     }
 
     bool Run() {
@@ -54,7 +92,21 @@ public:
         if (!queue_->OnEntry()) {
             return false;
         }
-        bool done = RunQueue();
+
+        uint64_t start = ClockMonotonicUsec();
+        size_t max_entries = queue_->RunBudget();
+        size_t count;
+        if (queue_->batch_callback_.empty()) {
+            count = RunQueue(max_entries);
+        } else {
+            count = RunQueueBatch(max_entries);
+        }
+        queue_->OnRunDone(count, ClockMonotonicUsec() - start);
+
+        // Running is done if queue_ is empty
+        // While notification is being run, its possible that more entries
+        // are added into queue_
+        bool done = queue_->RunnerDone();
         queue_->OnExit(done);
         return done;
     }
@@ -85,8 +137,13 @@ class WorkQueue {
 public:
     static const int kThreshold = 1024;
     static const int kMaxIterations = 32;
+    // Bound on the entries processed in a run when the target latency is set.
+    static const size_t kMaxAdaptiveEntries = 4096;
     typedef tbb::concurrent_queue<QueueEntryT> Queue;
+    typedef std::vector<QueueEntryT> EntryList;
     typedef boost::function<bool (QueueEntryT)> Callback;
+    typedef boost::function<bool (const EntryList &)> BatchCallback;
+    typedef boost::function<void (size_t)> WaterMarkCallback;
     typedef boost::function<bool (void)> StartRunnerFunc;
     typedef boost::function<void (bool)> TaskExitCallback;
     typedef boost::function<bool ()> TaskEntryCallback;
@@ -106,8 +163,20 @@ public:
         disable_(false),
         deleted_(false),
         enqueues_(0),
-        max_iterations_(max_iterations) {
+        max_iterations_(max_iterations),
+        max_batch_size_(1),
+        target_latency_usecs_(0),
+        entry_cost_nsecs_(0),
+        dequeues_(0),
+        runs_(0),
+        batches_(0),
+        busy_time_usecs_(0),
+        max_run_time_usecs_(0),
+        high_water_mark_(0),
+        low_water_mark_(0) {
         count_ = 0;
+        max_queue_count_ = 0;
+        above_high_water_mark_ = false;
     }
 
     // Concurrency - should be called from a task whose policy
@@ -140,14 +209,32 @@ public:
         queue_.push(entry);
         enqueues_++;
         MayBeStartRunner();
-        return count_.fetch_and_increment() < (kThreshold - 1);
+        long count = count_.fetch_and_increment() + 1;
+        if (count > max_queue_count_) {
+            max_queue_count_ = count;
+        }
+        if (high_water_mark_ && count >= (long) high_water_mark_ &&
+            !above_high_water_mark_ &&
+            !above_high_water_mark_.compare_and_swap(true, false)) {
+            if (!high_water_mark_cb_.empty()) {
+                high_water_mark_cb_(count);
+            }
+        }
+        return count <= (kThreshold - 1);
     }
 
     // Returns true if pop is successful.
     bool Dequeue(QueueEntryT *entry) {
         bool success = queue_.try_pop(*entry);
         if (success) {
-            count_.fetch_and_decrement();
+            long count = count_.fetch_and_decrement() - 1;
+            dequeues_++;
+            if (above_high_water_mark_ && count <= (long) low_water_mark_ &&
+                above_high_water_mark_.compare_and_swap(false, true)) {
+                if (!low_water_mark_cb_.empty()) {
+                    low_water_mark_cb_(count < 0 ? 0 : count);
+                }
+            }
         }
         return success;
     }
@@ -180,6 +267,38 @@ public:
     	return callback_;
     }
 
+    // Process the entries in batches of up to max_batch_size entries. The
+    // batch callback is used instead of the per entry callback.
+    void SetBatchCallback(BatchCallback callback, size_t max_batch_size) {
+        assert(max_batch_size > 0);
+        batch_callback_ = callback;
+        max_batch_size_ = max_batch_size;
+    }
+
+    BatchCallback GetBatchCallback() {
+        return batch_callback_;
+    }
+
+    // Adapt the number of entries processed in a run of the dequeue task so
+    // that the run takes about target_usecs. 0 disables the adaptation.
+    void set_target_latency_usecs(uint64_t target_usecs) {
+        target_latency_usecs_ = target_usecs;
+    }
+    uint64_t target_latency_usecs() const { return target_latency_usecs_; }
+
+    // The high water mark callback is invoked from Enqueue() when the queue
+    // length reaches count. The low water mark callback is then invoked
+    // once, by the dequeue task, when the length drops to the low water mark.
+    void SetHighWaterMark(size_t count, WaterMarkCallback callback) {
+        high_water_mark_ = count;
+        high_water_mark_cb_ = callback;
+    }
+
+    void SetLowWaterMark(size_t count, WaterMarkCallback callback) {
+        low_water_mark_ = count;
+        low_water_mark_cb_ = callback;
+    }
+
     void SetEntryCallback(TaskEntryCallback on_entry) {
         on_entry_cb_ = on_entry;
     }
@@ -230,7 +349,78 @@ public:
         return enqueues_;
     }
 
+    uint64_t DequeueCount() {
+        return dequeues_;
+    }
+
+    uint64_t MaxQueueCount() {
+        return max_queue_count_;
+    }
+
+    // Number of runs of the dequeue task, and of batches in batch mode.
+    uint64_t RunCount() {
+        return runs_;
+    }
+
+    uint64_t BatchCount() {
+        return batches_;
+    }
+
+    uint64_t BusyTimeUsecs() {
+        return busy_time_usecs_;
+    }
+
+    uint64_t MaxRunTimeUsecs() {
+        return max_run_time_usecs_;
+    }
+
+    // Smoothed processing cost of an entry.
+    uint64_t EntryCostNsecs() {
+        return entry_cost_nsecs_;
+    }
+
+    // Maximum number of entries for the next run of the dequeue task. A
+    // max_iterations of 0 means that the queue is drained in one run.
+    size_t RunBudget() const {
+        if (target_latency_usecs_ == 0 || entry_cost_nsecs_ == 0) {
+            if (max_iterations_ == 0) {
+                return std::numeric_limits<size_t>::max();
+            }
+            return max_iterations_ * max_batch_size_;
+        }
+        uint64_t budget = target_latency_usecs_ * 1000 / entry_cost_nsecs_;
+        if (budget == 0) {
+            return 1;
+        }
+        if (budget > kMaxAdaptiveEntries) {
+            return kMaxAdaptiveEntries;
+        }
+        return budget;
+    }
+
 private:
+    // Update the counters and the cost per entry after a run of the dequeue
+    // task. Only the dequeue task updates them, before RunnerDone().
+    void OnRunDone(size_t count, uint64_t usecs) {
+        runs_++;
+        busy_time_usecs_ += usecs;
+        if (usecs > max_run_time_usecs_) {
+            max_run_time_usecs_ = usecs;
+        }
+        if (count == 0) {
+            return;
+        }
+        uint64_t cost = usecs * 1000 / count;
+        if (cost == 0) {
+            cost = 1;
+        }
+        if (entry_cost_nsecs_ == 0) {
+            entry_cost_nsecs_ = cost;
+        } else {
+            entry_cost_nsecs_ = (entry_cost_nsecs_ * 7 + cost) / 8;
+        }
+    }
+
     bool RunnerDone() {
         tbb::mutex::scoped_lock lock(mutex_);
         if (queue_.empty()) {
@@ -263,6 +453,21 @@ private:
     bool deleted_;
     uint64_t enqueues_;
     size_t max_iterations_;
+    BatchCallback batch_callback_;
+    size_t max_batch_size_;
+    uint64_t target_latency_usecs_;
+    uint64_t entry_cost_nsecs_;
+    uint64_t dequeues_;
+    uint64_t runs_;
+    uint64_t batches_;
+    uint64_t busy_time_usecs_;
+    uint64_t max_run_time_usecs_;
+    tbb::atomic<long> max_queue_count_;
+    size_t high_water_mark_;
+    size_t low_water_mark_;
+    WaterMarkCallback high_water_mark_cb_;
+    WaterMarkCallback low_water_mark_cb_;
+    tbb::atomic<bool> above_high_water_mark_;
 
     friend class QueueTaskRunner<QueueEntryT, WorkQueue<QueueEntryT> >;
 
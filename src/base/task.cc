@@ -12,6 +12,7 @@
 #include "tbb/enumerable_thread_specific.h"
 #include "base/logging.h"
 #include "base/task.h"
+#include "base/task_histogram.h"
 
 using namespace std;
 using namespace tbb;
@@ -33,13 +34,16 @@ boost::scoped_ptr<TaskScheduler> TaskScheduler::singleton_;
 // registered with tbb::task
 class TaskImpl : public tbb::task {
 public:
-    TaskImpl(Task *t) : parent_(t) {};
+    TaskImpl(Task *t, TaskEntry *affinity_entry)
+        : parent_(t), affinity_entry_(affinity_entry) {};
     virtual ~TaskImpl();
 
 private:
     tbb::task *execute();
+    void note_affinity(affinity_id id);
 
     Task    *parent_;
+    TaskEntry *affinity_entry_; // Entry to record the worker thread in
 
     DISALLOW_COPY_AND_ASSIGN(TaskImpl);
 };
@@ -66,6 +70,9 @@ private:
 //            have this as NULL
 //            Running task is not in waitq_ or deferq_
 // run_count_: Number of running tasks for this TaskEntry
+// affinity_ : Worker thread that last ran a task of this entry, used only if
+//            affinity is enabled for the task group
+// latency_  : Latency histograms, allocated once measurement is enabled
 class TaskEntry {
 public:
     TaskEntry(int task_id);
@@ -90,6 +97,14 @@ public:
     void ClearTaskStats();
     void ClearQueues();
     int GetTaskDeferEntrySeqno() const;
+    void FastPathTaskStarted() { fast_path_run_count_++; }
+    void EnableLatency();
+    TaskLatency *latency() { return latency_.get(); }
+    void TaskBlocked(Task *t);
+    void RecordStart(Task *t);
+    void RecordExit(Task *t);
+    tbb::task::affinity_id affinity() const { return affinity_; }
+    void set_affinity(tbb::task::affinity_id id) { affinity_ = id; }
 
 private:
     friend class TaskGroup;
@@ -115,9 +130,14 @@ private:
     TaskDeferList   *deferq_;    // Tasks deferred for this to exit
     TaskEntry       *deferq_task_entry_;
     TaskGroup       *deferq_task_group_;
+    // Set by the worker threads that run the tasks of the entry
+    tbb::atomic<tbb::task::affinity_id> affinity_;
+    boost::scoped_ptr<TaskLatency> latency_;
 
     // Cummulative Maintenance stats
     TaskStats       stats_;
+    // Runs started by the fast path, folded into stats_ when read
+    tbb::atomic<int> fast_path_run_count_;
 
     DISALLOW_COPY_AND_ASSIGN(TaskEntry);
 };
@@ -137,6 +157,9 @@ struct TaskDeferEntryCmp {
 // run_count_   : Number of tasks running in context of this task-group
 // deferq_      : Tasks deferred till run_count_ on this task becomes 0
 // task_entry_  : Default TaskEntry used for task without an instance
+// unconstrained_: No policy refers to the group, so tasks without an instance
+//                can be started by the fast path
+// affinity_    : Run the tasks of an instance on the same worker thread
 class TaskGroup {
 public:
     TaskGroup(int task_id);
@@ -153,14 +176,21 @@ public:
     int  TaskRunCount() const {return run_count_;};
     void RunDeferQ();
     void TaskExited(Task *t);
+    bool FastPathTaskExited();
     void PolicySet();
     void TaskStarted() {run_count_++;};
+    bool unconstrained() const { return unconstrained_; }
+    bool affinity() const { return affinity_; }
+    void set_affinity(bool affinity) { affinity_ = affinity; }
     TaskStats *GetTaskGroupStats();
     TaskStats *GetTaskStats();
     TaskStats *GetTaskStats(int task_instance);
     void ClearTaskGroupStats();
     void ClearTaskStats();
     void ClearTaskStats(int instance_id);
+    void EnableLatency();
+    void ClearLatency();
+    void VisitTaskLatency(TaskScheduler::TaskLatencyVisitor visitor);
 
     int task_id() const { return task_id_; }
     int deferq_size() const { return deferq_.size(); }
@@ -191,7 +221,9 @@ private:
     static const int        kVectorGrowSize = 16;
     int                     task_id_;
     bool                    policy_set_;// policy already set?
-    int                     run_count_; // # of tasks running in the group
+    tbb::atomic<int>        run_count_; // # of tasks running in the group
+    tbb::atomic<bool>       unconstrained_;
+    bool                    affinity_;
 
     TaskGroupPolicyList     policy_;    // Policy rules for the group
     TaskDeferList           deferq_;    // Tasks deferred till run_count_ is 0
@@ -236,6 +268,14 @@ tbb::task *TaskImpl::execute() {
     return NULL;
 }
 
+// Called by tbb when the task is run by a worker thread other than the one
+// it has affinity to. Remember the thread for the next task of the entry.
+void TaskImpl::note_affinity(affinity_id id) {
+    if (affinity_entry_ != NULL) {
+        affinity_entry_->set_affinity(id);
+    }
+}
+
 // Destructor called when a task execution is compeleted. Invoked
 // implicitly by tbb::task. 
 // Invokes OnTaskExit to schedule tasks pending tasks
@@ -246,6 +286,24 @@ TaskImpl::~TaskImpl() {
     sched->OnTaskExit(parent_);
 }
 
+// The fast path is enabled with TASK_SCHEDULER_FAST_PATH=1. Otherwise all
+// tasks go through the scheduler mutex.
+static bool GetFastPathEnable() {
+    char *enable_str = getenv("TASK_SCHEDULER_FAST_PATH");
+    if (enable_str == NULL) {
+        return false;
+    }
+    return strtol(enable_str, NULL, 0) != 0;
+}
+
+static bool GetLatencyEnable() {
+    char *enable_str = getenv("TASK_SCHEDULER_LATENCY");
+    if (enable_str == NULL) {
+        return false;
+    }
+    return strtol(enable_str, NULL, 0) != 0;
+}
+
 // XXX For testing purposes only. Limit the number of tbb worker threads.
 int TaskScheduler::GetThreadCount() {
     static bool init_;
@@ -276,9 +334,12 @@ int TaskScheduler::GetThreadCount() {
 // part of tbb. So, initialize TBB with one thread more than its default
 TaskScheduler::TaskScheduler() : 
     task_scheduler_(GetThreadCount() + 1),
-    running_(true), seqno_(0), id_max_(0) {
+    seqno_(0), id_max_(0) {
+    running_ = true;
+    fast_path_ = GetFastPathEnable();
+    latency_ = GetLatencyEnable();
     hw_thread_count_ = GetThreadCount();
-    task_group_db_.resize(TaskScheduler::kVectorGrowSize);
+    task_group_db_.grow_to_at_least(TaskScheduler::kVectorGrowSize);
     stop_entry_ = new TaskEntry(-1);
 }
 
@@ -323,7 +384,8 @@ TaskGroup *TaskScheduler::GetTaskGroup(int task_id) {
     assert(task_id >= 0);
     int size = task_group_db_.size();
     if (size <= task_id) {
-        task_group_db_.resize(task_id + TaskScheduler::kVectorGrowSize);
+        task_group_db_.grow_to_at_least(task_id +
+                                        TaskScheduler::kVectorGrowSize);
     }
 
     TaskGroup *group = task_group_db_[task_id];
@@ -343,7 +405,11 @@ TaskGroup *TaskScheduler::QueryTaskGroup(int task_id) {
 // Get TaskGroup for a task_id. Grows task_entry_db_ if necessary
 TaskEntry *TaskScheduler::GetTaskEntry(int task_id, int task_instance) {
     TaskGroup *group = GetTaskGroup(task_id);
-    return group->GetTaskEntry(task_instance);
+    TaskEntry *entry = group->GetTaskEntry(task_instance);
+    if (latency_) {
+        entry->EnableLatency();
+    }
+    return entry;
 }
 
 // Query TaskEntry for a task-id and task-instance 
@@ -387,14 +453,58 @@ void TaskScheduler::SetPolicy(int task_id, TaskPolicy &policy) {
     }
 }
 
+void TaskScheduler::EnableAffinity(int task_id) {
+    tbb::mutex::scoped_lock     lock(mutex_);
+
+    TaskGroup *group = GetTaskGroup(task_id);
+    group->set_affinity(true);
+}
+
 // Enqueue a Task for running. Starts task if all policy rules are met else 
 // puts task in waitq
 void TaskScheduler::Enqueue(Task *t) {
+    if (latency_) {
+        t->enqueue_time_ = ClockMonotonicUsec();
+    }
+    if (EnqueueFastPath(t)) {
+        return;
+    }
+
     tbb::mutex::scoped_lock     lock(mutex_);
 
     EnqueueUnLocked(t);
 }
 
+// Start a task without an instance right away if no policy refers to its
+// TaskGroup. Such a task can't be deferred, so there's no state to update
+// other than the run counts, which are atomic.
+//
+// The TaskGroup is created by the first task enqueued through the slow path.
+// The waitq_ of the TaskEntry can only be populated while the scheduler is
+// stopped, and Start() runs the waitq_ before the fast path is resumed.
+bool TaskScheduler::EnqueueFastPath(Task *t) {
+    if (!fast_path_ || !running_ || t->GetTaskInstance() != -1) {
+        return false;
+    }
+
+    int task_id = t->GetTaskId();
+    if (task_id < 0 || (size_t) task_id >= task_group_db_.size()) {
+        return false;
+    }
+    TaskGroup *group = task_group_db_[task_id];
+    if (group == NULL || !group->unconstrained()) {
+        return false;
+    }
+
+    TaskEntry *entry = group->QueryTaskEntry(-1);
+    entry->FastPathTaskStarted();
+    entry->RecordStart(t);
+    group->TaskStarted();
+    t->fast_path_ = true;
+    t->StartTask(NULL);
+    return true;
+}
+
 void TaskScheduler::EnqueueUnLocked(Task *t) {
     t->SetSeqNo(++seqno_);
     TaskGroup *group = GetTaskGroup(t->GetTaskId());
@@ -483,12 +593,44 @@ TaskScheduler::CancelReturnCode TaskScheduler::Cancel(Task *t) {
     return QUEUED;
 }
 
+// Method invoked on exit of a task started by the fast path. The mutex is
+// needed only if a policy was set on the group while the task was running,
+// in which case tasks may have been deferred on the group.
+void TaskScheduler::OnFastPathTaskExit(Task *t) {
+    TaskGroup *group = QueryTaskGroup(t->GetTaskId());
+    group->QueryTaskEntry(-1)->RecordExit(t);
+    t->fast_path_ = false;
+    if (group->FastPathTaskExited()) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        if (group->TaskRunCount() == 0) {
+            group->RunDeferQ();
+        }
+    }
+
+    if ((t->task_recycle_ == false) || (t->task_cancel_ == true)) {
+        if (t->task_cancel_ == true) {
+            t->OnTaskCancel();
+        }
+        delete t;
+        return;
+    }
+
+    t->task_impl_ = NULL;
+    Enqueue(t);
+}
+
 // Method invoked on exit of a Task.
 // Exit of a task can potentially start tasks in pendingq.
 void TaskScheduler::OnTaskExit(Task *t) {
+    if (t->fast_path_) {
+        OnFastPathTaskExit(t);
+        return;
+    }
+
     tbb::mutex::scoped_lock lock(mutex_);
 
     TaskEntry *entry = QueryTaskEntry(t->GetTaskId(), t->GetTaskInstance());
+    entry->RecordExit(t);
     entry->TaskExited(t, GetTaskGroup(t->GetTaskId()));
 
     //
@@ -506,6 +648,9 @@ void TaskScheduler::OnTaskExit(Task *t) {
     }
 
     t->task_impl_ = NULL;
+    if (latency_) {
+        t->enqueue_time_ = ClockMonotonicUsec();
+    }
     EnqueueUnLocked(t);
 }
 
@@ -518,10 +663,11 @@ void TaskScheduler::Stop() {
 void TaskScheduler::Start() {
     tbb::mutex::scoped_lock             lock(mutex_);
 
-    running_ = true;
-
-    // Run all tasks that may be suspended
+    // Run all tasks that may be suspended. This is done before running_ is
+    // set, so that the fast path can't start tasks ahead of them.
     stop_entry_->RunDeferQ();
+
+    running_ = true;
     return;
 }
 
@@ -577,6 +723,57 @@ int TaskScheduler::GetTaskId(const string &name) {
     return tid;
 }
 
+string TaskScheduler::GetTaskName(int task_id) {
+    tbb::reader_writer_lock::scoped_lock_read lock(id_map_mutex_);
+    for (TaskIdMap::iterator loc = id_map_.begin(); loc != id_map_.end();
+         ++loc) {
+        if (loc->second == task_id) {
+            return loc->first;
+        }
+    }
+    return "";
+}
+
+// Allocate the histograms of all existing TaskEntries when enabled. Entries
+// created later get them in GetTaskEntry().
+void TaskScheduler::EnableLatency(bool enable) {
+    tbb::mutex::scoped_lock lock(mutex_);
+
+    if (enable) {
+        for (TaskGroupDb::iterator it = task_group_db_.begin();
+             it != task_group_db_.end(); ++it) {
+            if (*it != NULL) {
+                (*it)->EnableLatency();
+            }
+        }
+    }
+    latency_ = enable;
+}
+
+void TaskScheduler::ClearLatency() {
+    tbb::mutex::scoped_lock lock(mutex_);
+
+    for (TaskGroupDb::iterator it = task_group_db_.begin();
+         it != task_group_db_.end(); ++it) {
+        if (*it != NULL) {
+            (*it)->ClearLatency();
+        }
+    }
+}
+
+// Invoke the visitor for every <task-id, task-instance> that has latency
+// histograms.
+void TaskScheduler::VisitTaskLatency(TaskLatencyVisitor visitor) {
+    tbb::mutex::scoped_lock lock(mutex_);
+
+    for (TaskGroupDb::iterator it = task_group_db_.begin();
+         it != task_group_db_.end(); ++it) {
+        if (*it != NULL) {
+            (*it)->VisitTaskLatency(visitor);
+        }
+    }
+}
+
 void TaskScheduler::ClearTaskGroupStats(int task_id) {
     TaskGroup *group = GetTaskGroup(task_id);
     if (group == NULL)
@@ -689,7 +886,9 @@ void TaskScheduler::ClearRunningTask() {
 ////////////////////////////////////////////////////////////////////////////
 
 TaskGroup::TaskGroup(int task_id) : task_id_(task_id), policy_set_(false), 
-    run_count_(0) {
+    affinity_(false) {
+    run_count_ = 0;
+    unconstrained_ = true;
     task_entry_db_.resize(TaskGroup::kVectorGrowSize);
     task_entry_ = new TaskEntry(task_id);
     memset(&stats_, 0, sizeof(stats_));
@@ -739,6 +938,7 @@ TaskEntry *TaskGroup::QueryTaskEntry(int task_instance) {
 }
 
 void TaskGroup::AddPolicy(TaskGroup *group) {
+    unconstrained_ = false;
     policy_.push_back(group);
 }
 
@@ -761,6 +961,7 @@ bool TaskGroup::DeferOnPolicyFail(TaskEntry *entry, Task *task) {
         if (0 == entry->WaitQSize()) {
             entry->AddToWaitQ(task);
         }
+        entry->TaskBlocked(task);
         group->AddToDeferQ(entry);
         return true;
     }
@@ -786,6 +987,7 @@ void TaskGroup::DeleteFromDeferQ(TaskEntry &entry) {
 void TaskGroup::PolicySet() {
     assert(policy_set_ == false);
     policy_set_ = true;
+    unconstrained_ = false;
 }
 
 // Start executing tasks from deferq_ of a TaskGroup
@@ -807,6 +1009,12 @@ inline void TaskGroup::TaskExited(Task *t) {
     run_count_--;
 }
 
+// Returns true if the deferq_ needs to be run.
+bool TaskGroup::FastPathTaskExited() {
+    int count = --run_count_;
+    return (count == 0 && !unconstrained_);
+}
+
 // Returns true, if the waiq_ of all the tasks in the group are empty.
 //
 // Note: This function is invoked from TaskScheduler::IsEmpty() for each
@@ -863,6 +1071,40 @@ TaskStats *TaskGroup::GetTaskStats(int task_instance) {
     return entry->GetTaskStats();
 }
 
+void TaskGroup::EnableLatency() {
+    task_entry_->EnableLatency();
+    for (TaskEntryList::iterator it = task_entry_db_.begin();
+         it != task_entry_db_.end(); ++it) {
+        if (*it != NULL) {
+            (*it)->EnableLatency();
+        }
+    }
+}
+
+void TaskGroup::ClearLatency() {
+    if (task_entry_->latency()) {
+        task_entry_->latency()->Clear();
+    }
+    for (TaskEntryList::iterator it = task_entry_db_.begin();
+         it != task_entry_db_.end(); ++it) {
+        if (*it != NULL && (*it)->latency() != NULL) {
+            (*it)->latency()->Clear();
+        }
+    }
+}
+
+void TaskGroup::VisitTaskLatency(TaskScheduler::TaskLatencyVisitor visitor) {
+    if (task_entry_->latency()) {
+        visitor(task_id_, -1, *task_entry_->latency());
+    }
+    for (size_t i = 0; i < task_entry_db_.size(); i++) {
+        TaskEntry *entry = task_entry_db_[i];
+        if (entry != NULL && entry->latency() != NULL) {
+            visitor(task_id_, i, *entry->latency());
+        }
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////
 // Implementation for class TaskEntry 
 ////////////////////////////////////////////////////////////////////////////
@@ -876,6 +1118,8 @@ TaskEntry::TaskEntry(int task_id, int task_instance) : task_id_(task_id),
         policyq_.push_back(this);
     }
     memset(&stats_, 0, sizeof(stats_));
+    fast_path_run_count_ = 0;
+    affinity_ = 0;
     // allocate memory for deferq
     deferq_ = new TaskDeferList;
 }
@@ -884,6 +1128,8 @@ TaskEntry::TaskEntry(int task_id) : task_id_(task_id),
     task_instance_(-1), run_count_(0), run_task_(NULL),
     deferq_task_entry_(NULL), deferq_task_group_(NULL) {
     memset(&stats_, 0, sizeof(stats_));
+    fast_path_run_count_ = 0;
+    affinity_ = 0;
     // allocate memory for deferq
     deferq_ = new TaskDeferList;
 }
@@ -920,6 +1166,7 @@ bool TaskEntry::DeferOnPolicyFail(Task *task) {
         if (0 == WaitQSize()) {
             AddToWaitQ(task);
         }
+        TaskBlocked(task);
         policy_entry->AddToDeferQ(this);
         return true;
     }
@@ -974,8 +1221,13 @@ void TaskEntry::RunTask (Task *t) {
     TaskScheduler *scheduler = TaskScheduler::GetInstance();
     TaskGroup *group = scheduler->QueryTaskGroup(t->GetTaskId());
     group->TaskStarted();
+    RecordStart(t);
 
-    t->StartTask();
+    if (group->affinity() && task_instance_ != -1) {
+        t->StartTask(this);
+    } else {
+        t->StartTask(NULL);
+    }
 }
 
 void TaskEntry::RunWaitQ() {
@@ -1105,12 +1357,56 @@ void TaskEntry::ClearQueues() {
 
 void TaskEntry::ClearTaskStats() {
     memset(&stats_, 0, sizeof(stats_));
+    fast_path_run_count_ = 0;
 }
 
 TaskStats *TaskEntry::GetTaskStats() {
+    stats_.run_count_ += fast_path_run_count_.fetch_and_store(0);
     return &stats_;
 }
 
+void TaskEntry::EnableLatency() {
+    if (latency_.get() == NULL) {
+        latency_.reset(new TaskLatency);
+    }
+}
+
+// The task at the head of the waitq_ is deferred by a policy. Only the first
+// deferral is recorded, the task may be deferred again before it runs.
+void TaskEntry::TaskBlocked(Task *t) {
+    if (t->enqueue_time_ != 0 && t->blocked_time_ == 0) {
+        t->blocked_time_ = ClockMonotonicUsec();
+    }
+}
+
+// Record the wait and blocked times of a task that's being started. Tasks
+// enqueued while the measurement was disabled are not recorded.
+void TaskEntry::RecordStart(Task *t) {
+    if (t->enqueue_time_ == 0)
+        return;
+
+    uint64_t now = ClockMonotonicUsec();
+    if (latency_.get() != NULL) {
+        latency_->wait_.Record(now - t->enqueue_time_);
+        if (t->blocked_time_ != 0) {
+            latency_->blocked_.Record(now - t->blocked_time_);
+        }
+    }
+    t->enqueue_time_ = 0;
+    t->blocked_time_ = 0;
+    t->start_time_ = now;
+}
+
+void TaskEntry::RecordExit(Task *t) {
+    if (t->start_time_ == 0)
+        return;
+
+    if (latency_.get() != NULL) {
+        latency_->run_.Record(ClockMonotonicUsec() - t->start_time_);
+    }
+    t->start_time_ = 0;
+}
+
 // Addition/deletion of TaskEntry in the deferq_ is based on the seqno. 
 // seqno of the first Task in the waitq_ is used as the key. This function 
 // would be invoked by the comparison function during addition/deletion 
@@ -1129,19 +1425,27 @@ int TaskEntry::GetTaskDeferEntrySeqno() const {
 ////////////////////////////////////////////////////////////////////////////
 Task::Task(int task_id, int task_instance) : task_id_(task_id),
     task_instance_(task_instance), task_impl_(NULL), state_(INIT), seqno_(0),
-    task_recycle_(false), task_cancel_(false) {
+    task_recycle_(false), fast_path_(false),
+    enqueue_time_(0), blocked_time_(0), start_time_(0) {
+    task_cancel_ = false;
 }
 
 Task::Task(int task_id) : task_id_(task_id),
     task_instance_(-1), task_impl_(NULL), state_(INIT), seqno_(0),
-    task_recycle_(false), task_cancel_(false) {
+    task_recycle_(false), fast_path_(false),
+    enqueue_time_(0), blocked_time_(0), start_time_(0) {
+    task_cancel_ = false;
 }
 
-// Start execution of task
-void Task::StartTask() {
+// Start execution of task. If affinity_entry is set, the task is spawned
+// with affinity to the worker thread that last ran a task of the entry.
+void Task::StartTask(TaskEntry *affinity_entry) {
     assert(task_impl_ == NULL);
     state_ = RUN;
-    task_impl_ = new (task::allocate_root())TaskImpl(this);
+    task_impl_ = new (task::allocate_root())TaskImpl(this, affinity_entry);
+    if (affinity_entry != NULL && affinity_entry->affinity() != 0) {
+        task_impl_->set_affinity(affinity_entry->affinity());
+    }
     task::spawn(*task_impl_);
 }
 
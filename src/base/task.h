@@ -27,13 +27,21 @@
 //
 // When there are multiple tasks ready to run, they are scheduled in their
 // order of enqueue
+//
+// Tasks without an instance, whose task-id has no policy, can't conflict with
+// any other task. They are handed to tbb as soon as they are enqueued without
+// taking the scheduler mutex, and tbb's per-thread deques and work stealing
+// spread them over the worker threads.
 
 #ifndef ctrlplane_task_h
 #define ctrlplane_task_h
 
+#include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <map>
 #include <vector>
+#include <tbb/atomic.h>
+#include <tbb/concurrent_vector.h>
 #include <tbb/mutex.h>
 #include <tbb/reader_writer_lock.h>
 #include <tbb/task.h>
@@ -42,6 +50,7 @@
 
 class TaskGroup;
 class TaskEntry;
+struct TaskLatency;
 
 struct TaskStats {
     int     wait_count_;
@@ -102,7 +111,7 @@ private:
     void SetState(State s) { state_ = s; };
     void SetTaskRecycle() { task_recycle_ = true; };
     void SetTaskComplete() { task_recycle_ = false; };
-    void StartTask();
+    void StartTask(TaskEntry *affinity_entry);
 
     int                 task_id_;       // The code path executed by the task.
     int                 task_instance_; // The dataset id within a code path.
@@ -110,7 +119,12 @@ private:
     State               state_;
     uint32_t            seqno_;
     bool                task_recycle_;
-    bool                task_cancel_;
+    tbb::atomic<bool>   task_cancel_;
+    bool                fast_path_;     // Started without scheduler mutex
+    // Timestamps for the latency measurement, 0 if not measured
+    uint64_t            enqueue_time_;
+    uint64_t            blocked_time_;
+    uint64_t            start_time_;
 
     DISALLOW_COPY_AND_ASSIGN(Task);
 };
@@ -144,11 +158,36 @@ public:
     };
     CancelReturnCode Cancel(Task *task);
 
-    // Set the task exclusion policy.
+    // Set the task exclusion policy. The policy is expected to be set before
+    // any task with the task_id is enqueued.
     void SetPolicy(int task_id, TaskPolicy &policy);
 
+    // Hint that tasks of each instance of task_id should run on the worker
+    // thread that last ran the instance, so that the data of the instance
+    // stays in the cache of that core.
+    void EnableAffinity(int task_id);
+
+    // Enable or disable the lock-free enqueue of tasks that can't conflict
+    // with any other task. Disabled unless TASK_SCHEDULER_FAST_PATH=1. When
+    // enabled, policies must be set before any task of the groups they refer
+    // to is enqueued.
+    void set_fast_path(bool enable) { fast_path_ = enable; }
+    bool fast_path() const { return fast_path_; }
+
+    // Measure the wait, run and policy blocked times of tasks in histograms
+    // per <task-id, task-instance>. Disabled unless TASK_SCHEDULER_LATENCY=1,
+    // in which case enqueue, start and exit only check a flag.
+    typedef boost::function<void(int task_id, int task_instance,
+                                 const TaskLatency &latency)>
+        TaskLatencyVisitor;
+    void EnableLatency(bool enable);
+    bool latency_enabled() const { return latency_; }
+    void ClearLatency();
+    void VisitTaskLatency(TaskLatencyVisitor visitor);
+
     bool GetRunStatus() { return running_; };
     int GetTaskId(const std::string &name);
+    std::string GetTaskName(int task_id);
 
     TaskStats *GetTaskGroupStats(int task_id);
     TaskStats *GetTaskStats(int task_id);
@@ -177,7 +216,8 @@ public:
 
 private:
     friend class ConcurrencyScope;
-    typedef std::vector<TaskGroup *> TaskGroupDb;
+    // The vector is grown under mutex_, but read without it in the fast path.
+    typedef tbb::concurrent_vector<TaskGroup *> TaskGroupDb;
     typedef std::map<std::string, int> TaskIdMap;
 
     static const int        kVectorGrowSize = 16;
@@ -190,12 +230,16 @@ private:
     void SetRunningTask(Task *);
     void ClearRunningTask();
     void WaitForTerminateCompletion();
+    bool EnqueueFastPath(Task *task);
+    void OnFastPathTaskExit(Task *task);
 
     TaskEntry               *stop_entry_;
 
     tbb::task_scheduler_init task_scheduler_;
     tbb::mutex              mutex_;
-    bool                    running_;
+    tbb::atomic<bool>       running_;
+    tbb::atomic<bool>       fast_path_;
+    tbb::atomic<bool>       latency_;
     int                     seqno_;
     TaskGroupDb             task_group_db_;
 
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef ctrlplane_task_histogram_h
+#define ctrlplane_task_histogram_h
+
+#include <stdint.h>
+#include <tbb/atomic.h>
+
+#include "base/util.h"
+
+//
+// Log-linear histogram of durations in usec, in the style of HdrHistogram.
+// Values are bucketed by their most significant bit, and each power of two
+// is split into kSubBuckets linear sub-buckets. This bounds the error of the
+// reported percentiles to 1/kSubBuckets of the value, while a histogram that
+// covers up to kMaxValue takes only kBuckets counters.
+//
+// Record() is lock free, so that tasks can be measured from any thread.
+// Readers may see a histogram that is being updated, which is fine for
+// statistics.
+//
+class TaskHistogram {
+public:
+    static const int kSubBucketBits = 2;
+    static const int kSubBuckets = 1 << kSubBucketBits;
+    static const int kMaxShift = 34;
+    static const int kBuckets = (kMaxShift + 2) * kSubBuckets;
+    static const uint64_t kMaxValue =
+        ((uint64_t) (2 * kSubBuckets) << kMaxShift) - 1;
+
+    TaskHistogram() { Clear(); }
+
+    void Record(uint64_t value) {
+        if (value > kMaxValue) {
+            value = kMaxValue;
+        }
+        counts_[BucketIndex(value)]++;
+        count_++;
+        sum_ += value;
+        uint64_t max = max_;
+        while (value > max) {
+            uint64_t prev = max_.compare_and_swap(value, max);
+            if (prev == max)
+                break;
+            max = prev;
+        }
+    }
+
+    void Clear() {
+        for (int i = 0; i < kBuckets; i++) {
+            counts_[i] = 0;
+        }
+        count_ = 0;
+        sum_ = 0;
+        max_ = 0;
+    }
+
+    // Add the samples of another histogram to this one.
+    void Merge(const TaskHistogram &rhs) {
+        for (int i = 0; i < kBuckets; i++) {
+            counts_[i] += rhs.counts_[i];
+        }
+        count_ += rhs.count_;
+        sum_ += rhs.sum_;
+        if (rhs.max_ > max_) {
+            max_ = (uint64_t) rhs.max_;
+        }
+    }
+
+    // Returns the highest value that is equivalent to the percentile, or 0
+    // if the histogram is empty. The percentile is in the range [0, 100].
+    uint64_t Percentile(double percentile) const {
+        uint64_t count = count_;
+        if (count == 0)
+            return 0;
+        uint64_t rank = (uint64_t) (percentile * count / 100.0 + 0.5);
+        if (rank == 0)
+            rank = 1;
+        uint64_t total = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            total += counts_[i];
+            if (total >= rank) {
+                uint64_t value = BucketLowerBound(i + 1) - 1;
+                return (value < max_) ? value : (uint64_t) max_;
+            }
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    uint64_t mean() const {
+        uint64_t count = count_;
+        return count ? sum_ / count : 0;
+    }
+
+    static int BucketIndex(uint64_t value) {
+        if (value < (uint64_t) kSubBuckets)
+            return value;
+        int msb = 63 - __builtin_clzll(value);
+        int shift = msb - kSubBucketBits;
+        return (shift + 1) * kSubBuckets +
+            (int) ((value >> shift) - kSubBuckets);
+    }
+
+    static uint64_t BucketLowerBound(int index) {
+        if (index < kSubBuckets)
+            return index;
+        int shift = index / kSubBuckets - 1;
+        int sub = index % kSubBuckets;
+        return (uint64_t) (kSubBuckets + sub) << shift;
+    }
+
+private:
+    tbb::atomic<uint32_t> counts_[kBuckets];
+    tbb::atomic<uint64_t> count_;
+    tbb::atomic<uint64_t> sum_;
+    tbb::atomic<uint64_t> max_;
+
+    DISALLOW_COPY_AND_ASSIGN(TaskHistogram);
+};
+
+//
+// Latency of the tasks of a <task-id, task-instance>.
+// wait_    : time from enqueue to start
+// run_     : time from start to exit of Run()
+// blocked_ : time from the first deferral on a policy to start, only for the
+//            tasks deferred because a conflicting task was running
+//
+struct TaskLatency {
+    TaskHistogram wait_;
+    TaskHistogram run_;
+    TaskHistogram blocked_;
+
+    void Clear() {
+        wait_.Clear();
+        run_.Clear();
+        blocked_.Clear();
+    }
+    void Merge(const TaskLatency &rhs) {
+        wait_.Merge(rhs.wait_);
+        run_.Merge(rhs.run_);
+        blocked_.Merge(rhs.blocked_);
+    }
+};
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <base/taskinfo.h>
+
+#include <map>
+#include <boost/bind.hpp>
+
+#include "base/task.h"
+#include "base/task_histogram.h"
+#include "base/util.h"
+
+using namespace std;
+
+typedef map<int, TaskLatency *> TaskLatencyMap;
+
+static void FillHistogram(TaskLatencyHistogram *info,
+                          const TaskHistogram &histogram) {
+    info->set_count(histogram.count());
+    info->set_mean(histogram.mean());
+    info->set_p50(histogram.Percentile(50));
+    info->set_p90(histogram.Percentile(90));
+    info->set_p99(histogram.Percentile(99));
+    info->set_max(histogram.max());
+}
+
+static void FillLatency(TaskLatencyInfo *info, const string &name,
+                        int task_id, int task_instance,
+                        const TaskLatency &latency) {
+    info->set_task_name(name);
+    info->set_task_id(task_id);
+    info->set_task_instance(task_instance);
+    TaskLatencyHistogram histogram;
+    FillHistogram(&histogram, latency.wait_);
+    info->set_wait(histogram);
+    FillHistogram(&histogram, latency.run_);
+    info->set_run(histogram);
+    FillHistogram(&histogram, latency.blocked_);
+    info->set_blocked(histogram);
+}
+
+static void VisitLatency(vector<TaskLatencyInfo> *list,
+                         TaskLatencyMap *latency_map, const string &task_name,
+                         int task_id, int task_instance,
+                         const TaskLatency &latency) {
+    if (latency.wait_.count() == 0 && latency.run_.count() == 0)
+        return;
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    string name = scheduler->GetTaskName(task_id);
+    if (!task_name.empty() && name != task_name)
+        return;
+
+    if (latency_map == NULL) {
+        list->push_back(TaskLatencyInfo());
+        FillLatency(&list->back(), name, task_id, task_instance, latency);
+        return;
+    }
+
+    TaskLatencyMap::iterator loc = latency_map->find(task_id);
+    if (loc == latency_map->end()) {
+        loc = latency_map->insert(make_pair(task_id, new TaskLatency)).first;
+    }
+    loc->second->Merge(latency);
+}
+
+void TaskLatencyData::FillTaskLatencyInfo(vector<TaskLatencyInfo> *list,
+                                          const string &task_name,
+                                          bool per_instance) {
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    TaskLatencyMap latency_map;
+    scheduler->VisitTaskLatency(boost::bind(&VisitLatency, list,
+        per_instance ? NULL : &latency_map, task_name, _1, _2, _3));
+
+    for (TaskLatencyMap::iterator it = latency_map.begin();
+         it != latency_map.end(); ++it) {
+        list->push_back(TaskLatencyInfo());
+        FillLatency(&list->back(), scheduler->GetTaskName(it->first),
+                    it->first, -1, *it->second);
+    }
+    STLDeleteElements(&latency_map);
+}
+
+void TaskLatencyReq::HandleRequest() const {
+    vector<TaskLatencyInfo> list;
+    TaskLatencyData::FillTaskLatencyInfo(&list, get_task_name(),
+                                         get_per_instance());
+
+    TaskLatencyResp *resp = new TaskLatencyResp;
+    resp->set_enabled(TaskScheduler::GetInstance()->latency_enabled());
+    resp->set_task_latency_list(list);
+    resp->set_context(context());
+    resp->Response();
+}
+
+void TaskLatencyConfigReq::HandleRequest() const {
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    scheduler->EnableLatency(get_enable());
+    if (get_clear()) {
+        scheduler->ClearLatency();
+    }
+
+    TaskLatencyResp *resp = new TaskLatencyResp;
+    resp->set_enabled(scheduler->latency_enabled());
+    resp->set_context(context());
+    resp->Response();
+}
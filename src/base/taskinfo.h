@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef ctrlplane_taskinfo_h
+#define ctrlplane_taskinfo_h
+
+#include <string>
+#include <vector>
+
+#include <sandesh/sandesh_types.h>
+#include <sandesh/sandesh.h>
+
+#include <base/sandesh/taskinfo_types.h>
+
+class TaskLatencyData {
+public:
+    // Fill the latency of the tasks with the given name, or of all tasks if
+    // the name is empty. The instances of a task are aggregated unless
+    // per_instance is set.
+    static void FillTaskLatencyInfo(std::vector<TaskLatencyInfo> *list,
+                                    const std::string &task_name,
+                                    bool per_instance);
+};
+
+#endif // ctrlplane_taskinfo_h
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <stdlib.h>
+
+#include "base/bitset.h"
+#include "base/logging.h"
+#include "base/util.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+//
+// Runs the BitSet operations that the IFMapExporter and SchedulingGroup
+// use on their hot paths on sets that fit in the inline storage and on sets
+// that don't, checks the results bit by bit and logs the time they take.
+// The number of iterations can be set with the environment variable
+// BITSET_BENCH_TEST_ITERATIONS.
+//
+
+namespace {
+
+// Sizes in bits of the sets: inline, largest inline and heap.
+static const size_t kSizes[] = { 64, 256, 1024 };
+
+class BitSetBenchTest : public ::testing::Test {
+protected:
+    BitSetBenchTest() : iterations_(100000) {
+        const char *iterations = getenv("BITSET_BENCH_TEST_ITERATIONS");
+        if (iterations != NULL) {
+            iterations_ = strtoul(iterations, NULL, 0);
+        }
+    }
+
+    // Set every stride bit from offset up to size bits.
+    static BitSet MakeSet(size_t size, size_t stride, size_t offset) {
+        BitSet bitset;
+        for (size_t pos = offset; pos < size; pos += stride) {
+            bitset.set(pos);
+        }
+        return bitset;
+    }
+
+    int iterations_;
+};
+
+//
+// IFMapExporter: the add and remove sets of a node are built from its
+// interest and advertised sets, and the advertise sets of the updates of
+// the node are merged to check that they cover the add set.
+//
+TEST_F(BitSetBenchTest, ExporterComplement) {
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+        size_t size = kSizes[i];
+        BitSet interest = MakeSet(size, 2, 0);
+        BitSet advertised = MakeSet(size, 3, 0);
+        BitSet advertise = MakeSet(size, 2, 0);
+
+        BitSet add_set, rm_set, current;
+        add_set.BuildComplement(interest, advertised);
+        rm_set.BuildComplement(advertised, interest);
+        current |= advertise;
+        for (size_t pos = 0; pos < size; pos++) {
+            EXPECT_EQ(interest.test(pos) && !advertised.test(pos),
+                      add_set.test(pos));
+            EXPECT_EQ(advertised.test(pos) && !interest.test(pos),
+                      rm_set.test(pos));
+            EXPECT_EQ(advertise.test(pos), current.test(pos));
+        }
+        EXPECT_TRUE(current.Contains(add_set));
+        EXPECT_FALSE(rm_set.Contains(add_set));
+
+        size_t contains = 0;
+        uint64_t start = ClockMonotonicUsec();
+        for (int iter = 0; iter < iterations_; iter++) {
+            add_set.BuildComplement(interest, advertised);
+            rm_set.BuildComplement(advertised, interest);
+            current.clear();
+            current |= advertise;
+            contains += current.Contains(add_set);
+        }
+        uint64_t usecs = ClockMonotonicUsec() - start;
+        EXPECT_EQ((size_t) iterations_, contains);
+        LOG(DEBUG, "exporter complement " << size << " bits: " <<
+            iterations_ << " iterations in " << usecs << " usecs");
+    }
+}
+
+//
+// IFMapExporter: the client sets are walked to send the updates, compared
+// to tell if an update needs to change, and updated as the updates are
+// dequeued.
+//
+TEST_F(BitSetBenchTest, ExporterIterate) {
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+        size_t size = kSizes[i];
+        BitSet interest = MakeSet(size, 5, 1);
+        BitSet dequeue_set = MakeSet(size, 10, 1);
+        BitSet copy(interest);
+        EXPECT_TRUE(copy == interest);
+
+        size_t expected = 0;
+        for (size_t pos = 0; pos < size; pos++) {
+            expected += interest.test(pos);
+        }
+        EXPECT_EQ(expected, interest.count());
+
+        size_t bits = 0, equal = 0;
+        uint64_t start = ClockMonotonicUsec();
+        for (int iter = 0; iter < iterations_; iter++) {
+            for (size_t pos = interest.find_first(); pos != BitSet::npos;
+                 pos = interest.find_next(pos)) {
+                bits++;
+            }
+            BitSet advertised(interest);
+            advertised.Reset(dequeue_set);
+            equal += (advertised != interest);
+        }
+        uint64_t usecs = ClockMonotonicUsec() - start;
+        EXPECT_EQ(expected * iterations_, bits);
+        EXPECT_EQ((size_t) iterations_, equal);
+        LOG(DEBUG, "exporter iterate " << size << " bits: " <<
+            iterations_ << " iterations in " << usecs << " usecs");
+    }
+}
+
+//
+// SchedulingGroup: the in sync and out of sync peers of a RibOut are built
+// bit by bit, the blocked peers must be a subset of the ones in sync, the
+// peer sets of the RibOuts are merged and checked for overlap, and the out
+// of sync peers are walked.
+//
+TEST_F(BitSetBenchTest, SchedulingGroup) {
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+        size_t size = kSizes[i];
+        BitSet peers1 = MakeSet(size, 2, 0);
+        BitSet peers2 = MakeSet(size, 2, 1);
+        BitSet blocked = MakeSet(size, 8, 0);
+
+        BitSet msync, munsync;
+        for (size_t pos = 0; pos < size; pos++) {
+            if (pos % 4 == 0) {
+                msync.set(pos);
+            } else {
+                munsync.set(pos);
+            }
+        }
+        EXPECT_TRUE(msync.Contains(blocked));
+        EXPECT_FALSE(munsync.Contains(blocked));
+        EXPECT_FALSE(peers1.intersects(peers2));
+        EXPECT_TRUE(peers1.intersects(msync));
+        BitSet both = peers1 & msync;
+        EXPECT_EQ(msync, both);
+        EXPECT_EQ(size, (peers1 | peers2).count());
+
+        size_t ok = 0, bits = 0;
+        uint64_t start = ClockMonotonicUsec();
+        for (int iter = 0; iter < iterations_; iter++) {
+            BitSet group;
+            group |= peers1;
+            group |= peers2;
+            ok += msync.Contains(blocked);
+            ok += !peers1.intersects(peers2);
+            for (size_t pos = munsync.find_first(); pos != BitSet::npos;
+                 pos = munsync.find_next(pos)) {
+                bits++;
+            }
+            BitSet ready = group & msync;
+            ready.reset(0);
+            bits += ready.count();
+        }
+        uint64_t usecs = ClockMonotonicUsec() - start;
+        EXPECT_EQ((size_t) 2 * iterations_, ok);
+        EXPECT_EQ((munsync.count() + msync.count() - 1) * iterations_, bits);
+        LOG(DEBUG, "scheduling group " << size << " bits: " <<
+            iterations_ << " iterations in " << usecs << " usecs");
+    }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
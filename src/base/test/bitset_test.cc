@@ -10,8 +10,20 @@ using namespace std;
 
 class BitSetTest : public ::testing::Test {
 protected:
-    vector<uint64_t> &get_blocks(BitSet &bitset) {
-        return bitset.blocks_;
+    // Read only view of the blocks in use of a bitset.
+    class Blocks {
+    public:
+        explicit Blocks(const BitSet &bitset) : bitset_(bitset) { }
+        size_t size() const { return bitset_.size_; }
+        uint64_t operator[](size_t idx) const {
+            return bitset_.blocks()[idx];
+        }
+    private:
+        const BitSet &bitset_;
+    };
+
+    Blocks get_blocks(BitSet &bitset) {
+        return Blocks(bitset);
     }
 };
 
@@ -26,7 +38,7 @@ static int num_bits_set(uint64_t value) {
 
 TEST_F(BitSetTest, Basic) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    Blocks blocks = get_blocks(bitset);
     EXPECT_EQ(bitset.size(), 0);
     EXPECT_EQ(blocks.size(), 0);
 }
@@ -35,7 +47,7 @@ TEST_F(BitSetTest, Basic) {
 TEST_F(BitSetTest, set1) {
     for (int pos = 0; pos <= 63; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        Blocks blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), 1);
         EXPECT_EQ(blocks[0],  1LL << pos);
@@ -47,7 +59,7 @@ TEST_F(BitSetTest, set1) {
 TEST_F(BitSetTest, set2) {
     for (int pos = 128; pos <= 191; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        Blocks blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), 3);
         EXPECT_EQ(blocks[0], 0 );
@@ -61,7 +73,7 @@ TEST_F(BitSetTest, set2) {
 TEST_F(BitSetTest, set3)  {
     for (int pos = 0; pos <= 1023; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        Blocks blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), pos / 64 + 1);
         EXPECT_EQ(blocks[pos / 64], 1LL << (pos % 64));
@@ -72,7 +84,7 @@ TEST_F(BitSetTest, set3)  {
 // Set all bits within block idx 1 and verify.
 TEST_F(BitSetTest, set4) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    Blocks blocks = get_blocks(bitset);
     for (int pos = 64; pos <= 127; pos++) {
         bitset.set(pos);
     }
@@ -85,7 +97,7 @@ TEST_F(BitSetTest, set4) {
 TEST_F(BitSetTest, reset1) {
     for (int pos = 0; pos <= 63; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        Blocks blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), 1);
         bitset.reset(pos);
@@ -97,7 +109,7 @@ TEST_F(BitSetTest, reset1) {
 TEST_F(BitSetTest, reset2) {
     for (int pos = 64; pos <= 127; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        Blocks blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), 2);
         bitset.reset(pos);
@@ -109,7 +121,7 @@ TEST_F(BitSetTest, reset2) {
 TEST_F(BitSetTest, reset3) {
     for (int pos = 0; pos <= 1023; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        Blocks blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), pos / 64 + 1);
         bitset.reset(pos);
@@ -121,7 +133,7 @@ TEST_F(BitSetTest, reset3) {
 TEST_F(BitSetTest, reset4)  {
     for (int pos = 64; pos <= 127; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        Blocks blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), 2);
         bitset.reset(128);
@@ -133,7 +145,7 @@ TEST_F(BitSetTest, reset4)  {
 //  Set bits 0-127 and reset 0-63.
 TEST_F(BitSetTest, reset5) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    Blocks blocks = get_blocks(bitset);
     for (int pos = 0; pos <= 127; pos++) {
         bitset.set(pos);
     }
@@ -150,7 +162,7 @@ TEST_F(BitSetTest, reset5) {
 //  Set bits 0-127 and reset 64-127.
 TEST_F(BitSetTest, reset6) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    Blocks blocks = get_blocks(bitset);
     for (int pos = 0; pos <= 127; pos++) {
         bitset.set(pos);
     }
@@ -169,7 +181,7 @@ TEST_F(BitSetTest, reset6) {
 // Clear an empty BitSet.
 TEST_F(BitSetTest, clear1) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    Blocks blocks = get_blocks(bitset);
     bitset.clear();
     EXPECT_EQ(blocks.size(), 0);
 }
@@ -178,7 +190,7 @@ TEST_F(BitSetTest, clear1) {
 // Clear BitSet with first/last bit set in each idx.
 TEST_F(BitSetTest, clear2) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    Blocks blocks = get_blocks(bitset);
 
     for (int idx = 0; idx < 32; idx++) {
         bitset.set(idx * 64);
@@ -198,7 +210,7 @@ TEST_F(BitSetTest, clear2) {
 // Clear BitSet with all bits set in idx 0 thru 15.
 TEST_F(BitSetTest, clear3) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    Blocks blocks = get_blocks(bitset);
     for (int pos = 0; pos < 64 * 16 ; pos++) {
         bitset.set(pos);
     }
@@ -1836,6 +1848,29 @@ TEST_F(BitSetTest, String2) {
     }
 }
 
+// Verify copies and assignments across the inline and heap storage.
+TEST_F(BitSetTest, Copy1) {
+    BitSet small, large;
+    small.set(5);
+    small.set(200);
+    large.set(5);
+    large.set(1000);
+
+    BitSet copy(large);
+    EXPECT_EQ(large, copy);
+    copy = small;
+    EXPECT_EQ(small, copy);
+    EXPECT_EQ(2, copy.count());
+    copy = large;
+    EXPECT_EQ(large, copy);
+    copy.reset(1000);
+    Blocks blocks = get_blocks(copy);
+    EXPECT_EQ(blocks.size(), 1);
+    copy.BuildComplement(large, copy);
+    EXPECT_EQ(copy.count(), 1);
+    EXPECT_TRUE(copy.test(1000));
+}
+
 int main(int argc, char **argv) {
     LoggingInit();
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/queue_task.h"
+
+#include <vector>
+#include <boost/bind.hpp>
+#include <tbb/atomic.h>
+
+#include "base/logging.h"
+#include "base/test/task_test_util.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+typedef WorkQueue<int> IntQueue;
+
+class QueueTaskTest : public ::testing::Test {
+protected:
+    QueueTaskTest() {
+        task_id_ = TaskScheduler::GetInstance()->GetTaskId("test::QueueTask");
+        entry_usecs_ = 0;
+        high_count_ = 0;
+        low_count_ = 0;
+    }
+
+    virtual void TearDown() {
+        task_util::WaitForIdle();
+    }
+
+public:
+    bool EntryCallback(int entry) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        entries_.push_back(entry);
+        if (entry_usecs_) {
+            usleep(entry_usecs_);
+        }
+        return true;
+    }
+
+    bool BatchCallback(const IntQueue::EntryList &batch) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        batch_sizes_.push_back(batch.size());
+        entries_.insert(entries_.end(), batch.begin(), batch.end());
+        return true;
+    }
+
+    void HighWaterMark(size_t count) {
+        high_count_++;
+    }
+
+    void LowWaterMark(size_t count) {
+        low_count_++;
+    }
+
+protected:
+    size_t EntryCount() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        return entries_.size();
+    }
+
+    void VerifyOrder(int count) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        ASSERT_EQ(count, (int) entries_.size());
+        for (int i = 0; i < count; i++) {
+            EXPECT_EQ(i, entries_[i]);
+        }
+    }
+
+    int task_id_;
+    int entry_usecs_;
+    tbb::mutex mutex_;
+    vector<int> entries_;
+    vector<size_t> batch_sizes_;
+    tbb::atomic<int> high_count_;
+    tbb::atomic<int> low_count_;
+};
+
+TEST_F(QueueTaskTest, Basic) {
+    static const int kCount = 1000;
+    IntQueue queue(task_id_, -1,
+                   boost::bind(&QueueTaskTest::EntryCallback, this, _1));
+    for (int i = 0; i < kCount; i++) {
+        queue.Enqueue(i);
+    }
+    TASK_UTIL_EXPECT_EQ(kCount, EntryCount());
+    VerifyOrder(kCount);
+    EXPECT_EQ(kCount, queue.EnqueueCount());
+    EXPECT_EQ(kCount, queue.DequeueCount());
+    EXPECT_LE(1, queue.MaxQueueCount());
+    EXPECT_LE(1, queue.RunCount());
+    EXPECT_TRUE(queue.IsQueueEmpty());
+    queue.Shutdown();
+}
+
+TEST_F(QueueTaskTest, Batch) {
+    static const int kCount = 1000;
+    static const size_t kBatchSize = 16;
+    IntQueue queue(task_id_, -1, 0);
+    queue.SetBatchCallback(
+        boost::bind(&QueueTaskTest::BatchCallback, this, _1), kBatchSize);
+
+    // Fill the queue while it's disabled, so that the batches are full.
+    queue.set_disable(true);
+    for (int i = 0; i < kCount; i++) {
+        queue.Enqueue(i);
+    }
+    EXPECT_EQ(kCount, queue.QueueCount());
+    EXPECT_EQ(kCount, queue.MaxQueueCount());
+    queue.set_disable(false);
+
+    TASK_UTIL_EXPECT_EQ(kCount, EntryCount());
+    VerifyOrder(kCount);
+    EXPECT_EQ(batch_sizes_.size(), queue.BatchCount());
+    EXPECT_EQ((kCount + kBatchSize - 1) / kBatchSize, batch_sizes_.size());
+    for (size_t i = 0; i < batch_sizes_.size() - 1; i++) {
+        EXPECT_EQ(kBatchSize, batch_sizes_[i]);
+    }
+    queue.Shutdown();
+}
+
+//
+// With a target latency, the number of entries per run follows the cost of
+// the entries.
+//
+TEST_F(QueueTaskTest, Adaptive) {
+    static const int kCount = 200;
+    IntQueue queue(task_id_, -1,
+                   boost::bind(&QueueTaskTest::EntryCallback, this, _1));
+    queue.set_target_latency_usecs(10000);
+    EXPECT_EQ((size_t) IntQueue::kMaxIterations, queue.RunBudget());
+
+    entry_usecs_ = 1000;
+    for (int i = 0; i < kCount; i++) {
+        queue.Enqueue(i);
+    }
+    TASK_UTIL_EXPECT_EQ(kCount, EntryCount());
+    VerifyOrder(kCount);
+
+    // Entries take at least 1 msec, so runs after the first one process at
+    // most 10 of them.
+    EXPECT_LE(1000000, queue.EntryCostNsecs());
+    EXPECT_GE(10, queue.RunBudget());
+    EXPECT_LE((kCount - IntQueue::kMaxIterations) / 10, queue.RunCount());
+
+    queue.set_target_latency_usecs(0);
+    EXPECT_EQ((size_t) IntQueue::kMaxIterations, queue.RunBudget());
+    queue.Shutdown();
+}
+
+TEST_F(QueueTaskTest, WaterMarks) {
+    IntQueue queue(task_id_, -1,
+                   boost::bind(&QueueTaskTest::EntryCallback, this, _1));
+    queue.SetHighWaterMark(100,
+        boost::bind(&QueueTaskTest::HighWaterMark, this, _1));
+    queue.SetLowWaterMark(10,
+        boost::bind(&QueueTaskTest::LowWaterMark, this, _1));
+
+    queue.set_disable(true);
+    for (int i = 0; i < 99; i++) {
+        queue.Enqueue(i);
+    }
+    EXPECT_EQ(0, high_count_);
+    for (int i = 99; i < 200; i++) {
+        queue.Enqueue(i);
+    }
+    EXPECT_EQ(1, high_count_);
+    EXPECT_EQ(0, low_count_);
+
+    queue.set_disable(false);
+    TASK_UTIL_EXPECT_EQ(200, EntryCount());
+    EXPECT_EQ(1, high_count_);
+    EXPECT_EQ(1, low_count_);
+
+    // The high water mark is armed again once the low one is reached.
+    queue.set_disable(true);
+    for (int i = 200; i < 300; i++) {
+        queue.Enqueue(i);
+    }
+    EXPECT_EQ(2, high_count_);
+    queue.set_disable(false);
+    TASK_UTIL_EXPECT_EQ(300, EntryCount());
+    EXPECT_EQ(2, low_count_);
+    VerifyOrder(300);
+    queue.Shutdown();
+}
+
+// A max_iterations of 0 drains the queue in a single run.
+TEST_F(QueueTaskTest, UnlimitedIterations) {
+    static const int kCount = 1000;
+    IntQueue queue(task_id_, -1,
+                   boost::bind(&QueueTaskTest::EntryCallback, this, _1), 0, 0);
+    queue.set_disable(true);
+    for (int i = 0; i < kCount; i++) {
+        queue.Enqueue(i);
+    }
+    queue.set_disable(false);
+    TASK_UTIL_EXPECT_EQ(kCount, EntryCount());
+    VerifyOrder(kCount);
+    EXPECT_EQ(1U, queue.RunCount());
+    queue.Shutdown();
+}
+
+// The marks can be set without callbacks.
+TEST_F(QueueTaskTest, WaterMarksNoCallback) {
+    IntQueue queue(task_id_, -1,
+                   boost::bind(&QueueTaskTest::EntryCallback, this, _1));
+    queue.SetHighWaterMark(10, 0);
+    queue.SetLowWaterMark(5, 0);
+    queue.set_disable(true);
+    for (int i = 0; i < 20; i++) {
+        queue.Enqueue(i);
+    }
+    queue.set_disable(false);
+    TASK_UTIL_EXPECT_EQ(20, EntryCount());
+    VerifyOrder(20);
+    queue.Shutdown();
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
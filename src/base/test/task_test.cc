@@ -4,8 +4,11 @@
 
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <boost/bind.hpp>
 #include "tbb/task.h"
 #include "base/task.h"
+#include "base/task_histogram.h"
 #include "base/logging.h"
 #include "testing/gunit.h"
 
@@ -1354,6 +1357,177 @@ TEST_F(TestUT, test9_1)
     EXPECT_TRUE(scheduler->IsEmpty());
 }
 
+class CountTask : public Task {
+public:
+    CountTask(int id, int inst, int num_runs)
+        : Task(id, inst), num_runs_(num_runs) {
+    }
+    bool Run() {
+        EXPECT_EQ(this, Task::Running());
+        run_count_++;
+        return (--num_runs_ == 0);
+    }
+    static tbb::atomic<int> run_count_;
+
+private:
+    int num_runs_;
+};
+
+tbb::atomic<int> CountTask::run_count_;
+
+static void CountTaskWait(int count) {
+    for (int i = 0; i < 10000; i++) {
+        if (CountTask::run_count_ >= count && scheduler->IsEmpty())
+            break;
+        usleep(1000);
+    }
+    EXPECT_EQ(count, CountTask::run_count_);
+    EXPECT_TRUE(scheduler->IsEmpty());
+}
+
+/* Tasks without instance in a group without policy are started by the fast
+ * path once enabled. Verify that they all run and are accounted in the stats */
+TEST_F(TestUT, test10_0)
+{
+#define TEST10_0_TASKS 1000
+    EXPECT_FALSE(scheduler->fast_path());
+    scheduler->set_fast_path(true);
+    CountTask::run_count_ = 0;
+    scheduler->ClearTaskStats(100);
+    for (int i = 0; i < TEST10_0_TASKS; i++) {
+        scheduler->Enqueue(new CountTask(100, -1, 2));
+    }
+    CountTaskWait(TEST10_0_TASKS * 2);
+    EXPECT_EQ(TEST10_0_TASKS * 2, scheduler->GetTaskStats(100)->run_count_);
+    scheduler->set_fast_path(false);
+}
+
+/* Fast path tasks must not run while the scheduler is stopped */
+TEST_F(TestUT, test10_1)
+{
+    scheduler->set_fast_path(true);
+    CountTask::run_count_ = 0;
+    scheduler->Enqueue(new CountTask(101, -1, 1));
+    CountTaskWait(1);
+
+    scheduler->Stop();
+    for (int i = 0; i < 10; i++) {
+        scheduler->Enqueue(new CountTask(101, -1, 1));
+    }
+    usleep(10000);
+    EXPECT_EQ(1, CountTask::run_count_);
+    scheduler->Start();
+    CountTaskWait(11);
+    scheduler->set_fast_path(false);
+}
+
+/* A policy takes the tasks of both groups off the fast path. Verify that
+ * deferred tasks still run once the conflicting task exits */
+TEST_F(TestUT, test10_2)
+{
+    TaskExclusion exclude[] = { TaskExclusion(103) };
+    TaskPolicy policy;
+    InitPolicy(exclude, 1, &policy);
+    scheduler->set_fast_path(true);
+    scheduler->SetPolicy(102, policy);
+
+    CountTask::run_count_ = 0;
+    scheduler->Stop();
+    scheduler->Enqueue(new CountTask(102, -1, 1));
+    scheduler->Enqueue(new CountTask(103, -1, 1));
+    scheduler->Enqueue(new CountTask(103, -1, 1));
+    scheduler->Start();
+    CountTaskWait(3);
+    scheduler->set_fast_path(false);
+}
+
+/* Recycled tasks of a group with affinity enabled run to completion */
+TEST_F(TestUT, test10_3)
+{
+    scheduler->EnableAffinity(104);
+    CountTask::run_count_ = 0;
+    scheduler->ClearTaskStats(104, 0);
+    scheduler->ClearTaskStats(104, 1);
+    scheduler->Enqueue(new CountTask(104, 0, 100));
+    scheduler->Enqueue(new CountTask(104, 1, 100));
+    CountTaskWait(200);
+    EXPECT_EQ(100, scheduler->GetTaskStats(104, 0)->run_count_);
+    EXPECT_EQ(100, scheduler->GetTaskStats(104, 1)->run_count_);
+}
+
+/* Verify the bucketing and percentiles of the latency histogram */
+TEST_F(TestUT, test11_0)
+{
+    for (uint64_t value = 0; value < 100000; value++) {
+        int index = TaskHistogram::BucketIndex(value);
+        ASSERT_LE(TaskHistogram::BucketLowerBound(index), value);
+        ASSERT_GT(TaskHistogram::BucketLowerBound(index + 1), value);
+    }
+    EXPECT_EQ(TaskHistogram::kBuckets - 1,
+              TaskHistogram::BucketIndex(TaskHistogram::kMaxValue));
+
+    TaskHistogram histogram;
+    EXPECT_EQ(0, histogram.Percentile(50));
+    for (uint64_t value = 1; value <= 1000; value++) {
+        histogram.Record(value);
+    }
+    EXPECT_EQ(1000, histogram.count());
+    EXPECT_EQ(500, histogram.mean());
+    EXPECT_EQ(1000, histogram.max());
+    EXPECT_EQ(1000, histogram.Percentile(100));
+    // Percentiles are within 1/kSubBuckets of the actual value.
+    EXPECT_LE(500, histogram.Percentile(50));
+    EXPECT_GE(500 + 500 / TaskHistogram::kSubBuckets, histogram.Percentile(50));
+    EXPECT_LE(990, histogram.Percentile(99));
+
+    histogram.Clear();
+    EXPECT_EQ(0, histogram.count());
+    EXPECT_EQ(0, histogram.max());
+}
+
+static void CollectLatency(int match_id, map<int, uint64_t> *runs,
+                           int task_id, int task_instance,
+                           const TaskLatency &latency) {
+    if (task_id != match_id)
+        return;
+    EXPECT_EQ(latency.wait_.count(), latency.run_.count());
+    (*runs)[task_instance] = latency.run_.count();
+}
+
+/* Tasks are measured once latency is enabled, both in the fast path and in
+ * the policy engine */
+TEST_F(TestUT, test11_1)
+{
+    EXPECT_FALSE(scheduler->latency_enabled());
+    scheduler->EnableLatency(true);
+    scheduler->set_fast_path(true);
+    CountTask::run_count_ = 0;
+    scheduler->Enqueue(new CountTask(110, -1, 1));
+    CountTaskWait(1);
+    for (int i = 0; i < 10; i++) {
+        scheduler->Enqueue(new CountTask(110, -1, 1));
+        scheduler->Enqueue(new CountTask(110, 1, 2));
+    }
+    CountTaskWait(31);
+
+    map<int, uint64_t> runs;
+    scheduler->VisitTaskLatency(
+        boost::bind(&CollectLatency, 110, &runs, _1, _2, _3));
+    EXPECT_EQ(11, runs[-1]);
+    EXPECT_EQ(20, runs[1]);
+
+    scheduler->ClearLatency();
+    scheduler->EnableLatency(false);
+    scheduler->Enqueue(new CountTask(110, 1, 1));
+    CountTaskWait(32);
+    runs.clear();
+    scheduler->VisitTaskLatency(
+        boost::bind(&CollectLatency, 110, &runs, _1, _2, _3));
+    EXPECT_EQ(0, runs[-1]);
+    EXPECT_EQ(0, runs[1]);
+    scheduler->set_fast_path(false);
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -15,6 +15,7 @@
 #include <boost/uuid/string_generator.hpp>
 #include <boost/asio/ip/address.hpp>
 #include <sstream>
+#include <time.h>
 #include <stdlib.h>
 #include <sys/time.h>
 #include <vector>
@@ -141,6 +142,18 @@ private:
     T *ptr_;
 };
 
+/* monotonic clock - returns usec, for measuring durations */
+static inline uint64_t ClockMonotonicUsec() {
+#if defined(__APPLE__)
+    boost::posix_time::ptime t(boost::posix_time::microsec_clock::universal_time());
+    return (t - boost::posix_time::ptime(boost::gregorian::date(1970,1,1))).total_microseconds();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+#endif
+}
+
 static boost::posix_time::ptime epoch_ptime(boost::gregorian::date(1970,1,1));
 
 /* timestamp - returns usec since epoch */
@@ -120,6 +120,7 @@ public:
 private:
     friend int intrusive_ptr_add_ref(const AsPath *cpath);
     friend int intrusive_ptr_del_ref(const AsPath *cpath);
+    friend bool intrusive_ptr_try_add_ref(const AsPath *cpath);
     friend void intrusive_ptr_release(const AsPath *cpath);
 
     mutable tbb::atomic<int> refcount_;
@@ -131,6 +132,19 @@ inline int intrusive_ptr_add_ref(const AsPath *cpath) {
     return cpath->refcount_.fetch_and_increment();
 }
 
+// Take a reference only if the refcount is not 0, i.e. the entry is not
+// being deleted.
+inline bool intrusive_ptr_try_add_ref(const AsPath *cpath) {
+    int count = cpath->refcount_;
+    while (count > 0) {
+        int prev = cpath->refcount_.compare_and_swap(count + 1, count);
+        if (prev == count)
+            return true;
+        count = prev;
+    }
+    return false;
+}
+
 inline int intrusive_ptr_del_ref(const AsPath *cpath) {
     return cpath->refcount_.fetch_and_decrement();
 }
@@ -139,22 +153,16 @@ inline void intrusive_ptr_release(const AsPath *cpath) {
     int prev = cpath->refcount_.fetch_and_decrement();
     if (prev == 1) {
         AsPath *path = const_cast<AsPath *>(cpath);
+
+        // The database frees the entry once it is safe to do so.
         path->Remove();
-        assert(path->refcount_ == 0);
-        delete path;
     }
 }
 
 typedef boost::intrusive_ptr<const AsPath> AsPathPtr;
 
-struct AsPathCompare {
-    bool operator()(const AsPath *lhs, const AsPath *rhs) {
-        return lhs->CompareTo(*rhs) < 0;
-    }
-};
-
 class AsPathDB : public BgpPathAttributeDB<AsPath, AsPathPtr, AsPathSpec,
-                                           AsPathCompare, AsPathDB> {
+                                           AsPathDB> {
 public:
     AsPathDB(BgpServer *server);
 
@@ -283,6 +283,7 @@ private:
     friend class BgpAttrDB;
     friend int intrusive_ptr_add_ref(const BgpAttr *cattrp);
     friend int intrusive_ptr_del_ref(const BgpAttr *cattrp);
+    friend bool intrusive_ptr_try_add_ref(const BgpAttr *cattrp);
     friend void intrusive_ptr_release(const BgpAttr *cattrp);
 
     mutable tbb::atomic<int> refcount_;
@@ -306,6 +307,19 @@ inline int intrusive_ptr_add_ref(const BgpAttr *cattrp) {
     return cattrp->refcount_.fetch_and_increment();
 }
 
+// Take a reference only if the refcount is not 0, i.e. the entry is not
+// being deleted.
+inline bool intrusive_ptr_try_add_ref(const BgpAttr *cattrp) {
+    int count = cattrp->refcount_;
+    while (count > 0) {
+        int prev = cattrp->refcount_.compare_and_swap(count + 1, count);
+        if (prev == count)
+            return true;
+        count = prev;
+    }
+    return false;
+}
+
 inline int intrusive_ptr_del_ref(const BgpAttr *cattrp) {
     return cattrp->refcount_.fetch_and_decrement();
 }
@@ -314,22 +328,16 @@ inline void intrusive_ptr_release(const BgpAttr *cattrp) {
     int prev = cattrp->refcount_.fetch_and_decrement();
     if (prev == 1) {
         BgpAttr *attrp = const_cast<BgpAttr *>(cattrp);
+
+        // The database frees the entry once it is safe to do so.
         attrp->Remove();
-        assert(attrp->refcount_ == 0);
-        delete attrp;
     }
 }
 
 typedef boost::intrusive_ptr<const BgpAttr> BgpAttrPtr;
 
-struct BgpAttrCompare {
-    bool operator()(const BgpAttr *lhs, const BgpAttr *rhs) {
-        return lhs->CompareTo(*rhs) < 0;
-    }
-};
-
 class BgpAttrDB : public BgpPathAttributeDB<BgpAttr, BgpAttrPtr, BgpAttrSpec,
-                                            BgpAttrCompare, BgpAttrDB> {
+                                            BgpAttrDB> {
 public:
     BgpAttrDB(BgpServer *server);
     BgpAttrPtr ReplaceExtCommunityAndLocate(const BgpAttr *attr,
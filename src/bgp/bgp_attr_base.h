@@ -9,6 +9,7 @@
 #include <boost/scoped_array.hpp>
 #include <set>
 #include <string>
+#include <tbb/atomic.h>
 #include <tbb/mutex.h>
 #include <vector>
 #include "base/parse_object.h"
@@ -69,35 +70,105 @@ struct BgpProtoPrefix : public ParseObject {
 // Base class to manage BGP Path Attributes database. This class provides
 // thread safe access to the data base.
 //
+// The database is split into partitions based on the attribute hash. Each
+// partition is an open addressing hash table with linear probing. The hash
+// of an attribute is computed once per Locate and is stored in the table
+// slot along with the attribute pointer, so that most probes do not need to
+// dereference the attribute at all.
+//
+// Lookups of attributes that are already present in the database do not take
+// any lock. Updates to a partition (insert, delete and resize) are serialized
+// using the partition mutex. Since lock-free readers may still be looking at
+// an attribute (or a table) that has just been unlinked, memory is reclaimed
+// using a simple epoch scheme: unlinked objects are retired and are freed only
+// after all readers that could have seen them have left their read section.
+//
 // Lock contention can be tuned by varying the hash table size passed to the
 // constructor.
 //
 // Attribute contents must be hashable via hash_value() and hashed using
-// boost::hash_combine() to partition the attribute database.
-template <class Type, class TypePtr, class TypeSpec, typename TypeCompare,
-          class TypeDB>
+// boost::hash_combine() to partition the attribute database. Attributes must
+// provide CompareTo() to check for equality.
+template <class Type, class TypePtr, class TypeSpec, class TypeDB>
 class BgpPathAttributeDB {
 public:
+    struct Stats {
+        Stats()
+            : lockfree_hits(0), locked_hits(0), inserts(0), deletes(0),
+              lock_contention(0), retries(0), resizes(0), retired(0),
+              reclaimed(0) {
+        }
+        uint64_t lockfree_hits;
+        uint64_t locked_hits;
+        uint64_t inserts;
+        uint64_t deletes;
+        uint64_t lock_contention;
+        uint64_t retries;
+        uint64_t resizes;
+        uint64_t retired;
+        uint64_t reclaimed;
+    };
+
     BgpPathAttributeDB(int hash_size = GetHashSize()) :
-            hash_size_(hash_size), set_(new Set[hash_size]),
-            mutex_(new tbb::mutex[hash_size]) {
+            hash_size_(hash_size > 0 ? hash_size : 1),
+            partitions_(new Partition[hash_size_]) {
+        epoch_ = 0;
+        readers_[0] = 0;
+        readers_[1] = 0;
+        pending_ = 0;
+        retired_ = 0;
+        reclaimed_ = 0;
+    }
+
+    ~BgpPathAttributeDB() {
+        for (int i = 0; i < 2; i++) {
+            for (typename RetireList::iterator it = limbo_[i].begin();
+                 it != limbo_[i].end(); ++it) {
+                delete it->entry;
+                delete it->table;
+            }
+        }
+        for (size_t i = 0; i < hash_size_; i++) {
+            delete partitions_[i].table;
+        }
     }
 
     size_t Size() {
         size_t size = 0;
 
         for (size_t i = 0; i < hash_size_; i++) {
-            tbb::mutex::scoped_lock lock(mutex_[i]);
-            size += set_[i].size();
+            size += partitions_[i].size;
         }
         return size;
     }
 
+    void GetStats(Stats *stats) const {
+        for (size_t i = 0; i < hash_size_; i++) {
+            const Partition &partition = partitions_[i];
+            stats->lockfree_hits += partition.lockfree_hits;
+            stats->locked_hits += partition.locked_hits;
+            stats->inserts += partition.inserts;
+            stats->deletes += partition.deletes;
+            stats->lock_contention += partition.lock_contention;
+            stats->retries += partition.retries;
+            stats->resizes += partition.resizes;
+        }
+        stats->retired += retired_;
+        stats->reclaimed += reclaimed_;
+    }
+
+    // Unlink the attribute from the database and retire it. The attribute is
+    // freed once no lock-free reader can be referring to it any more.
     void Delete(Type *attr) {
         size_t hash = HashCompute(attr);
+        Partition &partition = partitions_[PartitionIndex(hash)];
 
-        tbb::mutex::scoped_lock lock(mutex_[hash]);
-        set_[hash].erase(attr);
+        {
+            tbb::mutex::scoped_lock lock(partition.mutex);
+            Unlink(&partition, hash, attr);
+        }
+
+        Retire(attr, NULL);
     }
 
     // Locate passed in attribute in the data base based on the attr ptr.
@@ -112,12 +183,103 @@ public:
     }
 
 private:
-    const size_t HashCompute(Type *attr) const {
-        if (hash_size_ <= 1) return 0;
+    static const size_t kMinCapacity = 16;
+
+    struct Slot {
+        tbb::atomic<size_t> hash;
+        tbb::atomic<Type *> entry;
+    };
+
+    struct Table {
+        explicit Table(size_t capacity)
+            : capacity(capacity), mask(capacity - 1),
+              slots(new Slot[capacity]) {
+            for (size_t i = 0; i < capacity; i++) {
+                slots[i].hash = 0;
+                slots[i].entry = NULL;
+            }
+        }
+        size_t capacity;
+        size_t mask;
+        boost::scoped_array<Slot> slots;
+    };
+
+    struct Partition {
+        Partition() : used(0) {
+            table = new Table(kMinCapacity);
+            size = 0;
+            lockfree_hits = 0;
+            locked_hits = 0;
+            inserts = 0;
+            deletes = 0;
+            lock_contention = 0;
+            retries = 0;
+            resizes = 0;
+        }
+        tbb::mutex mutex;
+        tbb::atomic<Table *> table;
+
+        // Number of live plus tombstone slots, protected by the mutex.
+        size_t used;
+
+        tbb::atomic<size_t> size;
+        tbb::atomic<uint64_t> lockfree_hits;
+        tbb::atomic<uint64_t> locked_hits;
+        tbb::atomic<uint64_t> inserts;
+        tbb::atomic<uint64_t> deletes;
+        tbb::atomic<uint64_t> lock_contention;
+        tbb::atomic<uint64_t> retries;
+        tbb::atomic<uint64_t> resizes;
+    };
+
+    struct RetireEntry {
+        RetireEntry(Type *entry, Table *table) : entry(entry), table(table) { }
+        Type *entry;
+        Table *table;
+    };
+    typedef std::vector<RetireEntry> RetireList;
+
+    // Marks a lock-free read section. Objects unlinked while the section is
+    // active are not freed until the section is exited.
+    class ReadSection;
+    friend class ReadSection;
+    class ReadSection {
+    public:
+        explicit ReadSection(BgpPathAttributeDB *db) : db_(db) {
+            while (true) {
+                index_ = db_->epoch_ & 1;
+                db_->readers_[index_].fetch_and_increment();
+                if ((db_->epoch_ & 1) == index_)
+                    break;
+                db_->ExitReadSection(index_);
+            }
+        }
+        ~ReadSection() { db_->ExitReadSection(index_); }
 
+    private:
+        BgpPathAttributeDB *db_;
+        size_t index_;
+    };
+
+    static Type *Tombstone() {
+        return reinterpret_cast<Type *>(static_cast<uintptr_t>(1));
+    }
+
+    static size_t HashCompute(Type *attr) {
         size_t hash = 0;
         boost::hash_combine(hash, *attr);
-        return hash % hash_size_;
+        return hash;
+    }
+
+    // The slot in the partition table is taken from the low bits of the hash,
+    // so the partition is taken from the high bits of the hash multiplied by
+    // the golden ratio, which depend on all the bits of the hash. Otherwise
+    // the attributes of a partition would all share their low bits and crowd
+    // the same slots.
+    size_t PartitionIndex(size_t hash) const {
+        static const int kHalfBits = sizeof(size_t) * 4;
+        size_t mixed = hash * static_cast<size_t>(0x9E3779B97F4A7C15ULL);
+        return (mixed >> kHalfBits) % hash_size_;
     }
 
     static size_t GetHashSize() {
@@ -128,77 +290,231 @@ private:
         return strtoul(str, NULL, 0);
     }
 
+    // Find an attribute with the same contents in the table. This is safe to
+    // call without the partition mutex as long as the caller is inside a read
+    // section.
+    static Type *Find(Table *table, size_t hash, Type *attr) {
+        for (size_t idx = hash & table->mask, count = 0;
+             count < table->capacity;
+             idx = (idx + 1) & table->mask, count++) {
+            Slot &slot = table->slots[idx];
+            Type *entry = slot.entry;
+            if (entry == NULL)
+                return NULL;
+            if (entry == Tombstone() || slot.hash != hash)
+                continue;
+            if (entry->CompareTo(*attr) == 0)
+                return entry;
+        }
+        return NULL;
+    }
+
+    // Remove the attribute from the partition table, if it is still there.
+    // Must be called with the partition mutex held.
+    static void Unlink(Partition *partition, size_t hash, Type *attr) {
+        Table *table = partition->table;
+        for (size_t idx = hash & table->mask, count = 0;
+             count < table->capacity;
+             idx = (idx + 1) & table->mask, count++) {
+            Slot &slot = table->slots[idx];
+            Type *entry = slot.entry;
+            if (entry == NULL)
+                break;
+            if (entry != attr)
+                continue;
+
+            // Use a fully fenced store so that the reader check done in
+            // Retire() is ordered after the unlink.
+            slot.entry.fetch_and_store(Tombstone());
+            partition->size--;
+            partition->deletes++;
+            break;
+        }
+    }
+
+    // Insert the attribute into the partition. Must be called with the
+    // partition mutex held, after making sure that no matching entry exists.
+    void Insert(Partition *partition, size_t hash, Type *attr) {
+        if ((partition->used + 1) * 4 > partition->table->capacity * 3)
+            Resize(partition);
+
+        Table *table = partition->table;
+        for (size_t idx = hash & table->mask; ;
+             idx = (idx + 1) & table->mask) {
+            Slot &slot = table->slots[idx];
+            Type *entry = slot.entry;
+            if (entry != NULL && entry != Tombstone())
+                continue;
+            if (entry == NULL)
+                partition->used++;
+
+            // Publish the hash before the entry, readers look at the entry
+            // first.
+            slot.hash = hash;
+            slot.entry = attr;
+            break;
+        }
+        partition->size++;
+        partition->inserts++;
+    }
+
+    // Rebuild the partition table without tombstones, growing it as needed.
+    // Must be called with the partition mutex held.
+    void Resize(Partition *partition) {
+        Table *old_table = partition->table;
+        size_t live = partition->size;
+        size_t capacity = kMinCapacity;
+        while (capacity < (live + 1) * 2)
+            capacity <<= 1;
+
+        Table *table = new Table(capacity);
+        for (size_t i = 0; i < old_table->capacity; i++) {
+            Type *entry = old_table->slots[i].entry;
+            if (entry == NULL || entry == Tombstone())
+                continue;
+            size_t hash = old_table->slots[i].hash;
+            size_t idx = hash & table->mask;
+            while (table->slots[idx].entry != NULL)
+                idx = (idx + 1) & table->mask;
+            table->slots[idx].hash = hash;
+            table->slots[idx].entry = entry;
+        }
+
+        partition->used = live;
+        partition->table = table;
+        partition->resizes++;
+
+        // Lock-free readers may still be probing the old table.
+        tbb::mutex::scoped_lock lock(reclaim_mutex_);
+        limbo_[epoch_ & 1].push_back(RetireEntry(NULL, old_table));
+        pending_++;
+        retired_++;
+    }
+
+    // Free the object right away if there are no readers. Otherwise, add it
+    // to the retire list of the current epoch.
+    void Retire(Type *attr, Table *table) {
+        if (readers_[0] == 0 && readers_[1] == 0) {
+            delete attr;
+            delete table;
+            reclaimed_++;
+            return;
+        }
+
+        {
+            tbb::mutex::scoped_lock lock(reclaim_mutex_);
+            limbo_[epoch_ & 1].push_back(RetireEntry(attr, table));
+            pending_++;
+            retired_++;
+        }
+        Reclaim();
+    }
+
+    void ExitReadSection(size_t index) {
+        if (readers_[index].fetch_and_decrement() == 1 && pending_ != 0)
+            Reclaim();
+    }
+
+    // Free objects retired in the previous epoch if all readers from that
+    // epoch are gone, and advance the epoch. This is done at most twice so
+    // that all retired objects get freed when there are no readers.
+    void Reclaim() {
+        RetireList free_list;
+        {
+            tbb::mutex::scoped_lock lock(reclaim_mutex_);
+            for (int i = 0; i < 2; i++) {
+                size_t prev = (epoch_ + 1) & 1;
+                if (readers_[prev] != 0)
+                    break;
+                free_list.insert(free_list.end(),
+                                 limbo_[prev].begin(), limbo_[prev].end());
+                limbo_[prev].clear();
+                epoch_++;
+            }
+            pending_ -= free_list.size();
+        }
+
+        for (typename RetireList::iterator it = free_list.begin();
+             it != free_list.end(); ++it) {
+            delete it->entry;
+            delete it->table;
+        }
+        reclaimed_ += free_list.size();
+    }
+
     // This template safely retrieves an attribute entry from its data base.
     // If the entry is not found, it is inserted into the database.
     //
     // If the entry is already present, then passed in entry is freed and
     // existing entry is returned.
     TypePtr LocateInternal(Type *attr) {
-
-        // Hash attribute contents to to avoid potential mutex contention.
         size_t hash = HashCompute(attr);
-        while (true) {
+        Partition &partition = partitions_[PartitionIndex(hash)];
+
+        // Fast path: look for an existing entry without taking the mutex.
+        //
+        // Take a reference to prevent the entry from getting deleted. The
+        // reference is only taken if the refcount is not 0: an entry whose
+        // refcount has dropped to 0 is about to be unlinked and must not be
+        // revived. Fall back to the slow path in that case.
+        {
+            ReadSection section(this);
+            Type *entry = Find(partition.table, hash, attr);
+            if (entry && intrusive_ptr_try_add_ref(entry)) {
 
-            // Grab mutex to keep db access thread safe.
-            tbb::mutex::scoped_lock lock(mutex_[hash]);
-            std::pair<typename Set::iterator, bool> ret;
-
-            // Try to insert the passed entry into the database.
-            ret = set_[hash].insert(attr);
-
-            // Take a reference to prevent this entry from getting deleted.
-            // Counter is automatically incremented, hence we get thread safety
-            // here.
-            int prev = intrusive_ptr_add_ref(*ret.first);
-
-            // Check if passed in entry did get into the data base.
-            if (ret.second) {
+                // Free passed in attribute, as it is already in the database.
+                // The intrusive pointer adopts the reference taken above.
+                delete attr;
+                partition.lockfree_hits++;
+                return TypePtr(entry, false);
+            }
+        }
 
-                // Take intrusive pointer, thereby incrementing the refcount.
-                TypePtr ptr = TypePtr(*ret.first);
+        // Grab mutex to keep db updates thread safe.
+        tbb::mutex::scoped_lock lock;
+        if (!lock.try_acquire(partition.mutex)) {
+            partition.lock_contention++;
+            lock.acquire(partition.mutex);
+        }
 
-                // Release redundant refcount taken above to protect this entry
-                // from getting deleted, as we have now bumped up refcount above
-                intrusive_ptr_del_ref(*ret.first);
-                return ptr;
-            }
+        while (Type *entry = Find(partition.table, hash, attr)) {
 
             // Make sure that this entry, though in the database is not
             // undergoing deletion. This can happen because attribute intrusive
             // pointer is released without taking the mutex.
-            //
-            // If the previous refcount is 0, it implies that this entry is
-            // about to get deleted (after we release the mutex). In such
-            // cases, we retry inserting the passed attribute pointer into the
-            // data base.
-            if (prev > 0) {
-
-                // Free passed in attribute, as it is already in the database.
+            if (intrusive_ptr_try_add_ref(entry)) {
                 delete attr;
-
-                // Take intrusive pointer, thereby incrementing the refcount.
-                TypePtr ptr = TypePtr(*ret.first);
-
-                // Release redundant refcount taken above to protect this entry
-                // from getting deleted, as we have now bumped up refcount above
-                intrusive_ptr_del_ref(*ret.first);
-                return ptr;
+                partition.locked_hits++;
+                return TypePtr(entry, false);
             }
 
-            // Decrement the counter bumped up above as we can't use this entry
-            // which is above to be deleted. Instead, retry inserting the passed
-            // entry again, into the database.
-            intrusive_ptr_del_ref(*ret.first);
+            // The refcount is 0, so the entry is about to get deleted once
+            // its owner gets the mutex. Unlink it right away rather than wait
+            // for that, so that the passed attribute can take its place. The
+            // owner still retires the entry, its Delete() finds it already
+            // unlinked.
+            Unlink(&partition, hash, entry);
+            partition.retries++;
         }
 
-        assert(false);
-        return NULL;
+        // Take the reference before the entry becomes visible to lock-free
+        // readers.
+        TypePtr ptr = TypePtr(attr);
+        Insert(&partition, hash, attr);
+        return ptr;
     }
 
-    typedef std::set<Type *, TypeCompare> Set;
     size_t hash_size_;
-    boost::scoped_array<Set> set_;
-    boost::scoped_array<tbb::mutex> mutex_;
+    boost::scoped_array<Partition> partitions_;
+
+    // Epoch based reclamation state.
+    tbb::mutex reclaim_mutex_;
+    tbb::atomic<size_t> epoch_;
+    tbb::atomic<int> readers_[2];
+    tbb::atomic<size_t> pending_;
+    RetireList limbo_[2];
+    tbb::atomic<uint64_t> retired_;
+    tbb::atomic<uint64_t> reclaimed_;
 };
 
 #endif
@@ -8,6 +8,7 @@
 #include "base/parse_object.h"
 #include "bgp/bgp_log.h"
 #include "bgp/bgp_route.h"
+#include "bgp/bgp_update.h"
 #include "net/bgp_af.h"
 
 BgpMessage::BgpMessage() {
@@ -141,7 +142,8 @@ bool BgpMessage::UpdateLength(const char *tag, int size, int delta) {
     return true;
 }
 
-bool BgpMessage::AddRoute(const BgpRoute *route, const RibOutAttr *roattr) {
+bool BgpMessage::AddRoute(const BgpRoute *route, UpdateInfo *uinfo) {
+    const RibOutAttr *roattr = &uinfo->roattr;
     uint8_t *data = data_ + datalen_;
     size_t size = sizeof(data_) - datalen_;
 
@@ -149,7 +151,7 @@ bool BgpMessage::AddRoute(const BgpRoute *route, const RibOutAttr *roattr) {
     nlri.afi = route->Afi();
     nlri.safi = route->Safi();
     BgpProtoPrefix *prefix = new BgpProtoPrefix;
-    uint32_t label = roattr ? roattr->label() : 0;
+    uint32_t label = roattr->label();
     route->BuildProtoPrefix(prefix, label);
     nlri.nlri.push_back(prefix);
     if (roattr->IsReachable()) {
@@ -199,9 +201,9 @@ const uint8_t *BgpMessage::GetData(IPeerUpdate *ipeer_update, size_t *lenp) {
 }
 
 Message *BgpMessageBuilder::Create(const BgpTable *table,
-        const RibOutAttr *roattr, const BgpRoute *route) const {
+        UpdateInfo *uinfo, const BgpRoute *route) const {
     BgpMessage *msg = new BgpMessage();
-    msg->Start(roattr, route);
+    msg->Start(&uinfo->roattr, route);
     return msg;
 }
 
@@ -13,7 +13,7 @@ public:
     BgpMessage();
     virtual ~BgpMessage();
     void Start(const RibOutAttr *roattr, const BgpRoute *route);
-    virtual bool AddRoute(const BgpRoute *route, const RibOutAttr *roattr);
+    virtual bool AddRoute(const BgpRoute *route, UpdateInfo *uinfo);
     virtual void Finish();
     virtual const uint8_t *GetData(IPeerUpdate *ipeer_update, size_t *lenp);
 
@@ -32,7 +32,7 @@ class BgpMessageBuilder : public MessageBuilder {
 public:
     BgpMessageBuilder();
     virtual Message *Create(const BgpTable *table,
-                            const RibOutAttr *roattr,
+                            UpdateInfo *uinfo,
                             const BgpRoute *route) const;
     static BgpMessageBuilder *GetInstance();
 
@@ -793,28 +793,31 @@ void BgpPeer::ProcessUpdate(const BgpProto::Update *msg) {
             return;
         }
 
+        // Enqueue all the prefixes in the message as a single batch.
+        DBRequestList reqs;
         for (vector<BgpProtoPrefix *>::const_iterator it =
              msg->withdrawn_routes.begin(); it != msg->withdrawn_routes.end();
              ++it++) {
-            DBRequest req;
-            req.oper = DBRequest::DB_ENTRY_DELETE;
-            req.data.reset(NULL);
+            DBRequest *req = new DBRequest();
+            req->oper = DBRequest::DB_ENTRY_DELETE;
+            req->data.reset(NULL);
             Ip4Prefix prefix = Ip4Prefix(**it);
-            req.key.reset(new InetTable::RequestKey(prefix, this));
-            table->Enqueue(&req);
+            req->key.reset(new InetTable::RequestKey(prefix, this));
+            reqs.push_back(req);
             inc_rx_route_unreach();
         }
 
         for (vector<BgpProtoPrefix *>::const_iterator it = msg->nlri.begin();
              it != msg->nlri.end(); ++it) {
-            DBRequest req;
-            req.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
-            req.data.reset(new InetTable::RequestData(attr, flags, 0));
+            DBRequest *req = new DBRequest();
+            req->oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+            req->data.reset(new InetTable::RequestData(attr, flags, 0));
             Ip4Prefix prefix = Ip4Prefix(**it);
-            req.key.reset(new InetTable::RequestKey(prefix, this));
-            table->Enqueue(&req);
+            req->key.reset(new InetTable::RequestKey(prefix, this));
+            reqs.push_back(req);
             inc_rx_route_reach();
         }
+        table->Enqueue(&reqs);
     }
 
     for (std::vector<BgpAttribute *>::const_iterator ait =
@@ -846,6 +849,7 @@ void BgpPeer::ProcessUpdate(const BgpProto::Update *msg) {
         if ((*ait)->code == BgpAttribute::MPReachNlri)
             attr = GetMpNlriNexthop(nlri, attr);
 
+        DBRequestList reqs;
         switch (family) {
         case Address::INET: {
             InetTable *table =
@@ -854,14 +858,15 @@ void BgpPeer::ProcessUpdate(const BgpProto::Update *msg) {
 
             vector<BgpProtoPrefix *>::const_iterator it;
             for (it = nlri->nlri.begin(); it < nlri->nlri.end(); it++) {
-                DBRequest req;
-                req.oper = oper;
+                DBRequest *req = new DBRequest();
+                req->oper = oper;
                 if (oper == DBRequest::DB_ENTRY_ADD_CHANGE)
-                    req.data.reset(new InetTable::RequestData(attr, flags, 0));
+                    req->data.reset(new InetTable::RequestData(attr, flags, 0));
                 Ip4Prefix prefix = Ip4Prefix(**it);
-                req.key.reset(new InetTable::RequestKey(prefix, this));
-                table->Enqueue(&req);
+                req->key.reset(new InetTable::RequestKey(prefix, this));
+                reqs.push_back(req);
             }
+            table->Enqueue(&reqs);
             break;
         }
 
@@ -875,14 +880,15 @@ void BgpPeer::ProcessUpdate(const BgpProto::Update *msg) {
                 uint32_t label = ((*it)->prefix[0] << 16 |
                                   (*it)->prefix[1] << 8 |
                                   (*it)->prefix[2]) >> 4;
-                DBRequest req;
-                req.oper = oper;
+                DBRequest *req = new DBRequest();
+                req->oper = oper;
                 if (oper == DBRequest::DB_ENTRY_ADD_CHANGE)
-                    req.data.reset(new InetVpnTable::RequestData(attr, flags, label));
-                req.key.reset(new InetVpnTable::RequestKey(InetVpnPrefix(**it),
-                                                           this));
-                table->Enqueue(&req);
+                    req->data.reset(new InetVpnTable::RequestData(attr, flags, label));
+                req->key.reset(new InetVpnTable::RequestKey(InetVpnPrefix(**it),
+                                                            this));
+                reqs.push_back(req);
             }
+            table->Enqueue(&reqs);
             break;
         }
 
@@ -903,13 +909,14 @@ void BgpPeer::ProcessUpdate(const BgpProto::Update *msg) {
                 uint32_t label = ((*it)->prefix[label_offset] << 16 |
                                   (*it)->prefix[label_offset + 1] << 8 |
                                   (*it)->prefix[label_offset + 2]) >> 4;
-                DBRequest req;
-                req.oper = oper;
+                DBRequest *req = new DBRequest();
+                req->oper = oper;
                 if (oper == DBRequest::DB_ENTRY_ADD_CHANGE)
-                    req.data.reset(new EvpnTable::RequestData(attr, flags, label));
-                req.key.reset(new EvpnTable::RequestKey(EvpnPrefix(**it), this));
-                table->Enqueue(&req);
+                    req->data.reset(new EvpnTable::RequestData(attr, flags, label));
+                req->key.reset(new EvpnTable::RequestKey(EvpnPrefix(**it), this));
+                reqs.push_back(req);
             }
+            table->Enqueue(&reqs);
             break;
         }
 
@@ -449,7 +449,10 @@ void PeerRibMembershipManager::Leave(BgpTable *table,
                     request_list),
         // _1: DBTableBase
         boost::bind(&PeerRibMembershipManager::LeaveDone, this, _1,
-                    request_list));
+                    request_list),
+        // Withdrawing routes from a peer that is going away shouldn't starve
+        // updates to the peers that are up
+        DBTableWalker::PRIORITY_LOW);
 }
 
 //
@@ -107,7 +107,7 @@ bool RibOutUpdates::DequeueCommon(UpdateMarker *marker, RouteUpdate *rt_update,
 
         // Generate the update and merge additional updates into that message.
         auto_ptr<Message> message(
-            builder_->Create(table, &uinfo->roattr, rt_update->route()));
+            builder_->Create(table, uinfo, rt_update->route()));
         UpdatePack(rt_update->queue_id(), message.get(), uinfo, msgset);
         message->Finish();
 
@@ -363,7 +363,7 @@ void RibOutUpdates::UpdatePack(int queue_id, Message *message,
         // Go ahead and add the route to the message.  Terminate the loop
         // if the message doesn't have room for the route.  The route will
         // get included in another update message.
-        bool success = message->AddRoute(update->route(), &uinfo->roattr);
+        bool success = message->AddRoute(update->route(), uinfo);
         if (!success) {
             break;
         }
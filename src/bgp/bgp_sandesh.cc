@@ -12,6 +12,7 @@
 
 #include "base/util.h"
 #include "io/tcp_server.h"
+#include "bgp/bgp_attr.h"
 #include "bgp/bgp_config.h"
 #include "bgp/bgp_multicast.h"
 #include "bgp/bgp_path.h"
@@ -19,6 +20,7 @@
 #include "bgp/bgp_peer_membership.h"
 #include "bgp/bgp_route.h"
 #include "bgp/bgp_sandesh.h"
+#include "bgp/bgp_server.h"
 #include "bgp/bgp_session_manager.h"
 #include "bgp/bgp_table.h"
 #include "bgp/bgp_xmpp_channel.h"
@@ -30,7 +32,9 @@
 #include "bgp/origin-vn/origin_vn.h"
 #include "bgp/security_group/security_group.h"
 #include "bgp/tunnel_encap/tunnel_encap.h"
+#include "db/db.h"
 #include "db/db_table_partition.h"
+#include "db/db_table_walker.h"
 #include "xmpp/xmpp_server.h"
 
 using namespace boost::assign;
@@ -1280,6 +1284,27 @@ void ShowBgpNeighborConfigReq::HandleRequest() const {
 
 class ShowBgpServerHandler {
 public:
+    template <typename TypeDB>
+    static void FillPathAttributeDbStats(const string &name, TypeDB *db,
+            vector<ShowPathAttributeDbStats> *stats_list) {
+        typename TypeDB::Stats stats;
+        db->GetStats(&stats);
+
+        ShowPathAttributeDbStats sdbs;
+        sdbs.set_name(name);
+        sdbs.set_entries(db->Size());
+        sdbs.set_lockfree_hits(stats.lockfree_hits);
+        sdbs.set_locked_hits(stats.locked_hits);
+        sdbs.set_inserts(stats.inserts);
+        sdbs.set_deletes(stats.deletes);
+        sdbs.set_lock_contention(stats.lock_contention);
+        sdbs.set_retries(stats.retries);
+        sdbs.set_resizes(stats.resizes);
+        sdbs.set_retired(stats.retired);
+        sdbs.set_reclaimed(stats.reclaimed);
+        stats_list->push_back(sdbs);
+    }
+
     static bool CallbackS1(const Sandesh *sr,
             const RequestPipeline::PipeSpec ps, int stage, int instNum,
             RequestPipeline::InstData *data) {
@@ -1296,6 +1321,15 @@ public:
         bsc->bgp_server->session_manager()->GetTxSocketStats(peer_socket_stats);
         resp->set_tx_socket_stats(peer_socket_stats);
 
+        vector<ShowPathAttributeDbStats> db_stats;
+        BgpServer *server = bsc->bgp_server;
+        FillPathAttributeDbStats("attr", server->attr_db(), &db_stats);
+        FillPathAttributeDbStats("aspath", server->aspath_db(), &db_stats);
+        FillPathAttributeDbStats("community", server->comm_db(), &db_stats);
+        FillPathAttributeDbStats("extcommunity", server->extcomm_db(),
+                                 &db_stats);
+        resp->set_path_attribute_db_stats(db_stats);
+
         resp->set_context(req->context());
         resp->Response();
         return true;
@@ -1316,6 +1350,80 @@ void ShowBgpServerReq::HandleRequest() const {
     RequestPipeline rp(ps);
 }
 
+class ShowDBTableWalkHandler {
+public:
+    static string PriorityName(DBTableWalker::Priority priority) {
+        switch (priority) {
+        case DBTableWalker::PRIORITY_LOW:
+            return "low";
+        case DBTableWalker::PRIORITY_HIGH:
+            return "high";
+        default:
+            return "normal";
+        }
+    }
+
+    static bool CallbackS1(const Sandesh *sr,
+            const RequestPipeline::PipeSpec ps, int stage, int instNum,
+            RequestPipeline::InstData *data) {
+        const ShowDBTableWalkReq *req =
+            static_cast<const ShowDBTableWalkReq *>(ps.snhRequest_.get());
+        BgpSandeshContext *bsc =
+            static_cast<BgpSandeshContext *>(req->client_context());
+        DBTableWalker *walker = bsc->bgp_server->database()->GetWalker();
+
+        vector<DBTableWalker::WalkStats> stats;
+        walker->GetWalkStats(&stats);
+        uint64_t now = UTCTimestampUsec();
+        vector<ShowDBTableWalk> walks;
+        for (vector<DBTableWalker::WalkStats>::const_iterator it =
+             stats.begin(); it != stats.end(); ++it) {
+            ShowDBTableWalk walk;
+            walk.set_id(it->id);
+            walk.set_table(it->table);
+            walk.set_priority(PriorityName(it->priority));
+            walk.set_requests(it->requests);
+            walk.set_cancelled(it->cancelled);
+            walk.set_partitions(it->partitions);
+            walk.set_partitions_done(it->partitions_done);
+            walk.set_entries(it->entries);
+            walk.set_slices(it->slices);
+            walk.set_max_slice_usecs(it->max_slice_usecs);
+            uint64_t start = it->start_time ? it->start_time : now;
+            uint64_t end = it->end_time ? it->end_time : now;
+            walk.set_queue_usecs(start - it->request_time);
+            walk.set_walk_usecs(end - start);
+            walk.set_complete(it->end_time != 0);
+            walks.push_back(walk);
+        }
+
+        ShowDBTableWalkResp *resp = new ShowDBTableWalkResp;
+        resp->set_request_count(walker->walk_request_count());
+        resp->set_complete_count(walker->walk_complete_count());
+        resp->set_cancel_count(walker->walk_cancel_count());
+        resp->set_merge_count(walker->walk_merge_count());
+        resp->set_slice_budget_usecs(walker->slice_budget_usecs());
+        resp->set_walks(walks);
+        resp->set_context(req->context());
+        resp->Response();
+        return true;
+    }
+};
+
+void ShowDBTableWalkReq::HandleRequest() const {
+    RequestPipeline::PipeSpec ps(this);
+
+    // Request pipeline has single stage to collect walker stats and respond
+    // to the request
+    RequestPipeline::StageSpec s1;
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    s1.taskId_ = scheduler->GetTaskId("bgp::ShowCommand");
+    s1.cbFn_ = ShowDBTableWalkHandler::CallbackS1;
+    s1.instances_.push_back(0);
+    ps.stages_ = list_of(s1);
+    RequestPipeline rp(ps);
+}
+
 class ShowXmppServerHandler {
 public:
     static bool CallbackS1(const Sandesh *sr,
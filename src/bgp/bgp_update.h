@@ -6,6 +6,7 @@
 #define ctrlplane_bgp_update_h
 
 #include <list>
+#include <string>
 
 #include <boost/intrusive/list.hpp>
 #include <boost/intrusive/slist.hpp>
@@ -79,11 +80,13 @@ struct UpdateInfo {
     void clear() {
         roattr.clear();
         target.clear();
+        encoded_route.clear();
     }
 
     void swap(UpdateInfo &rhs) {
         std::swap(roattr, rhs.roattr);
         std::swap(target, rhs.target);
+        std::swap(encoded_route, rhs.encoded_route);
     }
 
     // Intrusive slist node for RouteUpdate.
@@ -98,6 +101,14 @@ struct UpdateInfo {
     // Update mask
     RibPeerSet target;
 
+    // Encoded form of the route and roattr, filled in by the message builder
+    // the first time the update is encoded. Reused when the update is sent
+    // in more than one message e.g. to peers that are at different markers.
+    // Only xmpp updates are cached, and all xmpp peers have the same export
+    // policy, so a table has a single xmpp RibOut and the cache is shared by
+    // all the peers that get the route with these attributes.
+    std::string encoded_route;
+
     // Backpointer to the RouteUpdate.
     RouteUpdate *update;
 
@@ -118,6 +129,7 @@ template <>
 inline void swap<UpdateInfo>(UpdateInfo &lhs, UpdateInfo &rhs) {
     swap(lhs.roattr, rhs.roattr);
     swap(lhs.target, rhs.target);
+    swap(lhs.encoded_route, rhs.encoded_route);
 }
 }
 #endif
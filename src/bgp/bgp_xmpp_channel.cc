@@ -20,6 +20,7 @@
 #include "bgp/bgp_peer_membership.h"
 #include "bgp/bgp_ribout.h"
 #include "bgp/bgp_server.h"
+#include "bgp/bgp_xmpp_item_parser.h"
 #include "bgp/inet/inet_table.h"
 #include "bgp/inetmcast/inetmcast_table.h"
 #include "bgp/enet/enet_table.h"
@@ -368,7 +369,9 @@ BgpXmppChannel::BgpXmppChannel(XmppChannel *channel, BgpServer *bgp_server,
             TaskScheduler::GetInstance()->GetTaskId("xmpp::StateMachine"),
             channel->connection()->GetIndex(),
             boost::bind(&BgpXmppChannel::MembershipResponseHandler, this, _1)),
-      lb_mgr_(new LabelBlockManager()) {
+      lb_mgr_(new LabelBlockManager()),
+      batch_open_(false),
+      batch_table_(NULL) {
 
     channel_->RegisterReceive(peer_id_,
          boost::bind(&BgpXmppChannel::ReceiveUpdate, this, _1));
@@ -444,7 +447,12 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
                    BGP_LOG_FLAG_ALL, "Invalid multicast message received");
         return;
     }
+    ProcessMcastItem(vrf_name, item, add_change);
+}
 
+void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
+                                      const autogen::McastItemType &item,
+                                      bool add_change) {
     // NLRI ipaddress/mask
     if (item.entry.nlri.af != BgpAf::IPv4) {
         BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, SandeshLevel::SYS_WARN,
@@ -665,7 +673,7 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
                                << " from peer:" << peer_->ToString() <<
                                " is enqueued for " <<
                                (add_change ? "add/change" : "delete"));
-    table->Enqueue(&req);
+    EnqueueRequest(table, &req);
 }
 
 void BgpXmppChannel::ProcessItem(string vrf_name,
@@ -679,7 +687,12 @@ void BgpXmppChannel::ProcessItem(string vrf_name,
                                    "Invalid message received");
         return;
     }
+    ProcessItem(vrf_name, item, add_change);
+}
 
+void BgpXmppChannel::ProcessItem(string vrf_name,
+                                 const autogen::ItemType &item,
+                                 bool add_change) {
     // NLRI ipaddress/mask
     if (item.entry.nlri.af != BgpAf::IPv4) {
         BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, SandeshLevel::SYS_WARN,
@@ -893,7 +906,7 @@ void BgpXmppChannel::ProcessItem(string vrf_name,
                                << " and label " << label
                                <<  " is enqueued for "
                                << (add_change ? "add/change" : "delete"));
-    table->Enqueue(&req);
+    EnqueueRequest(table, &req);
 }
 
 void BgpXmppChannel::ProcessEnetItem(string vrf_name,
@@ -908,7 +921,12 @@ void BgpXmppChannel::ProcessEnetItem(string vrf_name,
                                    "Invalid message received");
         return;
     }
+    ProcessEnetItem(vrf_name, item, add_change);
+}
 
+void BgpXmppChannel::ProcessEnetItem(string vrf_name,
+                                     const autogen::EnetItemType &item,
+                                     bool add_change) {
     // NLRI ipaddress/mask
     if (item.entry.nlri.af != BgpAf::L2Vpn) {
         BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, SandeshLevel::SYS_WARN,
@@ -1113,7 +1131,7 @@ void BgpXmppChannel::ProcessEnetItem(string vrf_name,
                                << " and label " << label
                                <<  " is enqueued for "
                                << (add_change ? "add/change" : "delete"));
-    table->Enqueue(&req);
+    EnqueueRequest(table, &req);
 }
 
 void BgpXmppChannel::DequeueRequest(const string &table_name,
@@ -1154,7 +1172,42 @@ void BgpXmppChannel::DequeueRequest(const string &table_name,
         data->set_attrs(new_attr);
     }
 
-    table->Enqueue(ptr.get());
+    EnqueueRequest(table, ptr.get());
+}
+
+//
+// Enqueue a route request to the table. While a batch is open, requests are
+// accumulated and enqueued to the table with a single operation when the
+// batch is closed or when a request for a different table shows up.
+//
+void BgpXmppChannel::EnqueueRequest(DBTableBase *table, DBRequest *req) {
+    if (!batch_open_) {
+        table->Enqueue(req);
+        return;
+    }
+    if (table != batch_table_) {
+        FlushBatch();
+        batch_table_ = table;
+    }
+    DBRequest *request = new DBRequest();
+    request->Swap(req);
+    batch_.push_back(request);
+}
+
+void BgpXmppChannel::StartBatch() {
+    batch_open_ = true;
+}
+
+void BgpXmppChannel::EndBatch() {
+    FlushBatch();
+    batch_open_ = false;
+}
+
+void BgpXmppChannel::FlushBatch() {
+    if (batch_table_ != NULL) {
+        batch_table_->Enqueue(&batch_);
+        batch_table_ = NULL;
+    }
 }
 
 bool BgpXmppChannel::ResumeClose() {
@@ -1245,10 +1298,12 @@ bool BgpXmppChannel::MembershipResponseHandler(std::string table_name) {
         rib->set_instance_id(state.instance_id);
     }
 
+    StartBatch();
     for(DeferQ::iterator it = defer_q_.find(vrf_n_table);
         (it != defer_q_.end() && it->first.second == table_name); it++) {
         DequeueRequest(table_name, it->second);
     }
+    EndBatch();
     // Erase all elements for the table
     defer_q_.erase(vrf_n_table);
 
@@ -1472,35 +1527,108 @@ void BgpXmppChannel::ReceiveUpdate(const XmppStanza::XmppMessage *msg) {
             } else if (iq->action.compare("unsubscribe") == 0) {
                 ProcessSubscriptionRequest(iq->node, iq, false);
             } else if (iq->action.compare("publish") == 0) {
-                XmlBase *impl = msg->dom.get();
                 stats_[0].rt_updates++;
+                std::string id(iq->as_node.c_str());
+                char *str = const_cast<char *>(id.c_str());
+                char *saveptr;
+                char *af_str = strtok_r(str, "/", &saveptr);
+                char *safi_str = strtok_r(NULL, "/", &saveptr);
+                if (af_str == NULL || safi_str == NULL) {
+                    BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN,
+                                      BGP_LOG_FLAG_ALL,
+                                      "Invalid publish node attribute: " <<
+                                      iq->as_node);
+                    return;
+                }
+                int af = atoi(af_str);
+                int safi = atoi(safi_str);
+
+                // Enqueue the routes in the message as a single batch.
+                StartBatch();
+                XmlBase *impl = msg->dom.get();
+                if (!impl) {
+                    ProcessPublish(iq, af, safi);
+                    EndBatch();
+                    return;
+                }
+
                 XmlPugi *pugi = reinterpret_cast<XmlPugi *>(impl);
                 for (xml_node item = pugi->FindNode("item"); item;
                     item = item.next_sibling()) {
                     if (strcmp(item.name(), "item") != 0) continue;
 
-                        std::string id(iq->as_node.c_str());
-                        char *str = const_cast<char *>(id.c_str());
-                        char *saveptr;
-                        char *af = strtok_r(str, "/", &saveptr);
-                        char *safi = strtok_r(NULL, "/", &saveptr);
-
-                        if (atoi(af) == BgpAf::IPv4 &&
-                            atoi(safi) == BgpAf::Unicast) {
-                            ProcessItem(iq->node, item, iq->is_as_node);
-                        } else if (atoi(af) == BgpAf::IPv4 &&
-                            atoi(safi) == BgpAf::Mcast) {
-                            ProcessMcastItem(iq->node, item, iq->is_as_node);
-                        } else if (atoi(af) == BgpAf::L2Vpn &&
-                                   atoi(safi) == BgpAf::Enet) {
-                            ProcessEnetItem(iq->node, item, iq->is_as_node);
-                        }
+                    if (af == BgpAf::IPv4 && safi == BgpAf::Unicast) {
+                        ProcessItem(iq->node, item, iq->is_as_node);
+                    } else if (af == BgpAf::IPv4 && safi == BgpAf::Mcast) {
+                        ProcessMcastItem(iq->node, item, iq->is_as_node);
+                    } else if (af == BgpAf::L2Vpn && safi == BgpAf::Enet) {
+                        ProcessEnetItem(iq->node, item, iq->is_as_node);
+                    }
                 }
+                EndBatch();
             }
         }
     }
 }
 
+//
+// Process the items in a publish message that was received without a dom.
+// The items are decoded straight from the raw stanza.
+//
+void BgpXmppChannel::ProcessPublish(const XmppStanza::XmppMessageIq *iq,
+                                    int af, int safi) {
+    XmlPullParser parser(iq->data.data(), iq->data.size());
+    XmlPullParser::Event event;
+    while ((event = parser.Next()) != XmlPullParser::END_DOCUMENT &&
+           event != XmlPullParser::ERROR) {
+        if (event == XmlPullParser::START_ELEMENT &&
+            parser.NameIs("publish")) {
+            break;
+        }
+    }
+
+    int depth = parser.depth();
+    bool found = (event == XmlPullParser::START_ELEMENT);
+    while (found) {
+        event = parser.Next();
+        if (event == XmlPullParser::TEXT)
+            continue;
+        if (event != XmlPullParser::START_ELEMENT)
+            break;
+
+        bool success = true;
+        if (!parser.NameIs("item")) {
+            success = parser.SkipElement();
+        } else if (af == BgpAf::IPv4 && safi == BgpAf::Unicast) {
+            autogen::ItemType item;
+            success = BgpXmppItemParser::Parse(&parser, &item);
+            if (success)
+                ProcessItem(iq->node, item, iq->is_as_node);
+        } else if (af == BgpAf::IPv4 && safi == BgpAf::Mcast) {
+            autogen::McastItemType item;
+            success = BgpXmppItemParser::Parse(&parser, &item);
+            if (success)
+                ProcessMcastItem(iq->node, item, iq->is_as_node);
+        } else if (af == BgpAf::L2Vpn && safi == BgpAf::Enet) {
+            autogen::EnetItemType item;
+            success = BgpXmppItemParser::Parse(&parser, &item);
+            if (success)
+                ProcessEnetItem(iq->node, item, iq->is_as_node);
+        } else {
+            success = parser.SkipElement();
+        }
+        if (!success)
+            break;
+    }
+
+    if (!found || event != XmlPullParser::END_ELEMENT ||
+        parser.depth() != depth) {
+        BGP_LOG_XMPP_PEER_INSTANCE(Peer(), iq->node, SandeshLevel::SYS_WARN,
+                                   BGP_LOG_FLAG_ALL,
+                                   "Invalid message received");
+    }
+}
+
 bool BgpXmppChannelManager::DeleteExecutor(BgpXmppChannel *channel) {
     if (channel->deleted()) return true;
     channel->set_deleted(true);
@@ -1525,6 +1653,9 @@ BgpXmppChannelManager::BgpXmppChannelManager(XmppServer *xmpp_server,
     queue_.SetEntryCallback(
             boost::bind(&BgpXmppChannelManager::IsReadyForDeletion, this));
     if (xmpp_server) {
+        // Decode route updates without a dom only if asked to.
+        xmpp_server->set_streaming_publish(
+            getenv("BGP_XMPP_STREAMING_PARSER") != NULL);
         xmpp_server->RegisterConnectionEvent(xmps::BGP,
                boost::bind(&BgpXmppChannelManager::XmppHandleChannelEvent,
                            this, _1, _2));
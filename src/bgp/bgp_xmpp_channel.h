@@ -15,14 +15,20 @@
 
 #include "base/queue_task.h"
 #include "bgp/bgp_ribout.h"
+#include "db/db_table.h"
 #include "xmpp/xmpp_channel.h"
 
 namespace pugi{
 class xml_node;
 }
 
+namespace autogen {
+struct ItemType;
+struct EnetItemType;
+struct McastItemType;
+}
+
 class BgpServer;
-struct DBRequest;
 class IPeer;
 class PeerCloseManager;
 class RoutingInstance;
@@ -101,10 +107,18 @@ private:
 
     void ProcessItem(std::string rt_instance, const pugi::xml_node &item,
                      bool add_change);
+    void ProcessItem(std::string rt_instance, const autogen::ItemType &item,
+                     bool add_change);
     void ProcessMcastItem(std::string rt_instance, 
                           const pugi::xml_node &item, bool add_change);
+    void ProcessMcastItem(std::string rt_instance,
+                          const autogen::McastItemType &item,
+                          bool add_change);
     void ProcessEnetItem(std::string rt_instance,
                          const pugi::xml_node &item, bool add_change);
+    void ProcessEnetItem(std::string rt_instance,
+                         const autogen::EnetItemType &item, bool add_change);
+    void ProcessPublish(const XmppStanza::XmppMessageIq *iq, int af, int safi);
     void ProcessSubscriptionRequest(std::string rt_instance,
                                     const XmppStanza::XmppMessageIq *iq,
                                     bool add_change);
@@ -114,6 +128,10 @@ private:
     bool MembershipResponseHandler(std::string table_name);
     void MembershipRequestCallback(IPeer *ipeer, BgpTable *table);
     void DequeueRequest(const std::string &table_name, DBRequest *request);
+    void EnqueueRequest(DBTableBase *table, DBRequest *req);
+    void StartBatch();
+    void EndBatch();
+    void FlushBatch();
     bool XmppDecodeAddress(int af, const std::string &address,
                            IpAddress *addrp);
     bool ResumeClose();
@@ -145,6 +163,11 @@ private:
     // Label block manager for multicast labels.
     LabelBlockManagerPtr lb_mgr_;
 
+    // Route requests accumulated while a batch is open.
+    bool batch_open_;
+    DBTableBase *batch_table_;
+    DBRequestList batch_;
+
     DISALLOW_COPY_AND_ASSIGN(BgpXmppChannel);
 };
 
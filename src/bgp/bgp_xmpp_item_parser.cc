@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "bgp/bgp_xmpp_item_parser.h"
+
+#include <stdlib.h>
+
+#include "schema/xmpp_unicast_types.h"
+#include "schema/xmpp_multicast_types.h"
+#include "schema/xmpp_enet_types.h"
+
+using namespace std;
+
+//
+// Advance to the next child of the element at the given depth. Returns false
+// once the end of the parent element is reached or if there's a parse error.
+//
+bool BgpXmppItemParser::NextChild(XmlPullParser *parser, int depth) {
+    while (true) {
+        switch (parser->Next()) {
+        case XmlPullParser::START_ELEMENT:
+            return parser->depth() == depth + 1;
+        case XmlPullParser::TEXT:
+            break;
+        default:
+            return false;
+        }
+    }
+}
+
+bool BgpXmppItemParser::ReadValue(XmlPullParser *parser, int *value) {
+    XmlPullParser::Token text;
+    if (!parser->ReadRawText(&text))
+        return false;
+    if (text.empty())
+        return true;
+
+    char buf[32];
+    if (text.size >= sizeof(buf))
+        return false;
+    memcpy(buf, text.data, text.size);
+    buf[text.size] = '\0';
+    char *end;
+    long number = strtol(buf, &end, 10);
+    if (end == buf)
+        return false;
+    *value = number;
+    return true;
+}
+
+bool BgpXmppItemParser::ReadValue(XmlPullParser *parser, string *value) {
+    return parser->ReadText(value);
+}
+
+template <typename NextHopType>
+bool BgpXmppItemParser::ParseNextHop(XmlPullParser *parser, NextHopType *nh) {
+    int depth = parser->depth();
+    while (NextChild(parser, depth)) {
+        bool success;
+        if (parser->NameIs("af")) {
+            success = ReadValue(parser, &nh->af);
+        } else if (parser->NameIs("address")) {
+            success = ReadValue(parser, &nh->address);
+        } else if (parser->NameIs("label")) {
+            success = ReadValue(parser, &nh->label);
+        } else if (parser->NameIs("tunnel-encapsulation-list")) {
+            int list_depth = parser->depth();
+            vector<string> *list =
+                &nh->tunnel_encapsulation_list.tunnel_encapsulation;
+            while (NextChild(parser, list_depth)) {
+                if (parser->NameIs("tunnel-encapsulation")) {
+                    list->push_back(string());
+                    success = ReadValue(parser, &list->back());
+                } else {
+                    success = parser->SkipElement();
+                }
+                if (!success)
+                    return false;
+            }
+            success = !parser->error();
+        } else {
+            success = parser->SkipElement();
+        }
+        if (!success)
+            return false;
+    }
+    return !parser->error();
+}
+
+template <typename NextHopType>
+bool BgpXmppItemParser::ParseNextHops(XmlPullParser *parser,
+                                      vector<NextHopType> *list) {
+    int depth = parser->depth();
+    while (NextChild(parser, depth)) {
+        bool success;
+        if (parser->NameIs("next-hop")) {
+            list->push_back(NextHopType());
+            list->back().Clear();
+            success = ParseNextHop(parser, &list->back());
+        } else {
+            success = parser->SkipElement();
+        }
+        if (!success)
+            return false;
+    }
+    return !parser->error();
+}
+
+bool BgpXmppItemParser::ParseEntry(XmlPullParser *parser,
+                                   autogen::ItemType *item) {
+    int depth = parser->depth();
+    while (NextChild(parser, depth)) {
+        bool success = true;
+        if (parser->NameIs("nlri")) {
+            int nlri_depth = parser->depth();
+            while (success && NextChild(parser, nlri_depth)) {
+                if (parser->NameIs("af")) {
+                    success = ReadValue(parser, &item->entry.nlri.af);
+                } else if (parser->NameIs("safi")) {
+                    success = ReadValue(parser, &item->entry.nlri.safi);
+                } else if (parser->NameIs("address")) {
+                    success = ReadValue(parser, &item->entry.nlri.address);
+                } else {
+                    success = parser->SkipElement();
+                }
+            }
+        } else if (parser->NameIs("next-hops")) {
+            success = ParseNextHops(parser, &item->entry.next_hops.next_hop);
+        } else if (parser->NameIs("version")) {
+            success = ReadValue(parser, &item->entry.version);
+        } else if (parser->NameIs("virtual-network")) {
+            success = ReadValue(parser, &item->entry.virtual_network);
+        } else if (parser->NameIs("security-group-list")) {
+            int list_depth = parser->depth();
+            vector<int> *list = &item->entry.security_group_list.security_group;
+            while (success && NextChild(parser, list_depth)) {
+                if (parser->NameIs("security-group")) {
+                    list->push_back(0);
+                    success = ReadValue(parser, &list->back());
+                } else {
+                    success = parser->SkipElement();
+                }
+            }
+        } else {
+            success = parser->SkipElement();
+        }
+        if (!success || parser->error())
+            return false;
+    }
+    return !parser->error();
+}
+
+bool BgpXmppItemParser::ParseEntry(XmlPullParser *parser,
+                                   autogen::EnetItemType *item) {
+    int depth = parser->depth();
+    while (NextChild(parser, depth)) {
+        bool success = true;
+        if (parser->NameIs("nlri")) {
+            int nlri_depth = parser->depth();
+            while (success && NextChild(parser, nlri_depth)) {
+                if (parser->NameIs("af")) {
+                    success = ReadValue(parser, &item->entry.nlri.af);
+                } else if (parser->NameIs("safi")) {
+                    success = ReadValue(parser, &item->entry.nlri.safi);
+                } else if (parser->NameIs("mac")) {
+                    success = ReadValue(parser, &item->entry.nlri.mac);
+                } else if (parser->NameIs("address")) {
+                    success = ReadValue(parser, &item->entry.nlri.address);
+                } else {
+                    success = parser->SkipElement();
+                }
+            }
+        } else if (parser->NameIs("next-hops")) {
+            success = ParseNextHops(parser, &item->entry.next_hops.next_hop);
+        } else {
+            success = parser->SkipElement();
+        }
+        if (!success || parser->error())
+            return false;
+    }
+    return !parser->error();
+}
+
+bool BgpXmppItemParser::ParseEntry(XmlPullParser *parser,
+                                   autogen::McastItemType *item) {
+    int depth = parser->depth();
+    while (NextChild(parser, depth)) {
+        bool success = true;
+        if (parser->NameIs("nlri")) {
+            int nlri_depth = parser->depth();
+            while (success && NextChild(parser, nlri_depth)) {
+                if (parser->NameIs("af")) {
+                    success = ReadValue(parser, &item->entry.nlri.af);
+                } else if (parser->NameIs("safi")) {
+                    success = ReadValue(parser, &item->entry.nlri.safi);
+                } else if (parser->NameIs("group")) {
+                    success = ReadValue(parser, &item->entry.nlri.group);
+                } else if (parser->NameIs("source")) {
+                    success = ReadValue(parser, &item->entry.nlri.source);
+                } else if (parser->NameIs("source-label")) {
+                    success =
+                        ReadValue(parser, &item->entry.nlri.source_label);
+                } else {
+                    success = parser->SkipElement();
+                }
+            }
+        } else if (parser->NameIs("next-hops")) {
+            success = ParseNextHops(parser, &item->entry.next_hops.next_hop);
+        } else if (parser->NameIs("olist")) {
+            success = ParseNextHops(parser, &item->entry.olist.next_hop);
+        } else {
+            success = parser->SkipElement();
+        }
+        if (!success || parser->error())
+            return false;
+    }
+    return !parser->error();
+}
+
+template <typename ItemType>
+bool BgpXmppItemParser::ParseItem(XmlPullParser *parser, ItemType *item) {
+    item->Clear();
+    int depth = parser->depth();
+    while (NextChild(parser, depth)) {
+        bool success;
+        if (parser->NameIs("entry")) {
+            success = ParseEntry(parser, item);
+        } else {
+            success = parser->SkipElement();
+        }
+        if (!success)
+            return false;
+    }
+    return !parser->error();
+}
+
+bool BgpXmppItemParser::Parse(XmlPullParser *parser,
+                              autogen::ItemType *item) {
+    return ParseItem(parser, item);
+}
+
+bool BgpXmppItemParser::Parse(XmlPullParser *parser,
+                              autogen::EnetItemType *item) {
+    return ParseItem(parser, item);
+}
+
+bool BgpXmppItemParser::Parse(XmlPullParser *parser,
+                              autogen::McastItemType *item) {
+    return ParseItem(parser, item);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef ctrlplane_bgp_xmpp_item_parser_h
+#define ctrlplane_bgp_xmpp_item_parser_h
+
+#include <string>
+#include <vector>
+
+#include "xml/xml_pull_parser.h"
+
+namespace autogen {
+struct ItemType;
+struct EnetItemType;
+struct McastItemType;
+}
+
+//
+// Decodes the route items in an xmpp publish message directly into the
+// autogen item types, without building a DOM for the message. Each Parse
+// method must be called with the parser positioned at the START_ELEMENT of
+// an item. On return, the parser is positioned at the matching END_ELEMENT.
+// Elements that are not part of the schema are skipped.
+//
+class BgpXmppItemParser {
+public:
+    static bool Parse(XmlPullParser *parser, autogen::ItemType *item);
+    static bool Parse(XmlPullParser *parser, autogen::EnetItemType *item);
+    static bool Parse(XmlPullParser *parser, autogen::McastItemType *item);
+
+private:
+    static bool NextChild(XmlPullParser *parser, int depth);
+    static bool ReadValue(XmlPullParser *parser, int *value);
+    static bool ReadValue(XmlPullParser *parser, std::string *value);
+
+    template <typename ItemType>
+    static bool ParseItem(XmlPullParser *parser, ItemType *item);
+    template <typename NextHopType>
+    static bool ParseNextHop(XmlPullParser *parser, NextHopType *nh);
+    template <typename NextHopType>
+    static bool ParseNextHops(XmlPullParser *parser,
+                              std::vector<NextHopType> *list);
+    static bool ParseEntry(XmlPullParser *parser, autogen::ItemType *item);
+    static bool ParseEntry(XmlPullParser *parser, autogen::EnetItemType *item);
+    static bool ParseEntry(XmlPullParser *parser, autogen::McastItemType *item);
+};
+
+#endif
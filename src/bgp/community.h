@@ -63,6 +63,7 @@ public:
 private:
     friend int intrusive_ptr_add_ref(const Community *ccomm);
     friend int intrusive_ptr_del_ref(const Community *ccomm);
+    friend bool intrusive_ptr_try_add_ref(const Community *ccomm);
     friend void intrusive_ptr_release(const Community *ccomm);
 
     mutable tbb::atomic<int> refcount_;
@@ -74,6 +75,19 @@ inline int intrusive_ptr_add_ref(const Community *ccomm) {
     return ccomm->refcount_.fetch_and_increment();
 }
 
+// Take a reference only if the refcount is not 0, i.e. the entry is not
+// being deleted.
+inline bool intrusive_ptr_try_add_ref(const Community *ccomm) {
+    int count = ccomm->refcount_;
+    while (count > 0) {
+        int prev = ccomm->refcount_.compare_and_swap(count + 1, count);
+        if (prev == count)
+            return true;
+        count = prev;
+    }
+    return false;
+}
+
 inline int intrusive_ptr_del_ref(const Community *ccomm) {
     return ccomm->refcount_.fetch_and_decrement();
 }
@@ -82,23 +96,16 @@ inline void intrusive_ptr_release(const Community *ccomm) {
     int prev = ccomm->refcount_.fetch_and_decrement();
     if (prev == 1) {
         Community *comm = const_cast<Community *>(ccomm);
+
+        // The database frees the entry once it is safe to do so.
         comm->Remove();
-        assert(comm->refcount_ == 0);
-        delete comm;
     }
 }
 
 typedef boost::intrusive_ptr<const Community> CommunityPtr;
 
-struct CommunityCompare {
-    bool operator()(const Community *lhs, const Community *rhs) {
-        return lhs->CompareTo(*rhs) < 0;
-    }
-};
-
 class CommunityDB : public BgpPathAttributeDB<Community, CommunityPtr,
-                                              CommunitySpec, CommunityCompare,
-                                              CommunityDB> {
+                                              CommunitySpec, CommunityDB> {
 public:
     CommunityDB(BgpServer *server);
     virtual ~CommunityDB() { }
@@ -202,6 +209,7 @@ public:
 private:
     friend int intrusive_ptr_add_ref(const ExtCommunity *cextcomm);
     friend int intrusive_ptr_del_ref(const ExtCommunity *cextcomm);
+    friend bool intrusive_ptr_try_add_ref(const ExtCommunity *cextcomm);
     friend void intrusive_ptr_release(const ExtCommunity *cextcomm);
 
     mutable tbb::atomic<int> refcount_;
@@ -213,6 +221,19 @@ inline int intrusive_ptr_add_ref(const ExtCommunity *cextcomm) {
     return cextcomm->refcount_.fetch_and_increment();
 }
 
+// Take a reference only if the refcount is not 0, i.e. the entry is not
+// being deleted.
+inline bool intrusive_ptr_try_add_ref(const ExtCommunity *cextcomm) {
+    int count = cextcomm->refcount_;
+    while (count > 0) {
+        int prev = cextcomm->refcount_.compare_and_swap(count + 1, count);
+        if (prev == count)
+            return true;
+        count = prev;
+    }
+    return false;
+}
+
 inline int intrusive_ptr_del_ref(const ExtCommunity *cextcomm) {
     return cextcomm->refcount_.fetch_and_decrement();
 }
@@ -221,23 +242,16 @@ inline void intrusive_ptr_release(const ExtCommunity *cextcomm) {
     int prev = cextcomm->refcount_.fetch_and_decrement();
     if (prev == 1) {
         ExtCommunity *extcomm = const_cast<ExtCommunity *>(cextcomm);
+
+        // The database frees the entry once it is safe to do so.
         extcomm->Remove();
-        assert(extcomm->refcount_ == 0);
-        delete extcomm;
     }
 }
 
 typedef boost::intrusive_ptr<const ExtCommunity> ExtCommunityPtr;
 
-struct ExtCommunityCompare {
-    bool operator()(const ExtCommunity *lhs, const ExtCommunity *rhs) {
-        return lhs->CompareTo(*rhs) < 0;
-    }
-};
-
 class ExtCommunityDB : public BgpPathAttributeDB<ExtCommunity, ExtCommunityPtr,
                                                  ExtCommunitySpec,
-                                                 ExtCommunityCompare,
                                                  ExtCommunityDB> {
 public:
     ExtCommunityDB(BgpServer *server);
@@ -8,6 +8,7 @@
 #include "bgp/bgp_ribout.h"
 
 class BgpRoute;
+struct UpdateInfo;
 
 class Message {
 public:
@@ -15,7 +16,11 @@ public:
     }
     virtual ~Message();
     // Returns true if the route was successfully added to the message.
-    virtual bool AddRoute(const BgpRoute *route, const RibOutAttr *roattr) = 0;
+    //
+    // The UpdateInfo provides the RibOutAttr for the route. The message may
+    // also use it to cache the encoded form of the route, which is reused if
+    // the same UpdateInfo gets sent in more than one message.
+    virtual bool AddRoute(const BgpRoute *route, UpdateInfo *uinfo) = 0;
     virtual void Finish() = 0;
     virtual const uint8_t *GetData(IPeerUpdate *peer_update, size_t *lenp) = 0;
     uint32_t num_reach_routes() const { 
@@ -32,7 +37,7 @@ protected:
 class MessageBuilder {
 public:
     virtual Message *Create(const BgpTable *table,
-                            const RibOutAttr *roattr,
+                            UpdateInfo *uinfo,
                             const BgpRoute *route) const = 0;
     static MessageBuilder *GetInstance(RibExportPolicy::Encoding encoding);
 };
@@ -403,6 +403,62 @@ TEST_F(BgpAttrTest, BgpAttrDB) {
     STLDeleteValues(&spec);
 }
 
+TEST_F(BgpAttrTest, BgpAttrDBStats) {
+    BgpAttrSpec spec;
+    BgpAttrOrigin *origin = new BgpAttrOrigin(BgpAttrOrigin::INCOMPLETE);
+    spec.push_back(origin);
+
+    BgpAttrDB::Stats stats1;
+    attr_db_->GetStats(&stats1);
+
+    BgpAttrPtr ptr1 = attr_db_->Locate(spec);
+    BgpAttrPtr ptr2 = attr_db_->Locate(spec);
+    EXPECT_EQ(ptr1.get(), ptr2.get());
+    EXPECT_EQ(1, attr_db_->Size());
+
+    BgpAttrDB::Stats stats2;
+    attr_db_->GetStats(&stats2);
+    EXPECT_EQ(stats1.inserts + 1, stats2.inserts);
+    EXPECT_EQ(stats1.lockfree_hits + 1, stats2.lockfree_hits);
+
+    ptr1.reset();
+    ptr2.reset();
+    EXPECT_EQ(0, attr_db_->Size());
+
+    BgpAttrDB::Stats stats3;
+    attr_db_->GetStats(&stats3);
+    EXPECT_EQ(stats1.deletes + 1, stats3.deletes);
+
+    STLDeleteValues(&spec);
+}
+
+// Verify that the database grows beyond its initial size and that entries
+// are still found after the table is resized.
+TEST_F(BgpAttrTest, BgpAttrDBResize) {
+    std::vector<BgpAttrPtr> ptr_list;
+    for (int idx = 0; idx < 1024; idx++) {
+        BgpAttrSpec spec;
+        BgpAttrLocalPref *local_pref = new BgpAttrLocalPref(idx);
+        spec.push_back(local_pref);
+        ptr_list.push_back(attr_db_->Locate(spec));
+        STLDeleteValues(&spec);
+    }
+    EXPECT_EQ(1024, attr_db_->Size());
+
+    for (int idx = 0; idx < 1024; idx++) {
+        BgpAttrSpec spec;
+        BgpAttrLocalPref *local_pref = new BgpAttrLocalPref(idx);
+        spec.push_back(local_pref);
+        BgpAttrPtr ptr = attr_db_->Locate(spec);
+        EXPECT_EQ(ptr_list[idx].get(), ptr.get());
+        STLDeleteValues(&spec);
+    }
+    EXPECT_EQ(1024, attr_db_->Size());
+
+    ptr_list.clear();
+    EXPECT_EQ(0, attr_db_->Size());
+}
+
 // ----- Test multi-threaded issues in path attributes db.
 // Launch a number of threads, that add and delete the same attribute content.
 // Since many threads are launched, we get to uncover most of the concurrency
@@ -481,6 +537,67 @@ TEST_F(BgpAttrTest, ExtCommunityDBConcurrency) {
                     ExtCommunitySpec>(extcomm_db_);
 }
 
+// ----- Stress lock-free lookups against deletes.
+// A number of threads repeatedly locate and release a few communities, so
+// that lookups keep racing with the release of the last reference to an
+// entry. Each thread checks that it gets back an entry with the contents it
+// asked for, and the database must be empty once all threads are done.
+
+static const int kStressCommunities = 4;
+
+struct LocateReleaseArgs {
+    CommunityDB *db;
+    int iterations;
+    int offset;
+};
+
+static void *LocateReleaseThreadRun(void *objp) {
+    LocateReleaseArgs *args = reinterpret_cast<LocateReleaseArgs *>(objp);
+    for (int i = 0; i < args->iterations; i++) {
+        uint32_t value = 0x10000 + (i + args->offset) % kStressCommunities;
+        CommunitySpec spec;
+        spec.communities.push_back(value);
+        CommunityPtr comm = args->db->Locate(spec);
+        EXPECT_EQ(1, comm->communities().size());
+        EXPECT_EQ(value, comm->communities()[0]);
+
+        // Hold a second community across the release of the first one, so
+        // that refcounts go through 0 with other entries still live.
+        spec.communities[0] = 0x10000 + (i + args->offset + 1) %
+            kStressCommunities;
+        CommunityPtr next = args->db->Locate(spec);
+        comm.reset();
+        EXPECT_EQ(spec.communities[0], next->communities()[0]);
+    }
+    return NULL;
+}
+
+TEST_F(BgpAttrTest, CommunityDBLocateReleaseStress) {
+    int thread_count = 16;
+    int iterations = 10000;
+    char *str = getenv("BGP_ATTR_TEST_ITERATIONS");
+    if (str) iterations = strtoul(str, NULL, 0);
+
+    std::vector<LocateReleaseArgs> args(thread_count);
+    std::vector<pthread_t> thread_ids;
+    for (int i = 0; i < thread_count; i++) {
+        args[i].db = comm_db_;
+        args[i].iterations = iterations;
+        args[i].offset = i;
+        pthread_t tid;
+        if (!pthread_create(&tid, NULL, &LocateReleaseThreadRun, &args[i])) {
+            thread_ids.push_back(tid);
+        }
+    }
+
+    BOOST_FOREACH(pthread_t tid, thread_ids) { pthread_join(tid, NULL); }
+    TASK_UTIL_EXPECT_EQ(0, comm_db_->Size());
+
+    CommunityDB::Stats stats;
+    comm_db_->GetStats(&stats);
+    EXPECT_EQ(stats.inserts, stats.deletes);
+}
+
 static void SetUp() {
     bgp_log_test::init();
     ControlNode::SetDefaultSchedulingPolicy();
@@ -114,7 +114,7 @@ private:
 
 class MessageMock : public Message {
 public:
-    virtual bool AddRoute(const BgpRoute *route, const RibOutAttr *attr) {
+    virtual bool AddRoute(const BgpRoute *route, UpdateInfo *uinfo) {
         return true;
     }
     virtual void Finish() {
@@ -133,11 +133,11 @@ public:
     virtual ~MsgBuilderMock() { }
 
     virtual Message *Create(const BgpTable *table,
-                            const RibOutAttr *attr,
+                            UpdateInfo *uinfo,
                             const BgpRoute *route) const {
         msg_count_++;
         if (use_bgp_messages) {
-            return BgpMessageBuilder::Create(table, attr, route);
+            return BgpMessageBuilder::Create(table, uinfo, route);
         } else {
             return new MessageMock();
         }
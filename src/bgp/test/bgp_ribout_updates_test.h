@@ -83,7 +83,7 @@ private:
 class MessageMock : public Message {
 public:
     MessageMock() : route_count_(1) { }
-    virtual bool AddRoute(const BgpRoute *route, const RibOutAttr *attr) {
+    virtual bool AddRoute(const BgpRoute *route, UpdateInfo *uinfo) {
         return (++route_count_ == 1000 ? false : true);
     }
     virtual void Finish() {
@@ -105,11 +105,11 @@ public:
     virtual ~MsgBuilderMock() { }
 
     virtual Message *Create(const BgpTable *table,
-                            const RibOutAttr *attr,
+                            UpdateInfo *uinfo,
                             const BgpRoute *route) const {
         msg_count_++;
         if (use_bgp_messages) {
-            return BgpMessageBuilder::Create(table, attr, route);
+            return BgpMessageBuilder::Create(table, uinfo, route);
         } else {
             return new MessageMock();
         }
@@ -111,7 +111,7 @@ class MsgBuilderMock : public MessageBuilder {
 public:
     class MessageMock : public Message {
     public:
-        virtual bool AddRoute(const BgpRoute *route, const RibOutAttr* attr) {
+        virtual bool AddRoute(const BgpRoute *route, UpdateInfo *uinfo) {
             return true;
         }
         virtual void Finish() {
@@ -121,7 +121,7 @@ public:
         }
     };
     virtual Message *Create(const BgpTable *table,
-                            const RibOutAttr *attr,
+                            UpdateInfo *uinfo,
                             const BgpRoute *route) const {
         return new MessageMock();
     }
@@ -18,6 +18,9 @@
 #include "base/util.h"
 #include "control-node/control_node.h"
 #include "bgp/bgp_factory.h"
+#include "bgp/bgp_path.h"
+#include "bgp/bgp_route.h"
+#include "bgp/inet/inet_table.h"
 #include "bgp/routing-instance/routing_instance.h"
 #include "bgp/bgp_server.h"
 #include "bgp/bgp_session_manager.h"
@@ -30,6 +33,7 @@
 #include "xmpp/xmpp_channel.h"
 #include "xmpp/xmpp_channel_mux.h"
 #include "xmpp/xmpp_connection.h"
+#include "xmpp/xmpp_proto.h"
 #include "testing/gunit.h"
 
 using namespace std;
@@ -310,6 +314,53 @@ protected:
         return msg;
     }
 
+    // Decodes a route add or delete document the way XmppConnection does:
+    // the publish stanza, with the streaming parser if streaming is set,
+    // merged with the collection stanza that follows it.
+    std::auto_ptr<XmppStanza::XmppMessageIq> DecodeRouteMsg(
+            pugi::xml_document *doc, bool streaming) {
+        pugi::xml_node publish = doc->first_child();
+        pugi::xml_node collection = publish.next_sibling();
+        std::auto_ptr<XmppStanza::XmppMessage> pub_msg(
+            XmppProto::Decode(NodeString(publish), streaming));
+        std::auto_ptr<XmppStanza::XmppMessage> coll_msg(
+            XmppProto::Decode(NodeString(collection), false));
+        EXPECT_TRUE(pub_msg.get() != NULL);
+        EXPECT_TRUE(coll_msg.get() != NULL);
+        if (pub_msg.get() == NULL || coll_msg.get() == NULL) {
+            return std::auto_ptr<XmppStanza::XmppMessageIq>();
+        }
+
+        std::auto_ptr<XmppStanza::XmppMessageIq> msg(
+            static_cast<XmppStanza::XmppMessageIq *>(pub_msg.release()));
+        const XmppStanza::XmppMessageIq *coll =
+            static_cast<const XmppStanza::XmppMessageIq *>(coll_msg.get());
+        EXPECT_EQ("publish", msg->action);
+        EXPECT_EQ(streaming, msg->dom.get() == NULL);
+        EXPECT_EQ(msg->node, coll->as_node);
+        if (msg->dom.get()) {
+            msg->dom->ReadNode("publish");
+            msg->dom->ModifyAttribute("node", coll->node);
+        }
+        msg->node = coll->node;
+        msg->as_node = coll->as_node;
+        msg->is_as_node = coll->is_as_node;
+        return msg;
+    }
+
+    BgpRoute *InetRouteLookup(const string &instance_name,
+                              const string &prefix) {
+        RoutingInstance *rt_instance =
+            server_->routing_instance_mgr()->GetRoutingInstance(instance_name);
+        EXPECT_TRUE(rt_instance != NULL);
+        if (rt_instance == NULL) {
+            return NULL;
+        }
+        BgpTable *table = rt_instance->GetTable(Address::INET);
+        InetTable::RequestKey key(Ip4Prefix::FromString(prefix), NULL);
+        return static_cast<BgpRoute *>(table->Find(&key));
+    }
+
     BgpServer *server() { return server_.get(); }
 
     BgpXmppChannel *FindChannel(XmppChannel *ch) {
@@ -347,6 +398,12 @@ private:
         return msg;
     }
 
+    string NodeString(const pugi::xml_node &node) {
+        ostringstream oss;
+        node.print(oss, "", pugi::format_raw);
+        return oss.str();
+    }
+
     XmlBase *GetXmlDoc(pugi::xml_document *xdoc) {
         ostringstream oss;
         xdoc->save(oss);
@@ -354,6 +411,9 @@ private:
         return impl;
     }
     boost::scoped_ptr<XmppDocumentMock> enc_;
+
+protected:
+    XmppDocumentMock *enc() { return enc_.get(); }
 };
 
 namespace {
@@ -446,6 +506,115 @@ TEST_F(BgpXmppChannelTest, Connection) {
     EXPECT_EQ(0, Count(mgr_.get()));
 }
 
+
+// Routes published through the dom and the streaming decoders, on two
+// peers, end up with the same paths.
+TEST_F(BgpXmppChannelTest, StreamingPublish) {
+    const int kRoutes = 8;
+    const string kNexthop("192.168.1.1");
+
+    EXPECT_CALL(*(a.get()), RegisterReceive(xmps::BGP, _)).Times(1);
+    EXPECT_CALL(*(b.get()), RegisterReceive(xmps::BGP, _)).Times(1);
+    mgr_->XmppHandleChannelEvent(a.get(), xmps::READY);
+    mgr_->XmppHandleChannelEvent(b.get(), xmps::READY);
+
+    PeerRibMembershipManagerTest *mock_manager =
+        static_cast<PeerRibMembershipManagerTest *>(server_->membership_mgr());
+    EXPECT_CALL(*mock_manager, Register(_, _, _, _, _))
+        .WillRepeatedly(Invoke(mock_manager,
+                               &PeerRibMembershipManagerTest::MockRegister));
+    EXPECT_CALL(*mock_manager, Unregister(_, _, _))
+        .WillRepeatedly(Invoke(mock_manager,
+                               &PeerRibMembershipManagerTest::MockUnregister));
+
+    std::auto_ptr<XmppStanza::XmppMessageIq> msg;
+    msg = GetSubscribe("blue", true);
+    ReceiveUpdate(a.get(), msg.get());
+    msg = GetSubscribe("blue", true);
+    ReceiveUpdate(b.get(), msg.get());
+    BgpXmppChannel *channel_a = FindChannel(a.get());
+    BgpXmppChannel *channel_b = FindChannel(b.get());
+    task_util::WaitForCondition(&evm_,
+            boost::bind(&BgpXmppChannelTest::PeerRegistered, this,
+                        channel_a, "blue", true), 1 /* seconds */);
+    task_util::WaitForCondition(&evm_,
+            boost::bind(&BgpXmppChannelTest::PeerRegistered, this,
+                        channel_b, "blue", true), 1 /* seconds */);
+
+    // Same documents on both peers, dom on a and streaming on b
+    for (int i = 0; i < kRoutes; i++) {
+        stringstream prefix;
+        prefix << "10.1.1." << i << "/32";
+        NextHops nexthops;
+        nexthops.push_back(NextHop(kNexthop, 100 + i));
+        msg = DecodeRouteMsg(
+            enc()->RouteAddXmlDoc("blue", prefix.str(), nexthops), false);
+        ASSERT_TRUE(msg.get() != NULL);
+        ReceiveUpdate(a.get(), msg.get());
+        msg = DecodeRouteMsg(
+            enc()->RouteAddXmlDoc("blue", prefix.str(), nexthops), true);
+        ASSERT_TRUE(msg.get() != NULL);
+        ReceiveUpdate(b.get(), msg.get());
+    }
+
+    uint32_t path_id = Ip4Address::from_string(kNexthop).to_ulong();
+    for (int i = 0; i < kRoutes; i++) {
+        stringstream prefix;
+        prefix << "10.1.1." << i << "/32";
+        BgpRoute *rt = InetRouteLookup("blue", prefix.str());
+        ASSERT_TRUE(rt != NULL);
+        EXPECT_EQ(2U, rt->count());
+        const BgpPath *path_a =
+            rt->FindPath(BgpPath::BGP_XMPP, channel_a->Peer(), path_id);
+        const BgpPath *path_b =
+            rt->FindPath(BgpPath::BGP_XMPP, channel_b->Peer(), path_id);
+        ASSERT_TRUE(path_a != NULL);
+        ASSERT_TRUE(path_b != NULL);
+        EXPECT_EQ(path_a->GetAttr(), path_b->GetAttr());
+        EXPECT_EQ((uint32_t) 100 + i, path_a->GetLabel());
+        EXPECT_EQ(path_a->GetLabel(), path_b->GetLabel());
+    }
+
+    // A publish whose node has no afi/safi is dropped
+    NextHops nexthops;
+    nexthops.push_back(NextHop(kNexthop, 200));
+    msg = DecodeRouteMsg(
+        enc()->RouteAddXmlDoc("blue", "10.1.2.1/32", nexthops), true);
+    ASSERT_TRUE(msg.get() != NULL);
+    msg->as_node = "1";
+    ReceiveUpdate(b.get(), msg.get());
+    EXPECT_TRUE(InetRouteLookup("blue", "10.1.2.1/32") == NULL);
+
+    for (int i = 0; i < kRoutes; i++) {
+        stringstream prefix;
+        prefix << "10.1.1." << i << "/32";
+        NextHops nexthops;
+        nexthops.push_back(NextHop(kNexthop, 0));
+        msg = DecodeRouteMsg(
+            enc()->RouteDeleteXmlDoc("blue", prefix.str(), nexthops), false);
+        ASSERT_TRUE(msg.get() != NULL);
+        ReceiveUpdate(a.get(), msg.get());
+        msg = DecodeRouteMsg(
+            enc()->RouteDeleteXmlDoc("blue", prefix.str(), nexthops), true);
+        ASSERT_TRUE(msg.get() != NULL);
+        ReceiveUpdate(b.get(), msg.get());
+        BgpRoute *rt = InetRouteLookup("blue", prefix.str());
+        EXPECT_TRUE(rt == NULL || rt->IsDeleted());
+    }
+
+    EXPECT_CALL(*(a.get()), UnRegisterReceive(xmps::BGP)).Times(1);
+    EXPECT_CALL(*(b.get()), UnRegisterReceive(xmps::BGP)).Times(1);
+    mgr_->XmppHandleChannelEvent(a.get(), xmps::NOT_READY);
+    task_util::WaitForIdle();
+    delete FindChannel(a.get());
+    mgr_->RemoveChannel(a.get());
+    mgr_->XmppHandleChannelEvent(b.get(), xmps::NOT_READY);
+    task_util::WaitForIdle();
+    delete FindChannel(b.get());
+    mgr_->RemoveChannel(b.get());
+    EXPECT_EQ(0, Count(mgr_.get()));
+}
+
 }
 
 class TestEnvironment : public ::testing::Environment {
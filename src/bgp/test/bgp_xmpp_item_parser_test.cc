@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "bgp/bgp_xmpp_item_parser.h"
+
+#include <fstream>
+#include <sstream>
+#include <pugixml/pugixml.hpp>
+
+#include "base/logging.h"
+#include "base/util.h"
+#include "schema/xmpp_unicast_types.h"
+#include "schema/xmpp_multicast_types.h"
+#include "schema/xmpp_enet_types.h"
+#include "testing/gunit.h"
+#include "xml/xml_pugi.h"
+
+using namespace std;
+
+class BgpXmppItemParserTest : public ::testing::Test {
+protected:
+    string FileRead(const string &filename) {
+        string content;
+        fstream file(filename.c_str(), fstream::in);
+        while (!file.eof()) {
+            char piece[256];
+            file.read(piece, sizeof(piece));
+            content.append(piece, file.gcount());
+        }
+        file.close();
+        return content;
+    }
+
+    // Decode all items in the publish message using the autogen dom parser.
+    template <typename ItemType>
+    bool ParseDom(const string &xml, vector<ItemType> *items) {
+        auto_ptr<XmlBase> impl(XmppXmlImplFactory::Instance()->GetXmlImpl());
+        if (impl->LoadDoc(xml) == -1)
+            return false;
+        XmlPugi *pugi = static_cast<XmlPugi *>(impl.get());
+        for (pugi::xml_node node = pugi->FindNode("item"); node;
+             node = node.next_sibling()) {
+            if (strcmp(node.name(), "item") != 0)
+                continue;
+            items->push_back(ItemType());
+            items->back().Clear();
+            if (!items->back().XmlParse(node))
+                return false;
+        }
+        return true;
+    }
+
+    // Decode all items in the publish message using the streaming parser.
+    template <typename ItemType>
+    bool ParseStream(const string &xml, vector<ItemType> *items) {
+        XmlPullParser parser(xml.data(), xml.size());
+        while (true) {
+            switch (parser.Next()) {
+            case XmlPullParser::START_ELEMENT:
+                if (parser.NameIs("item")) {
+                    items->push_back(ItemType());
+                    if (!BgpXmppItemParser::Parse(&parser, &items->back()))
+                        return false;
+                }
+                break;
+            case XmlPullParser::END_DOCUMENT:
+                return true;
+            case XmlPullParser::ERROR:
+                return false;
+            default:
+                break;
+            }
+        }
+    }
+
+    template <typename NextHopType>
+    void VerifyNextHops(const vector<NextHopType> &expected,
+                        const vector<NextHopType> &actual) {
+        ASSERT_EQ(expected.size(), actual.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            EXPECT_EQ(expected[i].af, actual[i].af);
+            EXPECT_EQ(expected[i].address, actual[i].address);
+            EXPECT_EQ(expected[i].label, actual[i].label);
+            EXPECT_EQ(
+                expected[i].tunnel_encapsulation_list.tunnel_encapsulation,
+                actual[i].tunnel_encapsulation_list.tunnel_encapsulation);
+        }
+    }
+
+    void Verify(const autogen::ItemType &expected,
+                const autogen::ItemType &actual) {
+        EXPECT_EQ(expected.entry.nlri.af, actual.entry.nlri.af);
+        EXPECT_EQ(expected.entry.nlri.safi, actual.entry.nlri.safi);
+        EXPECT_EQ(expected.entry.nlri.address, actual.entry.nlri.address);
+        VerifyNextHops(expected.entry.next_hops.next_hop,
+                       actual.entry.next_hops.next_hop);
+        EXPECT_EQ(expected.entry.version, actual.entry.version);
+        EXPECT_EQ(expected.entry.virtual_network,
+                  actual.entry.virtual_network);
+        EXPECT_EQ(expected.entry.security_group_list.security_group,
+                  actual.entry.security_group_list.security_group);
+    }
+
+    void Verify(const autogen::EnetItemType &expected,
+                const autogen::EnetItemType &actual) {
+        EXPECT_EQ(expected.entry.nlri.af, actual.entry.nlri.af);
+        EXPECT_EQ(expected.entry.nlri.safi, actual.entry.nlri.safi);
+        EXPECT_EQ(expected.entry.nlri.mac, actual.entry.nlri.mac);
+        EXPECT_EQ(expected.entry.nlri.address, actual.entry.nlri.address);
+        VerifyNextHops(expected.entry.next_hops.next_hop,
+                       actual.entry.next_hops.next_hop);
+    }
+
+    void Verify(const autogen::McastItemType &expected,
+                const autogen::McastItemType &actual) {
+        EXPECT_EQ(expected.entry.nlri.af, actual.entry.nlri.af);
+        EXPECT_EQ(expected.entry.nlri.safi, actual.entry.nlri.safi);
+        EXPECT_EQ(expected.entry.nlri.group, actual.entry.nlri.group);
+        EXPECT_EQ(expected.entry.nlri.source, actual.entry.nlri.source);
+        EXPECT_EQ(expected.entry.nlri.source_label,
+                  actual.entry.nlri.source_label);
+        VerifyNextHops(expected.entry.next_hops.next_hop,
+                       actual.entry.next_hops.next_hop);
+        VerifyNextHops(expected.entry.olist.next_hop,
+                       actual.entry.olist.next_hop);
+    }
+
+    template <typename ItemType>
+    void VerifyParse(const string &xml, size_t count) {
+        vector<ItemType> dom_items, stream_items;
+        ASSERT_TRUE(ParseDom(xml, &dom_items));
+        ASSERT_TRUE(ParseStream(xml, &stream_items));
+        ASSERT_EQ(count, dom_items.size());
+        ASSERT_EQ(count, stream_items.size());
+        for (size_t i = 0; i < count; i++) {
+            Verify(dom_items[i], stream_items[i]);
+        }
+    }
+
+    string PublishMessage(const string &node, const string &items) {
+        ostringstream oss;
+        oss << "<iq type=\"set\" from=\"agent-a@domain.org\" "
+            << "to=\"network-control@contrailsystems.com/bgp-peer\" "
+            << "id=\"pubsub1\">"
+            << "<pubsub xmlns=\"http://jabber.org/protocol/pubsub\">"
+            << "<publish node=\"" << node << "\">" << items
+            << "</publish></pubsub></iq>";
+        return oss.str();
+    }
+
+    string InetItem(int index) {
+        ostringstream oss;
+        oss << "<item><entry xmlns=\"http://ietf.org/protocol/bgpvpn\">"
+            << "<nlri><af>1</af><safi>1</safi>"
+            << "<address>10." << (index >> 16) << "." << ((index >> 8) & 0xff)
+            << "." << (index & 0xff) << "/32</address></nlri>"
+            << "<next-hops><next-hop><af>1</af>"
+            << "<address>192.168.1.1</address>"
+            << "<label>" << 10000 + index << "</label>"
+            << "<tunnel-encapsulation-list>"
+            << "<tunnel-encapsulation>gre</tunnel-encapsulation>"
+            << "</tunnel-encapsulation-list>"
+            << "</next-hop></next-hops>"
+            << "<version>1</version>"
+            << "<virtual-network>default-domain:admin:blue</virtual-network>"
+            << "<security-group-list>"
+            << "<security-group>" << 8000000 + index << "</security-group>"
+            << "</security-group-list>"
+            << "</entry></item>";
+        return oss.str();
+    }
+};
+
+TEST_F(BgpXmppItemParserTest, Inet) {
+    string xml = FileRead("src/bgp/testdata/xmpp_inet_publish.xml");
+    VerifyParse<autogen::ItemType>(xml, 2);
+
+    vector<autogen::ItemType> items;
+    ASSERT_TRUE(ParseStream(xml, &items));
+    const autogen::ItemType &item = items[0];
+    EXPECT_EQ("10.1.1.1/32", item.entry.nlri.address);
+    ASSERT_EQ(2, item.entry.next_hops.next_hop.size());
+    EXPECT_EQ(10000, item.entry.next_hops.next_hop[0].label);
+    ASSERT_EQ(2, item.entry.next_hops.next_hop[0].
+                 tunnel_encapsulation_list.tunnel_encapsulation.size());
+    EXPECT_EQ("udp", item.entry.next_hops.next_hop[0].
+                     tunnel_encapsulation_list.tunnel_encapsulation[1]);
+    EXPECT_EQ(3, item.entry.version);
+    EXPECT_EQ("default-domain:admin:blue&red", item.entry.virtual_network);
+    ASSERT_EQ(2, item.entry.security_group_list.security_group.size());
+    EXPECT_EQ(8000002, item.entry.security_group_list.security_group[1]);
+    EXPECT_TRUE(items[1].entry.virtual_network.empty());
+}
+
+TEST_F(BgpXmppItemParserTest, Enet) {
+    string items =
+        "<item><entry xmlns=\"http://ietf.org/protocol/bgpvpn\">"
+        "<nlri><af>25</af><safi>242</safi><mac>01:02:03:04:05:06</mac>"
+        "<address>10.1.1.1/32</address></nlri>"
+        "<next-hops><next-hop><af>1</af><address>192.168.1.1</address>"
+        "<label>32</label><tunnel-encapsulation-list>"
+        "<tunnel-encapsulation>vxlan</tunnel-encapsulation>"
+        "</tunnel-encapsulation-list></next-hop></next-hops>"
+        "</entry></item>";
+    VerifyParse<autogen::EnetItemType>(
+        PublishMessage("25/242/01:02:03:04:05:06,10.1.1.1/32", items), 1);
+}
+
+TEST_F(BgpXmppItemParserTest, Mcast) {
+    string items =
+        "<item><entry xmlns=\"http://ietf.org/protocol/bgpvpn\">"
+        "<nlri><af>1</af><safi>241</safi><group>225.0.0.1</group>"
+        "<source>0.0.0.0</source><source-label>7</source-label></nlri>"
+        "<next-hops><next-hop><af>1</af><address>192.168.1.1</address>"
+        "<label>10000-20000</label></next-hop></next-hops>"
+        "<olist><next-hop><af>1</af><address>192.168.1.2</address>"
+        "<label>100</label></next-hop>"
+        "<next-hop><af>1</af><address>192.168.1.3</address>"
+        "<label>200</label></next-hop></olist>"
+        "</entry></item>";
+    VerifyParse<autogen::McastItemType>(
+        PublishMessage("1/241/225.0.0.1,0.0.0.0", items), 1);
+}
+
+TEST_F(BgpXmppItemParserTest, Invalid) {
+    vector<autogen::ItemType> items;
+    string xml = PublishMessage("1/1/blue/10.1.1.1/32",
+        "<item><entry><nlri><af>one</af></nlri></entry></item>");
+    EXPECT_FALSE(ParseStream(xml, &items));
+
+    items.clear();
+    xml = PublishMessage("1/1/blue/10.1.1.1/32",
+        "<item><entry><nlri><af>1</af></entry></item>");
+    EXPECT_FALSE(ParseStream(xml, &items));
+}
+
+//
+// Compare the time taken to decode a large publish message with the dom and
+// streaming parsers.
+//
+TEST_F(BgpXmppItemParserTest, Benchmark) {
+    static const int kItemCount = 2000;
+    string items;
+    for (int i = 0; i < kItemCount; i++) {
+        items += InetItem(i);
+    }
+    string xml = PublishMessage("1/1/blue/10.0.0.0/32", items);
+
+    vector<autogen::ItemType> dom_items;
+    uint64_t start = UTCTimestampUsec();
+    ASSERT_TRUE(ParseDom(xml, &dom_items));
+    uint64_t dom_usec = UTCTimestampUsec() - start;
+
+    vector<autogen::ItemType> stream_items;
+    start = UTCTimestampUsec();
+    ASSERT_TRUE(ParseStream(xml, &stream_items));
+    uint64_t stream_usec = UTCTimestampUsec() - start;
+
+    ASSERT_EQ(kItemCount, dom_items.size());
+    ASSERT_EQ(kItemCount, stream_items.size());
+    for (int i = 0; i < kItemCount; i++) {
+        Verify(dom_items[i], stream_items[i]);
+    }
+    LOG(DEBUG, "Decoded " << kItemCount << " items (" << xml.size() <<
+        " bytes): dom " << dom_usec << " usec, streaming " << stream_usec <<
+        " usec");
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
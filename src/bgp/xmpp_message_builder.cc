@@ -13,6 +13,7 @@
 #include "bgp/bgp_route.h"
 #include "bgp/routing-instance/routing_instance.h"
 #include "bgp/bgp_table.h"
+#include "bgp/bgp_update.h"
 #include "bgp/inetmcast/inetmcast_route.h"
 #include "bgp/enet/enet_route.h"
 #include "bgp/origin-vn/origin_vn.h"
@@ -31,30 +32,39 @@ public:
     BgpXmppMessage(const BgpTable *table, const RibOutAttr *roattr)
         : table_(table),
           is_reachable_(roattr->IsReachable()),
+          ext_community_processed_(false),
           virtual_network_("unresolved") {
     }
     virtual ~BgpXmppMessage() { }
-    void Start(const RibOutAttr *roattr, const BgpRoute *route);
-    virtual bool AddRoute(const BgpRoute *route, const RibOutAttr *roattr);
-    virtual void Finish() { }
+    void Start(UpdateInfo *uinfo, const BgpRoute *route);
+    virtual bool AddRoute(const BgpRoute *route, UpdateInfo *uinfo);
+    virtual void Finish();
     virtual const uint8_t *GetData(IPeerUpdate *peer, size_t *lenp);
 
 private:
+    static const char *kItemIndent;
+    static const unsigned int kItemDepth = 3;
+
+    void EncodeRoute(const BgpRoute *route, const RibOutAttr *roattr,
+                     string *repr);
+
     void EncodeNextHop(const BgpRoute *route, RibOutAttr::NextHop nexthop,
                        autogen::ItemType &item);
-    void AddInetReach(const BgpRoute *route, const RibOutAttr *roattr);
-    void AddInetUnreach(const BgpRoute *route);
-    bool AddInetRoute(const BgpRoute *route, const RibOutAttr *roattr);
+    void EncodeInetReach(const BgpRoute *route, const RibOutAttr *roattr,
+                         string *repr);
 
     void EncodeEnetNextHop(const BgpRoute *route, RibOutAttr::NextHop nexthop,
                            autogen::EnetItemType &item);
-    void AddEnetReach(const BgpRoute *route, const RibOutAttr *roattr);
-    void AddEnetUnreach(const BgpRoute *route);
-    bool AddEnetRoute(const BgpRoute *route, const RibOutAttr *roattr);
+    void EncodeEnetReach(const BgpRoute *route, const RibOutAttr *roattr,
+                         string *repr);
+
+    void EncodeMcastReach(const BgpRoute *route, const RibOutAttr *roattr,
+                          string *repr);
 
-    void AddMcastReach(const BgpRoute *route, const RibOutAttr *roattr);
-    void AddMcastUnreach(const BgpRoute *route);
-    bool AddMcastRoute(const BgpRoute *route, const RibOutAttr *roattr);
+    void EncodeUnreach(const BgpRoute *route, string *repr);
+
+    template <typename ItemType>
+    void SerializeItem(const BgpRoute *route, ItemType &item, string *repr);
 
     void ProcessExtCommunity(const ExtCommunity *ext_community) {
         if (ext_community == NULL)
@@ -79,57 +89,119 @@ private:
 
     const BgpTable *table_;
     bool is_reachable_;
-    xml_document xdoc_;
-    xml_node xitems_;
+    bool ext_community_processed_;
+    std::string node_;
     std::string virtual_network_;
     std::vector<int> security_group_list_;
+    string items_;
+    string repr_prefix_;
+    string repr_suffix_;
     string repr_;
-    string repr_new_;
-    size_t repr_part1_;
-    size_t repr_part2_;
     DISALLOW_COPY_AND_ASSIGN(BgpXmppMessage);
 };
 
-void BgpXmppMessage::Start(const RibOutAttr *roattr, const BgpRoute *route) {
-    // Build the DOM tree
-    xml_node message = xdoc_.append_child("message");
-    message.append_attribute("from") = XmppInit::kControlNodeJID;
-
-    xml_node event = message.append_child("event");
-    event.append_attribute("xmlns") = "http://jabber.org/protocol/pubsub";
-    xitems_ = event.append_child("items");
-
-    if (is_reachable_) {
-        const BgpAttr *attr = roattr->attr();
-        ProcessExtCommunity(attr->ext_community());
+const char *BgpXmppMessage::kItemIndent = "\t";
+
+//
+// Append the string to repr, escaping characters that are not allowed in an
+// xml attribute value.
+//
+static void AppendXmlAttributeValue(string *repr, const string &value) {
+    for (string::const_iterator it = value.begin(); it != value.end(); ++it) {
+        switch (*it) {
+        case '&':
+            repr->append("&amp;");
+            break;
+        case '<':
+            repr->append("&lt;");
+            break;
+        case '>':
+            repr->append("&gt;");
+            break;
+        case '"':
+            repr->append("&quot;");
+            break;
+        default:
+            repr->push_back(*it);
+            break;
+        }
     }
-    
+}
+
+void BgpXmppMessage::Start(UpdateInfo *uinfo, const BgpRoute *route) {
     stringstream ss;
     ss << route->Afi() << "/" << int(route->Safi()) << "/" <<
           table_->routing_instance()->name();
-    std::string node(ss.str());
-    if (table_->family() == Address::INETMCAST) {
-        xitems_.append_attribute("node") = node.c_str();
-        AddMcastRoute(route, roattr);
-    } else if (table_->family() == Address::ENET) {
-        xitems_.append_attribute("node") = node.c_str();
-        AddEnetRoute(route, roattr);
+    node_ = ss.str();
+    AddRoute(route, uinfo);
+}
+
+//
+// Add the encoded route to the message. The encoded item is cached in the
+// UpdateInfo so that the same update does not get encoded again when it's
+// sent in a different message. The UpdateInfo gets replaced when the route
+// or its attributes change, so there's no need to invalidate the cache.
+//
+bool BgpXmppMessage::AddRoute(const BgpRoute *route, UpdateInfo *uinfo) {
+    if (is_reachable_) {
+        num_reach_route_++;
     } else {
-        xitems_.append_attribute("node") = node.c_str();
-        AddInetRoute(route, roattr);
+        num_unreach_route_++;
     }
+
+    if (uinfo->encoded_route.empty())
+        EncodeRoute(route, &uinfo->roattr, &uinfo->encoded_route);
+    items_.append(uinfo->encoded_route);
+    return true;
 }
 
-bool BgpXmppMessage::AddRoute(const BgpRoute *route, const RibOutAttr *roattr) {
+void BgpXmppMessage::EncodeRoute(const BgpRoute *route,
+                                 const RibOutAttr *roattr, string *repr) {
+    if (!is_reachable_) {
+        EncodeUnreach(route, repr);
+        return;
+    }
+
+    // All routes in the message have the same attributes, so the extended
+    // communities need to be looked at only once.
+    if (!ext_community_processed_) {
+        ProcessExtCommunity(roattr->attr()->ext_community());
+        ext_community_processed_ = true;
+    }
+
     if (table_->family() == Address::INETMCAST) {
-        return AddMcastRoute(route, roattr);
+        EncodeMcastReach(route, roattr, repr);
     } else if (table_->family() == Address::ENET) {
-        return AddEnetRoute(route, roattr);
+        EncodeEnetReach(route, roattr, repr);
     } else {
-        return AddInetRoute(route, roattr);
+        EncodeInetReach(route, roattr, repr);
     }
 }
 
+//
+// Serialize the item into repr with the indentation that it would have if
+// the whole message were a single document.
+//
+template <typename ItemType>
+void BgpXmppMessage::SerializeItem(const BgpRoute *route, ItemType &item,
+                                   string *repr) {
+    xml_document xdoc;
+    xml_node node = xdoc.append_child("item");
+    node.append_attribute("id") = route->ToXmppIdString().c_str();
+    item.Encode(&node);
+
+    ostringstream oss;
+    node.print(oss, kItemIndent, format_default, encoding_auto, kItemDepth);
+    *repr = oss.str();
+}
+
+void BgpXmppMessage::EncodeUnreach(const BgpRoute *route, string *repr) {
+    repr->append(kItemDepth, kItemIndent[0]);
+    repr->append("<retract id=\"");
+    AppendXmlAttributeValue(repr, route->ToXmppIdString());
+    repr->append("\" />\n");
+}
+
 void BgpXmppMessage::EncodeNextHop(const BgpRoute *route,
                                    RibOutAttr::NextHop nexthop,
                                    autogen::ItemType &item) {
@@ -149,7 +221,8 @@ void BgpXmppMessage::EncodeNextHop(const BgpRoute *route,
     item.entry.next_hops.next_hop.push_back(item_nexthop);
 }
 
-void BgpXmppMessage::AddInetReach(const BgpRoute *route, const RibOutAttr *roattr) {
+void BgpXmppMessage::EncodeInetReach(const BgpRoute *route,
+                                     const RibOutAttr *roattr, string *repr) {
     autogen::ItemType item;
 
     item.entry.nlri.af = route->Afi();
@@ -172,25 +245,7 @@ void BgpXmppMessage::AddInetReach(const BgpRoute *route, const RibOutAttr *roatt
         item.entry.security_group_list.security_group.push_back(*it);
     }
 
-    xml_node node = xitems_.append_child("item");
-    node.append_attribute("id") = route->ToXmppIdString().c_str();
-    item.Encode(&node);
-}
-
-void BgpXmppMessage::AddInetUnreach(const BgpRoute *route) {
-    xml_node node = xitems_.append_child("retract");
-    node.append_attribute("id") = route->ToXmppIdString().c_str();
-}
-
-bool BgpXmppMessage::AddInetRoute(const BgpRoute *route, const RibOutAttr *roattr) {
-    if (is_reachable_) {
-        num_reach_route_++;
-        AddInetReach(route, roattr);
-    } else {
-        num_unreach_route_++;
-        AddInetUnreach(route);
-    }
-    return true;
+    SerializeItem(route, item, repr);
 }
 
 void BgpXmppMessage::EncodeEnetNextHop(const BgpRoute *route,
@@ -211,8 +266,8 @@ void BgpXmppMessage::EncodeEnetNextHop(const BgpRoute *route,
     item.entry.next_hops.next_hop.push_back(item_nexthop);
 }
 
-void BgpXmppMessage::AddEnetReach(const BgpRoute *route, const RibOutAttr *roattr) {
-
+void BgpXmppMessage::EncodeEnetReach(const BgpRoute *route,
+                                     const RibOutAttr *roattr, string *repr) {
     autogen::EnetItemType item;
     item.entry.nlri.af = route->Afi();
     item.entry.nlri.safi = route->Safi();
@@ -227,29 +282,11 @@ void BgpXmppMessage::AddEnetReach(const BgpRoute *route, const RibOutAttr *roatt
         EncodeEnetNextHop(route, nexthop, item);
     }
 
-    xml_node node = xitems_.append_child("item");
-    node.append_attribute("id") = route->ToXmppIdString().c_str();
-    item.Encode(&node);
-}
-
-void BgpXmppMessage::AddEnetUnreach(const BgpRoute *route) {
-    xml_node node = xitems_.append_child("retract");
-    node.append_attribute("id") = route->ToXmppIdString().c_str();
-}
-
-bool BgpXmppMessage::AddEnetRoute(const BgpRoute *route, const RibOutAttr *roattr) {
-    if (is_reachable_) {
-        num_reach_route_++;
-        AddEnetReach(route, roattr);
-    } else {
-        num_unreach_route_++;
-        AddEnetUnreach(route);
-    }
-    return true;
+    SerializeItem(route, item, repr);
 }
 
-void BgpXmppMessage::AddMcastReach(const BgpRoute *route, const RibOutAttr *roattr) {
-
+void BgpXmppMessage::EncodeMcastReach(const BgpRoute *route,
+                                      const RibOutAttr *roattr, string *repr) {
     autogen::McastItemType item;
     item.entry.nlri.af = route->Afi();
     item.entry.nlri.safi = route->Safi();
@@ -276,63 +313,48 @@ void BgpXmppMessage::AddMcastReach(const BgpRoute *route, const RibOutAttr *roat
         item.entry.olist.next_hop.push_back(nh);
     }
 
-    xml_node node = xitems_.append_child("item");
-    node.append_attribute("id") = route->ToXmppIdString().c_str();
-    item.Encode(&node);
+    SerializeItem(route, item, repr);
 }
 
-void BgpXmppMessage::AddMcastUnreach(const BgpRoute *route) {
-    xml_node node = xitems_.append_child("retract");
-    node.append_attribute("id") = route->ToXmppIdString().c_str();
-}
-
-bool BgpXmppMessage::AddMcastRoute(const BgpRoute *route, const RibOutAttr *roattr) {
-    if (is_reachable_) {
-        num_reach_route_++;
-        AddMcastReach(route, roattr);
-    } else {
-        num_unreach_route_++;
-        AddMcastUnreach(route);
-    }
-    return true;
+//
+// Build the message from the encoded items. Everything except the value of
+// the "to" attribute is the same for all peers, so keep the parts of the
+// message before and after it.
+//
+void BgpXmppMessage::Finish() {
+    repr_prefix_ = "<?xml version=\"1.0\"?>\n<message from=\"";
+    AppendXmlAttributeValue(&repr_prefix_, XmppInit::kControlNodeJID);
+    repr_prefix_.append("\" to=\"");
+
+    repr_suffix_ = "\">\n\t<event xmlns=\"http://jabber.org/protocol/pubsub\">\n";
+    repr_suffix_.reserve(repr_suffix_.size() + node_.size() + items_.size() +
+                         64);
+    repr_suffix_.append("\t\t<items node=\"");
+    AppendXmlAttributeValue(&repr_suffix_, node_);
+    repr_suffix_.append("\">\n");
+    repr_suffix_.append(items_);
+    repr_suffix_.append("\t\t</items>\n\t</event>\n</message>\n");
+    items_.clear();
 }
 
 const uint8_t *BgpXmppMessage::GetData(IPeerUpdate *peer, size_t *lenp) {
     std::string str = peer->ToString() + "/" + XmppInit::kBgpPeer;
 
-    // If the message has already been constructed, just replace the 'to' part.
-    if (!repr_.empty()) {
-        repr_new_ = string(repr_, 0, repr_part1_) + "to=\"" + str + "\">" +
-                    string(repr_, repr_part2_);
-
-        *lenp = repr_new_.size();
-        return reinterpret_cast<const uint8_t *>(repr_new_.c_str());
-    }
-
-    xml_node message =  xdoc_.child("message");
-    xml_attribute attr_to = message.attribute("to");
-    if (!attr_to) {
-        attr_to = message.append_attribute("to");
-    }
-    attr_to.set_value(str.c_str());
-    ostringstream oss;
-    xdoc_.save(oss);
-    repr_ = oss.str();
-
-    repr_part1_ = repr_.find("to=", 0);
-    assert(repr_part1_ != string::npos);
-    repr_part2_ = repr_.find("\n\t<event xmlns");
-    assert(repr_part2_ != string::npos);
+    repr_.clear();
+    repr_.reserve(repr_prefix_.size() + str.size() + repr_suffix_.size());
+    repr_.append(repr_prefix_);
+    AppendXmlAttributeValue(&repr_, str);
+    repr_.append(repr_suffix_);
 
     *lenp = repr_.size();
     return reinterpret_cast<const uint8_t *>(repr_.c_str());
 }
 
 Message *BgpXmppMessageBuilder::Create(const BgpTable *table,
-                                       const RibOutAttr *roattr,
+                                       UpdateInfo *uinfo,
                                        const BgpRoute *route) const {
-    BgpXmppMessage *msg = new BgpXmppMessage(table, roattr);
-    msg->Start(roattr, route);
+    BgpXmppMessage *msg = new BgpXmppMessage(table, &uinfo->roattr);
+    msg->Start(uinfo, route);
     return msg;
 }
 
@@ -11,7 +11,7 @@ class BgpXmppMessageBuilder : public MessageBuilder {
 public:
     BgpXmppMessageBuilder();
     virtual Message *Create(const BgpTable *table,
-                            const RibOutAttr *roattr,
+                            UpdateInfo *uinfo,
                             const BgpRoute *route) const;
     static BgpXmppMessageBuilder *GetInstance();
 
@@ -13,6 +13,7 @@
 
 #include "base/logging.h"
 #include "base/cpuinfo.h"
+#include "base/taskinfo.h"
 #include "bgp/bgp_config.h"
 #include "bgp/bgp_config_parser.h"
 #include "bgp/bgp_peer.h"
@@ -310,6 +311,15 @@ bool ControlNodeInfoLogger(BgpSandeshContext &ctx) {
         change = true;
     }
 
+    // Latency of the tasks, only if the measurement is enabled.
+    vector<TaskLatencyInfo> task_latency_list;
+    TaskLatencyData::FillTaskLatencyInfo(&task_latency_list, "", false);
+    if (task_latency_list != prev_state.get_task_latency_list()) {
+        state.set_task_latency_list(task_latency_list);
+        prev_state.set_task_latency_list(task_latency_list);
+        change = true;
+    }
+
     uint32_t out_load = server->get_output_queue_depth();
     if (out_load != prev_state.get_output_queue_depth() || first) {
         state.set_output_queue_depth(out_load);
@@ -614,8 +624,9 @@ int main(int argc, char *argv[]) {
     IFMapManager *ifmapmgr = new IFMapManager(&ifmap_server, map_server_url,
                 var_map["map-user"].as<string>(),
                 var_map["map-password"].as<string>(), certstore,
-                boost::bind(&IFMapServerParser::Receive, ifmap_parser,
-                            &config_db, _1, _2, _3), evm.io_service(),
+                boost::bind(&IFMapServerParser::ReceiveChunk, ifmap_parser,
+                            &config_db, _1, _2, _3, _4, _5, _6),
+                evm.io_service(),
                 ds_client);
     ifmap_server.set_ifmap_manager(ifmapmgr);
 
@@ -10,6 +10,7 @@ setup(
     packages=['control_node',
               'control_node.control_node', 
               'control_node.control_node.cpuinfo',
+              'control_node.control_node.taskinfo',
               'control_node.control_node.ifmap_server_show',
               'control_node.vns'
              ],
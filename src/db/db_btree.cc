@@ -0,0 +1,479 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "db/db_btree.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "db/db_entry.h"
+
+struct DBBTree::Node {
+    explicit Node(bool leaf) : leaf(leaf), count(0) {
+    }
+    bool leaf;
+    int count;
+};
+
+struct DBBTree::Leaf : public DBBTree::Node {
+    Leaf() : Node(true), prev(NULL), next(NULL) {
+    }
+    Leaf *prev;
+    Leaf *next;
+    DBEntry *entries[kLeafSize];
+};
+
+//
+// keys[i] is the smallest entry in the subtree rooted at children[i]. The
+// value of keys[0] is not used for lookups.
+//
+struct DBBTree::Inner : public DBBTree::Node {
+    Inner() : Node(false) {
+    }
+    DBEntry *keys[kInnerSize];
+    Node *children[kInnerSize];
+};
+
+template <typename T>
+static void ArrayInsert(T *array, int count, int index, T value) {
+    memmove(&array[index + 1], &array[index], (count - index) * sizeof(T));
+    array[index] = value;
+}
+
+template <typename T>
+static void ArrayErase(T *array, int count, int index) {
+    memmove(&array[index], &array[index + 1], (count - index - 1) * sizeof(T));
+}
+
+DBBTree::DBBTree()
+    : root_(new Leaf), size_(0), hint_leaf_(NULL), hint_index_(0) {
+}
+
+DBBTree::~DBBTree() {
+    FreeNode(root_);
+}
+
+void DBBTree::FreeNode(Node *node) {
+    if (node->leaf) {
+        delete static_cast<Leaf *>(node);
+        return;
+    }
+    Inner *inner = static_cast<Inner *>(node);
+    for (int i = 0; i < inner->count; i++) {
+        FreeNode(inner->children[i]);
+    }
+    delete inner;
+}
+
+void DBBTree::Clear() {
+    FreeNode(root_);
+    root_ = new Leaf;
+    size_ = 0;
+    hint_leaf_ = NULL;
+}
+
+int DBBTree::height() const {
+    int height = 1;
+    for (Node *node = root_; !node->leaf;
+         node = static_cast<Inner *>(node)->children[0]) {
+        height++;
+    }
+    return height;
+}
+
+//
+// Index of the child whose subtree covers the key i.e. the last child with
+// a smallest entry that is not greater than the key.
+//
+int DBBTree::InnerSearch(const Inner *inner, const DBEntry *key) {
+    int lo = 1, hi = inner->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (key->IsLess(*inner->keys[mid])) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo - 1;
+}
+
+// Index of the first entry in the leaf that is not less than the key.
+int DBBTree::LeafLowerBound(const Leaf *leaf, const DBEntry *key) {
+    int lo = 0, hi = leaf->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (leaf->entries[mid]->IsLess(*key)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+DBEntry *DBBTree::LeftmostEntry(Node *node) {
+    while (!node->leaf) {
+        node = static_cast<Inner *>(node)->children[0];
+    }
+    Leaf *leaf = static_cast<Leaf *>(node);
+    return (leaf->count ? leaf->entries[0] : NULL);
+}
+
+DBBTree::Leaf *DBBTree::Descend(const DBEntry *key, Path *path,
+                                int *depth) const {
+    Node *node = root_;
+    int level = 0;
+    while (!node->leaf) {
+        Inner *inner = static_cast<Inner *>(node);
+        int index = InnerSearch(inner, key);
+        if (path) {
+            assert(level < kMaxHeight);
+            path->node[level] = inner;
+            path->index[level] = index;
+        }
+        level++;
+        node = inner->children[index];
+    }
+    if (depth) {
+        *depth = level;
+    }
+    return static_cast<Leaf *>(node);
+}
+
+void DBBTree::SetHint(Leaf *leaf, int index) const {
+    hint_leaf_ = leaf;
+    hint_index_ = index;
+}
+
+bool DBBTree::Insert(DBEntry *entry) {
+    Path path;
+    int depth;
+    Leaf *leaf = Descend(entry, &path, &depth);
+    int index = LeafLowerBound(leaf, entry);
+    if (index < leaf->count && !entry->IsLess(*leaf->entries[index])) {
+        return false;
+    }
+    size_++;
+
+    if (leaf->count < kLeafSize) {
+        ArrayInsert(leaf->entries, leaf->count, index, entry);
+        leaf->count++;
+        return true;
+    }
+
+    // Split the leaf, moving the upper half into a new right sibling. The
+    // new entry never becomes the first entry of the right sibling, so the
+    // separator pushed up to the parent is not affected by the insert.
+    Leaf *right = new Leaf;
+    int split = kLeafSize / 2;
+    right->count = kLeafSize - split;
+    memcpy(right->entries, &leaf->entries[split],
+           right->count * sizeof(DBEntry *));
+    leaf->count = split;
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (leaf->next) {
+        leaf->next->prev = right;
+    }
+    leaf->next = right;
+
+    Leaf *target = leaf;
+    if (index > split) {
+        target = right;
+        index -= split;
+    }
+    ArrayInsert(target->entries, target->count, index, entry);
+    target->count++;
+
+    InsertChild(&path, depth, right, right->entries[0]);
+    return true;
+}
+
+//
+// Insert the child with the given smallest entry to the right of the node
+// at the given depth in the path, splitting inner nodes as required.
+//
+void DBBTree::InsertChild(Path *path, int depth, Node *child, DBEntry *key) {
+    for (int level = depth - 1; level >= 0; level--) {
+        Inner *inner = path->node[level];
+        int index = path->index[level] + 1;
+        if (inner->count < kInnerSize) {
+            ArrayInsert(inner->children, inner->count, index, child);
+            ArrayInsert(inner->keys, inner->count, index, key);
+            inner->count++;
+            return;
+        }
+
+        Node *children[kInnerSize + 1];
+        DBEntry *keys[kInnerSize + 1];
+        memcpy(children, inner->children, kInnerSize * sizeof(Node *));
+        memcpy(keys, inner->keys, kInnerSize * sizeof(DBEntry *));
+        ArrayInsert(children, kInnerSize, index, child);
+        ArrayInsert(keys, kInnerSize, index, key);
+
+        int split = (kInnerSize + 1) / 2;
+        Inner *right = new Inner;
+        right->count = kInnerSize + 1 - split;
+        memcpy(right->children, &children[split],
+               right->count * sizeof(Node *));
+        memcpy(right->keys, &keys[split], right->count * sizeof(DBEntry *));
+        inner->count = split;
+        memcpy(inner->children, children, split * sizeof(Node *));
+        memcpy(inner->keys, keys, split * sizeof(DBEntry *));
+
+        child = right;
+        key = right->keys[0];
+    }
+
+    // The root was split, grow the tree by one level.
+    Inner *root = new Inner;
+    root->children[0] = root_;
+    root->keys[0] = NULL;
+    root->children[1] = child;
+    root->keys[1] = key;
+    root->count = 2;
+    root_ = root;
+}
+
+bool DBBTree::Remove(DBEntry *entry) {
+    Path path;
+    int depth;
+    Leaf *leaf = Descend(entry, &path, &depth);
+    int index = LeafLowerBound(leaf, entry);
+    if (index == leaf->count || leaf->entries[index] != entry) {
+        return false;
+    }
+    ArrayErase(leaf->entries, leaf->count, index);
+    leaf->count--;
+    size_--;
+
+    RebalanceLeaf(&path, depth, leaf);
+
+    // The first entry of a leaf may be used as separator in an inner node.
+    if (index == 0) {
+        FixSeparator(entry);
+    }
+    return true;
+}
+
+void DBBTree::RemoveChild(Inner *parent, int index) {
+    assert(index > 0);
+    ArrayErase(parent->children, parent->count, index);
+    ArrayErase(parent->keys, parent->count, index);
+    parent->count--;
+}
+
+//
+// Merge an underflowing leaf with a sibling, or move entries over from the
+// sibling if both don't fit in a single leaf.
+//
+void DBBTree::RebalanceLeaf(Path *path, int depth, Leaf *leaf) {
+    if (depth == 0 || leaf->count >= kLeafSize / 4) {
+        return;
+    }
+
+    Inner *parent = path->node[depth - 1];
+    int index = path->index[depth - 1];
+    assert(parent->count > 1);
+    Leaf *left, *right;
+    int right_index;
+    if (index + 1 < parent->count) {
+        left = leaf;
+        right = static_cast<Leaf *>(parent->children[index + 1]);
+        right_index = index + 1;
+    } else {
+        left = static_cast<Leaf *>(parent->children[index - 1]);
+        right = leaf;
+        right_index = index;
+    }
+
+    if (left->count + right->count <= kLeafSize) {
+        memcpy(&left->entries[left->count], right->entries,
+               right->count * sizeof(DBEntry *));
+        left->count += right->count;
+        left->next = right->next;
+        if (right->next) {
+            right->next->prev = left;
+        }
+        if (hint_leaf_ == right) {
+            hint_leaf_ = NULL;
+        }
+        delete right;
+        RemoveChild(parent, right_index);
+        RebalanceInner(path, depth - 1);
+        return;
+    }
+
+    int count = (left->count + right->count) / 2;
+    if (left->count < count) {
+        int n = count - left->count;
+        memcpy(&left->entries[left->count], right->entries,
+               n * sizeof(DBEntry *));
+        memmove(right->entries, &right->entries[n],
+                (right->count - n) * sizeof(DBEntry *));
+        left->count += n;
+        right->count -= n;
+    } else {
+        int n = left->count - count;
+        memmove(&right->entries[n], right->entries,
+                right->count * sizeof(DBEntry *));
+        memcpy(right->entries, &left->entries[count], n * sizeof(DBEntry *));
+        left->count -= n;
+        right->count += n;
+    }
+    parent->keys[right_index] = right->entries[0];
+}
+
+//
+// Same as RebalanceLeaf for the inner node at the given level in the path.
+// The separator of the right node in the parent moves down into the node
+// that its children are merged into.
+//
+void DBBTree::RebalanceInner(Path *path, int level) {
+    Inner *inner = path->node[level];
+    if (level == 0) {
+        // Shrink the tree when the root is left with a single child.
+        if (inner->count == 1) {
+            root_ = inner->children[0];
+            delete inner;
+        }
+        return;
+    }
+    if (inner->count >= kInnerSize / 4) {
+        return;
+    }
+
+    Inner *parent = path->node[level - 1];
+    int index = path->index[level - 1];
+    assert(parent->count > 1);
+    Inner *left, *right;
+    int right_index;
+    if (index + 1 < parent->count) {
+        left = inner;
+        right = static_cast<Inner *>(parent->children[index + 1]);
+        right_index = index + 1;
+    } else {
+        left = static_cast<Inner *>(parent->children[index - 1]);
+        right = inner;
+        right_index = index;
+    }
+    right->keys[0] = parent->keys[right_index];
+
+    if (left->count + right->count <= kInnerSize) {
+        memcpy(&left->children[left->count], right->children,
+               right->count * sizeof(Node *));
+        memcpy(&left->keys[left->count], right->keys,
+               right->count * sizeof(DBEntry *));
+        left->count += right->count;
+        delete right;
+        RemoveChild(parent, right_index);
+        RebalanceInner(path, level - 1);
+        return;
+    }
+
+    int count = (left->count + right->count) / 2;
+    if (left->count < count) {
+        int n = count - left->count;
+        memcpy(&left->children[left->count], right->children,
+               n * sizeof(Node *));
+        memcpy(&left->keys[left->count], right->keys, n * sizeof(DBEntry *));
+        memmove(right->children, &right->children[n],
+                (right->count - n) * sizeof(Node *));
+        memmove(right->keys, &right->keys[n],
+                (right->count - n) * sizeof(DBEntry *));
+        left->count += n;
+        right->count -= n;
+    } else {
+        int n = left->count - count;
+        memmove(&right->children[n], right->children,
+                right->count * sizeof(Node *));
+        memmove(&right->keys[n], right->keys,
+                right->count * sizeof(DBEntry *));
+        memcpy(right->children, &left->children[count], n * sizeof(Node *));
+        memcpy(right->keys, &left->keys[count], n * sizeof(DBEntry *));
+        left->count -= n;
+        right->count += n;
+    }
+    parent->keys[right_index] = right->keys[0];
+}
+
+//
+// Replace the separator that points to a removed entry with the smallest
+// entry of its subtree. There is at most one such separator, and it's on the
+// search path of the removed entry since the entry still sorts between its
+// neighbours.
+//
+void DBBTree::FixSeparator(const DBEntry *entry) {
+    Node *node = root_;
+    while (!node->leaf) {
+        Inner *inner = static_cast<Inner *>(node);
+        int index = InnerSearch(inner, entry);
+        if (index > 0 && inner->keys[index] == entry) {
+            inner->keys[index] = LeftmostEntry(inner->children[index]);
+            return;
+        }
+        node = inner->children[index];
+    }
+}
+
+DBEntry *DBBTree::Find(const DBEntry *key) const {
+    Leaf *leaf = Descend(key, NULL, NULL);
+    int index = LeafLowerBound(leaf, key);
+    if (index < leaf->count && !key->IsLess(*leaf->entries[index])) {
+        return leaf->entries[index];
+    }
+    return NULL;
+}
+
+DBEntry *DBBTree::LowerBound(const DBEntry *key) const {
+    Leaf *leaf = Descend(key, NULL, NULL);
+    int index = LeafLowerBound(leaf, key);
+    if (index == leaf->count) {
+        leaf = leaf->next;
+        index = 0;
+    }
+    if (leaf == NULL) {
+        return NULL;
+    }
+    SetHint(leaf, index);
+    return leaf->entries[index];
+}
+
+DBEntry *DBBTree::First() const {
+    Node *node = root_;
+    while (!node->leaf) {
+        node = static_cast<Inner *>(node)->children[0];
+    }
+    Leaf *leaf = static_cast<Leaf *>(node);
+    if (leaf->count == 0) {
+        return NULL;
+    }
+    SetHint(leaf, 0);
+    return leaf->entries[0];
+}
+
+DBEntry *DBBTree::Next(const DBEntry *entry) const {
+    Leaf *leaf = hint_leaf_;
+    int index = hint_index_;
+    if (leaf != NULL && index < leaf->count && leaf->entries[index] == entry) {
+        index++;
+    } else {
+        leaf = Descend(entry, NULL, NULL);
+        index = LeafLowerBound(leaf, entry);
+        if (index < leaf->count && !entry->IsLess(*leaf->entries[index])) {
+            index++;
+        }
+    }
+    if (index == leaf->count) {
+        leaf = leaf->next;
+        index = 0;
+    }
+    if (leaf == NULL) {
+        hint_leaf_ = NULL;
+        return NULL;
+    }
+    SetHint(leaf, index);
+    return leaf->entries[index];
+}
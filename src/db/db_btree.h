@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef ctrlplane_db_btree_h
+#define ctrlplane_db_btree_h
+
+#include <cstddef>
+
+#include "base/util.h"
+
+class DBEntry;
+
+//
+// B+tree of DBEntry pointers, ordered by DBEntry::IsLess.
+//
+// Unlike the intrusive red-black tree, entries are kept in sorted arrays of
+// a few cache lines each, so a lookup touches O(log32 n) nodes and a walk
+// visits the entries of a leaf sequentially before following the leaf chain.
+// Separator keys in the inner nodes point to the smallest entry of the child
+// subtree, which means that comparisons still dereference the entries, but
+// the tree nodes themselves stay dense.
+//
+// Next() remembers the position of the last entry it returned, so that a
+// threaded walk (GetNext on the entry returned by the previous call) doesn't
+// need to search the tree for every step.
+//
+// Not thread safe, callers are expected to provide synchronization.
+//
+class DBBTree {
+public:
+    DBBTree();
+    ~DBBTree();
+
+    // Returns false if an entry with the same key is already present.
+    bool Insert(DBEntry *entry);
+
+    // Returns false if the entry is not in the tree. The entry itself is not
+    // freed.
+    bool Remove(DBEntry *entry);
+
+    DBEntry *Find(const DBEntry *key) const;
+
+    // Returns the matching entry or the next one in lex order.
+    DBEntry *LowerBound(const DBEntry *key) const;
+
+    DBEntry *First() const;
+
+    // Returns the entry following the given one in lex order.
+    DBEntry *Next(const DBEntry *entry) const;
+
+    // Remove all entries.
+    void Clear();
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    int height() const;
+
+private:
+    static const int kLeafSize = 32;
+    static const int kInnerSize = 32;
+    static const int kMaxHeight = 16;
+
+    struct Node;
+    struct Leaf;
+    struct Inner;
+
+    // Position of the child followed at each level during a descent.
+    struct Path {
+        Inner *node[kMaxHeight];
+        int index[kMaxHeight];
+    };
+
+    static int InnerSearch(const Inner *inner, const DBEntry *key);
+    static int LeafLowerBound(const Leaf *leaf, const DBEntry *key);
+    static DBEntry *LeftmostEntry(Node *node);
+
+    Leaf *Descend(const DBEntry *key, Path *path, int *depth) const;
+    void InsertChild(Path *path, int depth, Node *child, DBEntry *key);
+    void RemoveChild(Inner *parent, int index);
+    void RebalanceLeaf(Path *path, int depth, Leaf *leaf);
+    void RebalanceInner(Path *path, int depth);
+    void FixSeparator(const DBEntry *entry);
+    void FreeNode(Node *node);
+    void SetHint(Leaf *leaf, int index) const;
+
+    Node *root_;
+    size_t size_;
+    mutable Leaf *hint_leaf_;
+    mutable int hint_index_;
+
+    DISALLOW_COPY_AND_ASSIGN(DBBTree);
+};
+
+#endif
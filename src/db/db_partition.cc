@@ -20,12 +20,15 @@ int DBPartition::db_partition_task_id_ = -1;
 struct RequestQueueEntry {
     // Constructor takes ownership of DBRequest key, data.
     RequestQueueEntry(DBTablePartBase *tpart, DBClient *client, DBRequest *req)
-        : tpart(tpart), client(client) {
+        : tpart(tpart), client(client), next(NULL) {
         request.Swap(req);
     }
     DBTablePartBase *tpart;
     DBClient *client;
     DBRequest request;
+    // Requests enqueued as a batch are chained together and occupy a single
+    // slot in the request queue.
+    RequestQueueEntry *next;
 };
 
 struct RemoveQueueEntry {
@@ -44,7 +47,8 @@ public:
     typedef std::list<DBTablePartBase *> TablePartList;
 
     explicit WorkQueue(int partition_id) 
-        : db_partition_id_(partition_id), disable_(false), running_(false) {
+        : db_partition_id_(partition_id), disable_(false), running_(false),
+          pending_(NULL) {
         request_count_ = 0;
     }
     ~WorkQueue() {
@@ -52,23 +56,28 @@ public:
              iter != request_queue_.unsafe_end();) {
             RequestQueueEntry *req_entry = *iter;
             ++iter;
-            delete req_entry;
+            DeleteChain(req_entry);
         }
         request_queue_.clear();
+        DeleteChain(pending_);
     }
 
-    bool EnqueueRequest(RequestQueueEntry *req_entry) {
+    // Enqueue a chain of count requests with a single queue operation.
+    bool EnqueueRequest(RequestQueueEntry *req_entry, long count) {
         request_queue_.push(req_entry);
         MaybeStartRunner();
-        return request_count_.fetch_and_increment() < (kThreshold - 1);
+        return request_count_.fetch_and_add(count) + count < kThreshold;
     }
 
     bool DequeueRequest(RequestQueueEntry **req_entry) {
-        bool success = request_queue_.try_pop(*req_entry);
-        if (success) {
-            request_count_.fetch_and_decrement();
+        if (pending_ != NULL) {
+            *req_entry = pending_;
+        } else if (!request_queue_.try_pop(*req_entry)) {
+            return false;
         }
-        return success;
+        pending_ = (*req_entry)->next;
+        request_count_.fetch_and_decrement();
+        return true;
     }
 
     void EnqueueRemove(RemoveQueueEntry *rm_entry) {
@@ -103,7 +112,8 @@ public:
     }
 
     bool IsDBQueueEmpty() {
-        return (request_queue_.empty() && change_list_.empty());
+        return (request_queue_.empty() && pending_ == NULL &&
+                change_list_.empty());
     }
 
     bool disable() { return disable_; }
@@ -118,6 +128,17 @@ private:
     int db_partition_id_;
     bool disable_;
     bool running_;
+    // Rest of the batch that the runner is in the middle of processing.
+    RequestQueueEntry *pending_;
+
+    static void DeleteChain(RequestQueueEntry *req_entry) {
+        while (req_entry != NULL) {
+            RequestQueueEntry *next = req_entry->next;
+            delete req_entry;
+            req_entry = next;
+        }
+    }
+
     DISALLOW_COPY_AND_ASSIGN(WorkQueue);
 };
 
@@ -200,7 +221,7 @@ void DBPartition::WorkQueue::MaybeStartRunner() {
 
 bool DBPartition::WorkQueue::RunnerDone() {
     mutex::scoped_lock lock(mutex_);
-    if (request_queue_.empty() && remove_queue_.empty()) {
+    if (request_queue_.empty() && pending_ == NULL && remove_queue_.empty()) {
         running_ = false;
         return true;
     }
@@ -214,6 +235,9 @@ DBPartition::DBPartition(int partition_id)
     if (db_partition_task_id_ == -1) {
         TaskScheduler *scheduler = TaskScheduler::GetInstance();
         db_partition_task_id_ = scheduler->GetTaskId("db::DBTable");
+        // Keep each partition on the same core, along with its table
+        // partitions.
+        scheduler->EnableAffinity(db_partition_task_id_);
     }
 }
 
@@ -225,7 +249,22 @@ DBPartition::~DBPartition() {
 bool DBPartition::EnqueueRequest(DBTablePartBase *tpart, DBClient *client,
                                  DBRequest *req) {
     RequestQueueEntry *entry = new RequestQueueEntry(tpart, client, req);
-    return work_queue_->EnqueueRequest(entry);
+    return work_queue_->EnqueueRequest(entry, 1);
+}
+
+bool DBPartition::EnqueueRequests(DBTablePartBase *tpart, DBClient *client,
+                                  const std::vector<DBRequest *> &reqs) {
+    if (reqs.empty()) {
+        return true;
+    }
+    RequestQueueEntry *head = NULL;
+    RequestQueueEntry **tail = &head;
+    for (std::vector<DBRequest *>::const_iterator iter = reqs.begin();
+         iter != reqs.end(); ++iter) {
+        *tail = new RequestQueueEntry(tpart, client, *iter);
+        tail = &(*tail)->next;
+    }
+    return work_queue_->EnqueueRequest(head, reqs.size());
 }
 
 void DBPartition::EnqueueRemove(DBTablePartBase *tpart, DBEntryBase *db_entry) {
@@ -2,6 +2,8 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include <tbb/spin_rw_mutex.h>
 
@@ -40,29 +42,38 @@ void DBRequest::Swap(DBRequest *rhs) {
 class DBTableBase::ListenerInfo {
 public:
     typedef vector<ChangeCallback> CallbackList;
+    typedef vector<BatchChangeCallback> BatchCallbackList;
+
+    ListenerInfo() : batch_count_(0) {
+    }
 
     DBTableBase::ListenerId Register(ChangeCallback callback) {
         tbb::spin_rw_mutex::scoped_lock write_lock(rw_mutex_, true);
-        size_t i = bmap_.find_first();
-        if (i == bmap_.npos) {
-            i = callbacks_.size();
-            callbacks_.push_back(callback);
-        } else {
-            bmap_.reset(i);
-            if (bmap_.none()) {
-                bmap_.clear();
-            }
-            callbacks_[i] = callback;
-        }
+        size_t i = AllocId();
+        callbacks_[i] = callback;
+        return i;
+    }
+
+    DBTableBase::ListenerId RegisterBatch(BatchChangeCallback callback) {
+        tbb::spin_rw_mutex::scoped_lock write_lock(rw_mutex_, true);
+        size_t i = AllocId();
+        batch_callbacks_[i] = callback;
+        batch_count_++;
         return i;
     }
 
     void Unregister(ListenerId listener) {
         tbb::spin_rw_mutex::scoped_lock write_lock(rw_mutex_, true);
+        if (batch_callbacks_[listener] != NULL) {
+            batch_count_--;
+        }
         callbacks_[listener] = NULL;
+        batch_callbacks_[listener] = NULL;
         if ((size_t) listener == callbacks_.size() - 1) {
-            while (!callbacks_.empty() && callbacks_.back() == NULL) {
+            while (!callbacks_.empty() && callbacks_.back() == NULL &&
+                   batch_callbacks_.back() == NULL) {
                 callbacks_.pop_back();
+                batch_callbacks_.pop_back();
             }
             if (bmap_.size() > callbacks_.size()) {
                 bmap_.resize(callbacks_.size());
@@ -87,13 +98,48 @@ public:
         }
     }
 
+    // concurrency: called from DBPartition task.
+    void RunNotifyBatch(DBTablePartBase *tpart, const EntryList &entries) {
+        tbb::spin_rw_mutex::scoped_lock read_lock(rw_mutex_, false);
+        for (BatchCallbackList::iterator iter = batch_callbacks_.begin();
+             iter != batch_callbacks_.end(); ++iter) {
+            if (*iter != NULL) {
+                BatchChangeCallback cb = *iter;
+                (cb)(tpart, entries);
+            }
+        }
+    }
+
     bool empty() { 
         tbb::spin_rw_mutex::scoped_lock read_lock(rw_mutex_, false);
         return callbacks_.empty(); 
     }
 
+    bool has_batch() {
+        tbb::spin_rw_mutex::scoped_lock read_lock(rw_mutex_, false);
+        return batch_count_ != 0;
+    }
+
 private:
+    // concurrency: called with the write lock held.
+    size_t AllocId() {
+        size_t i = bmap_.find_first();
+        if (i == bmap_.npos) {
+            i = callbacks_.size();
+            callbacks_.push_back(NULL);
+            batch_callbacks_.push_back(NULL);
+        } else {
+            bmap_.reset(i);
+            if (bmap_.none()) {
+                bmap_.clear();
+            }
+        }
+        return i;
+    }
+
     CallbackList callbacks_;
+    BatchCallbackList batch_callbacks_;
+    int batch_count_;
     tbb::spin_rw_mutex rw_mutex_;
     boost::dynamic_bitset<> bmap_;      // free list.
 };
@@ -109,6 +155,11 @@ DBTableBase::ListenerId DBTableBase::Register(ChangeCallback callback) {
     return info_->Register(callback);
 }
 
+DBTableBase::ListenerId DBTableBase::RegisterBatch(
+    BatchChangeCallback callback) {
+    return info_->RegisterBatch(callback);
+}
+
 void DBTableBase::Unregister(ListenerId listener) {
     info_->Unregister(listener);
 }
@@ -119,6 +170,30 @@ bool DBTableBase::Enqueue(DBRequest *req) {
     return partition->EnqueueRequest(tpart, NULL, req);
 }
 
+bool DBTableBase::Enqueue(DBRequestList *reqs) {
+    // Group the requests by partition, preserving their relative order.
+    vector<DBTablePartBase *> tparts(DB::PartitionCount());
+    vector<vector<DBRequest *> > groups(DB::PartitionCount());
+    for (DBRequestList::iterator iter = reqs->begin(); iter != reqs->end();
+         ++iter) {
+        DBTablePartBase *tpart = GetTablePartition(iter->key.get());
+        tparts[tpart->index()] = tpart;
+        groups[tpart->index()].push_back(&*iter);
+    }
+
+    bool result = true;
+    for (size_t i = 0; i < groups.size(); i++) {
+        if (groups[i].empty())
+            continue;
+        DBPartition *partition = db_->GetPartition(i);
+        if (!partition->EnqueueRequests(tparts[i], NULL, groups[i])) {
+            result = false;
+        }
+    }
+    reqs->clear();
+    return result;
+}
+
 void DBTableBase::EnqueueRemove(DBEntryBase *db_entry) {
     DBTablePartBase *tpart = GetTablePartition(db_entry);
     DBPartition *partition = db_->GetPartition(tpart->index());
@@ -129,10 +204,19 @@ void DBTableBase::RunNotify(DBTablePartBase *tpart, DBEntryBase *entry) {
     info_->RunNotify(tpart, entry);
 }
 
+void DBTableBase::RunNotifyBatch(DBTablePartBase *tpart,
+                                 const EntryList &entries) {
+    info_->RunNotifyBatch(tpart, entries);
+}
+
 bool DBTableBase::HasListeners() const {
     return !info_->empty();
 }
 
+bool DBTableBase::HasBatchListeners() const {
+    return info_->has_batch();
+}
+
 ///////////////////////////////////////////////////////////
 // Implementation of DBTable methods
 ///////////////////////////////////////////////////////////
@@ -153,6 +237,19 @@ DBTablePartition *DBTable::AllocPartition(int index) {
     return new DBTablePartition(this, index);
 }
 
+static DBTable::IndexType DefaultIndexType() {
+    const char *index = getenv("DB_TABLE_INDEX");
+    if (index != NULL && strcmp(index, "btree") == 0) {
+        return DBTable::INDEX_BTREE;
+    }
+    return DBTable::INDEX_RBTREE;
+}
+
+DBTable::IndexType DBTable::index_type() const {
+    static IndexType default_type = DefaultIndexType();
+    return default_type;
+}
+
 DBEntry *DBTable::Add(const DBRequest *req) {
     return AllocEntry(req->key.get()).release();
 }
@@ -8,6 +8,7 @@
 #include <memory>
 #include <vector>
 #include <boost/function.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include "base/util.h"
 
 class DB;
@@ -46,10 +47,15 @@ private:
     DISALLOW_COPY_AND_ASSIGN(DBRequest);
 };
 
+typedef boost::ptr_vector<DBRequest> DBRequestList;
+
 // Database table interface.
 class DBTableBase {
 public:
     typedef boost::function<void(DBTablePartBase *, DBEntryBase *)> ChangeCallback;
+    typedef std::vector<DBEntryBase *> EntryList;
+    typedef boost::function<void(DBTablePartBase *, const EntryList &)>
+        BatchChangeCallback;
     typedef int ListenerId;
     static const int kInvalidId = -1;
 
@@ -58,6 +64,11 @@ public:
 
     // Enqueue a request to the table. Takes ownership of the data.
     bool Enqueue(DBRequest *req);
+    // Enqueue a batch of requests to the table. Requests are grouped by
+    // partition and each group is added to the partition queue with a single
+    // operation and wakeup. Requests for the same partition are processed in
+    // order. Takes ownership of the requests; the list is empty on return.
+    bool Enqueue(DBRequestList *reqs);
     void EnqueueRemove(DBEntryBase *db_entry);
 
     // Determine the table partition depending on the record key.
@@ -73,9 +84,14 @@ public:
 
     // Register a DB listener.
     ListenerId Register(ChangeCallback callback);
+    // Register a DB listener that is notified of the changed entries in a
+    // partition in batches, after the per-entry listeners. Entries that are
+    // deleted stay in the table until the batch callback returns.
+    ListenerId RegisterBatch(BatchChangeCallback callback);
     void Unregister(ListenerId listener);
 
     void RunNotify(DBTablePartBase *tpart, DBEntryBase *entry);
+    void RunNotifyBatch(DBTablePartBase *tpart, const EntryList &entries);
 
     // Calcuate the size across all partitions.
     virtual size_t Size() const { return 0; }
@@ -86,6 +102,7 @@ public:
     const std::string &name() const { return name_; }
 
     bool HasListeners() const;
+    bool HasBatchListeners() const;
 
     // Translates a DBRequest key to DBentry .... No search
 
@@ -105,6 +122,12 @@ private:
 // functionality
 class DBTable : public DBTableBase {
 public:
+    // Data structure used by the table partitions to store the entries.
+    enum IndexType {
+        INDEX_RBTREE,       // boost::intrusive::set
+        INDEX_BTREE,        // DBBTree
+    };
+
     DBTable(DB *db, const std::string &name);
     virtual ~DBTable();
     void Init();
@@ -127,6 +150,11 @@ public:
     // Override if *really* necessary
     virtual DBTablePartition *AllocPartition(int index);
 
+    // Index used by the partitions of the table. The red-black tree unless
+    // the B+tree is selected with DB_TABLE_INDEX=btree, or by a table that
+    // overrides this.
+    virtual IndexType index_type() const;
+
     // Input processing implemented by derived class. Default 
     // implementation takes care of Add/Delete/Change.
     // Override if *really* necessary
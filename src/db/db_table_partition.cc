@@ -30,6 +30,11 @@ void DBTablePartBase::Notify(DBEntryBase *entry) {
 
 // concurrency: called from DBPartition task.
 void DBTablePartBase::RunNotify() {
+    if (parent()->HasBatchListeners()) {
+        RunNotifyBatch();
+        return;
+    }
+
     while (!change_list_.empty()) {
         DBEntryBase *entry = &change_list_.front();
         change_list_.pop_front();
@@ -48,6 +53,46 @@ void DBTablePartBase::RunNotify() {
     }
 }
 
+//
+// Same as RunNotify, when there are batch listeners. The per-entry listeners
+// are invoked for each entry as it's taken off the change list, and the batch
+// listeners for up to kMaxNotifyBatch entries at a time. An entry can be put
+// back on the change list by the listeners once its per-entry listeners have
+// run, in which case it's notified again in the next batch. Deleted entries
+// are removed only after the batch listeners have run.
+//
+// concurrency: called from DBPartition task.
+void DBTablePartBase::RunNotifyBatch() {
+    DBTableBase::EntryList entries;
+    while (!change_list_.empty()) {
+        // Entries put back on the change list by the listeners go to the
+        // next batch, so that an entry appears only once in a batch.
+        size_t count = change_list_.size();
+        if (count > kMaxNotifyBatch) {
+            count = kMaxNotifyBatch;
+        }
+        entries.clear();
+        while (entries.size() < count) {
+            DBEntryBase *entry = &change_list_.front();
+            change_list_.pop_front();
+            parent()->RunNotify(this, entry);
+            entry->clear_onlist();
+            entries.push_back(entry);
+        }
+
+        parent()->RunNotifyBatch(this, entries);
+
+        for (DBTableBase::EntryList::iterator it = entries.begin();
+             it != entries.end(); ++it) {
+            DBEntryBase *entry = *it;
+            if (!entry->is_onlist() && entry->IsDeleted() &&
+                entry->is_state_empty(this) && !entry->IsOnRemoveQ()) {
+                Remove(entry);
+            }
+        }
+    }
+}
+
 void DBTablePartBase::Delete(DBEntryBase *entry) {
     if (parent_->HasListeners()) {
         entry->MarkDelete();
@@ -62,7 +107,10 @@ void DBTablePartBase::Delete(DBEntryBase *entry) {
 }
 
 DBTablePartition::DBTablePartition(DBTable *table, int index)
-    : DBTablePartBase(table, index) {
+    : DBTablePartBase(table, index), index_type_(table->index_type()) {
+    if (index_type_ == DBTable::INDEX_BTREE) {
+        btree_.reset(new DBBTree);
+    }
 }
 
 void DBTablePartition::Process(DBClient *client, DBRequest *req) {
@@ -72,8 +120,13 @@ void DBTablePartition::Process(DBClient *client, DBRequest *req) {
 
 void DBTablePartition::Add(DBEntry *entry) {
     tbb::mutex::scoped_lock lock(mutex_);
-    std::pair<Tree::iterator, bool> ret = tree_.insert(*entry);
-    assert(ret.second);
+    if (index_type_ == DBTable::INDEX_BTREE) {
+        bool inserted = btree_->Insert(entry);
+        assert(inserted);
+    } else {
+        std::pair<Tree::iterator, bool> ret = tree_.insert(*entry);
+        assert(ret.second);
+    }
     entry->set_table(static_cast<DBTableBase *>(table()));
     Notify(entry);
 }
@@ -87,18 +140,29 @@ void DBTablePartition::Remove(DBEntryBase *db_entry) {
     tbb::mutex::scoped_lock lock(mutex_);
     DBEntry *entry = static_cast<DBEntry *>(db_entry);
 
-    assert(tree_.erase(*entry));
+    bool empty;
+    if (index_type_ == DBTable::INDEX_BTREE) {
+        bool removed = btree_->Remove(entry);
+        assert(removed);
+        empty = btree_->empty();
+    } else {
+        assert(tree_.erase(*entry));
+        empty = tree_.empty();
+    }
     delete entry;
 
     //
     // If a table is marked for deletion, then we may trigger the deletion
     // process when the last prefix is deleted
     //
-    table()->MayResumeDelete(tree_.empty());
+    table()->MayResumeDelete(empty);
 }
 
 DBEntry *DBTablePartition::Find(const DBEntry *entry) {
     tbb::mutex::scoped_lock lock(mutex_);
+    if (index_type_ == DBTable::INDEX_BTREE) {
+        return btree_->Find(entry);
+    }
     Tree::iterator loc = tree_.find(*entry);
     if (loc != tree_.end()) {
         return loc.operator->();
@@ -110,6 +174,9 @@ DBEntry *DBTablePartition::Find(const DBRequestKey *key) {
     tbb::mutex::scoped_lock lock(mutex_);
     DBTable *table = static_cast<DBTable *>(parent());
     std::auto_ptr<DBEntry> entry_ptr = table->AllocEntry(key);
+    if (index_type_ == DBTable::INDEX_BTREE) {
+        return btree_->Find(entry_ptr.get());
+    }
 
     Tree::iterator loc = tree_.find(*(entry_ptr.get()));
     if (loc != tree_.end()) {
@@ -122,6 +189,9 @@ DBEntry *DBTablePartition::Find(const DBRequestKey *key) {
 DBEntry *DBTablePartition::lower_bound(const DBEntryBase *key) {
     const DBEntry *entry = static_cast<const DBEntry *>(key);
     tbb::mutex::scoped_lock lock(mutex_);
+    if (index_type_ == DBTable::INDEX_BTREE) {
+        return btree_->LowerBound(entry);
+    }
 
     Tree::iterator it = tree_.lower_bound(*entry);
     if (it != tree_.end()) {
@@ -132,6 +202,9 @@ DBEntry *DBTablePartition::lower_bound(const DBEntryBase *key) {
 
 DBEntry *DBTablePartition::GetFirst() {
     tbb::mutex::scoped_lock lock(mutex_);
+    if (index_type_ == DBTable::INDEX_BTREE) {
+        return btree_->First();
+    }
     Tree::iterator it = tree_.begin();
     if (it == tree_.end()) {
         return NULL;
@@ -143,6 +216,9 @@ DBEntry *DBTablePartition::GetFirst() {
 DBEntry *DBTablePartition::GetNext(const DBEntryBase *key) {
     const DBEntry *entry = static_cast<const DBEntry *>(key);
     tbb::mutex::scoped_lock lock(mutex_);
+    if (index_type_ == DBTable::INDEX_BTREE) {
+        return btree_->Next(entry);
+    }
 
     Tree::const_iterator it = tree_.iterator_to(*entry);
     it++;
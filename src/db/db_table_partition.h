@@ -6,9 +6,12 @@
 #define ctrlplane_db_table_partition_h
 
 #include <boost/intrusive/list.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <tbb/mutex.h>
 
+#include "db/db_btree.h"
 #include "db/db_entry.h"
+#include "db/db_table.h"
 
 class DBTableBase;
 class DBTable;
@@ -54,6 +57,10 @@ public:
 
     virtual ~DBTablePartBase() {};
 private:
+    static const size_t kMaxNotifyBatch = 1024;
+
+    void RunNotifyBatch();
+
     tbb::mutex dbstate_mutex_;
     DBTableBase *parent_;
     int index_;
@@ -86,7 +93,7 @@ public:
     ///////////////////////////////////////////////////////////
 
     // Add a DB Entry
-    void Add(DBEntry *entry);
+    virtual void Add(DBEntry *entry);
 
     // Generate Change notification for an entry
     void Change(DBEntry *entry);
@@ -102,11 +109,17 @@ public:
     DBEntry *Find(const DBRequestKey *key);
 
     DBTable *table();
-    size_t size() const { return tree_.size(); }
+    DBTable::IndexType index_type() const { return index_type_; }
+    size_t size() const {
+        return (index_type_ == DBTable::INDEX_BTREE ?
+                btree_->size() : tree_.size());
+    }
 
 private:
     tbb::mutex mutex_;
+    DBTable::IndexType index_type_;
     Tree tree_;
+    boost::scoped_ptr<DBBTree> btree_;  // only with INDEX_BTREE
     DISALLOW_COPY_AND_ASSIGN(DBTablePartition);
 };
 
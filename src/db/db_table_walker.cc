@@ -4,11 +4,13 @@
 
 #include "db/db_table_walker.h"
 
+#include <algorithm>
 #include <list>
 #include <tbb/atomic.h>
 
 #include "base/logging.h"
 #include "base/task.h"
+#include "base/util.h"
 #include "db/db.h"
 #include "db/db_partition.h"
 #include "db/db_table.h"
@@ -18,6 +20,20 @@ using namespace tbb;
 
 int DBTableWalker::walker_task_id_ = -1;
 
+static uint64_t DefaultSliceBudget(uint64_t budget) {
+    char *usecs = getenv("DB_WALKER_SLICE_USECS");
+    if (usecs) {
+        budget = strtoul(usecs, NULL, 0);
+    }
+    return budget;
+}
+
+DBTableWalker::WalkStats::WalkStats()
+    : id(kInvalidWalkerId), priority(PRIORITY_NORMAL), requests(0),
+      cancelled(0), partitions(0), partitions_done(0), entries(0), slices(0),
+      max_slice_usecs(0), request_time(0), start_time(0), end_time(0) {
+}
+
 DBTableWalker::DBTableWalker() {
     if (walker_task_id_ == -1) {
         TaskScheduler *scheduler = TaskScheduler::GetInstance();
@@ -27,18 +43,53 @@ DBTableWalker::DBTableWalker() {
     walk_request_count_ = 0;
     walk_complete_count_ = 0;
     walk_cancel_count_ = 0;
+    walk_merge_count_ = 0;
+    slice_budget_usecs_ = DefaultSliceBudget(kSliceBudgetUsecs);
 }
+
 class DBTableWalker::Walker {
 public:
-    Walker(WalkId id, DBTableWalker *wkmgr, DBTable *table,
-           const DBRequestKey *key, WalkFn walker, 
-           WalkCompleteFn walk_done);
+    // A walk request. Several requests may share the same walk.
+    struct Client {
+        Client(WalkId id, WalkFn walk_fn, WalkCompleteFn done_fn)
+            : id(id), walk_fn(walk_fn), done_fn(done_fn) {
+            cancelled = false;
+        }
+        WalkId id;
+        WalkFn walk_fn;
+        WalkCompleteFn done_fn;
+        tbb::atomic<bool> cancelled;
+    };
+    typedef std::vector<Client *> ClientList;
+
+    Walker(DBTableWalker *wkmgr, DBTable *table, const DBRequestKey *key,
+           Priority priority);
+    ~Walker() {
+        STLDeleteValues(&clients_);
+    }
+
+    // concurrency: called with the walkers mutex held.
+    void AddClient(WalkId id, WalkFn walker, WalkCompleteFn walk_done);
+    void Schedule();
+    void Start(uint64_t now);
+    void Cancel(WalkId id);
+    void UpdateStats(int entries, uint64_t usecs, bool partition_done);
+
+    bool Visit(std::vector<bool> *stopped, DBTablePartBase *tpart,
+               DBEntryBase *entry);
+    void Complete();
 
     void StopWalk() {
         should_stop_.fetch_and_store(true);
     }
 
-    WalkId  id_;
+    bool IsMergeable(DBTable *table) const {
+        return (table_ == table && key_start_.get() == NULL && !started_ &&
+                !should_stop_);
+    }
+
+    uint64_t SliceBudgetUsecs() const;
+    int IterationsToYield() const;
 
     // Parent walker manager
     DBTableWalker *wkmgr_;
@@ -49,21 +100,28 @@ public:
     // Take the ownership of key passed
     std::auto_ptr<DBRequestKey> key_start_;
 
-    WalkFn walker_fn_;
-    WalkCompleteFn done_fn_;
+    Priority priority_;
+    ClientList clients_;
+
+    // Set when the first worker runs. No more requests can be merged after
+    // that point.
+    bool started_;
 
     // Will be true if Table walk is cancelled
     tbb::atomic<bool> should_stop_;
 
     // check whether iteraton is completed on all Table Partition
     tbb::atomic<long> status_;
+
+    // Protected by the walkers mutex.
+    WalkStats stats_;
 };
 
 class DBTableWalker::Worker : public Task {
 public:
     Worker(Walker *walker, int db_partition_id, const DBRequestKey *key) 
         : Task(walker_task_id_, db_partition_id), walker_(walker), 
-          key_start_(key) {
+          key_start_(key), started_(false) {
         tbl_partition_ = static_cast<DBTablePartition *>(
             walker_->table_->GetTablePartition(db_partition_id));
     }
@@ -71,9 +129,14 @@ public:
     virtual bool Run();
 
 private:
+    // Number of entries visited between checks of the slice budget.
+    static const int kBudgetCheckInterval = 64;
+
     DBTableWalker::Walker *walker_;
 
-    // Store the last visited node to continue walk
+    // Store the key of the next node to visit to continue walk. The entry
+    // itself may be deleted before the next time slice, in which case the
+    // walk resumes from the entry following it.
     std::auto_ptr<DBRequestKey> walk_ctx_;
 
     // This is where the walk started
@@ -81,6 +144,11 @@ private:
 
     // Table partition for which this worker was created
     DBTablePartition *tbl_partition_;
+
+    bool started_;
+
+    // Clients that stopped the walk in this partition
+    std::vector<bool> stopped_;
 };
 
 static void db_walker_wait() {
@@ -102,6 +170,16 @@ static void db_walker_wait() {
 bool DBTableWalker::Worker::Run() {
     int count = 0;
     DBRequestKey *key_resume;
+    DBEntry *entry;
+    uint64_t slice_start = UTCTimestampUsec();
+    int max_iterations = walker_->IterationsToYield();
+    uint64_t budget = walker_->SliceBudgetUsecs();
+
+    if (!started_) {
+        started_ = true;
+        walker_->Start(slice_start);
+        stopped_.resize(walker_->clients_.size(), false);
+    }
 
     // Check whether Walker was requested to be cancelled
     if (walker_->should_stop_) {
@@ -114,7 +192,6 @@ bool DBTableWalker::Worker::Run() {
         key_resume = const_cast <DBRequestKey *>(key_start_);
     }
 
-    DBEntry *entry;
     if (key_resume != NULL) {
         DBTable *table = walker_->table_;
         std::auto_ptr<const DBEntryBase> start;
@@ -134,14 +211,18 @@ bool DBTableWalker::Worker::Run() {
         if (walker_->should_stop_) {
             break; 
         }
-        if (count == GetIterationToYield()) {
+        if (count == max_iterations ||
+            (count % kBudgetCheckInterval == 0 && count != 0 &&
+             UTCTimestampUsec() - slice_start >= budget)) {
             // store the context
             walk_ctx_ = entry->GetDBRequestKey();
+            walker_->UpdateStats(count, UTCTimestampUsec() - slice_start,
+                                 false);
             return false;
         }
 
-        // Invoke walker function
-        bool more = walker_->walker_fn_(tbl_partition_, entry);
+        // Invoke walker function of each client
+        bool more = walker_->Visit(&stopped_, tbl_partition_, entry);
         if (!more) {
             break;
         }
@@ -151,87 +232,264 @@ bool DBTableWalker::Worker::Run() {
     }
 
 walk_done:
+    walker_->UpdateStats(count, UTCTimestampUsec() - slice_start, true);
+
     // Check whether all other walks on the table is completed
     long num_walkers_on_tpart = walker_->status_.fetch_and_decrement();
     if (num_walkers_on_tpart == 1) {
-        // Invoke Walker_Complete callback
-        if (!walker_->should_stop_) {
-            walker_->wkmgr_->update_walk_complete_count(+1);
-        }
-        if (walker_->done_fn_ != NULL) {
-            if (!walker_->should_stop_) {
-                walker_->done_fn_(walker_->table_);
-            }
-        }
-        // Release the memory for walker and bitmap
-        walker_->wkmgr_->PurgeWalker(walker_->id_);
+        walker_->Complete();
     }
     return true;
 }
 
-DBTableWalker::Walker::Walker(WalkId id, DBTableWalker *wkmgr,
-                              DBTable *table, const DBRequestKey *key,
-                              WalkFn walker, WalkCompleteFn walk_done)
-    : id_(id), wkmgr_(wkmgr), table_(table),
-      key_start_(const_cast<DBRequestKey *>(key)), 
-      walker_fn_(walker), done_fn_(walk_done) {
-    int num_worker = DB::PartitionCount(); 
+DBTableWalker::Walker::Walker(DBTableWalker *wkmgr, DBTable *table,
+                              const DBRequestKey *key, Priority priority)
+    : wkmgr_(wkmgr), table_(table),
+      key_start_(const_cast<DBRequestKey *>(key)), priority_(priority),
+      started_(false) {
     should_stop_ = false;
-    status_ = num_worker;
+    status_ = DB::PartitionCount();
+    stats_.table = table->name();
+    stats_.priority = priority;
+    stats_.partitions = DB::PartitionCount();
+    stats_.request_time = UTCTimestampUsec();
+}
+
+void DBTableWalker::Walker::AddClient(WalkId id, WalkFn walker,
+                                      WalkCompleteFn walk_done) {
+    if (clients_.empty()) {
+        stats_.id = id;
+    }
+    clients_.push_back(new Client(id, walker, walk_done));
+    stats_.requests++;
+}
+
+void DBTableWalker::Walker::Schedule() {
+    int num_worker = DB::PartitionCount();
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
     for (int i = 0; i < num_worker; i++) {
-        Worker *task = new Worker(this, i, key);
-        TaskScheduler *scheduler = TaskScheduler::GetInstance();
+        Worker *task = new Worker(this, i, key_start_.get());
         scheduler->Enqueue(task);
     }
 }
 
-DBTableWalker::WalkId DBTableWalker::WalkTable(DBTable *table, 
-                                               const DBRequestKey *key_start, 
-                                               WalkFn walkerfn , 
-                                               WalkCompleteFn walk_complete) {
-    tbb::mutex::scoped_lock lock(walkers_mutex_);
-    walk_request_count_++;
+void DBTableWalker::Walker::Start(uint64_t now) {
+    tbb::mutex::scoped_lock lock(wkmgr_->walkers_mutex_);
+    if (!started_) {
+        started_ = true;
+        stats_.start_time = now;
+    }
+}
+
+void DBTableWalker::Walker::Cancel(WalkId id) {
+    int active = 0;
+    for (ClientList::iterator it = clients_.begin(); it != clients_.end();
+         ++it) {
+        Client *client = *it;
+        if (client->id == id && !client->cancelled) {
+            client->cancelled = true;
+            stats_.cancelled++;
+        }
+        if (!client->cancelled) {
+            active++;
+        }
+    }
+    if (active == 0) {
+        StopWalk();
+    }
+}
+
+void DBTableWalker::Walker::UpdateStats(int entries, uint64_t usecs,
+                                        bool partition_done) {
+    tbb::mutex::scoped_lock lock(wkmgr_->walkers_mutex_);
+    stats_.entries += entries;
+    stats_.slices++;
+    if (usecs > stats_.max_slice_usecs) {
+        stats_.max_slice_usecs = usecs;
+    }
+    if (partition_done) {
+        stats_.partitions_done++;
+    }
+}
+
+//
+// Invoke the walker function of each client that hasn't cancelled the walk
+// or stopped it in this partition. Returns false if there are no such
+// clients left.
+//
+bool DBTableWalker::Walker::Visit(std::vector<bool> *stopped,
+                                  DBTablePartBase *tpart, DBEntryBase *entry) {
+    bool more = false;
+    for (size_t i = 0; i < clients_.size(); i++) {
+        Client *client = clients_[i];
+        if ((*stopped)[i] || client->cancelled) {
+            continue;
+        }
+        if (!client->walk_fn(tpart, entry)) {
+            (*stopped)[i] = true;
+            continue;
+        }
+        more = true;
+    }
+    return more;
+}
+
+//
+// Called when the walk is done on all partitions.
+//
+void DBTableWalker::Walker::Complete() {
+    int completed = 0;
+    for (ClientList::iterator it = clients_.begin(); it != clients_.end();
+         ++it) {
+        if (!(*it)->cancelled) {
+            completed++;
+        }
+    }
+    if (completed) {
+        wkmgr_->update_walk_complete_count(completed);
+    }
+
+    // Invoke Walker_Complete callback
+    for (ClientList::iterator it = clients_.begin(); it != clients_.end();
+         ++it) {
+        Client *client = *it;
+        if (!client->cancelled && client->done_fn != NULL) {
+            client->done_fn(table_);
+        }
+    }
+
+    // Release the memory for walker and bitmap
+    wkmgr_->PurgeWalker(this);
+}
+
+uint64_t DBTableWalker::Walker::SliceBudgetUsecs() const {
+    uint64_t budget = wkmgr_->slice_budget_usecs();
+    switch (priority_) {
+    case PRIORITY_LOW:
+        return budget / 4;
+    case PRIORITY_HIGH:
+        return budget * 2;
+    default:
+        return budget;
+    }
+}
+
+int DBTableWalker::Walker::IterationsToYield() const {
+    int iterations = GetIterationToYield();
+    switch (priority_) {
+    case PRIORITY_LOW:
+        return std::max(iterations / 4, 1);
+    case PRIORITY_HIGH:
+        return iterations * 2;
+    default:
+        return iterations;
+    }
+}
+
+DBTableWalker::WalkId DBTableWalker::AllocWalkId(Walker *walker) {
     size_t i = walker_map_.find_first();
     if (i == walker_map_.npos) {
         i = walkers_.size();
-        Walker *walker = new Walker(i, this, table, key_start, 
-                                    walkerfn, walk_complete);
         walkers_.push_back(walker);
     } else {
         walker_map_.reset(i);
         if (walker_map_.none()) {
             walker_map_.clear();
         }
-        Walker *walker = new Walker(i, this, table, key_start, 
-                                    walkerfn, walk_complete);
         walkers_[i] = walker;
     }
     return i;
 }
 
+//
+// Find a walk of the whole table that hasn't started yet. Only requests
+// without a start key are merged.
+//
+DBTableWalker::Walker *DBTableWalker::FindMergeableWalker(DBTable *table,
+                                                          Priority priority) {
+    for (size_t i = 0; i < walkers_.size(); i++) {
+        Walker *walker = walkers_[i];
+        if (walker != NULL && walker->IsMergeable(table)) {
+            if (priority > walker->priority_) {
+                walker->priority_ = priority;
+                walker->stats_.priority = priority;
+            }
+            return walker;
+        }
+    }
+    return NULL;
+}
+
+DBTableWalker::WalkId DBTableWalker::WalkTable(DBTable *table, 
+                                               const DBRequestKey *key_start, 
+                                               WalkFn walkerfn , 
+                                               WalkCompleteFn walk_complete,
+                                               Priority priority) {
+    tbb::mutex::scoped_lock lock(walkers_mutex_);
+    walk_request_count_++;
+
+    Walker *walker = NULL;
+    if (key_start == NULL) {
+        walker = FindMergeableWalker(table, priority);
+    }
+    if (walker != NULL) {
+        walk_merge_count_++;
+        WalkId id = AllocWalkId(walker);
+        walker->AddClient(id, walkerfn, walk_complete);
+        return id;
+    }
+
+    walker = new Walker(this, table, key_start, priority);
+    WalkId id = AllocWalkId(walker);
+    walker->AddClient(id, walkerfn, walk_complete);
+    walker->Schedule();
+    return id;
+}
+
 void DBTableWalker::WalkCancel(WalkId id) {
     tbb::mutex::scoped_lock lock(walkers_mutex_);
     walk_cancel_count_++;
-    walkers_[id]->StopWalk();
+    walkers_[id]->Cancel(id);
     // Purge to be called after task has stopped
 }
 
-void DBTableWalker::PurgeWalker(WalkId id) {
+void DBTableWalker::PurgeWalker(Walker *walker) {
     tbb::mutex::scoped_lock lock(walkers_mutex_);
-    Walker *walker = walkers_[id];
-    delete walker;
-    walkers_[id] = NULL;
-    if ((size_t) id == walkers_.size() - 1) {
-        while (!walkers_.empty() && walkers_.back() == NULL) {
-            walkers_.pop_back();
-        }
-        if (walker_map_.size() > walkers_.size()) {
-            walker_map_.resize(walkers_.size());
+    walker->stats_.end_time = UTCTimestampUsec();
+    walk_history_.push_back(walker->stats_);
+    if (walk_history_.size() > kMaxWalkHistory) {
+        walk_history_.pop_front();
+    }
+
+    for (Walker::ClientList::iterator it = walker->clients_.begin();
+         it != walker->clients_.end(); ++it) {
+        WalkId id = (*it)->id;
+        walkers_[id] = NULL;
+        if ((size_t) id == walkers_.size() - 1) {
+            while (!walkers_.empty() && walkers_.back() == NULL) {
+                walkers_.pop_back();
+            }
+            if (walker_map_.size() > walkers_.size()) {
+                walker_map_.resize(walkers_.size());
+            }
+        } else {
+            if ((size_t) id >= walker_map_.size()) {
+                walker_map_.resize(id + 1);
+            }
+            walker_map_.set(id);
         }
-    } else {
-        if ((size_t) id >= walker_map_.size()) {
-            walker_map_.resize(id + 1);
+    }
+    delete walker;
+}
+
+void DBTableWalker::GetWalkStats(std::vector<WalkStats> *stats) {
+    tbb::mutex::scoped_lock lock(walkers_mutex_);
+    for (size_t i = 0; i < walkers_.size(); i++) {
+        Walker *walker = walkers_[i];
+        // A walker is listed under the id of each merged request.
+        if (walker != NULL && walker->stats_.id == (WalkId) i) {
+            stats->push_back(walker->stats_);
         }
-        walker_map_.set(id);
     }
+    stats->insert(stats->end(), walk_history_.rbegin(), walk_history_.rend());
 }
@@ -5,6 +5,9 @@
 #ifndef ctrlplane_db_table_walker_h
 #define ctrlplane_db_table_walker_h
 
+#include <deque>
+#include <string>
+#include <vector>
 #include <boost/function.hpp>
 #include <boost/dynamic_bitset.hpp>
 #include <tbb/task.h>
@@ -32,11 +35,43 @@ public:
 
     static const WalkId kInvalidWalkerId = -1;
 
+    // Walks with a higher priority get a larger budget in each time slice
+    // of the partition task, so they complete faster at the expense of the
+    // incremental updates queued in the same partition.
+    enum Priority {
+        PRIORITY_LOW,
+        PRIORITY_NORMAL,
+        PRIORITY_HIGH,
+    };
+
+    // Progress and latency of a walk. Times are in usecs since epoch.
+    struct WalkStats {
+        WalkStats();
+        WalkId id;
+        std::string table;
+        Priority priority;
+        int requests;           // walk requests merged into this walk
+        int cancelled;          // requests cancelled by the client
+        int partitions;
+        int partitions_done;
+        uint64_t entries;       // entries visited
+        uint64_t slices;        // time slices used across all partitions
+        uint64_t max_slice_usecs;
+        uint64_t request_time;
+        uint64_t start_time;    // start of the first slice
+        uint64_t end_time;      // 0 while the walk is in progress
+    };
+
     // Start a walk request on the specified table. If non null, 'key_start'
     // specifies the starting point for the walk. The walk is performed in
     // all table shards in parallel.
+    //
+    // A request to walk the whole table is merged with a pending walk of
+    // the same table that hasn't started yet. The entries are visited once
+    // and the walker function of each request is invoked for every entry.
     WalkId WalkTable(DBTable *table, const DBRequestKey *key_start,
-                     WalkFn walker, WalkCompleteFn walk_complete);
+                     WalkFn walker, WalkCompleteFn walk_complete,
+                     Priority priority = PRIORITY_NORMAL);
 
     // cancel a walk that may be in progress. This cannot be called from
     // the walker function itself.
@@ -51,9 +86,24 @@ public:
         walk_complete_count_ += inc;
     }
     uint64_t walk_cancel_count() { return walk_cancel_count_; }
+    uint64_t walk_merge_count() { return walk_merge_count_; }
+
+    // Maximum time spent by a walk of normal priority in a partition task
+    // before yielding to other tasks. Low priority walks get a quarter of
+    // it and high priority walks get twice as much.
+    uint64_t slice_budget_usecs() const { return slice_budget_usecs_; }
+    void set_slice_budget_usecs(uint64_t usecs) {
+        slice_budget_usecs_ = usecs;
+    }
+
+    // Statistics for the walks in progress followed by the most recently
+    // completed ones.
+    void GetWalkStats(std::vector<WalkStats> *stats);
 
 private:
     static const int kIterationToYield = 1024;
+    static const uint64_t kSliceBudgetUsecs = 10000;
+    static const size_t kMaxWalkHistory = 32;
 
     static const int GetIterationToYield() {
         static int iter_ = kIterationToYield;
@@ -80,18 +130,26 @@ private:
 
     typedef std::vector<Walker *> WalkerList;
     typedef boost::dynamic_bitset<> WalkerMap;
+    typedef std::deque<WalkStats> WalkHistory;
+
+    WalkId AllocWalkId(Walker *walker);
+    Walker *FindMergeableWalker(DBTable *table, Priority priority);
 
     // Purge the walker after the walk is completed/cancelled
-    void PurgeWalker(WalkId id);
+    void PurgeWalker(Walker *walker);
 
-    // List of walkers allocated
+    // List of walkers allocated. A walker is present at the index of each
+    // of the walk requests merged into it.
     tbb::mutex walkers_mutex_;
     WalkerList walkers_;
     WalkerMap walker_map_;
+    WalkHistory walk_history_;
 
     uint64_t walk_request_count_;
     uint64_t walk_complete_count_;
     uint64_t walk_cancel_count_;
+    uint64_t walk_merge_count_;
+    uint64_t slice_budget_usecs_;
 
     static int walker_task_id_;
 };
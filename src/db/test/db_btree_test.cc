@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "db/db_btree.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <set>
+#include <vector>
+#include <boost/intrusive/set.hpp>
+
+#include "base/logging.h"
+#include "base/util.h"
+#include "db/db_entry.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+class TestEntry : public DBEntry {
+public:
+    explicit TestEntry(int key) : key_(key) { }
+
+    virtual bool IsLess(const DBEntry &rhs) const {
+        return key_ < static_cast<const TestEntry &>(rhs).key_;
+    }
+    virtual void SetKey(const DBRequestKey *key) { }
+    virtual std::string ToString() const { return "TestEntry"; }
+    virtual KeyPtr GetDBRequestKey() const { return KeyPtr(); }
+
+    int key() const { return key_; }
+
+    // Hook for the red-black tree used as reference in the benchmarks.
+    boost::intrusive::set_member_hook<> hook_;
+
+private:
+    int key_;
+    DISALLOW_COPY_AND_ASSIGN(TestEntry);
+};
+
+typedef boost::intrusive::member_hook<TestEntry,
+        boost::intrusive::set_member_hook<>, &TestEntry::hook_> TestSetMember;
+typedef boost::intrusive::set<TestEntry, TestSetMember> TestTree;
+
+class DBBTreeTest : public ::testing::Test {
+protected:
+    virtual void TearDown() {
+        tree_.Clear();
+        for (vector<TestEntry *>::iterator it = entries_.begin();
+             it != entries_.end(); ++it) {
+            delete *it;
+        }
+        entries_.clear();
+    }
+
+    TestEntry *Alloc(int key) {
+        TestEntry *entry = new TestEntry(key);
+        entries_.push_back(entry);
+        return entry;
+    }
+
+    int Key(const DBEntry *entry) {
+        return static_cast<const TestEntry *>(entry)->key();
+    }
+
+    // Verify the contents and the order of the tree against the reference.
+    void Verify(const set<int> &expected) {
+        EXPECT_EQ(expected.size(), tree_.size());
+        set<int>::const_iterator it = expected.begin();
+        for (DBEntry *entry = tree_.First(); entry != NULL;
+             entry = tree_.Next(entry), ++it) {
+            ASSERT_TRUE(it != expected.end());
+            ASSERT_EQ(*it, Key(entry));
+        }
+        EXPECT_TRUE(it == expected.end());
+    }
+
+    DBBTree tree_;
+    vector<TestEntry *> entries_;
+};
+
+TEST_F(DBBTreeTest, Basic) {
+    EXPECT_TRUE(tree_.empty());
+    EXPECT_TRUE(tree_.First() == NULL);
+
+    TestEntry *entry = Alloc(10);
+    EXPECT_TRUE(tree_.Insert(entry));
+    EXPECT_FALSE(tree_.Insert(Alloc(10)));
+    EXPECT_EQ(1, tree_.size());
+
+    TestEntry key(10);
+    EXPECT_EQ(entry, tree_.Find(&key));
+    EXPECT_EQ(entry, tree_.LowerBound(&key));
+    TestEntry before(5), after(15);
+    EXPECT_TRUE(tree_.Find(&before) == NULL);
+    EXPECT_EQ(entry, tree_.LowerBound(&before));
+    EXPECT_TRUE(tree_.LowerBound(&after) == NULL);
+    EXPECT_EQ(entry, tree_.First());
+    EXPECT_TRUE(tree_.Next(entry) == NULL);
+
+    EXPECT_TRUE(tree_.Remove(entry));
+    EXPECT_FALSE(tree_.Remove(entry));
+    EXPECT_TRUE(tree_.empty());
+    EXPECT_TRUE(tree_.Find(&key) == NULL);
+}
+
+TEST_F(DBBTreeTest, Sequential) {
+    static const int kCount = 100000;
+    set<int> expected;
+    for (int i = 0; i < kCount; i++) {
+        EXPECT_TRUE(tree_.Insert(Alloc(i * 2)));
+        expected.insert(i * 2);
+    }
+    Verify(expected);
+    EXPECT_LT(2, tree_.height());
+
+    for (int i = 0; i < kCount * 2; i++) {
+        TestEntry key(i);
+        DBEntry *entry = tree_.Find(&key);
+        if (i % 2) {
+            EXPECT_TRUE(entry == NULL);
+            entry = tree_.LowerBound(&key);
+            if (i < kCount * 2 - 1) {
+                ASSERT_TRUE(entry != NULL);
+                EXPECT_EQ(i + 1, Key(entry));
+            } else {
+                EXPECT_TRUE(entry == NULL);
+            }
+        } else {
+            ASSERT_TRUE(entry != NULL);
+            EXPECT_EQ(i, Key(entry));
+        }
+    }
+
+    // Remove everything from the front, so that leaves and inner nodes are
+    // merged and the tree shrinks back to a single leaf.
+    for (int i = 0; i < kCount; i++) {
+        TestEntry key(i * 2);
+        EXPECT_TRUE(tree_.Remove(tree_.Find(&key)));
+        expected.erase(i * 2);
+        if (i % 10000 == 0) {
+            Verify(expected);
+        }
+    }
+    EXPECT_TRUE(tree_.empty());
+    EXPECT_EQ(1, tree_.height());
+}
+
+TEST_F(DBBTreeTest, Random) {
+    static const int kKeyRange = 20000;
+    static const int kIterations = 200000;
+    srand(1);
+    set<int> expected;
+    for (int i = 0; i < kIterations; i++) {
+        int value = rand() % kKeyRange;
+        TestEntry key(value);
+        DBEntry *entry = tree_.Find(&key);
+        ASSERT_EQ(expected.count(value) != 0, entry != NULL);
+        if (entry != NULL) {
+            EXPECT_TRUE(tree_.Remove(entry));
+            expected.erase(value);
+        } else {
+            EXPECT_TRUE(tree_.Insert(Alloc(value)));
+            expected.insert(value);
+        }
+
+        DBEntry *lower = tree_.LowerBound(&key);
+        set<int>::iterator it = expected.lower_bound(value);
+        if (it == expected.end()) {
+            EXPECT_TRUE(lower == NULL);
+        } else {
+            ASSERT_TRUE(lower != NULL);
+            EXPECT_EQ(*it, Key(lower));
+        }
+        if (i % 20000 == 0) {
+            Verify(expected);
+        }
+    }
+    Verify(expected);
+}
+
+//
+// Threaded walk that removes the previous entry and adds new entries while
+// walking, as table walkers and listeners do.
+//
+TEST_F(DBBTreeTest, WalkWithChanges) {
+    static const int kCount = 10000;
+    for (int i = 0; i < kCount; i++) {
+        tree_.Insert(Alloc(i * 4));
+    }
+
+    int count = 0;
+    DBEntry *previous = NULL;
+    for (DBEntry *entry = tree_.First(); entry != NULL;
+         entry = tree_.Next(entry)) {
+        EXPECT_EQ(count * 4, Key(entry));
+        if (previous != NULL) {
+            EXPECT_TRUE(tree_.Remove(previous));
+        }
+        tree_.Insert(Alloc(Key(entry) + 1));
+        tree_.Insert(Alloc(Key(entry) + 2));
+        // Skip over the entries that were just added.
+        entry = tree_.Next(tree_.Next(entry));
+        previous = entry;
+        count++;
+    }
+    EXPECT_EQ(kCount, count);
+    EXPECT_EQ(kCount * 2 + 1, tree_.size());
+}
+
+//
+// Compare the lookup and walk times of the B+tree against the intrusive
+// red-black tree. The number of entries can be set with the environment
+// variable DB_BTREE_BENCHMARK_SIZE e.g. to 1000000 or 10000000.
+//
+TEST_F(DBBTreeTest, Benchmark) {
+    int count = 100000;
+    const char *size = getenv("DB_BTREE_BENCHMARK_SIZE");
+    if (size != NULL) {
+        count = strtoul(size, NULL, 0);
+    }
+
+    // Allocate the entries in random order, so that they are scattered in
+    // the heap like the routes in a real table.
+    vector<int> keys;
+    for (int i = 0; i < count; i++) {
+        keys.push_back(i);
+    }
+    srand(1);
+    random_shuffle(keys.begin(), keys.end());
+    TestTree rbtree;
+    for (int i = 0; i < count; i++) {
+        TestEntry *entry = Alloc(keys[i]);
+        rbtree.insert(*entry);
+        tree_.Insert(entry);
+    }
+    random_shuffle(keys.begin(), keys.end());
+
+    int found = 0;
+    uint64_t start = UTCTimestampUsec();
+    for (int i = 0; i < count; i++) {
+        TestEntry key(keys[i]);
+        if (rbtree.find(key) != rbtree.end()) {
+            found++;
+        }
+    }
+    uint64_t rbtree_lookup = UTCTimestampUsec() - start;
+    EXPECT_EQ(count, found);
+
+    found = 0;
+    start = UTCTimestampUsec();
+    for (int i = 0; i < count; i++) {
+        TestEntry key(keys[i]);
+        if (tree_.Find(&key) != NULL) {
+            found++;
+        }
+    }
+    uint64_t btree_lookup = UTCTimestampUsec() - start;
+    EXPECT_EQ(count, found);
+
+    int walked = 0;
+    start = UTCTimestampUsec();
+    for (TestTree::iterator it = rbtree.begin(); it != rbtree.end(); ++it) {
+        walked++;
+    }
+    uint64_t rbtree_walk = UTCTimestampUsec() - start;
+    EXPECT_EQ(count, walked);
+
+    walked = 0;
+    start = UTCTimestampUsec();
+    for (DBEntry *entry = tree_.First(); entry != NULL;
+         entry = tree_.Next(entry)) {
+        walked++;
+    }
+    uint64_t btree_walk = UTCTimestampUsec() - start;
+    EXPECT_EQ(count, walked);
+
+    LOG(DEBUG, count << " entries, lookup usec: rbtree " << rbtree_lookup <<
+        " btree " << btree_lookup << ", walk usec: rbtree " << rbtree_walk <<
+        " btree " << btree_walk);
+    rbtree.clear();
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -25,6 +25,9 @@ protected:
     tbb::atomic<long> del_notification;
     tbb::atomic<long> walk_count_;
     tbb::atomic<bool> walk_done_;
+    tbb::atomic<long> batch_count_;
+    tbb::atomic<long> batch_adc_notification;
+    tbb::atomic<long> batch_del_notification;
 public:
     DBTest() { 
         itbl = static_cast<VlanTable *>(db_.CreateTable("db.test.vlan.0"));
@@ -59,6 +62,75 @@ public:
         walk_done_ = true;
     }
 
+    // Keeps a state for each entry until it's deleted.
+    void BatchListener(DBTablePartBase *root,
+                       const DBTableBase::EntryList &entries) {
+        batch_count_++;
+        for (DBTableBase::EntryList::const_iterator it = entries.begin();
+             it != entries.end(); ++it) {
+            DBEntryBase *entry = *it;
+            VlanState *state = static_cast<VlanState *>(
+                entry->GetState(root->parent(), tid_1_));
+            if (entry->IsDeleted()) {
+                batch_del_notification++;
+                if (state) {
+                    entry->ClearState(root->parent(), tid_1_);
+                    delete state;
+                }
+            } else {
+                batch_adc_notification++;
+                if (!state) {
+                    entry->SetState(root->parent(), tid_1_, new VlanState(0));
+                }
+            }
+        }
+    }
+
+    bool CountWalk(tbb::atomic<long> *count, DBTablePartBase *root,
+                   DBEntryBase *entry) {
+        (*count)++;
+        return true;
+    }
+
+    void CountWalkDone(tbb::atomic<long> *done, DBTableBase *tbl) {
+        (*done)++;
+    }
+
+    // Delete the next odd numbered vlan while walking the even ones.
+    bool DeleteWalk(tbb::atomic<long> *count, DBTablePartBase *root,
+                    DBEntryBase *entry) {
+        Vlan *vlan = static_cast<Vlan *>(entry);
+        (*count)++;
+        if (vlan->getTag() % 2 == 0) {
+            DBRequest delReq;
+            delReq.key.reset(new VlanTableReqKey(vlan->getTag() + 1));
+            delReq.oper = DBRequest::DB_ENTRY_DELETE;
+            itbl->Enqueue(&delReq);
+        }
+        return true;
+    }
+
+    void AddVlans(int count) {
+        for (int i = 0; i < count; i++) {
+            DBRequest addReq;
+            addReq.key.reset(new VlanTableReqKey(i));
+            addReq.data.reset(new VlanTableReqData("DB Test Vlan"));
+            addReq.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+            EXPECT_TRUE(itbl->Enqueue(&addReq));
+        }
+        task_util::WaitForIdle();
+    }
+
+    void DeleteVlans(int count) {
+        for (int i = 0; i < count; i++) {
+            DBRequest delReq;
+            delReq.key.reset(new VlanTableReqKey(i));
+            delReq.oper = DBRequest::DB_ENTRY_DELETE;
+            EXPECT_TRUE(itbl->Enqueue(&delReq));
+        }
+        task_util::WaitForIdle();
+    }
+
 
     void DBTestListener_1(DBTablePartBase *root, DBEntryBase *entry) {
         Vlan *vlan = static_cast<Vlan *>(entry);
@@ -520,6 +592,141 @@ TEST_F(DBTest, JWalker) {
     EXPECT_TRUE(del_notification == walk_count);
 }
 
+// To Test:
+// Batch listeners are notified of all changes along with the per-entry
+// listeners, and deleted entries are removed once the batch listener clears
+// its state
+TEST_F(DBTest, BatchListener) {
+    static const int kVlanCount = 100;
+    adc_notification = 0;
+    del_notification = 0;
+    batch_count_ = 0;
+    batch_adc_notification = 0;
+    batch_del_notification = 0;
+
+    tid_ =
+        itbl->Register(boost::bind(&DBTest::DBTestListener, this, _1, _2));
+    tid_1_ =
+        itbl->RegisterBatch(boost::bind(&DBTest::BatchListener, this, _1, _2));
+    EXPECT_NE(tid_, tid_1_);
+
+    AddVlans(kVlanCount);
+    EXPECT_EQ(kVlanCount, adc_notification);
+    EXPECT_EQ(kVlanCount, batch_adc_notification);
+    EXPECT_LT(0, batch_count_);
+    EXPECT_GE(kVlanCount, batch_count_);
+
+    DeleteVlans(kVlanCount);
+    EXPECT_EQ(kVlanCount, del_notification);
+    EXPECT_EQ(kVlanCount, batch_del_notification);
+    for (int i = 0; i < kVlanCount; i++) {
+        VlanTableReqKey lookupKey(i);
+        EXPECT_TRUE(itbl->Find(&lookupKey) == NULL);
+    }
+
+    itbl->Unregister(tid_1_);
+    itbl->Unregister(tid_);
+    EXPECT_FALSE(itbl->HasListeners());
+}
+
+// To Test:
+// Walks of the whole table requested before the walk starts are merged into
+// a single pass, and cancelling one of them doesn't affect the others
+TEST_F(DBTest, WalkMerge) {
+    DBTable *table = dynamic_cast<DBTable *>(itbl);
+    if (table == NULL) {
+        return;
+    }
+
+    static const int kVlanCount = 1024;
+    AddVlans(kVlanCount);
+
+    DBTableWalker *walker = db_.GetWalker();
+    uint64_t merge_count = walker->walk_merge_count();
+    uint64_t complete_count = walker->walk_complete_count();
+    tbb::atomic<long> count[3], done[3];
+    DBTableWalker::WalkId id[3];
+
+    TaskScheduler::GetInstance()->Stop();
+    for (int i = 0; i < 3; i++) {
+        count[i] = 0;
+        done[i] = 0;
+        id[i] = walker->WalkTable(table, NULL,
+            boost::bind(&DBTest::CountWalk, this, &count[i], _1, _2),
+            boost::bind(&DBTest::CountWalkDone, this, &done[i], _1));
+    }
+    walker->WalkCancel(id[1]);
+    EXPECT_NE(id[0], id[1]);
+    EXPECT_NE(id[1], id[2]);
+    EXPECT_EQ(merge_count + 2, walker->walk_merge_count());
+    TaskScheduler::GetInstance()->Start();
+    task_util::WaitForIdle();
+
+    EXPECT_EQ(kVlanCount, count[0]);
+    EXPECT_EQ(1, done[0]);
+    EXPECT_EQ(0, count[1]);
+    EXPECT_EQ(0, done[1]);
+    EXPECT_EQ(kVlanCount, count[2]);
+    EXPECT_EQ(1, done[2]);
+    EXPECT_EQ(complete_count + 2, walker->walk_complete_count());
+
+    std::vector<DBTableWalker::WalkStats> stats;
+    walker->GetWalkStats(&stats);
+    ASSERT_FALSE(stats.empty());
+    EXPECT_EQ(id[0], stats[0].id);
+    EXPECT_EQ(3, stats[0].requests);
+    EXPECT_EQ(1, stats[0].cancelled);
+    EXPECT_EQ(kVlanCount, stats[0].entries);
+    EXPECT_EQ(stats[0].partitions, stats[0].partitions_done);
+    EXPECT_NE(0, stats[0].end_time);
+
+    DeleteVlans(kVlanCount);
+}
+
+// To Test:
+// A walk that runs out of budget resumes where it left off, even when the
+// entries following it are deleted before the next time slice
+TEST_F(DBTest, WalkBudget) {
+    DBTable *table = dynamic_cast<DBTable *>(itbl);
+    if (table == NULL) {
+        return;
+    }
+
+    static const int kVlanCount = 1024;
+    AddVlans(kVlanCount);
+
+    DBTableWalker *walker = db_.GetWalker();
+    uint64_t budget = walker->slice_budget_usecs();
+    walker->set_slice_budget_usecs(0);
+
+    tbb::atomic<long> count, done;
+    count = 0;
+    done = 0;
+    walker->WalkTable(table, NULL,
+        boost::bind(&DBTest::DeleteWalk, this, &count, _1, _2),
+        boost::bind(&DBTest::CountWalkDone, this, &done, _1),
+        DBTableWalker::PRIORITY_LOW);
+    task_util::WaitForIdle();
+    walker->set_slice_budget_usecs(budget);
+
+    EXPECT_EQ(1, done);
+    EXPECT_LE(kVlanCount / 2, count);
+    EXPECT_GE(kVlanCount, count);
+    for (int i = 0; i < kVlanCount; i++) {
+        VlanTableReqKey lookupKey(i);
+        EXPECT_EQ(i % 2 == 0, itbl->Find(&lookupKey) != NULL);
+    }
+
+    std::vector<DBTableWalker::WalkStats> stats;
+    walker->GetWalkStats(&stats);
+    ASSERT_FALSE(stats.empty());
+    EXPECT_EQ(DBTableWalker::PRIORITY_LOW, stats[0].priority);
+    EXPECT_EQ(count, stats[0].entries);
+    EXPECT_LE(count / 64, stats[0].slices);
+
+    DeleteVlans(kVlanCount);
+}
+
 // To Test:
 // Verify Bulk ADD DELETE of objects to DBTable
 TEST_F(DBTest, Bulk) {
@@ -637,4 +844,101 @@ TEST_F(DBTest, ReqInNotifyPath) {
     del_notification = 0;
 }
 
+// To Test:
+// Verify that a batch of requests is processed in order within a partition
+TEST_F(DBTest, BatchEnqueue) {
+    int bulk_count = 100;
+
+    // Add all VLANs and delete the even numbered ones in the same batch.
+    // Each delete must be processed after the corresponding add.
+    DBRequestList reqs;
+    for (int i = 0; i < bulk_count; i++) {
+        DBRequest *addReq = new DBRequest();
+        addReq->key.reset(new VlanTableReqKey(i));
+        addReq->data.reset(new VlanTableReqData("DB Test Vlan"));
+        addReq->oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+        reqs.push_back(addReq);
+    }
+    for (int i = 0; i < bulk_count; i += 2) {
+        DBRequest *delReq = new DBRequest();
+        delReq->key.reset(new VlanTableReqKey(i));
+        delReq->oper = DBRequest::DB_ENTRY_DELETE;
+        reqs.push_back(delReq);
+    }
+    EXPECT_TRUE(itbl->Enqueue(&reqs));
+    EXPECT_TRUE(reqs.empty());
+    task_util::WaitForIdle();
+
+    for (int i = 0; i < bulk_count; i++) {
+        VlanTableReqKey lookupKey(i);
+        Vlan *vlan = itbl->Find(&lookupKey);
+        if (i % 2) {
+            EXPECT_TRUE(vlan != NULL);
+        } else {
+            EXPECT_TRUE(vlan == NULL);
+        }
+    }
+
+    // An empty batch is a no-op.
+    EXPECT_TRUE(itbl->Enqueue(&reqs));
+
+    for (int i = 1; i < bulk_count; i += 2) {
+        DBRequest *delReq = new DBRequest();
+        delReq->key.reset(new VlanTableReqKey(i));
+        delReq->oper = DBRequest::DB_ENTRY_DELETE;
+        reqs.push_back(delReq);
+    }
+    EXPECT_TRUE(itbl->Enqueue(&reqs));
+    task_util::WaitForIdle();
+    for (int i = 0; i < bulk_count; i++) {
+        VlanTableReqKey lookupKey(i);
+        EXPECT_TRUE(itbl->Find(&lookupKey) == NULL);
+    }
+}
+
+// To Test:
+// Compare the rate at which requests are processed when they are enqueued
+// one at a time and in batches
+TEST_F(DBTest, EnqueueBenchmark) {
+    static const int kRequestCount = 50000;
+    static const size_t kBatchSize = 256;
+
+    for (int pass = 0; pass < 2; pass++) {
+        bool batch = (pass == 1);
+        for (int oper = 0; oper < 2; oper++) {
+            bool add = (oper == 0);
+            DBRequestList reqs;
+            uint64_t start = UTCTimestampUsec();
+            for (int i = 0; i < kRequestCount; i++) {
+                std::auto_ptr<DBRequest> req(new DBRequest());
+                req->key.reset(new VlanTableReqKey(i));
+                if (add) {
+                    req->data.reset(new VlanTableReqData("DB Test Vlan"));
+                    req->oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+                } else {
+                    req->oper = DBRequest::DB_ENTRY_DELETE;
+                }
+                if (!batch) {
+                    itbl->Enqueue(req.get());
+                    continue;
+                }
+                reqs.push_back(req.release());
+                if (reqs.size() == kBatchSize) {
+                    itbl->Enqueue(&reqs);
+                }
+            }
+            itbl->Enqueue(&reqs);
+            task_util::WaitForIdle();
+            uint64_t elapsed = UTCTimestampUsec() - start + 1;
+
+            LOG(DEBUG, (batch ? "Batch" : "Single") << " enqueue of " <<
+                kRequestCount << (add ? " adds: " : " deletes: ") <<
+                kRequestCount * 1000000ULL / elapsed << " requests/sec");
+
+            VlanTableReqKey lookupKey(kRequestCount - 1);
+            EXPECT_EQ(add, itbl->Find(&lookupKey) != NULL);
+        }
+    }
+}
+
 #endif // db_test_cmn_h
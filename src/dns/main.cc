@@ -258,8 +258,8 @@ int main(int argc, char *argv[]) {
     IFMapManager *ifmapmgr = new IFMapManager(&ifmap_server, map_server_url,
                         var_map["map-user"].as<string>(),
                         var_map["map-password"].as<string>(), certstore,
-                        boost::bind(&IFMapServerParser::Receive, ifmap_parser,
-                                &config_db, _1, _2, _3),
+                        boost::bind(&IFMapServerParser::ReceiveChunk, ifmap_parser,
+                                &config_db, _1, _2, _3, _4, _5, _6),
                         Dns::GetEventManager()->io_service(), ds_client);
     ifmap_server.set_ifmap_manager(ifmapmgr);
 
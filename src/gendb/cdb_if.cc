@@ -3,6 +3,7 @@
  */
 
 #include "cdb_if.h"
+#include <deque>
 #include <boost/bind.hpp>
 #include <boost/cast.hpp>
 #include <boost/lexical_cast.hpp>
@@ -96,11 +97,22 @@ CdbIf::CdbIf(boost::asio::io_service *ioservice, DbErrorHandler errhandler,
     errhandler_(errhandler),
     db_init_done_(false),
     name_(name),
-    cassandra_ttl_(ttl) {
+    cassandra_ttl_(ttl),
+    batch_max_columns_(kBatchMaxColumns),
+    batch_max_outstanding_(kBatchMaxOutstanding),
+    batch_max_latency_usecs_(kBatchMaxLatencyUsecs) {
+    last_timestamp_ = 0;
 }
 
-CdbIf::CdbIf()
-{ }
+CdbIf::CdbIf() :
+    db_init_done_(false),
+    periodic_timer_(NULL),
+    cassandra_ttl_(0),
+    batch_max_columns_(kBatchMaxColumns),
+    batch_max_outstanding_(kBatchMaxOutstanding),
+    batch_max_latency_usecs_(kBatchMaxLatencyUsecs) {
+    last_timestamp_ = 0;
+}
 
 bool CdbIf::Db_IsInitDone() const {
     return db_init_done_;
@@ -126,6 +138,10 @@ bool CdbIf::Db_Init(std::string task_id, int task_instance) {
             TaskScheduler::GetInstance()->GetTaskId(task_id), task_instance,
             boost::bind(&CdbIf::Db_AsyncAddColumn, this, _1),
             boost::bind(&CdbIf::Db_IsInitDone, this)));
+        cdbq_->SetBatchCallback(
+            boost::bind(&CdbIf::Db_AsyncAddColumnBatch, this, _1),
+            batch_max_columns_ * batch_max_outstanding_);
+        cdbq_->set_target_latency_usecs(batch_max_latency_usecs_);
     }
 
     try {
@@ -625,103 +641,376 @@ bool CdbIf::NewDb_AddColumnfamily(const GenDb::NewCf& cf) {
 }
 
 /*
- * called by the WorkQueue mechanism
+ * Append the mutations for the columns of new_colp to the mutation map,
+ * coalescing them with those already there for the same row key and
+ * column family
  */
-bool CdbIf::Db_AsyncAddColumn(CdbIfColList *cl) {
+bool CdbIf::Db_AddMutations(CdbIfMutationMap *mutation_map,
+        GenDb::ColList *new_colp, uint64_t ts) {
+    std::vector<cassandra::Mutation> mutations;
+    GenDb::NewCf::ColumnFamilyType cftype = GenDb::NewCf::COLUMN_FAMILY_INVALID;
+
+    for (std::vector<GenDb::NewCol>::iterator it = new_colp->columns_.begin();
+                it != new_colp->columns_.end(); it++) {
+            cassandra::Mutation mutation;
+            cassandra::ColumnOrSuperColumn c_or_sc;
+            cassandra::Column c;
+
+            if (it->cftype_ == GenDb::NewCf::COLUMN_FAMILY_SQL) {
+                CDBIF_CONDCHECK_LOG_RETF((it->name.size() == 1) && (it->value.size() == 1));
+                CDBIF_CONDCHECK_LOG_RETF(cftype != GenDb::NewCf::COLUMN_FAMILY_NOSQL);
+                cftype = GenDb::NewCf::COLUMN_FAMILY_SQL;
+
+                std::string col_name;
+                try {
+                    col_name = boost::get<std::string>(it->name.at(0));
+                } catch (boost::bad_get& ex) {
+                    CDBIF_HANDLE_EXCEPTION(__func__ << "Exception for boost::get, what=" << ex.what());
+                }
+                c.__set_name(col_name);
+                std::string col_value;
+                DbDataValueToStringFromCf(col_value, new_colp->cfname_, col_name, it->value.at(0));
+                c.__set_value(col_value);
+                c.__set_timestamp(ts);
+                if (it->ttl == -1) {
+                    if (cassandra_ttl_)
+                        c.__set_ttl(cassandra_ttl_);
+                } else if (it->ttl) {
+                    c.__set_ttl(it->ttl);
+                }
+
+                c_or_sc.__set_column(c);
+                mutation.__set_column_or_supercolumn(c_or_sc);
+                mutations.push_back(mutation);
+            } else if (it->cftype_ == GenDb::NewCf::COLUMN_FAMILY_NOSQL) {
+                CDBIF_CONDCHECK_LOG_RETF(cftype != GenDb::NewCf::COLUMN_FAMILY_SQL);
+                cftype = GenDb::NewCf::COLUMN_FAMILY_NOSQL;
+
+                std::string col_name;
+                ConstructDbDataValueColumnName(col_name, new_colp->cfname_, it->name);
+                c.__set_name(col_name);
+
+                std::string col_value;
+                ConstructDbDataValueColumnValue(col_value, new_colp->cfname_, it->value);
+                c.__set_value(col_value);
+
+                c.__set_timestamp(ts);
+                if (it->ttl == -1) {
+                    if (cassandra_ttl_)
+                        c.__set_ttl(cassandra_ttl_);
+                } else if (it->ttl) {
+                    c.__set_ttl(it->ttl);
+                }
+
+                c_or_sc.__set_column(c);
+                mutation.__set_column_or_supercolumn(c_or_sc);
+                mutations.push_back(mutation);
+            } else {
+                CDBIF_CONDCHECK_LOG_RETF(0);
+            }
+    }
+    std::string key_value;
+    ConstructDbDataValueKey(key_value, new_colp->cfname_, new_colp->rowkey_);
+    std::vector<cassandra::Mutation>& cf_mutations =
+        (*mutation_map)[key_value][new_colp->cfname_];
+    cf_mutations.insert(cf_mutations.end(), mutations.begin(), mutations.end());
+    return true;
+}
+
+/*
+ * Column time stamps are kept strictly increasing, so that two writes of
+ * the same column coalesced into one batch_mutate keep their order
+ */
+uint64_t CdbIf::Db_NextTimestamp() {
+    while (true) {
+        uint64_t last = last_timestamp_;
+        uint64_t ts = UTCTimestampUsec();
+        if (ts <= last) {
+            ts = last + 1;
+        }
+        if (last_timestamp_.compare_and_swap(ts, last) == last) {
+            return ts;
+        }
+    }
+}
+
+int CdbIf::HistogramBucket(uint64_t value) {
+    int bucket = 0;
+    while (value > 1 && bucket < kHistogramBuckets - 1) {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void CdbIf::Db_BatchMutateSend(const CdbIfMutationMap& mutation_map) {
+    client_->send_batch_mutate(mutation_map,
+            org::apache::cassandra::ConsistencyLevel::ONE);
+}
+
+void CdbIf::Db_BatchMutateRecv() {
+    client_->recv_batch_mutate();
+}
+
+/*
+ * Returns false if the connection failed
+ */
+bool CdbIf::Db_BatchSend(const CdbIfMutationMap& mutation_map) {
+    try {
+        Db_BatchMutateSend(mutation_map);
+    } catch (TTransportException& te) {
+        CDBIF_HANDLE_EXCEPTION(__func__ << ": TTransportException what: " << te.what());
+        batch_stats_.errors++;
+        errhandler_();
+        return false;
+    } catch (TException& tx) {
+        CDBIF_HANDLE_EXCEPTION(__func__ << ": TException what: " << tx.what());
+        batch_stats_.errors++;
+        errhandler_();
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Receive the reply to the oldest batch_mutate outstanding. Returns false if
+ * the connection failed, the column lists of the batch are then left to be
+ * sent again. Otherwise they are freed, except on an error reply:
+ * - invalid request, the column lists of a batch of more than one are added
+ *   to invalid, to be sent one by one so that only the bad one is dropped
+ * - unavailable or timed out, they are added to retry, to be queued again
+ *   like on a connection failure, up to kBatchMaxRetries times
+ */
+bool CdbIf::Db_BatchComplete(CdbIfPendingBatch *batch,
+        std::vector<CdbIfColList *> *invalid,
+        std::vector<CdbIfColList *> *retry) {
+    try {
+        Db_BatchMutateRecv();
+    } catch (InvalidRequestException& ire) {
+        CDBIF_HANDLE_EXCEPTION(__func__ << ": InvalidRequestException: " << ire.why);
+        batch_stats_.errors++;
+        if (invalid && batch->entries.size() > 1) {
+            invalid->insert(invalid->end(), batch->entries.begin(),
+                            batch->entries.end());
+        } else {
+            Db_DropEntries(batch->entries);
+        }
+        return true;
+    } catch (UnavailableException& ue) {
+        CDBIF_HANDLE_EXCEPTION(__func__ << ": UnavailableException: " << ue.what());
+        batch_stats_.errors++;
+        Db_RetryEntries(batch->entries, retry);
+        return true;
+    } catch (TimedOutException& te) {
+        CDBIF_HANDLE_EXCEPTION(__func__ << ": TimedOutException: " << te.what());
+        batch_stats_.errors++;
+        Db_RetryEntries(batch->entries, retry);
+        return true;
+    } catch (TTransportException& te) {
+        CDBIF_HANDLE_EXCEPTION(__func__ << ": TTransportException what: " << te.what());
+        batch_stats_.errors++;
+        errhandler_();
+        return false;
+    } catch (TException& tx) {
+        CDBIF_HANDLE_EXCEPTION(__func__ << ": TException what: " << tx.what());
+        batch_stats_.errors++;
+        Db_DropEntries(batch->entries);
+        return true;
+    }
+
+    uint64_t now = UTCTimestampUsec();
+    uint64_t latency = now > batch->enqueue_time ? now - batch->enqueue_time : 0;
+    batch_stats_.batches++;
+    batch_stats_.entries += batch->entries.size();
+    batch_stats_.columns += batch->columns;
+    batch_stats_.batch_size_hist[HistogramBucket(batch->entries.size())]++;
+    batch_stats_.write_latency_hist[HistogramBucket(latency)]++;
+    for (size_t i = 0; i < batch->entries.size(); i++) {
+        delete batch->entries[i];
+    }
+    return true;
+}
+
+/*
+ * column lists that got an unavailable or timed out reply are sent again,
+ * unless they already were kBatchMaxRetries times
+ */
+void CdbIf::Db_RetryEntries(const std::vector<CdbIfColList *>& entries,
+        std::vector<CdbIfColList *> *retry) {
+    for (size_t i = 0; i < entries.size(); i++) {
+        CdbIfColList *cl = entries[i];
+        if (++cl->retries > kBatchMaxRetries) {
+            Db_DropEntries(std::vector<CdbIfColList *>(1, cl));
+        } else {
+            retry->push_back(cl);
+        }
+    }
+}
+
+/*
+ * free column lists that are not written, they were allocated when enqueued
+ */
+void CdbIf::Db_DropEntries(const std::vector<CdbIfColList *>& entries) {
+    batch_stats_.dropped += entries.size();
+    for (size_t i = 0; i < entries.size(); i++) {
+        delete entries[i];
+    }
+}
+
+/*
+ * Write a column list on its own, it already has its time stamp. Returns
+ * false if the connection failed, the column list is then left to be sent
+ * again
+ */
+bool CdbIf::Db_AddColumnSingle(CdbIfColList *cl,
+        std::vector<CdbIfColList *> *retry) {
+    CdbIfMutationMap mutation_map;
+    if (!Db_AddMutations(&mutation_map, cl->new_cl.get(), cl->timestamp)) {
+        Db_DropEntries(std::vector<CdbIfColList *>(1, cl));
+        return true;
+    }
+    CdbIfPendingBatch batch;
+    batch.entries.push_back(cl);
+    batch.columns = cl->new_cl->columns_.size();
+    batch.enqueue_time = cl->enqueue_time;
+    if (!Db_BatchSend(mutation_map)) {
+        return false;
+    }
+    return Db_BatchComplete(&batch, NULL, retry);
+}
+
+/*
+ * The column lists are coalesced into batch_mutate calls of up to
+ * batch_max_columns_ columns, with up to batch_max_outstanding_ of them in
+ * flight. The column lists of a batch_mutate rejected as an invalid request
+ * are then sent one by one. Returns false if the connection failed.
+ * Processing stops at the failure, and the column lists that are not known
+ * to be written are returned in unsent, in order: those of the batch_mutate
+ * calls in flight, those of the batch being built, those not processed yet
+ * and those to be sent one by one. The column lists that got an unavailable
+ * or timed out reply are returned in unsent as well, last
+ */
+bool CdbIf::Db_AddColumnBatch(const std::vector<CdbIfColList *>& entries,
+        std::vector<CdbIfColList *> *unsent) {
     bool ret_value = true;
-    uint64_t ts(UTCTimestampUsec());
-    GenDb::ColList *new_colp;
-
-    if ((new_colp = cl->new_cl.get())) {
-        std::map<std::string, std::map<std::string, std::vector<cassandra::Mutation> > > mutation_map;
-        std::vector<cassandra::Mutation> mutations;
-        GenDb::NewCf::ColumnFamilyType cftype = GenDb::NewCf::COLUMN_FAMILY_INVALID;
-
-        for (std::vector<GenDb::NewCol>::iterator it = new_colp->columns_.begin();
-                    it != new_colp->columns_.end(); it++) {
-                cassandra::Mutation mutation;
-                cassandra::ColumnOrSuperColumn c_or_sc;
-                cassandra::Column c;
-
-                if (it->cftype_ == GenDb::NewCf::COLUMN_FAMILY_SQL) {
-                    CDBIF_CONDCHECK_LOG_RETF((it->name.size() == 1) && (it->value.size() == 1));
-                    CDBIF_CONDCHECK_LOG_RETF(cftype != GenDb::NewCf::COLUMN_FAMILY_NOSQL);
-                    cftype = GenDb::NewCf::COLUMN_FAMILY_SQL;
-
-                    std::string col_name;
-                    try {
-                        col_name = boost::get<std::string>(it->name.at(0));
-                    } catch (boost::bad_get& ex) {
-                        CDBIF_HANDLE_EXCEPTION(__func__ << "Exception for boost::get, what=" << ex.what());
-                    }
-                    c.__set_name(col_name);
-                    std::string col_value;
-                    DbDataValueToStringFromCf(col_value, new_colp->cfname_, col_name, it->value.at(0));
-                    c.__set_value(col_value);
-                    c.__set_timestamp(ts);
-                    if (it->ttl == -1) {
-                        if (cassandra_ttl_)
-                            c.__set_ttl(cassandra_ttl_);
-                    } else if (it->ttl) {
-                        c.__set_ttl(it->ttl);
-                    }
-
-                    c_or_sc.__set_column(c);
-                    mutation.__set_column_or_supercolumn(c_or_sc);
-                    mutations.push_back(mutation);
-                } else if (it->cftype_ == GenDb::NewCf::COLUMN_FAMILY_NOSQL) {
-                    CDBIF_CONDCHECK_LOG_RETF(cftype != GenDb::NewCf::COLUMN_FAMILY_SQL);
-                    cftype = GenDb::NewCf::COLUMN_FAMILY_NOSQL;
-
-                    std::string col_name;
-                    ConstructDbDataValueColumnName(col_name, new_colp->cfname_, it->name);
-                    c.__set_name(col_name);
-
-                    std::string col_value;
-                    ConstructDbDataValueColumnValue(col_value, new_colp->cfname_, it->value);
-                    c.__set_value(col_value);
-
-                    c.__set_timestamp(ts);
-                    if (it->ttl == -1) {
-                        if (cassandra_ttl_)
-                            c.__set_ttl(cassandra_ttl_);
-                    } else if (it->ttl) {
-                        c.__set_ttl(it->ttl);
-                    }
-
-                    c_or_sc.__set_column(c);
-                    mutation.__set_column_or_supercolumn(c_or_sc);
-                    mutations.push_back(mutation);
-                } else {
-                    CDBIF_CONDCHECK_LOG_RETF(0);
+    CdbIfMutationMap mutation_map;
+    CdbIfPendingBatch batch;
+    std::deque<CdbIfPendingBatch> pending;
+    std::vector<CdbIfColList *> invalid, retry;
+    size_t next = 0;
+
+    while (next < entries.size()) {
+        CdbIfColList *cl = entries[next++];
+        GenDb::ColList *new_colp = cl->new_cl.get();
+
+        if (!new_colp) {
+            CDBIF_HANDLE_EXCEPTION(__func__ << ": No column info passed");
+            Db_DropEntries(std::vector<CdbIfColList *>(1, cl));
+        } else {
+            // A column list sent again keeps its time stamp, so that it does
+            // not override later writes of the same columns
+            if (cl->timestamp == 0) {
+                cl->timestamp = Db_NextTimestamp();
+            }
+            if (Db_AddMutations(&mutation_map, new_colp, cl->timestamp)) {
+                if (batch.entries.empty() ||
+                    cl->enqueue_time < batch.enqueue_time) {
+                    batch.enqueue_time = cl->enqueue_time;
                 }
+                batch.entries.push_back(cl);
+                batch.columns += new_colp->columns_.size();
+            } else {
+                Db_DropEntries(std::vector<CdbIfColList *>(1, cl));
+            }
         }
-        std::map<std::string, std::vector<cassandra::Mutation> > cf_map;
-        cf_map.insert(std::make_pair(new_colp->cfname_, mutations));
-        std::string key_value;
-        ConstructDbDataValueKey(key_value, new_colp->cfname_, new_colp->rowkey_);
-        mutation_map.insert(std::make_pair(key_value, cf_map));
-        try {
-            client_->batch_mutate(mutation_map, org::apache::cassandra::ConsistencyLevel::ONE);
-        } catch (InvalidRequestException& ire) {
-            CDBIF_HANDLE_EXCEPTION(__func__ << ": InvalidRequestException: " << ire.why << "for cf: " << new_colp->cfname_);
-        } catch (UnavailableException& ue) {
-            CDBIF_HANDLE_EXCEPTION(__func__ << "UnavailableException: " << ue.what() << "for cf: " << new_colp->cfname_);
-        } catch (TimedOutException& te) {
-            CDBIF_HANDLE_EXCEPTION(__func__ << "TimedOutException: " << te.what() << "for cf: " << new_colp->cfname_);
-        } catch (TTransportException& te) {
-            CDBIF_HANDLE_EXCEPTION(__func__ << ": TTransportException what: " << te.what());
-            errhandler_();
-            ret_value = false;
-        } catch (TException& tx) {
-            CDBIF_HANDLE_EXCEPTION(__func__ << ": TTransportException what: " << tx.what() << new_colp->cfname_);
+
+        if (batch.entries.empty()) {
+            continue;
+        }
+        if (batch.columns < batch_max_columns_ && next < entries.size()) {
+            continue;
+        }
+
+        // Wait for the oldest batch_mutate if the pipeline is full
+        if (pending.size() >= batch_max_outstanding_) {
+            ret_value = Db_BatchComplete(&pending.front(), &invalid, &retry);
+            if (!ret_value) {
+                break;
+            }
+            pending.pop_front();
+        }
+        ret_value = Db_BatchSend(mutation_map);
+        if (!ret_value) {
+            break;
+        }
+        pending.push_back(batch);
+        mutation_map.clear();
+        batch = CdbIfPendingBatch();
+    }
+
+    while (ret_value && !pending.empty()) {
+        ret_value = Db_BatchComplete(&pending.front(), &invalid, &retry);
+        if (ret_value) {
+            pending.pop_front();
+        }
+    }
+
+    size_t next_invalid = 0;
+    while (ret_value && next_invalid < invalid.size()) {
+        ret_value = Db_AddColumnSingle(invalid[next_invalid], &retry);
+        if (ret_value) {
+            next_invalid++;
         }
-    } else {
-        CDBIF_HANDLE_EXCEPTION(__func__ << ": No column info passed");
     }
 
-    /* allocated when enqueued, free it after processing */
-    delete cl;
+    if (!ret_value) {
+        for (size_t i = 0; i < pending.size(); i++) {
+            unsent->insert(unsent->end(), pending[i].entries.begin(),
+                           pending[i].entries.end());
+        }
+        unsent->insert(unsent->end(), batch.entries.begin(),
+                       batch.entries.end());
+        unsent->insert(unsent->end(), entries.begin() + next, entries.end());
+        unsent->insert(unsent->end(), invalid.begin() + next_invalid,
+                       invalid.end());
+    }
+    unsent->insert(unsent->end(), retry.begin(), retry.end());
+    return ret_value;
+}
+
+/*
+ * called by the WorkQueue mechanism with a batch of column lists. If the
+ * connection fails, the column lists that are not written are queued again,
+ * to be sent once the connection is back: the error handler marks the
+ * database down, which stops the queue until then. Column lists that got an
+ * unavailable or timed out reply are queued again as well, and false is
+ * returned to end the queue run
+ */
+bool CdbIf::Db_AsyncAddColumnBatch(const std::vector<CdbIfColList *>& entries) {
+    std::vector<CdbIfColList *> unsent;
+    bool ret_value = Db_AddColumnBatch(entries, &unsent);
+    if (unsent.empty()) {
+        return ret_value;
+    }
+    if (!cdbq_.get()) {
+        Db_DropEntries(unsent);
+        return ret_value;
+    }
+    batch_stats_.requeued += unsent.size();
+    for (size_t i = 0; i < unsent.size(); i++) {
+        cdbq_->Enqueue(unsent[i]);
+    }
+    // End the run, so that they are not sent again right away
+    return false;
+}
+
+/*
+ * called by AddColumnSync
+ */
+bool CdbIf::Db_AsyncAddColumn(CdbIfColList *cl) {
+    std::vector<CdbIfColList *> entries(1, cl), unsent;
+    bool ret_value = Db_AddColumnBatch(entries, &unsent);
+    Db_DropEntries(unsent);
     return ret_value;
 }
 
@@ -1013,6 +1302,37 @@ bool CdbIf::Db_GetQueueStats(uint64_t &queue_count, uint64_t &enqueues) const {
     return true;
 }
 
+bool CdbIf::Db_GetBatchStats(GenDb::DbBatchStats &stats) const {
+    stats.set_batches(batch_stats_.batches);
+    stats.set_entries(batch_stats_.entries);
+    stats.set_columns(batch_stats_.columns);
+    stats.set_errors(batch_stats_.errors);
+    stats.set_requeued(batch_stats_.requeued);
+    stats.set_dropped(batch_stats_.dropped);
+    std::vector<uint64_t> batch_size_hist, write_latency_hist;
+    for (int i = 0; i < kHistogramBuckets; i++) {
+        batch_size_hist.push_back(batch_stats_.batch_size_hist[i]);
+        write_latency_hist.push_back(batch_stats_.write_latency_hist[i]);
+    }
+    stats.set_batch_size_hist(batch_size_hist);
+    stats.set_write_latency_hist(write_latency_hist);
+    return true;
+}
+
+void CdbIf::Db_SetBatchLimits(size_t max_columns, size_t max_outstanding,
+        uint64_t max_latency_usecs) {
+    assert(max_columns > 0 && max_outstanding > 0);
+    batch_max_columns_ = max_columns;
+    batch_max_outstanding_ = max_outstanding;
+    batch_max_latency_usecs_ = max_latency_usecs;
+    if (cdbq_.get()) {
+        cdbq_->SetBatchCallback(
+            boost::bind(&CdbIf::Db_AsyncAddColumnBatch, this, _1),
+            batch_max_columns_ * batch_max_outstanding_);
+        cdbq_->set_target_latency_usecs(batch_max_latency_usecs_);
+    }
+}
+
 /* encode/decode for non-composite */
 std::string CdbIf::Db_encode_string_non_composite(const DbDataValue& value) {
     std::string output;
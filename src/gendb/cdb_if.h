@@ -16,6 +16,7 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/ptr_container/ptr_map.hpp>
 
+#include <tbb/atomic.h>
 #include <tbb/task.h>
 #include <tbb/mutex.h>
 
@@ -27,6 +28,7 @@
 #include "base/logging.h"
 #include "base/queue_task.h"
 #include "base/timer.h"
+#include "base/util.h"
 
 #define CDBIF_HANDLE_EXCEPTION_RETF(msg) \
     LOG(ERROR, msg); \
@@ -93,6 +95,30 @@ class CdbIf : public GenDbIf {
                 const GenDb::ColumnNameRange& crange,
                 const GenDb::DbDataValueVec& key);
         virtual bool Db_GetQueueStats(uint64_t &queue_count, uint64_t &enqueues) const;
+        virtual bool Db_GetBatchStats(GenDb::DbBatchStats &stats) const;
+
+        /*
+         * The queued column lists are coalesced per row key and column
+         * family into batch_mutate calls of up to max_columns columns, and
+         * up to max_outstanding calls are pipelined on the connection. A
+         * run of the queue task is bounded to about max_latency_usecs, 0
+         * leaves it unbounded.
+         */
+        virtual void Db_SetBatchLimits(size_t max_columns,
+                size_t max_outstanding, uint64_t max_latency_usecs);
+
+        /* times a column list is queued again after an unavailable or
+         * timed out reply before it is dropped */
+        static const int kBatchMaxRetries = 3;
+        static const int kHistogramBuckets = 24;
+
+    protected:
+        typedef std::map<std::string, std::map<std::string,
+                std::vector<org::apache::cassandra::Mutation> > > CdbIfMutationMap;
+
+        /* send and receive a batch_mutate on the connection, stubbed in tests */
+        virtual void Db_BatchMutateSend(const CdbIfMutationMap& mutation_map);
+        virtual void Db_BatchMutateRecv();
 
     private:
         friend class CdbIfTest;
@@ -158,9 +184,52 @@ class CdbIf : public GenDbIf {
          * structure for passing between sync and async add_column
          */
         struct CdbIfColList {
-            CdbIfColList(std::auto_ptr<GenDb::ColList> cl) : new_cl(cl) { }
+            CdbIfColList(std::auto_ptr<GenDb::ColList> cl) : new_cl(cl),
+                enqueue_time(UTCTimestampUsec()), timestamp(0), retries(0) { }
 
             std::auto_ptr<GenDb::ColList> new_cl;
+            uint64_t enqueue_time;
+            /* column time stamp, kept if the column list is sent again */
+            uint64_t timestamp;
+            /* unavailable or timed out replies so far */
+            int retries;
+        };
+
+        /*
+         * batch_mutate sent and not yet received. The column lists are kept
+         * until the reply so that they can be sent again if the connection
+         * fails
+         */
+        struct CdbIfPendingBatch {
+            CdbIfPendingBatch() : columns(0), enqueue_time(0) { }
+
+            std::vector<CdbIfColList *> entries;
+            size_t columns;
+            uint64_t enqueue_time; /* of the oldest column list */
+        };
+
+        struct CdbIfBatchStats {
+            CdbIfBatchStats() {
+                batches = 0;
+                entries = 0;
+                columns = 0;
+                errors = 0;
+                requeued = 0;
+                dropped = 0;
+                for (int i = 0; i < kHistogramBuckets; i++) {
+                    batch_size_hist[i] = 0;
+                    write_latency_hist[i] = 0;
+                }
+            }
+
+            tbb::atomic<uint64_t> batches;
+            tbb::atomic<uint64_t> entries;
+            tbb::atomic<uint64_t> columns;
+            tbb::atomic<uint64_t> errors;
+            tbb::atomic<uint64_t> requeued;
+            tbb::atomic<uint64_t> dropped;
+            tbb::atomic<uint64_t> batch_size_hist[kHistogramBuckets];
+            tbb::atomic<uint64_t> write_latency_hist[kHistogramBuckets];
         };
 
         bool DbDataTypeVecToCompositeType(std::string& res, const std::vector<GenDb::DbDataType::type>& db_type);
@@ -180,6 +249,22 @@ class CdbIf : public GenDbIf {
         bool ColListFromColumnOrSuper(GenDb::ColList&, std::vector<org::apache::cassandra::ColumnOrSuperColumn>&, const string&);
 
         bool Db_AsyncAddColumn(CdbIfColList *cl);
+        bool Db_AsyncAddColumnBatch(const std::vector<CdbIfColList *>& entries);
+        bool Db_AddColumnBatch(const std::vector<CdbIfColList *>& entries,
+                std::vector<CdbIfColList *> *unsent);
+        void Db_DropEntries(const std::vector<CdbIfColList *>& entries);
+        void Db_RetryEntries(const std::vector<CdbIfColList *>& entries,
+                std::vector<CdbIfColList *> *retry);
+        bool Db_AddMutations(CdbIfMutationMap *mutation_map,
+                GenDb::ColList *new_colp, uint64_t ts);
+        bool Db_AddColumnSingle(CdbIfColList *cl,
+                std::vector<CdbIfColList *> *retry);
+        bool Db_BatchSend(const CdbIfMutationMap& mutation_map);
+        bool Db_BatchComplete(CdbIfPendingBatch *batch,
+                std::vector<CdbIfColList *> *invalid,
+                std::vector<CdbIfColList *> *retry);
+        uint64_t Db_NextTimestamp();
+        static int HistogramBucket(uint64_t value);
         bool Db_Columnfamily_present(const std::string& cfname);
         bool Db_GetColumnfamily(CdbIfCfInfo **info, const std::string& cfname);
         bool Db_IsInitDone() const;
@@ -233,6 +318,12 @@ class CdbIf : public GenDbIf {
         std::string name_;
 
         int cassandra_ttl_;
+
+        size_t batch_max_columns_;
+        size_t batch_max_outstanding_;
+        uint64_t batch_max_latency_usecs_;
+        tbb::atomic<uint64_t> last_timestamp_;
+        CdbIfBatchStats batch_stats_;
 };
 
 #endif
@@ -17,3 +17,7 @@ GenDb::GenDbIf *GenDbIf::GenDbIfImpl(boost::asio::io_service *ioservice,
     return (new CdbIf(ioservice, hdlr, cassandra_ip, cassandra_port, analytics_ttl, name));
 }
 
+
+const size_t GenDbIf::kBatchMaxColumns;
+const size_t GenDbIf::kBatchMaxOutstanding;
+const uint64_t GenDbIf::kBatchMaxLatencyUsecs;
@@ -136,6 +136,16 @@ class GenDbIf {
                 const std::string& cfname, const ColumnNameRange& crange,
                 const DbDataValueVec& key) = 0;
         virtual bool Db_GetQueueStats(uint64_t &queue_count, uint64_t &enqueues) const = 0;
+        /* api to get the write batching statistics, if the backend batches */
+        virtual bool Db_GetBatchStats(DbBatchStats &stats) const { return false; }
+        /* api to set the write batching limits, if the backend batches */
+        virtual void Db_SetBatchLimits(size_t max_columns,
+                size_t max_outstanding, uint64_t max_latency_usecs) { }
+
+        /* default write batching limits */
+        static const size_t kBatchMaxColumns = 1024;
+        static const size_t kBatchMaxOutstanding = 4;
+        static const uint64_t kBatchMaxLatencyUsecs = 100000;
 
         static GenDbIf *GenDbIfImpl(boost::asio::io_service *ioservice, DbErrorHandler hdlr, 
                 std::string cassandra_ip, unsigned short cassandra_port, 
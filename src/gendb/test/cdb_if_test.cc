@@ -2,15 +2,79 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <boost/bind.hpp>
+
 #include "testing/gunit.h"
 #include "../cdb_if.h"
 #include "base/logging.h"
+#include "base/task.h"
+
+//
+// CdbIf with the batch_mutate calls recorded instead of sent to Cassandra.
+// Sends fail with a transport exception once fail_send is reached. Replies
+// are an invalid request for the batches with the invalid row key, and
+// unavailable for the next fail_recv ones.
+//
+class CdbIfStub : public CdbIf {
+public:
+    typedef CdbIfMutationMap MutationMap;
+
+    CdbIfStub() : outstanding_(0), max_outstanding_(0), fail_send_(-1),
+        received_(0), fail_recv_(0) {
+    }
+
+    virtual void Db_BatchMutateSend(const CdbIfMutationMap& mutation_map) {
+        if ((int) sent_.size() == fail_send_) {
+            throw TTransportException("stub send failure");
+        }
+        sent_.push_back(mutation_map);
+        outstanding_++;
+        max_outstanding_ = std::max(max_outstanding_, outstanding_);
+    }
+
+    virtual void Db_BatchMutateRecv() {
+        ASSERT_LT(0U, outstanding_);
+        outstanding_--;
+        const CdbIfMutationMap& mutation_map = sent_[received_++];
+        if (mutation_map.find(invalid_key_) != mutation_map.end()) {
+            throw InvalidRequestException();
+        }
+        if (fail_recv_ > 0) {
+            fail_recv_--;
+            throw UnavailableException();
+        }
+    }
+
+    const std::vector<CdbIfMutationMap>& sent() const { return sent_; }
+    size_t outstanding() const { return outstanding_; }
+    size_t max_outstanding() const { return max_outstanding_; }
+    void set_fail_send(int fail_send) { fail_send_ = fail_send; }
+    void set_invalid_key(const std::string& key) { invalid_key_ = key; }
+    void set_fail_recv(int fail_recv) { fail_recv_ = fail_recv; }
+
+private:
+    std::vector<CdbIfMutationMap> sent_;
+    size_t outstanding_;
+    size_t max_outstanding_;
+    int fail_send_;
+    size_t received_;
+    std::string invalid_key_;
+    int fail_recv_;
+};
 
 class CdbIfTest : public ::testing::Test {
 public:
+    typedef CdbIf::CdbIfColList ColListEntry;
 
     CdbIfTest() :
-        cdbif_(new CdbIf()) {
+        cdbif_(new CdbIfStub()), errors_(0) {
+        cdbif_->errhandler_ = boost::bind(&CdbIfTest::ErrorHandler, this);
+        std::string cfname("FlowTest");
+        GenDb::DbDataTypeVec key_type(1, GenDb::DbDataType::Unsigned32Type);
+        GenDb::DbDataTypeVec comp_type(1, GenDb::DbDataType::AsciiType);
+        GenDb::DbDataTypeVec valid_class(1, GenDb::DbDataType::Unsigned64Type);
+        cdbif_->CdbIfCfList.insert(cfname, new CdbIf::CdbIfCfInfo(new CfDef,
+            new GenDb::NewCf(cfname, key_type, comp_type, valid_class)));
     }
     ~CdbIfTest() {
         delete cdbif_;
@@ -20,6 +84,9 @@ public:
     }
 
     virtual void TearDown() {
+        if (cdbif_->cdbq_.get()) {
+            cdbif_->cdbq_->Shutdown();
+        }
     }
 
     CdbIf *cdbif() {
@@ -38,10 +105,273 @@ public:
         return cdbif_->Db_decode_Double_non_composite(testdouble_enc);
     }
 
-private:
-    CdbIf *cdbif_;
+    // Column list of the given row with a column per name.
+    ColListEntry *ColList(uint32_t row,
+                                 const std::vector<std::string>& names) {
+        std::auto_ptr<GenDb::ColList> col_list(new GenDb::ColList);
+        col_list->cfname_ = "FlowTest";
+        col_list->rowkey_.push_back(row);
+        for (size_t i = 0; i < names.size(); i++) {
+            GenDb::DbDataValueVec name(1, names[i]);
+            GenDb::DbDataValueVec value(1, (uint64_t) i);
+            col_list->columns_.push_back(GenDb::NewCol(name, value));
+        }
+        return new ColListEntry(col_list);
+    }
+
+    bool AddColumnBatch(const std::vector<ColListEntry *>& entries) {
+        return cdbif_->Db_AsyncAddColumnBatch(entries);
+    }
+
+    std::string RowKey(uint32_t row) {
+        std::string key;
+        GenDb::DbDataValueVec rowkey(1, row);
+        cdbif_->ConstructDbDataValueKey(key, "FlowTest", rowkey);
+        return key;
+    }
+
+    void ErrorHandler() { errors_++; }
+
+    // Queue of the column lists, which is not run since the database is
+    // not up.
+    void CreateQueue() {
+        cdbif_->cdbq_.reset(new WorkQueue<ColListEntry *>(
+            TaskScheduler::GetInstance()->GetTaskId("cdbif::Test"), 0,
+            boost::bind(&CdbIf::Db_AsyncAddColumn, cdbif_, _1),
+            boost::bind(&CdbIf::Db_IsInitDone, cdbif_)));
+    }
+
+    void DequeueAll(std::vector<ColListEntry *> *entries) {
+        ColListEntry *entry;
+        while (cdbif_->cdbq_->Dequeue(&entry)) {
+            entries->push_back(entry);
+        }
+    }
+
+    static uint32_t Row(const ColListEntry *entry) {
+        return boost::get<uint32_t>(entry->new_cl->rowkey_[0]);
+    }
+
+    int64_t Timestamp(const CdbIfStub::MutationMap& sent, uint32_t row) {
+        return sent.find(RowKey(row))->second.find("FlowTest")->second[0].
+            column_or_supercolumn.column.timestamp;
+    }
+
+protected:
+    CdbIfStub *cdbif_;
+    int errors_;
 };
 
+TEST_F(CdbIfTest, BatchCoalesce) {
+    std::vector<std::string> names;
+    names.push_back("a");
+    names.push_back("b");
+    std::vector<ColListEntry *> entries;
+    entries.push_back(ColList(1, names));
+    entries.push_back(ColList(2, names));
+    entries.push_back(ColList(1, names));
+    EXPECT_TRUE(AddColumnBatch(entries));
+
+    // One batch_mutate with the column lists of row 1 coalesced
+    ASSERT_EQ(1U, cdbif_->sent().size());
+    EXPECT_EQ(0U, cdbif_->outstanding());
+    const CdbIfStub::MutationMap& sent = cdbif_->sent()[0];
+    EXPECT_EQ(2U, sent.size());
+    ASSERT_TRUE(sent.find(RowKey(1)) != sent.end());
+    const std::vector<org::apache::cassandra::Mutation>& row1 =
+        sent.find(RowKey(1))->second.find("FlowTest")->second;
+    ASSERT_EQ(4U, row1.size());
+    // The later write of column a wins
+    EXPECT_EQ(row1[0].column_or_supercolumn.column.name,
+              row1[2].column_or_supercolumn.column.name);
+    EXPECT_LT(row1[0].column_or_supercolumn.column.timestamp,
+              row1[2].column_or_supercolumn.column.timestamp);
+
+    GenDb::DbBatchStats stats;
+    EXPECT_TRUE(cdbif_->Db_GetBatchStats(stats));
+    EXPECT_EQ(1U, stats.get_batches());
+    EXPECT_EQ(3U, stats.get_entries());
+    EXPECT_EQ(6U, stats.get_columns());
+    EXPECT_EQ(0U, stats.get_errors());
+    ASSERT_EQ((size_t) CdbIf::kHistogramBuckets,
+              stats.get_batch_size_hist().size());
+    EXPECT_EQ(1U, stats.get_batch_size_hist()[1]);
+}
+
+TEST_F(CdbIfTest, BatchPipeline) {
+    cdbif_->Db_SetBatchLimits(2, 2, 0);
+    std::vector<std::string> names(1, "a");
+    std::vector<ColListEntry *> entries;
+    for (uint32_t i = 0; i < 9; i++) {
+        entries.push_back(ColList(i, names));
+    }
+    EXPECT_TRUE(AddColumnBatch(entries));
+
+    // Batches of 2 columns and a last one of 1, 2 in flight at most
+    ASSERT_EQ(5U, cdbif_->sent().size());
+    EXPECT_EQ(2U, cdbif_->sent()[0].size());
+    EXPECT_EQ(1U, cdbif_->sent()[4].size());
+    EXPECT_EQ(2U, cdbif_->max_outstanding());
+    EXPECT_EQ(0U, cdbif_->outstanding());
+
+    GenDb::DbBatchStats stats;
+    EXPECT_TRUE(cdbif_->Db_GetBatchStats(stats));
+    EXPECT_EQ(5U, stats.get_batches());
+    EXPECT_EQ(9U, stats.get_entries());
+    EXPECT_EQ(4U, stats.get_batch_size_hist()[1]);
+    EXPECT_EQ(1U, stats.get_batch_size_hist()[0]);
+    uint64_t latencies = 0;
+    for (size_t i = 0; i < stats.get_write_latency_hist().size(); i++) {
+        latencies += stats.get_write_latency_hist()[i];
+    }
+    EXPECT_EQ(5U, latencies);
+}
+
+TEST_F(CdbIfTest, BatchSendFailure) {
+    cdbif_->Db_SetBatchLimits(1, 4, 0);
+    cdbif_->set_fail_send(2);
+    std::vector<std::string> names(1, "a");
+    std::vector<ColListEntry *> entries;
+    for (uint32_t i = 0; i < 4; i++) {
+        entries.push_back(ColList(i, names));
+    }
+    EXPECT_FALSE(AddColumnBatch(entries));
+
+    // The connection error is reported. Without a queue to put them back
+    // on, the column lists not acknowledged are dropped.
+    EXPECT_EQ(2U, cdbif_->sent().size());
+    EXPECT_EQ(1, errors_);
+    GenDb::DbBatchStats stats;
+    EXPECT_TRUE(cdbif_->Db_GetBatchStats(stats));
+    EXPECT_EQ(0U, stats.get_batches());
+    EXPECT_EQ(1U, stats.get_errors());
+    EXPECT_EQ(0U, stats.get_requeued());
+    EXPECT_EQ(4U, stats.get_dropped());
+}
+
+TEST_F(CdbIfTest, BatchSendFailureRequeue) {
+    CreateQueue();
+    cdbif_->Db_SetBatchLimits(1, 2, 0);
+    cdbif_->set_fail_send(3);
+    std::vector<std::string> names(1, "a");
+    std::vector<ColListEntry *> entries;
+    for (uint32_t i = 0; i < 6; i++) {
+        entries.push_back(ColList(i, names));
+    }
+    EXPECT_FALSE(AddColumnBatch(entries));
+
+    // Rows 0 and 1 are acknowledged, row 2 is in flight, the send of row 3
+    // fails and rows 4 and 5 are not processed. They are all queued again,
+    // in order, and nothing is lost.
+    ASSERT_EQ(3U, cdbif_->sent().size());
+    EXPECT_EQ(1, errors_);
+    GenDb::DbBatchStats stats;
+    EXPECT_TRUE(cdbif_->Db_GetBatchStats(stats));
+    EXPECT_EQ(2U, stats.get_batches());
+    EXPECT_EQ(4U, stats.get_requeued());
+    EXPECT_EQ(0U, stats.get_dropped());
+    EXPECT_EQ(4U, cdbif_->cdbq_->QueueCount());
+    std::vector<ColListEntry *> requeued;
+    DequeueAll(&requeued);
+    ASSERT_EQ(4U, requeued.size());
+    for (uint32_t i = 0; i < 4; i++) {
+        EXPECT_EQ(i + 2, Row(requeued[i]));
+    }
+    int64_t timestamp = Timestamp(cdbif_->sent()[2], 2);
+
+    // Once the connection is back they are all written, and the column
+    // sent twice keeps its time stamp
+    cdbif_->set_fail_send(-1);
+    EXPECT_TRUE(AddColumnBatch(requeued));
+    ASSERT_EQ(7U, cdbif_->sent().size());
+    EXPECT_EQ(timestamp, Timestamp(cdbif_->sent()[3], 2));
+    for (uint32_t i = 0; i < 4; i++) {
+        EXPECT_TRUE(cdbif_->sent()[3 + i].find(RowKey(i + 2)) !=
+                    cdbif_->sent()[3 + i].end());
+    }
+    EXPECT_TRUE(cdbif_->Db_GetBatchStats(stats));
+    EXPECT_EQ(6U, stats.get_batches());
+    EXPECT_EQ(6U, stats.get_entries());
+    EXPECT_EQ(0U, cdbif_->cdbq_->QueueCount());
+}
+
+TEST_F(CdbIfTest, BatchInvalidRequest) {
+    cdbif_->Db_SetBatchLimits(2, 2, 0);
+    cdbif_->set_invalid_key(RowKey(2));
+    std::vector<std::string> names(1, "a");
+    std::vector<ColListEntry *> entries;
+    for (uint32_t i = 0; i < 4; i++) {
+        entries.push_back(ColList(i, names));
+    }
+    EXPECT_TRUE(AddColumnBatch(entries));
+
+    // The batch of rows 2 and 3 is rejected, the rows are then sent one by
+    // one and only row 2 is dropped
+    ASSERT_EQ(4U, cdbif_->sent().size());
+    EXPECT_EQ(1U, cdbif_->sent()[2].size());
+    EXPECT_TRUE(cdbif_->sent()[2].find(RowKey(2)) != cdbif_->sent()[2].end());
+    EXPECT_TRUE(cdbif_->sent()[3].find(RowKey(3)) != cdbif_->sent()[3].end());
+    EXPECT_EQ(0, errors_);
+    GenDb::DbBatchStats stats;
+    EXPECT_TRUE(cdbif_->Db_GetBatchStats(stats));
+    EXPECT_EQ(2U, stats.get_batches());
+    EXPECT_EQ(3U, stats.get_entries());
+    EXPECT_EQ(2U, stats.get_errors());
+    EXPECT_EQ(1U, stats.get_dropped());
+    EXPECT_EQ(0U, stats.get_requeued());
+}
+
+TEST_F(CdbIfTest, BatchUnavailableRequeue) {
+    CreateQueue();
+    cdbif_->Db_SetBatchLimits(2, 2, 0);
+    cdbif_->set_fail_recv(1);
+    std::vector<std::string> names(1, "a");
+    std::vector<ColListEntry *> entries;
+    for (uint32_t i = 0; i < 4; i++) {
+        entries.push_back(ColList(i, names));
+    }
+    EXPECT_FALSE(AddColumnBatch(entries));
+
+    // The first batch is unavailable and queued again, the connection is
+    // not reported down
+    ASSERT_EQ(2U, cdbif_->sent().size());
+    EXPECT_EQ(0, errors_);
+    GenDb::DbBatchStats stats;
+    EXPECT_TRUE(cdbif_->Db_GetBatchStats(stats));
+    EXPECT_EQ(1U, stats.get_batches());
+    EXPECT_EQ(2U, stats.get_requeued());
+    EXPECT_EQ(0U, stats.get_dropped());
+    std::vector<ColListEntry *> requeued;
+    DequeueAll(&requeued);
+    ASSERT_EQ(2U, requeued.size());
+    EXPECT_EQ(0U, Row(requeued[0]));
+    EXPECT_EQ(1U, Row(requeued[1]));
+    int64_t timestamp = Timestamp(cdbif_->sent()[0], 0);
+
+    // Sent again with their time stamps
+    EXPECT_TRUE(AddColumnBatch(requeued));
+    ASSERT_EQ(3U, cdbif_->sent().size());
+    EXPECT_EQ(timestamp, Timestamp(cdbif_->sent()[2], 0));
+    EXPECT_TRUE(cdbif_->Db_GetBatchStats(stats));
+    EXPECT_EQ(2U, stats.get_batches());
+    EXPECT_EQ(4U, stats.get_entries());
+
+    // Dropped once retried kBatchMaxRetries times
+    entries.clear();
+    entries.push_back(ColList(4, names));
+    cdbif_->set_fail_recv(CdbIf::kBatchMaxRetries + 1);
+    for (int i = 0; i < CdbIf::kBatchMaxRetries; i++) {
+        EXPECT_FALSE(AddColumnBatch(entries));
+        entries.clear();
+        DequeueAll(&entries);
+        ASSERT_EQ(1U, entries.size());
+    }
+    EXPECT_TRUE(AddColumnBatch(entries));
+    EXPECT_EQ(0U, cdbif_->cdbq_->QueueCount());
+    EXPECT_TRUE(cdbif_->Db_GetBatchStats(stats));
+    EXPECT_EQ(1U, stats.get_dropped());
+}
+
 TEST_F(CdbIfTest, Test1) {
     std::string teststrs[] = {"Test String1",
             "Test:Str :ing :2"};
@@ -78,6 +408,8 @@ TEST_F(CdbIfTest, Test1) {
 int main(int argc, char **argv) {
     LoggingInit();
     ::testing::InitGoogleTest(&argc, argv);
-    return RUN_ALL_TESTS();
+    int result = RUN_ALL_TESTS();
+    TaskScheduler::GetInstance()->Terminate();
+    return result;
 }
 
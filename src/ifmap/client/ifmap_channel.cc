@@ -3,6 +3,7 @@
  */
 
 #include "ifmap_channel.h"
+#include <algorithm>
 #include <sstream>
 #include <string>
 
@@ -43,6 +44,7 @@
 
 const int IFMapChannel::kSocketCloseTimeout = 2;
 const uint64_t IFMapChannel::kRetryConnectionMax = 2;
+const size_t IFMapChannel::kPollChunkSize;
 
 using namespace boost::assign;
 using namespace std;
@@ -123,7 +125,8 @@ IFMapChannel::IFMapChannel(IFMapManager *manager, const std::string& user,
       ssrc_socket_(new SslStream((*manager->io_service()), ctx_)),
       arc_socket_(new SslStream((*manager->io_service()), ctx_)),
       username_(user), password_(passwd), state_machine_(NULL),
-      response_state_(NONE), sequence_number_(0), recv_msg_cnt_(0),
+      response_state_(NONE), poll_remaining_(0), poll_first_(false),
+      poll_result_(false), sequence_number_(0), recv_msg_cnt_(0),
       sent_msg_cnt_(0), reconnect_attempts_(0), connection_status_(NOCONN),
       connection_status_change_at_(UTCTimestampUsec()) {
 
@@ -486,39 +489,70 @@ void IFMapChannel::PollResponseWait() {
                     boost::asio::placeholders::bytes_transferred));
 }
 
+// The longest string searched for across chunks, less one byte.
+static const size_t kPollTailSize = sizeof("endSessionResult") - 2;
+
 int IFMapChannel::ReadPollResponse() {
 
     CHECK_CONCURRENCY("ifmap::StateMachine");
-    // Append the new bytes read, if any, to the stringstream
+    // Append the new bytes read, if any, to the chunk
     IFMAP_DEBUG(IFMapServerConnection, "IFMapChannel::ReadPollResponse",
                 GetSizeAsString(reply_.size(), " bytes in reply_. "));
-    reply_ss_ << &reply_;
-    std::string reply_str = reply_ss_.str();
+    size_t read_size = reply_.size();
+    poll_chunk_.append(boost::asio::buffers_begin(reply_.data()),
+                       boost::asio::buffers_end(reply_.data()));
+    reply_.consume(read_size);
+    poll_remaining_ -= std::min(read_size, poll_remaining_);
     IFMAP_LOG_POLL_RESP(IFMapServerConnection,
-                   GetSizeAsString(reply_.size(), " bytes in reply_. ") +
-                   GetSizeAsString(reply_str.size(), " bytes in reply_str. ") +
-                   "PollResponse message is: \n", reply_str);
-
-    // all possible responses, 3.7.5
-    if ((reply_str.find("errorResult") != string::npos) ||
-        (reply_str.find("endSessionResult") != string::npos)) {
+                   GetSizeAsString(poll_chunk_.size(), " bytes in chunk. ") +
+                   GetSizeAsString(poll_remaining_, " bytes to read. ") +
+                   "PollResponse message is: \n", poll_chunk_);
+
+    // all possible responses, 3.7.5. The strings may span 2 chunks.
+    std::string scan_str(poll_tail_ + poll_chunk_);
+    if ((scan_str.find("errorResult") != string::npos) ||
+        (scan_str.find("endSessionResult") != string::npos)) {
         IFMAP_WARN(IFMapServerConnection, 
                    "Error received instead of PollResult. Quitting.", "");
-        return -1;
-    } else if (reply_str.find(string("pollResult")) != string::npos) {
-        size_t pos = reply_str.find(string("<?xml version="));
-        assert(pos != string::npos);
-        string poll_string = reply_str.substr(pos);
-        increment_recv_msg_cnt();
-        if (manager_->pollreadcb()) {
-            (manager_->pollreadcb())(poll_string.c_str(), poll_string.length(),
+        poll_chunk_.clear();
+        // Let the parser drop the part of the response it was given. The
+        // items that ended in the earlier chunks stay applied.
+        if (!poll_first_ && manager_->pollreadcb()) {
+            (manager_->pollreadcb())(NULL, 0, false, true, true,
                                      sequence_number_);
         }
-        response_state_ = NONE;
-        return 0;
-    } else {
-        assert(0);
+        return -1;
     }
+    if (scan_str.find("pollResult") != string::npos) {
+        poll_result_ = true;
+    }
+    poll_tail_ = scan_str.substr(scan_str.size() -
+                                 std::min(scan_str.size(), kPollTailSize));
+
+    bool last = (poll_remaining_ == 0);
+    if (last) {
+        assert(poll_result_);
+    }
+    if (manager_->pollreadcb()) {
+        (manager_->pollreadcb())(poll_chunk_.data(), poll_chunk_.size(),
+                                 poll_first_, last, false, sequence_number_);
+    }
+    poll_first_ = false;
+    poll_chunk_.clear();
+
+    if (!last) {
+        // Read the next chunk of the body
+        size_t bytes_to_read = std::min(poll_remaining_, kPollChunkSize);
+        boost::asio::async_read(*arc_socket_.get(), reply_,
+            boost::asio::transfer_exactly(bytes_to_read),
+            boost::bind(&IFMapStateMachine::ProcPollResponseRead,
+                        state_machine_, boost::asio::placeholders::error,
+                        boost::asio::placeholders::bytes_transferred));
+        return 1;
+    }
+    increment_recv_msg_cnt();
+    response_state_ = NONE;
+    return 0;
 }
 
 void IFMapChannel::ProcResponse(const boost::system::error_code& error,
@@ -583,6 +617,20 @@ void IFMapChannel::ProcResponse(const boost::system::error_code& error,
                 "Content length is", content_len,
                 "Total bytes read are", reply_str.length());
 
+    // The body of a poll response is handed to the parser in chunks as it
+    // is read, starting with the bytes read along with the header.
+    if (response_state_ == POLLRESPONSE) {
+        size_t body_read = reply_str.length() - header_length;
+        poll_chunk_ = reply_str.substr(header_length);
+        poll_tail_.clear();
+        poll_remaining_ = (content_len > (int) body_read) ?
+                          content_len - body_read : 0;
+        poll_first_ = true;
+        poll_result_ = false;
+        callback(error, header_length);
+        return;
+    }
+
     // If both header and body are completely read, goto the next state
     if ((header_length + content_len) == reply_str.length()) {
         callback(error, header_length);
@@ -83,6 +83,9 @@ public:
 
     virtual void PollResponseWait();
 
+    // Hand the body of the poll response read so far to the parser. Returns
+    // 0 once the whole response is read, 1 if there is more to read and -1
+    // for failure.
     virtual int ReadPollResponse();
 
     void ProcResponse(const boost::system::error_code& error,
@@ -176,6 +179,7 @@ private:
     static const int kSessionKeepaliveIdleTime = 60; // in seconds
     static const int kSessionKeepaliveInterval = 3; // in seconds
     static const int kSessionKeepaliveProbes = 5; // count
+    static const size_t kPollChunkSize = 64 * 1024;
 
     enum ResponseState {
         NONE = 0,
@@ -217,6 +221,11 @@ private:
     boost::asio::streambuf reply_;
     std::ostringstream reply_ss_;
     ResponseState response_state_;
+    std::string poll_chunk_;        // body read since the last chunk
+    std::string poll_tail_;         // end of the last chunk
+    size_t poll_remaining_;         // bytes of the body still to read
+    bool poll_first_;
+    bool poll_result_;
     uint64_t sequence_number_;
     uint64_t recv_msg_cnt_;
     uint64_t sent_msg_cnt_;
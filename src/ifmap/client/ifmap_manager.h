@@ -22,8 +22,14 @@ class PeerIFMapServerFinder;
 // This class is the window to the ifmap server for the rest of the system
 class IFMapManager {
 public:
-    typedef boost::function<void(const char *data, size_t length,
-                                 uint64_t sequence_number)> PollReadCb;
+    // Called with the chunks of the body of a poll response as they are
+    // read. first is set for the first chunk of a response and last for its
+    // last one. If the response turns out to be an error after some chunks
+    // were passed on, it is called with no data and last and aborted set.
+    typedef boost::function<void(const char *data, size_t length, bool first,
+                                 bool last, bool aborted,
+                                 uint64_t sequence_number)>
+        PollReadCb;
 
     IFMapManager();
     IFMapManager(IFMapServer *ifmap_server, const std::string& url,
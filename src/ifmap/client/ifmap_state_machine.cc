@@ -636,11 +636,14 @@ struct PollResponseWait :
         sm->channel()->PollResponseWait();
     }
     sc::result react(const EvReadSuccess &event) {
-        // the header of the response to 'poll' has been read successfully
+        // a chunk of the response to 'poll' has been read successfully
         IFMapStateMachine *sm = &context<IFMapStateMachine>();
-        int failure = sm->channel()->ReadPollResponse();
-        if (failure) {
+        int result = sm->channel()->ReadPollResponse();
+        if (result < 0) {
             return transit<SsrcStart>();
+        } else if (result > 0) {
+            // the rest of the response is being read
+            return discard_event();
         } else {
             return transit<SendPoll>();
         }
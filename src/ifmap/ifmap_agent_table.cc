@@ -43,10 +43,7 @@ IFMapNode* IFMapAgentTable::TableEntryLookup(DB *db, RequestKey *key) {
         return NULL;
     }
 
-    auto_ptr<DBEntry> entry(new IFMapNode(table));
-    entry->SetKey(key);
-    IFMapNode *node = static_cast<IFMapNode *>(table->Find(entry.get()));
-    return node;
+    return table->FindNode(key->id_name);
 }
 
 
@@ -60,9 +57,7 @@ IFMapAgentTable* IFMapAgentTable::TableFind(const string &node_name) {
 }
 
 IFMapNode *IFMapAgentTable::EntryLookup(RequestKey *request) {
-    auto_ptr<DBEntry> key(AllocEntry(request));
-    IFMapNode *node = static_cast<IFMapNode *>(Find(key.get()));
-    return node;
+    return FindNode(request->id_name);
 }
 
 IFMapNode *IFMapAgentTable::EntryLocate(IFMapNode *node, RequestKey *req) {
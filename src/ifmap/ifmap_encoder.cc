@@ -5,6 +5,7 @@
 #include "ifmap/ifmap_encoder.h"
 
 #include <sstream>
+#include <pugixml/pugixml.hpp>
 #include "ifmap/ifmap_link.h"
 #include "ifmap/ifmap_object.h"
 #include "ifmap/ifmap_update.h"
@@ -14,88 +15,139 @@ using namespace std;
 
 IFMapMessage::IFMapMessage() : op_type_(NONE), node_count_(0),
     objects_per_message_(kObjectsPerMessage) {
-    // init empty document
-    Open();
 }
 
-void IFMapMessage::Open() {
-    xml_node iq = doc_.append_child("iq");
-    // set iq (type, from, to) attributes
-    iq.append_attribute("type") = "set";
-    iq.append_attribute("from") = "network-control@contrailsystems.com"; 
-    iq.append_attribute("to") = "";
-    config_ = iq.append_child("config");
+// Escape the value of an attribute like pugixml does.
+static void AppendEscaped(string *out, const string &value) {
+    for (string::const_iterator it = value.begin(); it != value.end(); ++it) {
+        unsigned char ch = *it;
+        switch (ch) {
+        case '&':
+            *out += "&amp;";
+            break;
+        case '<':
+            *out += "&lt;";
+            break;
+        case '>':
+            *out += "&gt;";
+            break;
+        case '"':
+            *out += "&quot;";
+            break;
+        default:
+            if (ch < 32) {
+                // pugixml writes the code of control characters with 2
+                // digits.
+                *out += "&#";
+                *out += static_cast<char>('0' + ch / 10);
+                *out += static_cast<char>('0' + ch % 10);
+                *out += ';';
+            } else {
+                *out += ch;
+            }
+            break;
+        }
+    }
+}
+
+// Append the end tag of the current op.
+void IFMapMessage::AppendOpEnd(string *str) const {
+    if (op_type_ == UPDATE) {
+        *str += "\t\t</update>\n";
+    } else if (op_type_ == DELETE) {
+        *str += "\t\t</delete>\n";
+    }
 }
 
 void IFMapMessage::Close() {
-    ostringstream oss;
-    doc_.save(oss);
-    str_ = oss.str();
+    str_.clear();
+    str_.reserve(body_.size() + receiver_.size() + 160);
+    str_ += "<?xml version=\"1.0\"?>\n";
+    str_ += "<iq type=\"set\" from=\"network-control@contrailsystems.com\"";
+    str_ += " to=\"";
+    str_ += receiver_;
+    str_ += "\">\n";
+    if (body_.empty()) {
+        str_ += "\t<config />\n";
+    } else {
+        str_ += "\t<config>\n";
+        str_ += body_;
+        AppendOpEnd(&str_);
+        str_ += "\t</config>\n";
+    }
+    str_ += "</iq>\n";
+    stats_.messages++;
+    stats_.bytes += str_.size();
 }
 
 void IFMapMessage::SetReceiverInMsg(const std::string &cli_identifier) {
-    xml_node iq = doc_.child("iq");
-    assert(iq);
-    xml_attribute iqattr = iq.attribute("to");
-    assert(iqattr);
-    std::string str(cli_identifier);
-    str += "/config";
-    iqattr.set_value(str.c_str());
+    receiver_.clear();
+    AppendEscaped(&receiver_, cli_identifier);
+    receiver_ += "/config";
 }
 
 void IFMapMessage::SetObjectsPerMessage(int num) {
     objects_per_message_ = num;
 }
 
-void IFMapMessage::EncodeUpdate(const IFMapUpdate *update) {
+void IFMapMessage::EncodeUpdate(IFMapUpdate *update) {
     // update is either of type UPDATE OR DELETE
-    if (update->IsUpdate()) {
-        if (op_type_ != UPDATE) {
-            op_node_ = config_.append_child("update");
-            op_type_ = UPDATE;
-        }
-        if (update->data().type == IFMapObjectPtr::NODE) {
-            EncodeNode(update);
-        } else if (update->data().type == IFMapObjectPtr::LINK) {
-            EncodeLink(update);
-        } else {
-            assert(0);
-        }
+    Op op = update->IsUpdate() ? UPDATE : DELETE;
+    if (op_type_ != op) {
+        AppendOpEnd(&body_);
+        body_ += (op == UPDATE) ? "\t\t<update>\n" : "\t\t<delete>\n";
+        op_type_ = op;
+    }
+    if (update->encoded().empty()) {
+        EncodeFragment(update);
+        stats_.fragment_misses++;
+        stats_.fragment_bytes += update->encoded().size();
     } else {
-        if (op_type_ != DELETE) {
-            op_node_ = config_.append_child("delete");
-            op_type_ = DELETE;
-        }
-        if (update->data().type == IFMapObjectPtr::NODE) {
-            EncodeNode(update);
-        } else if (update->data().type == IFMapObjectPtr::LINK) {
-            EncodeLink(update);
-        } else {
-            assert(0);
-        }
+        stats_.fragment_hits++;
+    }
+    body_ += update->encoded();
+
+    // A link counts as 2 objects.
+    if (update->data().type == IFMapObjectPtr::LINK) {
+        node_count_++;
     }
     node_count_++;
 }
 
-void IFMapMessage::EncodeNode(const IFMapUpdate *update) {
-    IFMapNode *node = update->data().u.node;
-    if (update->IsUpdate()) {
-        node->EncodeNodeDetail(&op_node_);
+//
+// Encode the objects of the update under an op node of a document of their
+// own, and keep their text indented at the depth that they have in the
+// message.
+//
+void IFMapMessage::EncodeFragment(IFMapUpdate *update) {
+    xml_document doc;
+    xml_node op_node =
+        doc.append_child(update->IsUpdate() ? "update" : "delete");
+
+    if (update->data().type == IFMapObjectPtr::NODE) {
+        IFMapNode *node = update->data().u.node;
+        if (update->IsUpdate()) {
+            node->EncodeNodeDetail(&op_node);
+        } else {
+            node->EncodeNode(&op_node);
+        }
+    } else if (update->data().type == IFMapObjectPtr::LINK) {
+        xml_node link_node = op_node.append_child("link");
+        const IFMapLink *link = update->data().u.link;
+        IFMapNode::EncodeNode(link->left_id(), &link_node);
+        IFMapNode::EncodeNode(link->right_id(), &link_node);
+        //link->EncodeLinkInfo(&link_node);
     } else {
-        node->EncodeNode(&op_node_);
-    }    
-}
-
-void IFMapMessage::EncodeLink(const IFMapUpdate *update) {
-    xml_node link_node = op_node_.append_child("link");
-
-    const IFMapLink *link = update->data().u.link;
-
-    IFMapNode::EncodeNode(link->left_id(), &link_node);
-    IFMapNode::EncodeNode(link->right_id(), &link_node);
-    //link->EncodeLinkInfo(&link_node);
+        assert(0);
+    }
 
-    node_count_++;
+    // iq, config and the op are above the objects.
+    ostringstream oss;
+    for (xml_node child = op_node.first_child(); child;
+         child = child.next_sibling()) {
+        child.print(oss, "\t", format_default, encoding_auto, 3);
+    }
+    update->set_encoded(oss.str());
 }
 
 bool IFMapMessage::IsFull() {
@@ -107,10 +159,9 @@ bool IFMapMessage::IsEmpty() {
 }
 
 void IFMapMessage::Reset() {
-    doc_.reset();
+    body_.clear();
     node_count_ = 0;
     op_type_ = NONE;
-    Open();
 }
 
 const char * IFMapMessage::c_str() const {
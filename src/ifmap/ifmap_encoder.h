@@ -5,27 +5,50 @@
 #ifndef __ctrlplane__ifmap_encoder__
 #define __ctrlplane__ifmap_encoder__
 
-#include <pugixml/pugixml.hpp>
+#include <stdint.h>
+#include <string>
 
 class IFMapNode;
 class IFMapLink;
 class IFMapUpdate;
 
+//
+// The xml text of the objects in a message is encoded once per update and
+// kept in the update, so that the clients that receive the update, in this
+// message or in later ones, share the same text. A message is the text of
+// its updates grouped by op, and Close() wraps it in the envelope of the
+// receiver. The text is the same as the one pugixml saves for the document
+// with all the objects.
+//
 class IFMapMessage {
 public:
     static const int kObjectsPerMessage = 16;
+
+    struct Stats {
+        Stats() : messages(0), fragment_hits(0), fragment_misses(0),
+            fragment_bytes(0), bytes(0) {
+        }
+        uint64_t messages;          // messages closed, one per receiver
+        uint64_t fragment_hits;     // updates with their text already encoded
+        uint64_t fragment_misses;   // updates encoded
+        uint64_t fragment_bytes;    // bytes of the updates encoded
+        uint64_t bytes;             // bytes of the messages closed
+    };
+
     IFMapMessage();
 
     void Close();
     // set the 'to' field in the message
     void SetReceiverInMsg(const std::string &cli_identifier);
     void SetObjectsPerMessage(int num);
-    void EncodeUpdate(const IFMapUpdate *update);
+    // Encode the update, unless it already has its text.
+    void EncodeUpdate(IFMapUpdate *update);
     bool IsFull();
     bool IsEmpty();
     void Reset();
 
     const char *c_str() const;
+    const Stats &stats() const { return stats_; }
 
 private:
     enum Op {
@@ -33,17 +56,16 @@ private:
         UPDATE,
         DELETE
     };
-    void Open();
-    void EncodeNode(const IFMapUpdate *update);
-    void EncodeLink(const IFMapUpdate *update);
-
-    pugi::xml_document doc_;
-    pugi::xml_node config_;
-    Op op_type_;             // the current  type of op_node_
-    pugi::xml_node op_node_;
+    void AppendOpEnd(std::string *str) const;
+    static void EncodeFragment(IFMapUpdate *update);
+
+    std::string receiver_;   // escaped 'to' field
+    std::string body_;       // the ops and their objects
+    Op op_type_;             // the current type of op in body_
     std::string str_;
     int node_count_;
     int objects_per_message_;
+    Stats stats_;
 };
 
 #endif /* defined(__ctrlplane__ifmap_encoder__) */
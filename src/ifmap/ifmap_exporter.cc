@@ -162,6 +162,10 @@ bool IFMapExporter::UpdateAddChange(ObjectType *obj, IFMapState *state,
     IFMapUpdate *update = state->GetUpdate(IFMapListEntry::UPDATE);
     if (update != NULL) {
         update->AdvertiseReset(rm_set);
+        // The object may differ from the text encoded for the update.
+        if (change) {
+            update->ClearEncoded();
+        }
     }
 
     if (state->interest().empty()) {
@@ -504,7 +508,7 @@ void IFMapExporter::LinkTableExport(DBTablePartBase *partition,
         BitSet interest = s_left->interest() & s_right->interest();
         IFMAP_DEBUG(LinkOper, "LinkRemove", left->ToString(), right->ToString(),
             s_left->interest().ToString(), s_right->interest().ToString());
-        walker_->LinkRemove(interest);
+        walker_->LinkRemove(left, right, interest);
 
         state->RemoveDependency();
         state->ClearValid();
@@ -64,13 +64,45 @@ class GraphPropagateFilter : public DBGraph::VisitorFilter {
     const BitSet &bset_;
 };
 
+// Restricts a walk to the nodes that have at least one of the interest bits
+// of bset.
+class GraphRegionFilter : public DBGraph::VisitorFilter {
+  public:
+    GraphRegionFilter(IFMapExporter *exporter,
+                      const IFMapTypenameWhiteList *type_filter,
+                      const BitSet &bitset)
+            : exporter_(exporter),
+              type_filter_(type_filter),
+              bset_(bitset) {
+    }
+
+    bool VertexFilter(const DBGraphVertex *vertex) const {
+        if (!type_filter_->VertexFilter(vertex)) {
+            return false;
+        }
+        const IFMapNode *node = static_cast<const IFMapNode *>(vertex);
+        const DBTable *table = node->table();
+        const IFMapNodeState *state = static_cast<const IFMapNodeState *>(
+            node->GetState(table, exporter_->TableListenerId(table)));
+        return (state != NULL && state->interest().intersects(bset_));
+    }
+
+    bool EdgeFilter(const DBGraphVertex *source, const DBGraphVertex *target,
+                    const DBGraphEdge *edge) const {
+        return type_filter_->EdgeFilter(source, target, edge);
+    }
+
+  private:
+    IFMapExporter *exporter_;
+    const IFMapTypenameWhiteList *type_filter_;
+    const BitSet &bset_;
+};
+
 IFMapGraphWalker::IFMapGraphWalker(DBGraph *graph, IFMapExporter *exporter)
     : graph_(graph),
       exporter_(exporter),
       work_queue_(TaskScheduler::GetInstance()->GetTaskId("db::DBTable"), 0,
                   boost::bind(&IFMapGraphWalker::Worker, this, _1)) {
-    work_queue_.SetExitCallback(
-        boost::bind(&IFMapGraphWalker::WorkBatchEnd, this, _1));
     traversal_white_list_.reset(new IFMapTypenameWhiteList());
     AddNodesToWhitelist();
     AddLinksToWhitelist();
@@ -118,9 +150,14 @@ void IFMapGraphWalker::LinkAdd(IFMapNode *lnode, const BitSet &lhs,
     }
 }
 
-void IFMapGraphWalker::LinkRemove(const BitSet &bset) {
+void IFMapGraphWalker::LinkRemove(IFMapNode *lnode, IFMapNode *rnode,
+                                  const BitSet &bset) {
     QueueEntry entry;
     entry.set = bset;
+    entry.ltable = lnode->table();
+    entry.lname = lnode->name();
+    entry.rtable = rnode->table();
+    entry.rname = rnode->name();
     work_queue_.Enqueue(entry);
 }
 
@@ -134,39 +171,158 @@ bool IFMapGraphWalker::FilterNeighbor(IFMapNode *lnode, IFMapNode *rnode) {
     return false;
 }
 
-void IFMapGraphWalker::RecomputeInterest(DBGraphVertex *vertex, int bit) {
+// Returns the state of the node if its interest has the bit set.
+IFMapNodeState *IFMapGraphWalker::InterestState(IFMapNode *node, int bit) {
+    IFMapNodeState *state = exporter_->NodeStateLookup(node);
+    if (state == NULL || !state->interest().test(bit)) {
+        return NULL;
+    }
+    return state;
+}
+
+void IFMapGraphWalker::AddToRegion(DBGraphVertex *vertex, NodeSet *region,
+                                   NodeList *list) {
     IFMapNode *node = static_cast<IFMapNode *>(vertex);
-    IFMapNodeState *state = exporter_->NodeStateLocate(node);
-    state->nmask_set(bit);
+    if (region->insert(node).second) {
+        list->push_back(node);
+    }
 }
 
-bool IFMapGraphWalker::Worker(QueueEntry work_entry) {
-    const BitSet &bset = work_entry.set;
-    IFMapServer *server = exporter_->server();
-    for (size_t i = bset.find_first(); i != BitSet::npos;
-         i = bset.find_next(i)) {
-        IFMapClient *client = server->GetClient(i);
-        if (client == NULL) {
+// Add the nodes reachable from target that have any of the bits in bset to
+// the region. Only the side of the removed link that was reached through it
+// is walked. If the source node is gone the direction of the link is not
+// known and target is walked regardless.
+void IFMapGraphWalker::CollectRegion(IFMapNode *source, IFMapNode *target,
+                                     const BitSet &bset, NodeSet *region,
+                                     NodeList *list) {
+    if (target == NULL || target->IsDeleted() || !target->IsVertexValid()) {
+        return;
+    }
+    if (source != NULL && !source->IsDeleted() &&
+        FilterNeighbor(source, target)) {
+        return;
+    }
+    GraphRegionFilter filter(exporter_, traversal_white_list_.get(), bset);
+    if (!filter.VertexFilter(target)) {
+        return;
+    }
+    graph_->Visit(target,
+        boost::bind(&IFMapGraphWalker::AddToRegion, this, _1, region, list),
+        0, filter);
+}
+
+// A node of the region keeps the interest bit if a node outside of the
+// region that has the bit links to it. Nodes outside of the region that
+// have the bit are not reached through the removed link and keep it.
+bool IFMapGraphWalker::IsAnchor(IFMapNode *node, int bit,
+                                const NodeSet &region) {
+    for (DBGraphVertex::edge_iterator iter = node->edge_list_begin(graph_);
+         iter != node->edge_list_end(graph_); ++iter) {
+        if (iter->IsDeleted()) {
+            continue;
+        }
+        IFMapNode *source = static_cast<IFMapNode *>(iter.target());
+        if (region.find(source) != region.end() || source->IsDeleted()) {
             continue;
         }
-        // TODO: In order to handle interest based on the vswitch registration
-        // there need to be links in the graph that correspond to these.
+        if (!traversal_white_list_->VertexFilter(source) ||
+            !traversal_white_list_->EdgeFilter(source, node, &*iter)) {
+            continue;
+        }
+        if (InterestState(source, bit) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Set the bit in the nmask of the nodes of the region that are still reached
+// from the virtual-router of the client: the anchors and the nodes of the
+// region reachable from them.
+void IFMapGraphWalker::RecomputeInterest(const NodeSet &region,
+                                         const NodeList &list, int bit) {
+    IFMapServer *server = exporter_->server();
+    IFMapClient *client = server->GetClient(bit);
+    IFMapNode *root = NULL;
+    if (client != NULL) {
         IFMapTable *table = IFMapTable::FindTable(server->database(),
                                                   "virtual-router");
-        IFMapNode *node = table->FindNode(client->identifier());
-        if ((node != NULL) && node->IsVertexValid()) {
-            graph_->Visit(node,
-                boost::bind(&IFMapGraphWalker::RecomputeInterest, this, _1, i),
-                0, *traversal_white_list_.get());
+        root = table->FindNode(client->identifier());
+    }
+
+    NodeList work;
+    for (NodeList::const_iterator iter = list.begin(); iter != list.end();
+         ++iter) {
+        IFMapNode *node = *iter;
+        IFMapNodeState *state = InterestState(node, bit);
+        if (state == NULL) {
+            continue;
+        }
+        if (node == root || IsAnchor(node, bit, region)) {
+            state->nmask_set(bit);
+            work.push_back(node);
         }
     }
-    rm_mask_ |= work_entry.set;
+
+    while (!work.empty()) {
+        IFMapNode *node = work.back();
+        work.pop_back();
+        for (DBGraphVertex::edge_iterator iter = node->edge_list_begin(graph_);
+             iter != node->edge_list_end(graph_); ++iter) {
+            if (iter->IsDeleted()) {
+                continue;
+            }
+            IFMapNode *target = static_cast<IFMapNode *>(iter.target());
+            if (region.find(target) == region.end() ||
+                !traversal_white_list_->EdgeFilter(node, target, &*iter)) {
+                continue;
+            }
+            IFMapNodeState *state = InterestState(target, bit);
+            if (state == NULL || state->nmask().test(bit)) {
+                continue;
+            }
+            state->nmask_set(bit);
+            work.push_back(target);
+        }
+    }
+}
+
+//
+// Recompute the interest bits of a removed link.
+//
+// A node loses a bit only if every path to it from the virtual-router of the
+// client went through the removed link. All such nodes are reachable from
+// the node on the far side of the link through nodes that have the bit, so
+// the walk is limited to that region. For each bit, the nodes of the region
+// that are linked to from a node outside of it that has the bit are still
+// reachable, as are the nodes of the region reachable from them. The other
+// nodes of the region lose the bit.
+//
+bool IFMapGraphWalker::Worker(QueueEntry work_entry) {
+    const BitSet &bset = work_entry.set;
+    IFMapNode *lnode = work_entry.ltable->FindNode(work_entry.lname);
+    IFMapNode *rnode = work_entry.rtable->FindNode(work_entry.rname);
+
+    NodeSet region;
+    NodeList list;
+    CollectRegion(lnode, rnode, bset, &region, &list);
+    CollectRegion(rnode, lnode, bset, &region, &list);
+    if (list.empty()) {
+        return true;
+    }
+
+    for (size_t i = bset.find_first(); i != BitSet::npos;
+         i = bset.find_next(i)) {
+        RecomputeInterest(region, list, i);
+    }
+    for (NodeList::iterator iter = list.begin(); iter != list.end(); ++iter) {
+        CleanupInterest(*iter, bset);
+    }
     return true;
 }
 
-void IFMapGraphWalker::CleanupInterest(DBGraphVertex *vertex) {
-    // interest = interest - rm_mask_ + nmask
-    IFMapNode *node = static_cast<IFMapNode *>(vertex);
+void IFMapGraphWalker::CleanupInterest(IFMapNode *node, const BitSet &bset) {
+    // interest = interest - bset + nmask
     IFMapNodeState *state = exporter_->NodeStateLookup(node);
     if (state == NULL) {
         return;
@@ -174,11 +330,11 @@ void IFMapGraphWalker::CleanupInterest(DBGraphVertex *vertex) {
 
     if (!state->interest().empty() && !state->nmask().empty()) {
         IFMAP_DEBUG(CleanupInterest, node->ToString(),
-                    state->interest().ToString(), rm_mask_.ToString(),
+                    state->interest().ToString(), bset.ToString(),
                     state->nmask().ToString());
     }
     BitSet ninterest;
-    ninterest.BuildComplement(state->interest(), rm_mask_);
+    ninterest.BuildComplement(state->interest(), bset);
     ninterest |= state->nmask();
     state->nmask_clear();
     if (state->interest() == ninterest) {
@@ -196,17 +352,6 @@ void IFMapGraphWalker::CleanupInterest(DBGraphVertex *vertex) {
     }
 }
 
-// Cleanup all graph nodes that a bit set in the remove mask (rm_mask_) but
-// where not visited by the walker.
-void IFMapGraphWalker::WorkBatchEnd(bool done) {
-    for (DBGraph::vertex_iterator iter = graph_->vertex_list_begin();
-         iter != graph_->vertex_list_end(); ++iter) {
-        DBGraphVertex *vertex = iter.operator->();
-        CleanupInterest(vertex);
-    }
-    rm_mask_.clear();
-}
-
 // The nodes listed below and the nodes in 
 // IFMapGraphTraversalFilterCalculator::CreateNodeBlackList() are mutually 
 // exclusive
@@ -5,6 +5,10 @@
 #ifndef __ctrlplane__ifmap_graph_walker__
 #define __ctrlplane__ifmap_graph_walker__
 
+#include <set>
+#include <string>
+#include <vector>
+
 #include "base/bitset.h"
 #include "base/queue_task.h"
 #include "schema/vnc_cfg_types.h"
@@ -14,6 +18,8 @@ class DBGraphEdge;
 class DBGraphVertex;
 class IFMapExporter;
 class IFMapNode;
+class IFMapNodeState;
+class IFMapTable;
 struct IFMapTypenameFilter;
 struct IFMapTypenameWhiteList;
 
@@ -28,22 +34,38 @@ public:
     // list.
     void LinkAdd(IFMapNode *lnode, const BitSet &lhs,
                  IFMapNode *rnode, const BitSet &rhs);
-    void LinkRemove(const BitSet &bset);
+    // When a link is removed, the interest bits common to both nodes are
+    // recomputed for the nodes downstream of the link that have them. The
+    // nodes elsewhere in the graph are not visited.
+    void LinkRemove(IFMapNode *lnode, IFMapNode *rnode, const BitSet &bset);
 
     bool FilterNeighbor(IFMapNode *lnode, IFMapNode *rnode);
 
 private:
+    // The nodes of the removed link are looked up by name when the entry is
+    // processed since they may be deleted in the meantime.
     struct QueueEntry {
         BitSet set;
+        IFMapTable *ltable;
+        std::string lname;
+        IFMapTable *rtable;
+        std::string rname;
     };
+    typedef std::set<IFMapNode *> NodeSet;
+    typedef std::vector<IFMapNode *> NodeList;
 
     bool Worker(QueueEntry entry);
-    void WorkBatchEnd(bool done);
 
     void ProcessLinkAdd(IFMapNode *lnode, IFMapNode *rnode, const BitSet &bset);
     void JoinVertex(DBGraphVertex *vertex, const BitSet &bset);
-    void RecomputeInterest(DBGraphVertex *vertex, int bit);
-    void CleanupInterest(DBGraphVertex *vertex);
+    void AddToRegion(DBGraphVertex *vertex, NodeSet *region, NodeList *list);
+    void CollectRegion(IFMapNode *source, IFMapNode *target,
+                       const BitSet &bset, NodeSet *region, NodeList *list);
+    bool IsAnchor(IFMapNode *node, int bit, const NodeSet &region);
+    void RecomputeInterest(const NodeSet &region, const NodeList &list,
+                           int bit);
+    void CleanupInterest(IFMapNode *node, const BitSet &bset);
+    IFMapNodeState *InterestState(IFMapNode *node, int bit);
     void AddNodesToWhitelist();
     void AddLinksToWhitelist();
 
@@ -51,7 +73,6 @@ private:
     IFMapExporter *exporter_;
     WorkQueue<QueueEntry> work_queue_;
     std::auto_ptr<IFMapTypenameWhiteList> traversal_white_list_;
-    BitSet rm_mask_;
 };
 
 #endif /* defined(__ctrlplane__ifmap_graph_walker__) */
@@ -4,6 +4,8 @@
 
 #include "ifmap/ifmap_server_parser.h"
 
+#include <algorithm>
+#include <boost/bind.hpp>
 #include <pugixml/pugixml.hpp>
 #include "base/logging.h"
 #include "db/db.h"
@@ -14,9 +16,11 @@ using namespace pugi;
 
 IFMapServerParser::ModuleMap IFMapServerParser::module_map_;
 
-static const char *NodeName(const xml_node &node) {
-    const char *name = node.name();
-    // strip namespace
+// A response that is already in memory is parsed in chunks of this size, so
+// that it is not copied whole.
+static const size_t kReceiveChunkSize = 64 * 1024;
+
+static const char *StripNamespace(const char *name) {
     const char *dot = index(name, ':');
     if (dot != NULL) {
         name = dot + 1;
@@ -24,6 +28,10 @@ static const char *NodeName(const xml_node &node) {
     return name;
 }
 
+static const char *NodeName(const xml_node &node) {
+    return StripNamespace(node.name());
+}
+
 IFMapServerParser *IFMapServerParser::GetInstance(const string &module) {
     ModuleMap::iterator loc = module_map_.find(module);
     if (loc != module_map_.end()) {
@@ -211,30 +219,262 @@ void IFMapServerParser::ParseResults(
     }
 }
 
+void IFMapServerParser::EnqueueRequests(DB *db, uint64_t sequence_number,
+                                        RequestList *requests) {
+    while (!requests->empty()) {
+        auto_ptr<DBRequest> req(requests->front());
+        requests->pop_front();
+
+        IFMapTable::RequestKey *key =
+                static_cast<IFMapTable::RequestKey *>(req->key.get());
+        key->id_seq_num = sequence_number;
+
+        IFMapTable *table = IFMapTable::FindTable(db, key->id_type);
+        if (table != NULL) {
+            table->Enqueue(req.get());
+        }
+    }
+}
+
 // Called in the context of the ifmap client thread.
 void IFMapServerParser::Receive(DB *db, const char *data, size_t length,
                                 uint64_t sequence_number) {
-    xml_document xdoc;
-    pugi::xml_parse_result result = xdoc.load_buffer(data, length);
-    if (!result) {
+    IFMapServerStreamParser stream(this,
+        boost::bind(&IFMapServerParser::EnqueueRequests, db,
+                    sequence_number, _1));
+    for (size_t offset = 0; offset < length; offset += kReceiveChunkSize) {
+        size_t size = min(length - offset, kReceiveChunkSize);
+        if (!stream.Feed(data + offset, size)) {
+            break;
+        }
+    }
+    if (!stream.Finish()) {
         LOG(WARN, "Unable to load XML document");
+    }
+}
+
+// Called in the context of the ifmap client thread.
+void IFMapServerParser::ReceiveChunk(DB *db, const char *data, size_t length,
+                                     bool first, bool last, bool aborted,
+                                     uint64_t sequence_number) {
+    if (first) {
+        stream_.reset(new IFMapServerStreamParser(this,
+            boost::bind(&IFMapServerParser::EnqueueRequests, db,
+                        sequence_number, _1)));
+    }
+    if (stream_.get() == NULL) {
+        return;
+    }
+    if (aborted) {
+        LOG(WARN, "Poll response aborted after " << stream_->items() <<
+            " items");
+        stream_.reset();
         return;
     }
+    stream_->Feed(data, length);
+    if (last) {
+        if (!stream_->Finish()) {
+            LOG(WARN, "Unable to load XML document");
+        }
+        stream_.reset();
+    }
+}
 
-    IFMapServerParser::RequestList requests;
-    ParseResults(xdoc, &requests);
+IFMapServerStreamParser::IFMapServerStreamParser(
+    const IFMapServerParser *parser, RequestCb request_cb)
+    : parser_(parser), request_cb_(request_cb), pos_(0), result_depth_(-1),
+      add_change_(false), item_start_(string::npos), root_(false),
+      error_(false), items_(0), max_buffered_(0) {
+}
 
-    while (!requests.empty()) {
-        auto_ptr<DBRequest> req(requests.front());
-        requests.pop_front();
+IFMapServerStreamParser::~IFMapServerStreamParser() {
+}
 
-        IFMapTable::RequestKey *key =
-                static_cast<IFMapTable::RequestKey *>(req->key.get());
-        key->id_seq_num = sequence_number;
+bool IFMapServerStreamParser::Feed(const char *data, size_t length) {
+    if (error_) {
+        return false;
+    }
+    buffer_.append(data, length);
+    max_buffered_ = max(max_buffered_, buffer_.size());
+    if (!Scan()) {
+        error_ = true;
+        buffer_.clear();
+        return false;
+    }
+    Compact();
+    return true;
+}
 
-        IFMapTable *table = IFMapTable::FindTable(db, key->id_type);
-        if (table != NULL) {
-            table->Enqueue(req.get());
+bool IFMapServerStreamParser::Finish() {
+    return (!error_ && root_ && stack_.empty() && pos_ == buffer_.size());
+}
+
+// Handle the markup in the buffer up to the first one that is incomplete.
+bool IFMapServerStreamParser::Scan() {
+    while (true) {
+        size_t start = buffer_.find('<', pos_);
+        if (start == string::npos) {
+            pos_ = buffer_.size();
+            return true;
+        }
+        pos_ = start;
+        size_t end;
+        bool done;
+        if (!ScanMarkup(&end, &done)) {
+            return false;
+        }
+        if (!done) {
+            return true;
         }
+        pos_ = end;
+    }
+}
+
+//
+// Find the end of the markup at pos_ and handle it if it is an element tag.
+// done is cleared if the markup does not end in the buffer yet.
+//
+bool IFMapServerStreamParser::ScanMarkup(size_t *end, bool *done) {
+    static const struct {
+        const char *open;
+        const char *close;
+    } kOther[] = {
+        { "<!--", "-->" },
+        { "<![CDATA[", "]]>" },
+        { "<?", "?>" },
+        { "<!", ">" },
+    };
+
+    *done = false;
+    size_t avail = buffer_.size() - pos_;
+    for (size_t i = 0; i < sizeof(kOther) / sizeof(kOther[0]); i++) {
+        size_t len = strlen(kOther[i].open);
+        size_t cmp = min(len, avail);
+        if (buffer_.compare(pos_, cmp, kOther[i].open, cmp) != 0) {
+            continue;
+        }
+        if (cmp < len) {
+            return true;
+        }
+        size_t close = buffer_.find(kOther[i].close, pos_ + len);
+        if (close == string::npos) {
+            return true;
+        }
+        *end = close + strlen(kOther[i].close);
+        *done = true;
+        return true;
+    }
+
+    // An element tag. Attribute values may have a '>'.
+    char quote = 0;
+    size_t i;
+    for (i = pos_ + 1; i < buffer_.size(); i++) {
+        char ch = buffer_[i];
+        if (quote != 0) {
+            if (ch == quote) {
+                quote = 0;
+            }
+        } else if (ch == '"' || ch == '\'') {
+            quote = ch;
+        } else if (ch == '>') {
+            break;
+        }
+    }
+    if (i == buffer_.size()) {
+        return true;
+    }
+    *end = i + 1;
+    *done = true;
+    return StartEndElement(pos_, *end);
+}
+
+// The qualified name of the element in the tag between start and end.
+static string TagName(const string &buffer, size_t start, size_t end) {
+    size_t first = start + 1;
+    if (buffer[first] == '/') {
+        first++;
+    }
+    size_t last = first;
+    while (last < end && !isspace(buffer[last]) && buffer[last] != '/' &&
+           buffer[last] != '>') {
+        last++;
+    }
+    return string(buffer, first, last - first);
+}
+
+bool IFMapServerStreamParser::StartEndElement(size_t start, size_t end) {
+    string name = TagName(buffer_, start, end);
+    if (name.empty()) {
+        return false;
+    }
+    if (buffer_[start + 1] == '/') {
+        return EndElement(name, end);
+    }
+
+    stack_.push_back(name);
+    root_ = true;
+    int depth = stack_.size();
+    const char *local = StripNamespace(name.c_str());
+    if (result_depth_ < 0) {
+        if (strcmp(local, "updateResult") == 0 ||
+            strcmp(local, "searchResult") == 0 ||
+            strcmp(local, "deleteResult") == 0) {
+            result_depth_ = depth;
+            add_change_ = (strcmp(local, "deleteResult") != 0);
+        }
+    } else if (depth == result_depth_ + 1) {
+        item_start_ = start;
+    }
+
+    // Empty element
+    if (buffer_[end - 2] == '/') {
+        return EndElement(name, end);
+    }
+    return true;
+}
+
+bool IFMapServerStreamParser::EndElement(const string &name, size_t end) {
+    if (stack_.empty() || stack_.back() != name) {
+        return false;
+    }
+    int depth = stack_.size();
+    stack_.pop_back();
+    if (depth == result_depth_ + 1 && item_start_ != string::npos) {
+        bool success = ParseItem(item_start_, end);
+        item_start_ = string::npos;
+        return success;
+    }
+    if (depth == result_depth_) {
+        result_depth_ = -1;
+    }
+    return true;
+}
+
+bool IFMapServerStreamParser::ParseItem(size_t start, size_t end) {
+    xml_document xdoc;
+    pugi::xml_parse_result result =
+        xdoc.load_buffer(buffer_.data() + start, end - start);
+    if (!result) {
+        return false;
+    }
+    items_++;
+    IFMapServerParser::RequestList requests;
+    parser_->ParseResultItem(xdoc.first_child(), add_change_, &requests);
+    if (!requests.empty()) {
+        request_cb_(&requests);
+    }
+    return true;
+}
+
+// Drop the bytes that have been handled, except for the open resultItem.
+void IFMapServerStreamParser::Compact() {
+    size_t keep = (item_start_ != string::npos) ? item_start_ : pos_;
+    if (keep == 0) {
+        return;
+    }
+    buffer_.erase(0, keep);
+    pos_ -= keep;
+    if (item_start_ != string::npos) {
+        item_start_ -= keep;
     }
 }
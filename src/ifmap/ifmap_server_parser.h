@@ -5,13 +5,18 @@
 #ifndef __DB_IFMAP_PARSER_H__
 #define __DB_IFMAP_PARSER_H__
 
+#include <stdint.h>
 #include <list>
 #include <map>
+#include <string>
+#include <vector>
 #include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
 
 struct AutogenProperty;
 class DB;
 struct DBRequest;
+class IFMapServerStreamParser;
 
 namespace pugi {
 class xml_document;
@@ -38,6 +43,14 @@ public:
     void Receive(DB *db, const char *data, size_t length,
                  uint64_t sequence_number);
 
+    // Called with the chunks of a poll response as they are read. The
+    // requests of each resultItem are enqueued as soon as the item ends.
+    // If the response is aborted, the rest of it is dropped but the items
+    // already enqueued are not undone: a response is applied in part, as
+    // by Receive() when a response is malformed.
+    void ReceiveChunk(DB *db, const char *data, size_t length, bool first,
+                      bool last, bool aborted, uint64_t sequence_number);
+
     static IFMapServerParser *GetInstance(const std::string &module);
     static void DeleteInstance(const std::string &module);
 
@@ -47,8 +60,60 @@ private:
 
     bool ParseMetadata(const pugi::xml_node &node,
                        struct DBRequest *result) const;
+    static void EnqueueRequests(DB *db, uint64_t sequence_number,
+                                RequestList *list);
 
     MetadataParseMap metadata_map_;
+    boost::scoped_ptr<IFMapServerStreamParser> stream_;
+};
+
+//
+// Parses an IF-MAP response as it arrives, in chunks of any size, with
+// memory bounded by the size of a resultItem rather than of the response.
+// The text of a resultItem is kept only until the item ends; the item is
+// then parsed as a document of its own and its requests are passed to the
+// callback. The element structure of the rest of the response is checked
+// but not kept.
+//
+class IFMapServerStreamParser {
+public:
+    typedef boost::function<void(IFMapServerParser::RequestList *)>
+        RequestCb;
+
+    IFMapServerStreamParser(const IFMapServerParser *parser,
+                            RequestCb request_cb);
+    ~IFMapServerStreamParser();
+
+    // Returns false once the response is found to be malformed.
+    bool Feed(const char *data, size_t length);
+    // Returns false if the response is malformed or incomplete.
+    bool Finish();
+
+    // The number of resultItems parsed.
+    uint64_t items() const { return items_; }
+    // The most bytes buffered at once.
+    size_t max_buffered() const { return max_buffered_; }
+
+private:
+    bool Scan();
+    bool ScanMarkup(size_t *end, bool *done);
+    bool StartEndElement(size_t start, size_t end);
+    bool EndElement(const std::string &name, size_t end);
+    bool ParseItem(size_t start, size_t end);
+    void Compact();
+
+    const IFMapServerParser *parser_;
+    RequestCb request_cb_;
+    std::string buffer_;
+    size_t pos_;                        // next byte of buffer_ to scan
+    std::vector<std::string> stack_;    // names of the open elements
+    int result_depth_;                  // depth of the open *Result element
+    bool add_change_;                   // the open *Result is not a delete
+    size_t item_start_;                 // start of the open resultItem
+    bool root_;                         // an element has been seen
+    bool error_;
+    uint64_t items_;
+    size_t max_buffered_;
 };
 
 #endif
@@ -6,6 +6,7 @@
 #include <sandesh/sandesh.h>
 #include <sandesh/request_pipeline.h>
 
+#include <algorithm>
 #include <boost/bind.hpp>
 #include <boost/assign/list_of.hpp>
 #include "base/logging.h"
@@ -27,6 +28,7 @@
 #include "ifmap/ifmap_syslog_types.h"
 #include "ifmap/ifmap_table.h"
 #include "ifmap/ifmap_update.h"
+#include "ifmap/ifmap_update_sender.h"
 #include "ifmap/ifmap_uuid_mapper.h"
 
 #include "bgp/bgp_sandesh.h"
@@ -866,6 +868,11 @@ public:
         return static_cast<RequestPipeline::InstData *>(new TrackerData);
     }
 
+    static bool UuidLess(const IFMapUuidToNodeMappingEntry &lhs,
+                         const IFMapUuidToNodeMappingEntry &rhs) {
+        return lhs.get_uuid() < rhs.get_uuid();
+    }
+
     static bool BufferStage(const Sandesh *sr,
                             const RequestPipeline::PipeSpec ps, int stage,
                             int instNum, RequestPipeline::InstData *data);
@@ -897,6 +904,9 @@ bool ShowIFMapUuidToNodeMapping::BufferStage(const Sandesh *sr,
         dest.set_node_name(node->ToString());
         show_data->send_buffer.push_back(dest);
     }
+    // The map is unordered, sort by uuid so that the output is stable
+    sort(show_data->send_buffer.begin(), show_data->send_buffer.end(),
+         UuidLess);
 
     return true;
 }
@@ -1265,6 +1275,51 @@ void IFMapServerClientShowReq::HandleRequest() const {
     RequestPipeline rp(ps);
 }
 
+// Runs in the db::DBTable task, like the sender, so the stats are stable.
+static bool IFMapUpdateSenderShowReqHandleRequest(const Sandesh *sr,
+                const RequestPipeline::PipeSpec ps, int stage, int instNum,
+                RequestPipeline::InstData *data) {
+    const IFMapUpdateSenderShowReq *request =
+        static_cast<const IFMapUpdateSenderShowReq *>(ps.snhRequest_.get());
+    BgpSandeshContext *bsc =
+        static_cast<BgpSandeshContext *>(request->client_context());
+
+    const IFMapMessage::Stats &msg_stats =
+        bsc->ifmap_server->sender()->message_stats();
+    IFMapUpdateSenderStats stats;
+    stats.set_messages(msg_stats.messages);
+    stats.set_bytes(msg_stats.bytes);
+    stats.set_fragment_hits(msg_stats.fragment_hits);
+    stats.set_fragment_misses(msg_stats.fragment_misses);
+    stats.set_fragment_bytes(msg_stats.fragment_bytes);
+    uint64_t total = msg_stats.fragment_hits + msg_stats.fragment_misses;
+    stats.set_fragment_hit_percent(
+        total ? (msg_stats.fragment_hits * 100) / total : 0);
+
+    IFMapUpdateSenderShowResp *response = new IFMapUpdateSenderShowResp();
+    response->set_stats(stats);
+    response->set_context(request->context());
+    response->set_more(false);
+    response->Response();
+
+    // Return 'true' so that we are not called again
+    return true;
+}
+
+void IFMapUpdateSenderShowReq::HandleRequest() const {
+
+    RequestPipeline::StageSpec s0;
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+
+    s0.taskId_ = scheduler->GetTaskId("db::DBTable");
+    s0.cbFn_ = IFMapUpdateSenderShowReqHandleRequest;
+    s0.instances_.push_back(0);
+
+    RequestPipeline::PipeSpec ps(this);
+    ps.stages_= boost::assign::list_of(s0);
+    RequestPipeline rp(ps);
+}
+
 static bool IFMapNodeTableListShowReqHandleRequest(const Sandesh *sr,
                 const RequestPipeline::PipeSpec ps, int stage, int instNum,
                 RequestPipeline::InstData *data) {
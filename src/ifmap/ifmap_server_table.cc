@@ -59,8 +59,7 @@ static IFMapServerTable *TableFind(DB *db, const string &metadata) {
 }
 
 IFMapNode *IFMapServerTable::EntryLookup(RequestKey *request) {
-    auto_ptr<DBEntry> key(AllocEntry(request));
-    IFMapNode *node = static_cast<IFMapNode *>(Find(key.get()));
+    IFMapNode *node = FindNode(request->id_name);
     if ((node == NULL) || node->IsDeleted()) {
         return NULL;
     }
@@ -68,8 +67,7 @@ IFMapNode *IFMapServerTable::EntryLookup(RequestKey *request) {
 }
 
 IFMapNode *IFMapServerTable::EntryLocate(RequestKey *request, bool *changep) {
-    auto_ptr<DBEntry> key(AllocEntry(request));
-    IFMapNode *node = static_cast<IFMapNode *>(Find(key.get()));
+    IFMapNode *node = FindNode(request->id_name);
     if (node != NULL) {
         if (node->IsDeleted()) {
             node->ClearDelete();
@@ -79,6 +77,7 @@ IFMapNode *IFMapServerTable::EntryLocate(RequestKey *request, bool *changep) {
         return node;
     }
     *changep = true;
+    auto_ptr<DBEntry> key(AllocEntry(request));
     node = const_cast<IFMapNode *>(
         static_cast<const IFMapNode *>(key.release()));
     DBTablePartition *partition =
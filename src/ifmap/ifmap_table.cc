@@ -21,10 +21,51 @@ IFMapTable::IFMapTable(DB *db, const std::string &name) : DBTable(db, name) {
 }
 
 IFMapNode *IFMapTable::FindNode(const std::string &name) {
-    IFMapTable::RequestKey reqkey;
-    reqkey.id_name = name;
-    auto_ptr<DBEntry> key(AllocEntry(&reqkey));
-    return static_cast<IFMapNode *>(Find(key.get()));
+    IFMapTablePartition *partition =
+        static_cast<IFMapTablePartition *>(GetTablePartition(0));
+    return partition->FindNode(name);
+}
+
+DBTablePartition *IFMapTable::AllocPartition(int index) {
+    return new IFMapTablePartition(this, index);
+}
+
+IFMapTablePartition::NameKey::NameKey(const std::string *str)
+    : name(str), hash(boost::hash<std::string>()(*str)) {
+}
+
+IFMapTablePartition::IFMapTablePartition(DBTable *parent, int index)
+    : DBTablePartition(parent, index) {
+}
+
+void IFMapTablePartition::Add(DBEntry *entry) {
+    IFMapNode *node = static_cast<IFMapNode *>(entry);
+    {
+        tbb::mutex::scoped_lock lock(index_mutex_);
+        bool inserted = name_index_.insert(
+            make_pair(NameKey(&node->name()), node)).second;
+        assert(inserted);
+    }
+    DBTablePartition::Add(entry);
+}
+
+void IFMapTablePartition::Remove(DBEntryBase *entry) {
+    IFMapNode *node = static_cast<IFMapNode *>(entry);
+    {
+        tbb::mutex::scoped_lock lock(index_mutex_);
+        size_t erased = name_index_.erase(NameKey(&node->name()));
+        assert(erased == 1);
+    }
+    DBTablePartition::Remove(entry);
+}
+
+IFMapNode *IFMapTablePartition::FindNode(const std::string &name) {
+    tbb::mutex::scoped_lock lock(index_mutex_);
+    NameIndex::const_iterator loc = name_index_.find(NameKey(&name));
+    if (loc == name_index_.end()) {
+        return NULL;
+    }
+    return loc->second;
 }
 
 IFMapTable *IFMapTable::FindTable(DB *db, const std::string &element_type) {
@@ -5,11 +5,50 @@
 #ifndef ctrlplane_ifmap_table_h
 #define ctrlplane_ifmap_table_h
 
+#include <boost/unordered_map.hpp>
+#include <tbb/mutex.h>
 #include "db/db_table.h"
+#include "db/db_table_partition.h"
 
 class IFMapNode;
 class IFMapNodeTableListShowEntry;
 
+//
+// The partition of an IFMapTable. Besides the ordered tree, the nodes are
+// indexed by name in a hash table. The keys point to the name of the node
+// and carry its hash: the index holds no copy of the names, and a lookup
+// hashes the name once, compares strings only when the hashes match and,
+// unlike a lookup in the tree, does not allocate a key node.
+//
+class IFMapTablePartition : public DBTablePartition {
+public:
+    IFMapTablePartition(DBTable *parent, int index);
+
+    virtual void Add(DBEntry *entry);
+    virtual void Remove(DBEntryBase *entry);
+
+    IFMapNode *FindNode(const std::string &name);
+
+private:
+    struct NameKey {
+        explicit NameKey(const std::string *str);
+        bool operator==(const NameKey &rhs) const {
+            return hash == rhs.hash && *name == *rhs.name;
+        }
+        const std::string *name;
+        size_t hash;
+    };
+    struct NameKeyHash {
+        size_t operator()(const NameKey &key) const { return key.hash; }
+    };
+    typedef boost::unordered_map<NameKey, IFMapNode *, NameKeyHash>
+        NameIndex;
+
+    tbb::mutex index_mutex_;
+    NameIndex name_index_;
+    DISALLOW_COPY_AND_ASSIGN(IFMapTablePartition);
+};
+
 class IFMapTable : public DBTable {
 public:
     static const int kPartitionCount = 1;
@@ -27,6 +66,7 @@ public:
 
     virtual const char *Typename() const = 0;
 
+    // Find a node by name in the index of the partition.
     IFMapNode *FindNode(const std::string &name);
 
     virtual void Clear() = 0;
@@ -35,5 +75,7 @@ public:
     static void ClearTables(DB *db);
     static void FillNodeTableList(DB *db,
         std::vector<IFMapNodeTableListShowEntry> *table_list);
+
+    virtual DBTablePartition *AllocPartition(int index);
 };
 #endif
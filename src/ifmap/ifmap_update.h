@@ -7,6 +7,7 @@
 
 #include <boost/intrusive/list.hpp>
 #include <boost/intrusive/slist.hpp>
+#include <string>
 
 #include "base/bitset.h"
 #include "base/dependency.h"
@@ -66,11 +67,18 @@ public:
 
     const IFMapObjectPtr &data() const { return data_; }
 
+    // The xml text of the object, shared by the messages that carry the
+    // update to its clients. Empty until the update is first sent.
+    const std::string &encoded() const { return encoded_; }
+    void set_encoded(const std::string &encoded) { encoded_ = encoded; }
+    void ClearEncoded() { encoded_.clear(); }
+
 private:
     friend class IFMapState;
     boost::intrusive::slist_member_hook<> node_;
     IFMapObjectPtr data_;
     BitSet advertise_;
+    std::string encoded_;
 };
 
 struct IFMapMarker : public IFMapListEntry {
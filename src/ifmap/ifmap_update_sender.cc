@@ -237,7 +237,7 @@ void IFMapUpdateSender::SendUpdate(BitSet send_set, BitSet *blocked_set) {
             continue;
         }
         message_->SetReceiverInMsg(client->identifier());
-        // Close the message to save the document as string
+        // Close the message to wrap the encoded updates for the client
         message_->Close();
 
         // Send the string version of the message to the client.
@@ -42,6 +42,10 @@ public:
         return send_blocked_.test(client_index);
     }
 
+    const IFMapMessage::Stats &message_stats() const {
+        return message_->stats();
+    }
+
 private:
     class SendTask;
     friend class IFMapUpdateSenderTest;
@@ -6,6 +6,7 @@
 #define __IFMAP_UUID_MAPPER_H__
 
 #include <boost/bind.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
@@ -23,7 +24,7 @@ class IFMapServerTable;
 // Maintains a mapping of [uuid, node]
 class IFMapUuidMapper {
 public:
-    typedef std::map<std::string, IFMapNode *> UuidNodeMap;
+    typedef boost::unordered_map<std::string, IFMapNode *> UuidNodeMap;
     typedef UuidNodeMap::size_type Sz_t;
 
     std::string Add(uint64_t ms_long, uint64_t ls_long, IFMapNode *node);
@@ -4,10 +4,12 @@
 
 #include "ifmap/ifmap_graph_walker.h"
 
+#include <stdlib.h>
 #include <fstream>
 
 #include "base/logging.h"
 #include "base/test/task_test_util.h"
+#include "base/util.h"
 #include "control-node/control_node.h"
 #include "db/db.h"
 #include "db/db_graph.h"
@@ -496,6 +498,107 @@ TEST_F(IFMapGraphWalkerTest, Cli2Vn3Vm6Np2Add) {
     c2.PrintLinks();
 }
 
+// Builds a synthetic config in which the interfaces of the virtual machines
+// of all the clients link to the same virtual-network, and times the
+// removal of links to and from the shared node. The number of nodes, 100 by
+// default, can be set with the environment variable
+// IFMAP_GRAPH_WALKER_TEST_NODES e.g. to 100000 to measure a large graph.
+TEST_F(IFMapGraphWalkerTest, SharedNodeLinkRemove) {
+    int nodes = 100;
+    const char *env_nodes = getenv("IFMAP_GRAPH_WALKER_TEST_NODES");
+    if (env_nodes != NULL) {
+        nodes = strtoul(env_nodes, NULL, 0);
+    }
+    const int kClients = 10;
+    int vms = max(nodes / (2 * kClients), 2);
+
+    vector<IFMapClientMock *> clients;
+    for (int i = 0; i < kClients; i++) {
+        string vr = "vr" + integerToString(i);
+        clients.push_back(new IFMapClientMock(vr));
+        server_.AddClient(clients.back());
+    }
+    ifmap_test_util::IFMapMsgLink(&db_, "virtual-network", "vn",
+                                  "access-control-list", "acl",
+                                  "virtual-network-access-control-list");
+    uint64_t start = ClockMonotonicUsec();
+    for (int i = 0; i < kClients; i++) {
+        string vr = "vr" + integerToString(i);
+        for (int j = 0; j < vms; j++) {
+            string vm = vr + "-vm" + integerToString(j);
+            string vmi = vm + ":veth0";
+            ifmap_test_util::IFMapMsgLink(&db_, "virtual-router", vr,
+                "virtual-machine", vm, "virtual-router-virtual-machine");
+            ifmap_test_util::IFMapMsgLink(&db_, "virtual-machine", vm,
+                "virtual-machine-interface", vmi,
+                "virtual-machine-virtual-machine-interface");
+            ifmap_test_util::IFMapMsgLink(&db_, "virtual-machine-interface",
+                vmi, "virtual-network", "vn",
+                "virtual-machine-interface-virtual-network");
+        }
+    }
+    task_util::WaitForIdle();
+    uint64_t add_usecs = ClockMonotonicUsec() - start;
+    for (int i = 0; i < kClients; i++) {
+        TASK_UTIL_EXPECT_TRUE(clients[i]->NodeExists("access-control-list",
+                                                     "acl"));
+        TASK_UTIL_EXPECT_EQ(vms, (int) clients[i]->NodeKeyCount(
+            "virtual-machine-interface"));
+    }
+
+    // All the clients lose the node downstream of the shared node.
+    start = ClockMonotonicUsec();
+    ifmap_test_util::IFMapMsgUnlink(&db_, "virtual-network", "vn",
+                                    "access-control-list", "acl",
+                                    "virtual-network-access-control-list");
+    task_util::WaitForIdle();
+    uint64_t acl_usecs = ClockMonotonicUsec() - start;
+    for (int i = 0; i < kClients; i++) {
+        TASK_UTIL_EXPECT_FALSE(clients[i]->NodeExists("access-control-list",
+                                                      "acl"));
+        TASK_UTIL_EXPECT_TRUE(clients[i]->NodeExists("virtual-network",
+                                                     "vn"));
+    }
+
+    // The client still reaches the shared node through its other virtual
+    // machines.
+    start = ClockMonotonicUsec();
+    ifmap_test_util::IFMapMsgUnlink(&db_, "virtual-machine-interface",
+                                    "vr0-vm0:veth0", "virtual-network", "vn",
+                                    "virtual-machine-interface-virtual-network");
+    task_util::WaitForIdle();
+    uint64_t vmi_usecs = ClockMonotonicUsec() - start;
+    TASK_UTIL_EXPECT_TRUE(clients[0]->NodeExists("virtual-network", "vn"));
+
+    // The virtual machine and its interface are no longer of interest.
+    start = ClockMonotonicUsec();
+    ifmap_test_util::IFMapMsgUnlink(&db_, "virtual-router", "vr0",
+                                    "virtual-machine", "vr0-vm0",
+                                    "virtual-router-virtual-machine");
+    task_util::WaitForIdle();
+    uint64_t vm_usecs = ClockMonotonicUsec() - start;
+    TASK_UTIL_EXPECT_FALSE(clients[0]->NodeExists("virtual-machine",
+                                                  "vr0-vm0"));
+    TASK_UTIL_EXPECT_FALSE(clients[0]->NodeExists(
+        "virtual-machine-interface", "vr0-vm0:veth0"));
+    TASK_UTIL_EXPECT_TRUE(clients[0]->NodeExists("virtual-network", "vn"));
+    TASK_UTIL_EXPECT_EQ(vms - 1, (int) clients[0]->NodeKeyCount(
+        "virtual-machine-interface"));
+    TASK_UTIL_EXPECT_EQ(vms, (int) clients[1]->NodeKeyCount(
+        "virtual-machine-interface"));
+
+    LOG(DEBUG, "graph of " << db_graph_.vertex_count() << " nodes: add " <<
+        add_usecs << " usecs, shared node link remove " << acl_usecs <<
+        " usecs, interface link remove " << vmi_usecs <<
+        " usecs, virtual machine link remove " << vm_usecs << " usecs");
+
+    for (int i = 0; i < kClients; i++) {
+        server_.DeleteClient(clients[i]);
+    }
+    task_util::WaitForIdle();
+    STLDeleteValues(&clients);
+}
+
 // Calculate the white list filter information based on the xsd.
 TEST_F(IFMapGraphWalkerTest, PopulateWhiteList) {
     // Populate 'filter_info' with information from the xsd
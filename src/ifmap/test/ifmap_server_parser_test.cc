@@ -5,6 +5,9 @@
 #include "ifmap/ifmap_server_parser.h"
 
 #include <fstream>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <pugixml/pugixml.hpp>
 #include "base/logging.h"
 #include "base/test/task_test_util.h"
 #include "control-node/control_node.h"
@@ -14,6 +17,7 @@
 #include "ifmap/ifmap_client.h"
 #include "ifmap/ifmap_link_table.h"
 #include "ifmap/ifmap_server.h"
+#include "ifmap/ifmap_server_table.h"
 #include "ifmap/ifmap_table.h"
 #include "ifmap/ifmap_update_queue.h"
 #include "ifmap/ifmap_xmpp.h"
@@ -82,6 +86,26 @@ class IFMapServerParserTest : public ::testing::Test {
         return static_cast<IFMapLink *>(graph_.GetEdge(left, right));
     }
 
+    // Append the requests to results as text and free them.
+    static void RequestStrings(vector<string> *results,
+                               IFMapServerParser::RequestList *requests) {
+        while (!requests->empty()) {
+            auto_ptr<DBRequest> req(requests->front());
+            requests->pop_front();
+            IFMapTable::RequestKey *key =
+                static_cast<IFMapTable::RequestKey *>(req->key.get());
+            IFMapServerTable::RequestData *data =
+                static_cast<IFMapServerTable::RequestData *>(req->data.get());
+            ostringstream oss;
+            oss << req->oper << " " << key->id_type << ":" << key->id_name;
+            if (data != NULL) {
+                oss << " " << data->id_type << ":" << data->id_name << " " <<
+                    data->metadata;
+            }
+            results->push_back(oss.str());
+        }
+    }
+
     DB db_;
     DBGraph graph_;
     EventManager evm_;
@@ -1633,6 +1657,119 @@ TEST_F(IFMapServerParserTest, ServerParser16InParts) {
 }
 
 
+// Replays the captured poll responses through the stream parser in chunks of
+// various sizes and checks that it makes the same requests as the parser of
+// the whole document, while buffering no more than a few items.
+TEST_F(IFMapServerParserTest, StreamReplay) {
+    vector<string> files;
+    files.push_back("src/ifmap/testdata/inter-vn.xml");
+    files.push_back("src/ifmap/testdata/server_parser_test.xml");
+    for (int i = 1; i <= 16; i++) {
+        ostringstream oss;
+        oss << "src/ifmap/testdata/server_parser_test" << i << ".xml";
+        files.push_back(oss.str());
+    }
+    static const size_t kChunkSizes[] = { 1, 7, 512, 1 << 20 };
+
+    for (size_t i = 0; i < files.size(); i++) {
+        string message(FileRead(files[i]));
+        ASSERT_NE(0U, message.size());
+
+        pugi::xml_document xdoc;
+        bool loaded = xdoc.load_buffer(message.data(), message.size());
+        ASSERT_TRUE(loaded);
+        IFMapServerParser::RequestList requests;
+        parser_->ParseResults(xdoc, &requests);
+        vector<string> expected;
+        RequestStrings(&expected, &requests);
+        EXPECT_NE(0U, expected.size());
+
+        for (size_t j = 0; j < sizeof(kChunkSizes) / sizeof(kChunkSizes[0]);
+             j++) {
+            size_t chunk_size = kChunkSizes[j];
+            vector<string> results;
+            IFMapServerStreamParser stream(parser_,
+                boost::bind(&IFMapServerParserTest::RequestStrings, &results,
+                            _1));
+            for (size_t offset = 0; offset < message.size();
+                 offset += chunk_size) {
+                size_t size = min(chunk_size, message.size() - offset);
+                EXPECT_TRUE(stream.Feed(message.data() + offset, size));
+            }
+            EXPECT_TRUE(stream.Finish());
+            EXPECT_TRUE(expected == results) << files[i] << " in chunks of "
+                << chunk_size;
+            if (chunk_size == 1 && stream.items() > 2) {
+                EXPECT_LT(stream.max_buffered(), message.size() / 2);
+            }
+        }
+    }
+
+    // A truncated response
+    string message(FileRead("src/ifmap/testdata/inter-vn.xml"));
+    vector<string> results;
+    IFMapServerStreamParser stream(parser_,
+        boost::bind(&IFMapServerParserTest::RequestStrings, &results, _1));
+    EXPECT_TRUE(stream.Feed(message.data(), message.size() / 2));
+    EXPECT_FALSE(stream.Finish());
+    EXPECT_NE(0U, results.size());
+}
+
+// Same as ServerParser, with the response received in chunks.
+TEST_F(IFMapServerParserTest, ServerParserInChunks) {
+    IFMapTable *table = IFMapTable::FindTable(&db_, "virtual-network");
+
+    string message(FileRead("src/ifmap/testdata/server_parser_test.xml"));
+    assert(message.size() != 0);
+    static const size_t kChunkSize = 100;
+    for (size_t offset = 0; offset < message.size(); offset += kChunkSize) {
+        size_t size = min(kChunkSize, message.size() - offset);
+        parser_->ReceiveChunk(&db_, message.data() + offset, size,
+                              offset == 0, offset + size == message.size(),
+                              false, 0);
+    }
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_EQ(1, table->Size());
+
+    IFMapNode *vn1 = NodeLookup("virtual-network", "vn1");
+    EXPECT_TRUE(vn1 != NULL);
+    IFMapObject *obj = vn1->Find(IFMapOrigin(IFMapOrigin::MAP_SERVER));
+    EXPECT_TRUE(obj != NULL);
+
+    IFMapNode *vn = NodeLookup("virtual-network", "vn2");
+    EXPECT_TRUE(vn == NULL);
+    vn = NodeLookup("virtual-network", "vn3");
+    EXPECT_TRUE(vn == NULL);
+    vn = NodeLookup("virtual-network", "vn4");
+    EXPECT_TRUE(vn == NULL);
+    vn = NodeLookup("virtual-network", "vn5");
+    EXPECT_TRUE(vn == NULL);
+}
+
+// A response aborted half way leaves no partial stream behind: the chunks
+// that follow without a new first chunk are ignored, and the next response
+// is parsed from its start.
+TEST_F(IFMapServerParserTest, ServerParserChunkAbort) {
+    IFMapTable *table = IFMapTable::FindTable(&db_, "virtual-network");
+
+    string message(FileRead("src/ifmap/testdata/server_parser_test.xml"));
+    assert(message.size() != 0);
+    size_t half = message.size() / 2;
+    parser_->ReceiveChunk(&db_, message.data(), half, true, false, false, 0);
+    parser_->ReceiveChunk(&db_, NULL, 0, false, true, true, 0);
+    parser_->ReceiveChunk(&db_, message.data() + half, message.size() - half,
+                          false, true, false, 0);
+    task_util::WaitForIdle();
+    EXPECT_GE(1U, table->Size());
+
+    parser_->ReceiveChunk(&db_, message.data(), message.size(), true, true,
+                          false, 0);
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_EQ(1, table->Size());
+    EXPECT_TRUE(NodeLookup("virtual-network", "vn1") != NULL);
+    EXPECT_TRUE(NodeLookup("virtual-network", "vn2") == NULL);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     LoggingInit();
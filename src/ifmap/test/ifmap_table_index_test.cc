@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "ifmap/ifmap_table.h"
+
+#include <stdlib.h>
+#include <memory>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/util.h"
+#include "base/test/task_test_util.h"
+#include "control-node/control_node.h"
+#include "db/db.h"
+#include "db/db_graph.h"
+#include "io/event_manager.h"
+#include "ifmap/ifmap_link_table.h"
+#include "ifmap/ifmap_node.h"
+#include "ifmap/ifmap_server.h"
+#include "ifmap/ifmap_server_parser.h"
+#include "ifmap/ifmap_uuid_mapper.h"
+#include "ifmap/test/ifmap_test_util.h"
+#include "schema/vnc_cfg_types.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+//
+// Loads a large synthetic configuration of virtual networks, looks the nodes
+// up by name through the index of the table and through the ordered tree,
+// and by uuid through the uuid mapper, checks that they agree and logs the
+// time it takes. The number of nodes can be set with the environment
+// variable IFMAP_TABLE_INDEX_TEST_NODES.
+//
+
+class IFMapTableIndexTest : public ::testing::Test {
+protected:
+    IFMapTableIndexTest()
+        : server_(&db_, &graph_, evm_.io_service()), parser_(NULL),
+          table_(NULL), nodes_(100000) {
+        const char *nodes = getenv("IFMAP_TABLE_INDEX_TEST_NODES");
+        if (nodes != NULL) {
+            nodes_ = strtoul(nodes, NULL, 0);
+        }
+    }
+
+    virtual void SetUp() {
+        IFMapLinkTable_Init(&db_, &graph_);
+        parser_ = IFMapServerParser::GetInstance("vnc_cfg");
+        vnc_cfg_ParserInit(parser_);
+        vnc_cfg_Server_ModuleInit(&db_, &graph_);
+        server_.Initialize();
+        table_ = IFMapTable::FindTable(&db_, "virtual-network");
+        ASSERT_TRUE(table_ != NULL);
+    }
+
+    virtual void TearDown() {
+        server_.Shutdown();
+        task_util::WaitForIdle();
+        IFMapLinkTable_Clear(&db_);
+        IFMapTable::ClearTables(&db_);
+        task_util::WaitForIdle();
+        db_.Clear();
+        parser_->MetadataClear("vnc_cfg");
+        evm_.Shutdown();
+    }
+
+    static string NetworkName(int index) {
+        return "default-domain:project" + integerToString(index % 64) +
+            ":vn" + integerToString(index);
+    }
+
+    // Look the node up in the ordered tree, the way the table did before
+    // it had an index.
+    IFMapNode *TreeFind(const string &name) {
+        IFMapTable::RequestKey key;
+        key.id_name = name;
+        auto_ptr<DBEntry> entry(table_->AllocEntry(&key));
+        return static_cast<IFMapNode *>(table_->Find(entry.get()));
+    }
+
+    void LoadNetworks() {
+        uint64_t start = ClockMonotonicUsec();
+        for (int i = 0; i < nodes_; i++) {
+            IFMapMsgNodeAdd(&db_, "virtual-network", NetworkName(i), 1);
+        }
+        task_util::WaitForIdle();
+        uint64_t usecs = ClockMonotonicUsec() - start;
+        EXPECT_EQ((size_t) nodes_, table_->Size());
+        LOG(DEBUG, "load " << nodes_ << " nodes in " << usecs << " usecs");
+    }
+
+    DB db_;
+    DBGraph graph_;
+    EventManager evm_;
+    IFMapServer server_;
+    IFMapServerParser *parser_;
+    IFMapTable *table_;
+    int nodes_;
+};
+
+TEST_F(IFMapTableIndexTest, NameLookup) {
+    LoadNetworks();
+
+    vector<string> names;
+    names.reserve(nodes_);
+    for (int i = 0; i < nodes_; i++) {
+        names.push_back(NetworkName(i));
+    }
+
+    vector<IFMapNode *> tree_nodes;
+    tree_nodes.reserve(nodes_);
+    uint64_t start = ClockMonotonicUsec();
+    for (int i = 0; i < nodes_; i++) {
+        tree_nodes.push_back(TreeFind(names[i]));
+    }
+    uint64_t tree_usecs = ClockMonotonicUsec() - start;
+
+    vector<IFMapNode *> index_nodes;
+    index_nodes.reserve(nodes_);
+    start = ClockMonotonicUsec();
+    for (int i = 0; i < nodes_; i++) {
+        index_nodes.push_back(table_->FindNode(names[i]));
+    }
+    uint64_t index_usecs = ClockMonotonicUsec() - start;
+
+    for (int i = 0; i < nodes_; i++) {
+        ASSERT_TRUE(index_nodes[i] != NULL);
+        EXPECT_EQ(tree_nodes[i], index_nodes[i]);
+        EXPECT_EQ(names[i], index_nodes[i]->name());
+    }
+    EXPECT_TRUE(table_->FindNode("default-domain:project0:vn") == NULL);
+    LOG(DEBUG, "lookup " << nodes_ << " nodes: tree usecs " << tree_usecs <<
+        " index usecs " << index_usecs);
+}
+
+// Nodes that are removed from the table are removed from the index.
+TEST_F(IFMapTableIndexTest, Delete) {
+    LoadNetworks();
+
+    for (int i = 0; i < nodes_; i += 2) {
+        IFMapMsgNodeDelete(&db_, "virtual-network", NetworkName(i));
+    }
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_EQ((size_t) nodes_ / 2, table_->Size());
+
+    for (int i = 0; i < nodes_; i++) {
+        string name = NetworkName(i);
+        EXPECT_EQ(TreeFind(name), table_->FindNode(name));
+        EXPECT_EQ(i % 2 == 1, table_->FindNode(name) != NULL);
+    }
+
+    // Add them back.
+    for (int i = 0; i < nodes_; i += 2) {
+        IFMapMsgNodeAdd(&db_, "virtual-network", NetworkName(i), 2);
+    }
+    task_util::WaitForIdle();
+    EXPECT_EQ((size_t) nodes_, table_->Size());
+    for (int i = 0; i < nodes_; i++) {
+        EXPECT_TRUE(table_->FindNode(NetworkName(i)) != NULL);
+    }
+}
+
+TEST_F(IFMapTableIndexTest, UuidLookup) {
+    LoadNetworks();
+
+    IFMapUuidMapper mapper;
+    vector<string> uuids;
+    uuids.reserve(nodes_);
+    uint64_t start = ClockMonotonicUsec();
+    for (int i = 0; i < nodes_; i++) {
+        uint64_t ms_long = 0x9a0b1c2d00000000ULL + i * 2654435761ULL;
+        uint64_t ls_long = 0x8000000000000000ULL | i;
+        uuids.push_back(mapper.Add(ms_long, ls_long,
+                                   table_->FindNode(NetworkName(i))));
+    }
+    uint64_t add_usecs = ClockMonotonicUsec() - start;
+    EXPECT_EQ((size_t) nodes_, mapper.Size());
+
+    start = ClockMonotonicUsec();
+    size_t found = 0;
+    for (int i = 0; i < nodes_; i++) {
+        found += (mapper.Find(uuids[i]) != NULL);
+    }
+    uint64_t find_usecs = ClockMonotonicUsec() - start;
+    EXPECT_EQ((size_t) nodes_, found);
+
+    for (int i = 0; i < nodes_; i++) {
+        EXPECT_EQ(NetworkName(i), mapper.Find(uuids[i])->name());
+    }
+    for (int i = 0; i < nodes_; i += 2) {
+        mapper.Delete(uuids[i]);
+    }
+    EXPECT_EQ((size_t) nodes_ / 2, mapper.Size());
+    for (int i = 0; i < nodes_; i++) {
+        EXPECT_EQ(i % 2 == 1, mapper.Exists(uuids[i]));
+    }
+    LOG(DEBUG, "uuid " << nodes_ << " nodes: add usecs " << add_usecs <<
+        " find usecs " << find_usecs);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    LoggingInit();
+    ControlNode::SetDefaultSchedulingPolicy();
+    int result = RUN_ALL_TESTS();
+    TaskScheduler::GetInstance()->Terminate();
+    return result;
+}
@@ -4,6 +4,9 @@
 
 #include "ifmap/ifmap_update_sender.h"
 
+#include <sstream>
+#include <pugixml/pugixml.hpp>
+
 #include "base/logging.h"
 #include "base/task.h"
 #include "base/test/task_test_util.h"
@@ -12,6 +15,7 @@
 #include "db/db_table.h"
 #include "io/event_manager.h"
 #include "ifmap/ifmap_client.h"
+#include "ifmap/ifmap_encoder.h"
 #include "ifmap/ifmap_exporter.h"
 #include "ifmap/ifmap_link_table.h"
 #include "ifmap/ifmap_node.h"
@@ -36,11 +40,13 @@ public:
 
     virtual bool SendUpdate(const std::string &msg) {
         cout << "Sending " << endl << msg << endl;
+        last_msg_ = msg;
         send_update_cnt_++;
         return send_success_;
     }
 
     int get_send_update_cnt() { return send_update_cnt_; }
+    const string &last_msg() const { return last_msg_; }
 
     // Control if you want to block or continue sending
     void set_send_success(bool succ) { send_success_ = succ; }
@@ -49,6 +55,7 @@ private:
     string identifier_;
     bool send_success_;
     int send_update_cnt_;
+    string last_msg_;
 };
 
 struct IFMapUpdateDeleter {
@@ -112,6 +119,47 @@ protected:
         sender_->SetSendBlocked(client_index);
     }
 
+    // The message of the node updates saved from a pugixml document, the
+    // way IFMapMessage built it before it kept the text of the updates.
+    static string DocumentMessage(const string &receiver,
+                                  const vector<IFMapUpdate *> &updates) {
+        pugi::xml_document doc;
+        pugi::xml_node iq = doc.append_child("iq");
+        iq.append_attribute("type") = "set";
+        iq.append_attribute("from") = "network-control@contrailsystems.com";
+        iq.append_attribute("to") = (receiver + "/config").c_str();
+        pugi::xml_node config = iq.append_child("config");
+        pugi::xml_node op_node;
+        bool op_update = false;
+        for (size_t i = 0; i < updates.size(); i++) {
+            IFMapUpdate *update = updates[i];
+            if (!op_node || op_update != update->IsUpdate()) {
+                op_update = update->IsUpdate();
+                op_node = config.append_child(op_update ? "update" : "delete");
+            }
+            IFMapNode *node = update->data().u.node;
+            if (op_update) {
+                node->EncodeNodeDetail(&op_node);
+            } else {
+                node->EncodeNode(&op_node);
+            }
+        }
+        ostringstream oss;
+        doc.save(oss);
+        return oss.str();
+    }
+
+    static string EncodeMessage(IFMapMessage *message, const string &receiver,
+                                const vector<IFMapUpdate *> &updates) {
+        message->Reset();
+        for (size_t i = 0; i < updates.size(); i++) {
+            message->EncodeUpdate(updates[i]);
+        }
+        message->SetReceiverInMsg(receiver);
+        message->Close();
+        return message->c_str();
+    }
+
     DB db_;
     DBGraph graph_;
     EventManager evm_;
@@ -1205,6 +1253,127 @@ TEST_F(IFMapUpdateSenderTest, Bug228) {
     queue_->PrintQueue();
 }
 
+// The updates are encoded once, when first sent, and the client that gets
+// them later receives the same text in its own envelope.
+TEST_F(IFMapUpdateSenderTest, SharedFragments) {
+    TestClient c0("c0");
+    TestClient c1("c1");
+    server_.ClientRegister(&c0);
+    server_.ClientRegister(&c1);
+
+    IFMapUpdate *u1 = CreateUpdate("u1", true);
+    IFMapUpdate *u2 = CreateUpdate("u2", true);
+    IFMapUpdate *u3 = CreateUpdate("u3", false);
+    IFMapUpdate *u4 = CreateUpdate("u4", true);
+
+    // Both to receive all updates.
+    BitSet cli_bs;
+    cli_bs.set(c0.index());
+    cli_bs.set(c1.index());
+    u1->AdvertiseOr(cli_bs);
+    u2->AdvertiseOr(cli_bs);
+    u3->AdvertiseOr(cli_bs);
+    u4->AdvertiseOr(cli_bs);
+
+    queue_->Join(c0.index());
+    queue_->Join(c1.index());
+
+    queue_->Enqueue(u1);
+    queue_->Enqueue(u2);
+    queue_->Enqueue(u3);
+    queue_->Enqueue(u4);
+    TASK_UTIL_EXPECT_EQ(5, queue_->size()); // 4 updates and 1 tail_marker
+
+    // c0 gets all the updates in one message and encodes them.
+    SetSendBlocked(c1.index());
+    sender_->SendActive(c0.index());
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_EQ(1, c0.get_send_update_cnt());
+    EXPECT_EQ(0, c1.get_send_update_cnt());
+    EXPECT_EQ(0U, sender_->message_stats().fragment_hits);
+    EXPECT_EQ(4U, sender_->message_stats().fragment_misses);
+    EXPECT_FALSE(u1->encoded().empty());
+
+    // c1 gets the same updates from their text.
+    sender_->SendActive(c1.index());
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_EQ(1, c1.get_send_update_cnt());
+    EXPECT_EQ(4U, sender_->message_stats().fragment_hits);
+    EXPECT_EQ(4U, sender_->message_stats().fragment_misses);
+    EXPECT_EQ(2U, sender_->message_stats().messages);
+    TASK_UTIL_EXPECT_EQ(1, queue_->size());
+
+    string msg(c0.last_msg());
+    size_t pos = msg.find("to=\"c0/config\"");
+    ASSERT_NE(string::npos, pos);
+    msg.replace(pos, 14, "to=\"c1/config\"");
+    EXPECT_EQ(msg, c1.last_msg());
+    EXPECT_NE(string::npos, msg.find("\t\t<update>\n"));
+    EXPECT_NE(string::npos, msg.find("\t\t<delete>\n"));
+
+    queue_->Leave(c0.index());
+    queue_->Leave(c1.index());
+}
+
+// The message built from the text of the updates is byte for byte the one
+// saved from a pugixml document, whether the text is encoded for the message
+// or reused from an earlier one.
+TEST_F(IFMapUpdateSenderTest, MessageMatchesDocument) {
+    vector<IFMapUpdate *> updates;
+    updates.push_back(CreateUpdate("u1", true));
+    updates.push_back(CreateUpdate("u2", true));
+    updates.push_back(CreateUpdate("u3", false));
+    updates.push_back(CreateUpdate("u4", true));
+    updates.push_back(CreateUpdate("u5", false));
+    updates.push_back(CreateUpdate("u6", false));
+    // Queued only so that the fixture can dispose of them.
+    BitSet cli_bs;
+    cli_bs.set(0);
+    for (size_t i = 0; i < updates.size(); i++) {
+        updates[i]->AdvertiseOr(cli_bs);
+        queue_->Enqueue(updates[i]);
+    }
+
+    const char *receivers[] = {
+        "vr1",
+        "a&b<c>d\"e'f",
+        "tab\tnew\nline\x01",
+    };
+    IFMapMessage message;
+    for (size_t i = 0; i < sizeof(receivers) / sizeof(receivers[0]); i++) {
+        string receiver(receivers[i]);
+
+        // An empty message.
+        vector<IFMapUpdate *> none;
+        EXPECT_EQ(DocumentMessage(receiver, none),
+                  EncodeMessage(&message, receiver, none)) << receiver;
+
+        // Single updates and deletes.
+        for (size_t j = 0; j < updates.size(); j++) {
+            vector<IFMapUpdate *> one(1, updates[j]);
+            EXPECT_EQ(DocumentMessage(receiver, one),
+                      EncodeMessage(&message, receiver, one)) << receiver;
+        }
+
+        // Updates and deletes mixed, in runs of each.
+        EXPECT_EQ(DocumentMessage(receiver, updates),
+                  EncodeMessage(&message, receiver, updates)) << receiver;
+        vector<IFMapUpdate *> reversed(updates.rbegin(), updates.rend());
+        EXPECT_EQ(DocumentMessage(receiver, reversed),
+                  EncodeMessage(&message, receiver, reversed)) << receiver;
+    }
+    EXPECT_EQ(updates.size(), message.stats().fragment_misses);
+    EXPECT_LT(0U, message.stats().fragment_hits);
+
+    // The receiver is escaped like pugixml does.
+    EncodeMessage(&message, receivers[1], updates);
+    EXPECT_NE(string::npos, string(message.c_str()).find(
+        "to=\"a&amp;b&lt;c&gt;d&quot;e'f/config\""));
+    EncodeMessage(&message, receivers[2], updates);
+    EXPECT_NE(string::npos, string(message.c_str()).find(
+        "to=\"tab&#09;new&#10;line&#01;/config\""));
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     bool success = RUN_ALL_TESTS();
@@ -3,6 +3,9 @@
  */
 
 #include "io/event_manager.h"
+
+#include <stdlib.h>
+
 #include "base/logging.h"
 #include "io/io_log.h"
 
@@ -10,39 +13,116 @@ using namespace boost::asio;
 
 SandeshTraceBufferPtr IOTraceBuf(SandeshTraceBufferCreate(IO_TRACE_BUF, 1000));
 
+struct EventManager::ShardThread {
+    ShardThread(EventManager *evm, size_t shard) : evm(evm), shard(shard) { }
+    EventManager *evm;
+    size_t shard;
+};
+
 EventManager::EventManager() {
+    size_t shard_count = 1;
+    char *threads_str = getenv("EVENT_MANAGER_THREADS");
+    if (threads_str) {
+        shard_count = strtoul(threads_str, NULL, 0);
+    }
+    Initialize(shard_count);
+}
+
+EventManager::EventManager(size_t shard_count) {
+    Initialize(shard_count);
+}
+
+EventManager::~EventManager() {
+    STLDeleteValues(&shards_);
+}
+
+void EventManager::Initialize(size_t shard_count) {
     shutdown_ = false;
+    next_shard_ = 0;
+    if (shard_count == 0) {
+        shard_count = 1;
+    }
+    for (size_t i = 0; i < shard_count; i++) {
+        shards_.push_back(new boost::asio::io_service());
+    }
 }
 
 void EventManager::Shutdown() {
     shutdown_ = true;
 
     // TODO: make sure that are no users of this event manager.
-    io_service_.stop();
+    for (size_t i = 0; i < shards_.size(); i++) {
+        shards_[i]->stop();
+    }
 }
 
+void *EventManager::ShardThreadRun(void *arg) {
+    ShardThread *thread = reinterpret_cast<ShardThread *>(arg);
+    thread->evm->RunShard(thread->shard);
+    delete thread;
+    return NULL;
+}
+
+void EventManager::RunShard(size_t shard) {
+    io_service::work work(*shards_[shard]);
+    if (shutdown_) return;
+    boost::system::error_code ec;
+    shards_[shard]->run(ec);
+    if (ec) {
+        EVENT_MANAGER_LOG_ERROR("io_service " << shard << " run failed: "
+                                << ec.message());
+    }
+}
+
+//
+// Run shard 0 in the calling thread and the other shards in threads of their
+// own, until shutdown.
+//
 void EventManager::Run() {
     assert(mutex_.try_lock());
-    io_service::work work(io_service_);
-    do {
-        if (shutdown_) break;
-        boost::system::error_code ec;
-        io_service_.run(ec);
-        if (ec) {
-            EVENT_MANAGER_LOG_ERROR("io_service run failed: " << ec.message());
-            continue;
-        }
-    } while(0);
+    for (size_t i = 1; i < shards_.size(); i++) {
+        pthread_t thread_id;
+        int res = pthread_create(&thread_id, NULL, &ShardThreadRun,
+                                 new ShardThread(this, i));
+        assert(res == 0);
+        threads_.push_back(thread_id);
+    }
+    RunShard(0);
+    for (size_t i = 0; i < threads_.size(); i++) {
+        int res = pthread_join(threads_[i], NULL);
+        assert(res == 0);
+    }
+    threads_.clear();
     mutex_.unlock();
 }
 
+// Run the ready handlers of the shards other than shard 0.
+size_t EventManager::PollShards() {
+    size_t res = 0;
+    for (size_t i = 1; i < shards_.size(); i++) {
+        boost::system::error_code err;
+        size_t count = shards_[i]->poll(err);
+        if (count == 0)
+            shards_[i]->reset();
+        res += count;
+    }
+    return res;
+}
+
+//
+// With several shards, the other shards are polled and shard 0 is only run
+// if they had nothing to do.
+//
 size_t EventManager::RunOnce() {
     assert(mutex_.try_lock());
     if (shutdown_) return 0;
-    boost::system::error_code err;
-    size_t res = io_service_.run_one(err);
-    if (res == 0)
-        io_service_.reset();
+    size_t res = PollShards();
+    if (res == 0) {
+        boost::system::error_code err;
+        res = io_service()->run_one(err);
+        if (res == 0)
+            io_service()->reset();
+    }
     mutex_.unlock();
     return res;
 }
@@ -51,9 +131,10 @@ size_t EventManager::Poll() {
     assert(mutex_.try_lock());
     if (shutdown_) return 0;
     boost::system::error_code err;
-    size_t res = io_service_.poll(err);
+    size_t res = io_service()->poll(err);
     if (res == 0)
-        io_service_.reset();
+        io_service()->reset();
+    res += PollShards();
     mutex_.unlock();
     return res;
 }
@@ -4,7 +4,10 @@
 
 #pragma once
 
+#include <pthread.h>
+#include <vector>
 #include <boost/asio/io_service.hpp>
+#include <tbb/atomic.h>
 #include <tbb/spin_mutex.h>
 
 #include "base/util.h"
@@ -18,9 +21,22 @@
 // Poll directly or indirectly after having started a ServerThread (which
 // calls Run).
 //
+// Sharding: the EventManager can be created with several io_services, or
+// shards. The thread that calls Run runs shard 0 and Run starts one thread
+// for each of the other shards. Each socket or timer is bound to the shard
+// of the io_service it was created with, so the handlers of a given session
+// are still run in order by a single thread. io_service() is shard 0, which
+// is used for acceptors and everything that doesn't ask for a shard.
+// NextIoService() spreads sessions and timers over the shards.
+//
+// The number of shards defaults to 1, or the value of the environment
+// variable EVENT_MANAGER_THREADS.
+//
 class EventManager {
 public:
     EventManager();
+    explicit EventManager(size_t shard_count);
+    ~EventManager();
 
     // Run until shutdown.
     void Run();
@@ -33,10 +49,32 @@ public:
 
     void Shutdown();
 
-    boost::asio::io_service *io_service() { return &io_service_; }
+    boost::asio::io_service *io_service() { return shards_[0]; }
+    boost::asio::io_service *io_service(size_t shard) {
+        return shards_[shard % shards_.size()];
+    }
+
+    // Returns the shards in round robin order.
+    boost::asio::io_service *NextIoService() {
+        if (shards_.size() == 1) {
+            return shards_[0];
+        }
+        return io_service(next_shard_++);
+    }
+
+    size_t shard_count() const { return shards_.size(); }
 
 private:
-    boost::asio::io_service io_service_;
+    struct ShardThread;
+
+    void Initialize(size_t shard_count);
+    static void *ShardThreadRun(void *arg);
+    void RunShard(size_t shard);
+    size_t PollShards();
+
+    std::vector<boost::asio::io_service *> shards_;
+    std::vector<pthread_t> threads_;
+    tbb::atomic<size_t> next_shard_;
     bool shutdown_;
     tbb::spin_mutex mutex_;
 
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "io/tcp_buffer_pool.h"
+
+#include <assert.h>
+
+using tbb::spin_mutex;
+
+TcpBufferPool::TcpBufferPool() {
+}
+
+TcpBufferPool::~TcpBufferPool() {
+    for (int i = 0; i < kSizeClasses; i++) {
+        for (FreeList::iterator iter = free_list_[i].begin();
+             iter != free_list_[i].end(); ++iter) {
+            delete[] *iter;
+        }
+        free_list_[i].clear();
+    }
+}
+
+// Sizes above kMaxBufferSize are not pooled and keep their size.
+size_t TcpBufferPool::BufferSize(size_t size) {
+    if (size > kMaxBufferSize) {
+        return size;
+    }
+    size_t bufsize = kMinBufferSize;
+    while (bufsize < size) {
+        bufsize <<= 1;
+    }
+    return bufsize;
+}
+
+int TcpBufferPool::SizeClass(size_t size) {
+    if (size > kMaxBufferSize) {
+        return -1;
+    }
+    int index = 0;
+    for (size_t bufsize = kMinBufferSize; bufsize < size; bufsize <<= 1) {
+        index++;
+    }
+    assert(index < kSizeClasses);
+    return index;
+}
+
+uint8_t *TcpBufferPool::Allocate(size_t size) {
+    size = BufferSize(size);
+    int index = SizeClass(size);
+    if (index >= 0) {
+        spin_mutex::scoped_lock lock(mutex_[index]);
+        if (!free_list_[index].empty()) {
+            uint8_t *data = free_list_[index].back();
+            free_list_[index].pop_back();
+            stats_.hits++;
+            stats_.cached_bytes -= size;
+            return data;
+        }
+    }
+    stats_.allocs++;
+    return new uint8_t[size];
+}
+
+void TcpBufferPool::Release(uint8_t *data, size_t size) {
+    assert(size == BufferSize(size));
+    int index = SizeClass(size);
+    if (index >= 0) {
+        spin_mutex::scoped_lock lock(mutex_[index]);
+        if ((free_list_[index].size() + 1) * size <= kMaxCachedBytes) {
+            free_list_[index].push_back(data);
+            stats_.cached_bytes += size;
+            return;
+        }
+    }
+    stats_.frees++;
+    delete[] data;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef __TCP_BUFFER_POOL_H__
+#define __TCP_BUFFER_POOL_H__
+
+#include <stdint.h>
+#include <vector>
+#include <tbb/atomic.h>
+#include <tbb/spin_mutex.h>
+
+#include "base/util.h"
+
+//
+// TcpBufferPool
+//
+// Pool of receive buffers shared by the sessions of a TcpServer. Buffers
+// come in size classes, powers of two from kMinBufferSize to kMaxBufferSize,
+// and released buffers are kept in a free list per size class so that reads
+// don't go through malloc and free in the steady state. Each free list holds
+// at most kMaxCachedBytes; buffers beyond that are returned to the heap.
+//
+// Concurrency: Allocate and Release may be called from any thread.
+//
+class TcpBufferPool {
+public:
+    static const size_t kMinBufferSize = 4 * 1024;
+    static const size_t kMaxBufferSize = 64 * 1024;
+    static const int kSizeClasses = 5;
+    static const size_t kMaxCachedBytes = 1024 * 1024;
+
+    struct Stats {
+        Stats() {
+            allocs = 0;
+            hits = 0;
+            frees = 0;
+            cached_bytes = 0;
+        }
+
+        tbb::atomic<uint64_t> allocs;       // Allocated from the heap
+        tbb::atomic<uint64_t> hits;         // Allocated from a free list
+        tbb::atomic<uint64_t> frees;        // Returned to the heap
+        tbb::atomic<uint64_t> cached_bytes; // Bytes in the free lists
+    };
+
+    TcpBufferPool();
+    ~TcpBufferPool();
+
+    // Returns the size of the buffers that Allocate returns for size.
+    static size_t BufferSize(size_t size);
+
+    // Allocate a buffer of BufferSize(size) bytes.
+    uint8_t *Allocate(size_t size);
+
+    // Release a buffer, size must be the size it was allocated with.
+    void Release(uint8_t *data, size_t size);
+
+    const Stats &stats() const { return stats_; }
+
+private:
+    typedef std::vector<uint8_t *> FreeList;
+
+    static int SizeClass(size_t size);
+
+    tbb::spin_mutex mutex_[kSizeClasses];
+    FreeList free_list_[kSizeClasses];
+    Stats stats_;
+
+    DISALLOW_COPY_AND_ASSIGN(TcpBufferPool);
+};
+
+#endif // __TCP_BUFFER_POOL_H__
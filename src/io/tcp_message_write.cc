@@ -14,26 +14,26 @@ using namespace boost::system;
 using tbb::mutex;
 
 TcpMessageWriter::TcpMessageWriter(Socket *socket, TcpSession *session) :
-    socket_(socket), offset_(0), session_(session) {
+    socket_(socket), offset_(0), pending_bytes_(0), session_(session) {
 }
 
 TcpMessageWriter::~TcpMessageWriter() {
-    for (BufferQueue::iterator iter = buffer_queue_.begin();
-         iter != buffer_queue_.end(); ++iter) {
-        DeleteBuffer(*iter);
-    }
     buffer_queue_.clear();
 }
 
-int TcpMessageWriter::Send(const uint8_t *data, size_t len, error_code &ec) {
-    int wrote = 0;
-
+void TcpMessageWriter::UpdateStats(size_t len) {
     // Update socket write call statistics.
     session_->stats_.write_calls++;
     session_->stats_.write_bytes += len;
 
     session_->server_->stats_.write_calls++;
     session_->server_->stats_.write_bytes += len;
+}
+
+int TcpMessageWriter::Send(const uint8_t *data, size_t len, error_code &ec) {
+    int wrote = 0;
+
+    UpdateStats(len);
 
     if (buffer_queue_.empty()) {
         wrote = socket_->write_some(boost::asio::buffer(data, len), ec);
@@ -55,6 +55,57 @@ int TcpMessageWriter::Send(const uint8_t *data, size_t len, error_code &ec) {
     return wrote;
 }
 
+int TcpMessageWriter::Send(const TcpSendBufferList &buffers, error_code &ec) {
+    size_t len = 0;
+    for (TcpSendBufferList::const_iterator iter = buffers.begin();
+         iter != buffers.end(); ++iter) {
+        len += (*iter)->size();
+    }
+    UpdateStats(len);
+
+    if (!buffer_queue_.empty()) {
+        TCP_SESSION_LOG_UT_DEBUG(session_, TCP_DIR_OUT,
+            "Write not ready. Enqueue " << buffers.size() << " buffers (len = "
+            << len << ") and return");
+        for (TcpSendBufferList::const_iterator iter = buffers.begin();
+             iter != buffers.end(); ++iter) {
+            BufferAppend(*iter, 0);
+        }
+        return 0;
+    }
+
+    GatherList list;
+    for (TcpSendBufferList::const_iterator iter = buffers.begin();
+         iter != buffers.end() && list.size() < (size_t) kMaxGatherBuffers;
+         ++iter) {
+        list.push_back(const_buffer((*iter)->data(), (*iter)->size()));
+    }
+    int wrote = socket_->write_some(list, ec);
+    if (TcpSession::IsSocketErrorHard(ec)) return -1;
+    assert(wrote >= 0);
+
+    if ((size_t)wrote != len) {
+        TCP_SESSION_LOG_UT_DEBUG(session_, TCP_DIR_OUT,
+            "Encountered partial send of " << wrote << " bytes when "
+            "sending " << len << " bytes, Error: " << ec);
+
+        // Queue the buffers that were not completely written, by reference.
+        size_t skip = wrote;
+        for (TcpSendBufferList::const_iterator iter = buffers.begin();
+             iter != buffers.end(); ++iter) {
+            size_t size = (*iter)->size();
+            if (skip >= size) {
+                skip -= size;
+                continue;
+            }
+            BufferAppend(*iter, skip);
+            skip = 0;
+        }
+        DeferWrite();
+    }
+    return wrote;
+}
+
 void TcpMessageWriter::DeferWrite() {
 
     // Update socket write block count.
@@ -68,6 +119,44 @@ void TcpMessageWriter::DeferWrite() {
     return;
 }
 
+//
+// Fill the list with the queued data, starting at the unwritten part of
+// the head buffer. Return the number of bytes in the list.
+//
+size_t TcpMessageWriter::Gather(GatherList *list) const {
+    size_t bytes = 0;
+    size_t offset = offset_;
+    for (BufferQueue::const_iterator iter = buffer_queue_.begin();
+         iter != buffer_queue_.end() &&
+         list->size() < (size_t) kMaxGatherBuffers; ++iter) {
+        const TcpSendBufferPtr &buffer = *iter;
+        list->push_back(const_buffer(buffer->data() + offset,
+                                     buffer->size() - offset));
+        bytes += buffer->size() - offset;
+        offset = 0;
+    }
+    return bytes;
+}
+
+//
+// Drop the first bytes of the queued data, which have been written to the
+// socket.
+//
+void TcpMessageWriter::Consume(size_t bytes) {
+    assert(bytes <= pending_bytes_);
+    pending_bytes_ -= bytes;
+    while (!buffer_queue_.empty()) {
+        size_t remaining = buffer_queue_.front()->size() - offset_;
+        if (bytes < remaining) {
+            offset_ += bytes;
+            return;
+        }
+        bytes -= remaining;
+        offset_ = 0;
+        buffer_queue_.pop_front();
+    }
+}
+
 // Socket is ready for write. Flush any pending data and notify 
 // clients aboout it.
 void TcpMessageWriter::HandleWriteReady(TcpSessionPtr session_ptr,
@@ -90,28 +179,22 @@ void TcpMessageWriter::HandleWriteReady(TcpSessionPtr session_ptr,
     if (session_->IsClosedLocked()) return;
 
     while (!buffer_queue_.empty()) {
-        boost::asio::mutable_buffer head = buffer_queue_.front();
-        const uint8_t *data = buffer_cast<const uint8_t *>(head) + offset_;
-        int remaining = buffer_size(head) - offset_;
+        GatherList list;
+        size_t remaining = Gather(&list);
         error_code ec;
-        int wrote = socket_->write_some(buffer(data, remaining), ec);
+        size_t wrote = socket_->write_some(list, ec);
         if (TcpSession::IsSocketErrorHard(ec)) {
             lock.release();
             if (!cb_.empty()) cb_(ec);
             return;
         }
-        assert(wrote >= 0);
+        Consume(wrote);
         if (wrote != remaining) {
-            offset_ += wrote;
             DeferWrite();
             return;
-        } else {
-            offset_ = 0;
-            DeleteBuffer(head);
-            buffer_queue_.pop_front();
         }
     }
-    buffer_queue_.clear();
+    assert(pending_bytes_ == 0);
 
 done:
     lock.release();
@@ -124,17 +207,27 @@ done:
     return;
 }
 
+//
+// Copy data that the caller owns into a new buffer.
+//
 void TcpMessageWriter::BufferAppend(const uint8_t *src, int bytes) {
-    u_int8_t *data = new u_int8_t[bytes];
-    memcpy(data, src, bytes);
-    mutable_buffer buffer = mutable_buffer(data, bytes);
-    buffer_queue_.push_back(buffer);
+    session_->stats_.write_copies++;
+    session_->stats_.write_copy_bytes += bytes;
+    session_->server_->stats_.write_copies++;
+    session_->server_->stats_.write_copy_bytes += bytes;
+    BufferAppend(TcpSendBufferPtr(TcpSendBuffer::Copy(src, bytes)), 0);
 }
 
-void TcpMessageWriter::DeleteBuffer(mutable_buffer buffer) {
-    const uint8_t *data = buffer_cast<const uint8_t *>(buffer);
-    delete[] data;
-    return;
+void TcpMessageWriter::BufferAppend(TcpSendBufferPtr buffer, size_t offset) {
+    if (buffer->size() == offset)
+        return;
+    if (buffer_queue_.empty()) {
+        offset_ = offset;
+    } else {
+        assert(offset == 0);
+    }
+    pending_bytes_ += buffer->size() - offset;
+    buffer_queue_.push_back(buffer);
 }
 
 void TcpMessageWriter::RegisterNotification(SendReadyCb cb) {
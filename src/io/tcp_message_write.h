@@ -5,7 +5,8 @@
 #ifndef __MESSAGE_WRITE_H__
 #define __MESSAGE_WRITE_H__
 
-#include <list>
+#include <deque>
+#include <vector>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/asio/buffer.hpp>
@@ -13,29 +14,53 @@
 #include <boost/system/error_code.hpp>
 #include <tbb/mutex.h>
 #include "base/util.h"
+#include "io/tcp_send_buffer.h"
 
 using namespace boost::system;
 
 class TcpSession;
 
+//
+// TcpMessageWriter
+//
+// Writes to a non-blocking socket. Data that can't be written right away is
+// queued as a list of TcpSendBuffers and flushed with scatter-gather writes
+// once the socket becomes writable. Buffers that are sent through the
+// TcpSendBufferList interface are queued by reference; only the unsent tail
+// of a raw (data, len) send is copied.
+//
+// Concurrency: all methods are called with the session mutex held.
+//
 class TcpMessageWriter {
 public:
     typedef boost::asio::ip::tcp::socket Socket;
     static const int kDefaultBufferSize = 4 * 1024;
+    // Max number of buffers handed to the socket in one write call.
+    static const int kMaxGatherBuffers = 64;
     explicit TcpMessageWriter(Socket *, TcpSession *session);
     ~TcpMessageWriter();
 
-    // return false for send  
+    // Return the number of bytes written to the socket, or -1 on a hard
+    // socket error. The rest of the data is queued.
     int Send(const uint8_t *msg, size_t len, error_code &ec);
+    int Send(const TcpSendBufferList &buffers, error_code &ec);
+
+    // Number of bytes queued for write.
+    size_t pending_bytes() const { return pending_bytes_; }
 
     typedef boost::function<void(const error_code &ec)> SendReadyCb;
     void RegisterNotification(SendReadyCb);
 
 private:
     typedef boost::intrusive_ptr<TcpSession> TcpSessionPtr;
-    typedef std::list<boost::asio::mutable_buffer> BufferQueue;
+    typedef std::deque<TcpSendBufferPtr> BufferQueue;
+    typedef std::vector<boost::asio::const_buffer> GatherList;
+
     void BufferAppend(const uint8_t *data, int len);
-    void DeleteBuffer(boost::asio::mutable_buffer buffer); 
+    void BufferAppend(TcpSendBufferPtr buffer, size_t offset);
+    size_t Gather(GatherList *list) const;
+    void Consume(size_t bytes);
+    void UpdateStats(size_t len);
     void DeferWrite();
     void HandleWriteReady(TcpSessionPtr session_ref, const error_code &ec,
                           uint64_t block_start_time);
@@ -43,7 +68,8 @@ private:
     BufferQueue buffer_queue_;
     SendReadyCb cb_;
     Socket *socket_;
-    int offset_;
+    size_t offset_;             // Bytes of the head buffer already written.
+    size_t pending_bytes_;
     TcpSession *session_;
 };
 
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef __TCP_SEND_BUFFER_H__
+#define __TCP_SEND_BUFFER_H__
+
+#include <string.h>
+#include <vector>
+#include <boost/intrusive_ptr.hpp>
+#include <tbb/atomic.h>
+
+#include "base/util.h"
+
+//
+// TcpSendBuffer
+//
+// Reference counted buffer for the zero-copy send path of TcpSession.
+// A message that goes to many sessions (e.g. a BGP update or an XMPP route
+// message) is encoded once into a TcpSendBuffer and handed to each session.
+// A session that can't write the message to the socket right away keeps a
+// reference to the buffer instead of copying the unsent part.
+//
+// The contents must not be modified once the buffer has been sent.
+//
+class TcpSendBuffer {
+public:
+    // Allocate a buffer of size bytes, to be filled in by the caller.
+    explicit TcpSendBuffer(size_t size)
+        : data_(new uint8_t[size]), size_(size) {
+        refcount_ = 0;
+    }
+
+    // Take ownership of data, which must have been allocated with new[].
+    TcpSendBuffer(uint8_t *data, size_t size) : data_(data), size_(size) {
+        refcount_ = 0;
+    }
+
+    ~TcpSendBuffer() {
+        delete[] data_;
+    }
+
+    static TcpSendBuffer *Copy(const uint8_t *data, size_t size) {
+        TcpSendBuffer *buffer = new TcpSendBuffer(size);
+        memcpy(buffer->data_, data, size);
+        return buffer;
+    }
+
+    uint8_t *data() { return data_; }
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    friend void intrusive_ptr_add_ref(TcpSendBuffer *buffer);
+    friend void intrusive_ptr_release(TcpSendBuffer *buffer);
+
+    uint8_t *data_;
+    size_t size_;
+    tbb::atomic<int> refcount_;
+
+    DISALLOW_COPY_AND_ASSIGN(TcpSendBuffer);
+};
+
+inline void intrusive_ptr_add_ref(TcpSendBuffer *buffer) {
+    buffer->refcount_.fetch_and_increment();
+}
+
+inline void intrusive_ptr_release(TcpSendBuffer *buffer) {
+    int prev = buffer->refcount_.fetch_and_decrement();
+    if (prev == 1) {
+        delete buffer;
+    }
+}
+
+typedef boost::intrusive_ptr<TcpSendBuffer> TcpSendBufferPtr;
+typedef std::vector<TcpSendBufferPtr> TcpSendBufferList;
+
+#endif // __TCP_SEND_BUFFER_H__
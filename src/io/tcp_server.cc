@@ -19,7 +19,7 @@ using namespace std;
 using namespace tbb;
 
 TcpServer::TcpServer(EventManager *evm)
-    : evm_(evm) {
+    : evm_(evm), buffer_pool_(new TcpBufferPool()) {
     refcount_ = 0;
     TcpServerManager::AddServer(this);
 }
@@ -136,7 +136,7 @@ void TcpServer::ClearSessions() {
 }
 
 TcpSession *TcpServer::CreateSession() {
-    Socket *socket = new Socket(*evm_->io_service());
+    Socket *socket = new Socket(*evm_->NextIoService());
     TcpSession *session = AllocSession(socket);
     {
         mutex::scoped_lock lock(mutex_);
@@ -196,7 +196,7 @@ void TcpServer::AsyncAccept() {
     if (acceptor_ == NULL) {
         return;
     }
-    so_accept_.reset(new Socket(*evm_->io_service()));
+    so_accept_.reset(new Socket(*evm_->NextIoService()));
     acceptor_->async_accept(*so_accept_.get(),
         boost::bind(&TcpServer::AcceptHandlerInternal, this,
             TcpServerPtr(this), boost::asio::placeholders::error));
@@ -381,6 +381,13 @@ void TcpServer::GetRxSocketStats(TcpServerSocketStats &socket_stats) {
     if (stats_.read_calls) {
         socket_stats.average_bytes = stats_.read_bytes/stats_.read_calls;
     }
+    socket_stats.copies = stats_.read_copies;
+    socket_stats.copy_bytes = stats_.read_copy_bytes;
+    const TcpBufferPool::Stats &pool_stats = buffer_pool_->stats();
+    socket_stats.buffer_allocs = pool_stats.allocs;
+    socket_stats.buffer_pool_hits = pool_stats.hits;
+    socket_stats.buffer_frees = pool_stats.frees;
+    socket_stats.buffer_cached_bytes = pool_stats.cached_bytes;
 }
 
 void TcpServer::GetTxSocketStats(TcpServerSocketStats &socket_stats) {
@@ -398,6 +405,8 @@ void TcpServer::GetTxSocketStats(TcpServerSocketStats &socket_stats) {
                      stats_.write_blocked_duration_usecs/
                      stats_.write_blocked);
     }
+    socket_stats.copies = stats_.write_copies;
+    socket_stats.copy_bytes = stats_.write_copy_bytes;
 }
 
 //
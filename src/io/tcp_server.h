@@ -10,12 +10,14 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/intrusive_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <tbb/mutex.h>
 #ifndef _LIBCPP_VERSION
 #include <tbb/compat/condition_variable>
 #endif
 
 #include "base/util.h"
+#include "io/tcp_buffer_pool.h"
 
 class EventManager;
 class TcpSession;
@@ -64,6 +66,10 @@ class TcpServer {
             write_bytes = 0;
             write_blocked = 0;
             write_blocked_duration_usecs = 0;
+            write_copies = 0;
+            write_copy_bytes = 0;
+            read_copies = 0;
+            read_copy_bytes = 0;
         }
 
         tbb::atomic<uint64_t> read_calls;
@@ -72,6 +78,13 @@ class TcpServer {
         tbb::atomic<uint64_t> write_bytes;
         tbb::atomic<uint64_t> write_blocked;
         tbb::atomic<uint64_t> write_blocked_duration_usecs;
+        // Sends whose unwritten part had to be copied, and the bytes copied.
+        tbb::atomic<uint64_t> write_copies;
+        tbb::atomic<uint64_t> write_copy_bytes;
+        // Received messages that had to be reassembled from several reads,
+        // and the bytes copied.
+        tbb::atomic<uint64_t> read_copies;
+        tbb::atomic<uint64_t> read_copy_bytes;
     };
     const SocketStats &GetSocketStats() const { return stats_; }
 
@@ -84,6 +97,9 @@ class TcpServer {
 
     EventManager *event_manager() { return evm_; }
 
+    // Pool of the receive buffers of the sessions.
+    TcpBufferPool *buffer_pool() { return buffer_pool_.get(); }
+
     // Returns true if any of the sessions on this server has read available
     // data.
     bool HasSessionReadAvailable() const;
@@ -114,6 +130,7 @@ class TcpServer {
 
   private:
     friend class TcpSession;
+    friend class TcpMessageReader;
     friend class TcpMessageWriter;
     friend void intrusive_ptr_add_ref(TcpServer *server);
     friend void intrusive_ptr_release(TcpServer *server);
@@ -143,6 +160,8 @@ class TcpServer {
 
     SocketStats stats_;
     EventManager *evm_;
+    // Shared with the sessions, which may outlive the server.
+    boost::shared_ptr<TcpBufferPool> buffer_pool_;
     // mutex protects the session maps
     mutable tbb::mutex mutex_;
     std::condition_variable cond_var_;
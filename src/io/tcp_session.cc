@@ -6,7 +6,6 @@
 
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
-#include <boost/scoped_array.hpp>
 #include <boost/asio/detail/socket_option.hpp>
 
 #include "base/logging.h"
@@ -50,7 +49,9 @@ TcpSession::TcpSession(
     : server_(server),
       socket_(socket),
       read_on_connect_(async_read_ready),
+      buffer_pool_(server->buffer_pool_),
       buffer_size_(kDefaultBufferSize),
+      small_reads_(0),
       established_(false),
       closed_(false),
       direction_(ACTIVE),
@@ -75,18 +76,41 @@ TcpSession::~TcpSession() {
 }
 
 mutable_buffer TcpSession::AllocateBuffer() {
-    u_int8_t *data = new u_int8_t[buffer_size_];
-    mutable_buffer buffer = mutable_buffer(data, buffer_size_);
-    {
-        mutex::scoped_lock lock(mutex_);
-        buffer_queue_.push_back(buffer);
-    }
+    mutex::scoped_lock lock(mutex_);
+    size_t size = TcpBufferPool::BufferSize(buffer_size_);
+    mutable_buffer buffer = mutable_buffer(buffer_pool_->Allocate(size), size);
+    buffer_queue_.push_back(buffer);
     return buffer;
 }
 
 void TcpSession::DeleteBuffer(mutable_buffer buffer) {
-    uint8_t *data = buffer_cast<uint8_t *>(buffer);
-    delete[] data;
+    buffer_pool_->Release(buffer_cast<uint8_t *>(buffer),
+                          buffer_size(buffer));
+}
+
+//
+// Adapt the size of the next reads to the data that the socket has, so that
+// a burst is read with few large reads and an idle session doesn't hold on
+// to large buffers.
+//
+// Requires: lock must be held
+void TcpSession::UpdateBufferSize(size_t size, size_t bytes_transferred) {
+    if (bytes_transferred == size) {
+        small_reads_ = 0;
+        if (buffer_size_ < kMaxBufferSize) {
+            buffer_size_ *= 2;
+        }
+        return;
+    }
+    if (buffer_size_ > kDefaultBufferSize &&
+        bytes_transferred < (size_t) buffer_size_ / 4) {
+        if (++small_reads_ == kShrinkReads) {
+            buffer_size_ /= 2;
+            small_reads_ = 0;
+        }
+    } else {
+        small_reads_ = 0;
+    }
 }
 
 static int BufferCmp(const mutable_buffer &lhs, const const_buffer &rhs) {
@@ -296,6 +320,66 @@ bool TcpSession::Send(const u_int8_t *data, size_t size, size_t *sent) {
     return ret;
 }
 
+//
+// The buffers are bound to the handler so that they stay around until the
+// asynchronous write completes.
+//
+void TcpSession::AsyncWriteBuffersHandler(TcpSessionPtr session,
+                                          TcpSendBufferList buffers,
+                                          const boost::system::error_code &error) {
+    AsyncWriteHandler(session, error);
+}
+
+bool TcpSession::SendBuffers(const TcpSendBufferList &buffers, size_t *sent) {
+    bool ret = true;
+    mutex::scoped_lock lock(mutex_);
+
+    // Reset sent, if provided.
+    if (sent) *sent = 0;
+
+    //
+    // If the session closed in the mean while, bail out
+    //
+    if (!established_) return false;
+
+    size_t size = 0;
+    for (TcpSendBufferList::const_iterator iter = buffers.begin();
+         iter != buffers.end(); ++iter) {
+        size += (*iter)->size();
+    }
+
+    if (socket_->non_blocking()) {
+        boost::system::error_code error;
+        int len = writer_->Send(buffers, error);
+        lock.release();
+        if (len < 0) {
+            TCP_SESSION_LOG_INFO(this, TCP_DIR_OUT,
+                "Write failed due to error: " << error.category().name() << " "
+                                              << error.message());
+            CloseInternal(true);
+            return false;
+        }
+        if ((size_t)len != size) ret = false;
+        if (sent) *sent = len;
+    } else {
+        vector<const_buffer> list;
+        for (TcpSendBufferList::const_iterator iter = buffers.begin();
+             iter != buffers.end(); ++iter) {
+            list.push_back(const_buffer((*iter)->data(), (*iter)->size()));
+        }
+        boost::asio::async_write(*socket_.get(), list,
+            boost::bind(&TcpSession::AsyncWriteBuffersHandler,
+                        TcpSessionPtr(this), buffers, placeholders::error));
+        if (sent) *sent = size;
+    }
+    return ret;
+}
+
+size_t TcpSession::GetWritePendingBytes() const {
+    mutex::scoped_lock lock(mutex_);
+    return writer_->pending_bytes();
+}
+
 void TcpSession::AsyncReadHandler(
     TcpSessionPtr session, mutable_buffer buffer,
     const boost::system::error_code &error, size_t bytes_transferred) {
@@ -316,6 +400,8 @@ void TcpSession::AsyncReadHandler(
         return;
     }
 
+    session->UpdateBufferSize(buffer_size(buffer), bytes_transferred);
+
     // Update read statistics.
     session->stats_.read_calls++;
     session->stats_.read_bytes += bytes_transferred;
@@ -401,6 +487,10 @@ uint8_t *TcpMessageReader::BufferConcat(uint8_t *data, Buffer buffer,
     memcpy(dst, TcpSession::BufferData(buffer), count);
     offset_ = count;
 
+    session_->stats_.read_copies++;
+    session_->stats_.read_copy_bytes += msglength;
+    session_->server_->stats_.read_copies++;
+    session_->server_->stats_.read_copy_bytes += msglength;
     return data;
 }
 
@@ -467,8 +557,8 @@ void TcpMessageReader::OnRead(Buffer buffer) {
                 queue_.push_back(buffer);
                 return;
             }
-            boost::scoped_array<uint8_t> data(new uint8_t[kHeaderLenSize]);
-            Buffer header = PullUp(data.get(), buffer, kHeaderLenSize);
+            header_.resize(kHeaderLenSize);
+            Buffer header = PullUp(&header_[0], buffer, kHeaderLenSize);
             assert(TcpSession::BufferSize(header) == (size_t) kHeaderLenSize);
 
             msglength = MsgLength(header, 0);
@@ -486,13 +576,20 @@ void TcpMessageReader::OnRead(Buffer buffer) {
             return;
         }
 
-        // concat the buffers into a contiguous message.
-        boost::scoped_array<uint8_t>
-            data(new uint8_t[AllocBufferSize(msglength)]);
-        BufferConcat(data.get(), buffer, msglength);
+        // concat the buffers into a contiguous message. The scratch buffer
+        // is reused, so this doesn't allocate once it has reached the usual
+        // message size.
+        if (data_.size() < (size_t) msglength) {
+            data_.resize(AllocBufferSize(msglength));
+        }
+        BufferConcat(&data_[0], buffer, msglength);
         assert(remain_ == -1);
         // Receive the message
-        callback_(data.get(), msglength);
+        callback_(&data_[0], msglength);
+        // Don't hold on to the space of a message larger than a read buffer.
+        if (data_.size() > (size_t) TcpSession::kMaxBufferSize) {
+            std::vector<uint8_t>(TcpSession::kMaxBufferSize).swap(data_);
+        }
     }
 
     int avail = size - offset_;
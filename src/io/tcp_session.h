@@ -7,6 +7,7 @@
 
 #include <list>
 #include <deque>
+#include <vector>
 
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/io_service.hpp>
@@ -14,6 +15,7 @@
 #include <boost/intrusive_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <tbb/mutex.h>
 #include <tbb/task.h>
@@ -21,6 +23,7 @@
 #include <tbb/compat/condition_variable>
 #endif
 #include "base/util.h"
+#include "io/tcp_send_buffer.h"
 #include "io/tcp_server.h"
 
 class EventManager;
@@ -35,7 +38,12 @@ class TcpMessageWriter;
 // invoked by a different thread.
 class TcpSession {
   public:
+    // Read buffer sizes. The size of the reads adapts to the traffic: it
+    // doubles when a read fills the buffer, and halves after kShrinkReads
+    // consecutive reads that use less than a quarter of it.
     static const int kDefaultBufferSize = 4 * 1024;
+    static const int kMaxBufferSize = 64 * 1024;
+    static const int kShrinkReads = 16;
 
     enum Event {
         EVENT_NONE,
@@ -59,6 +67,16 @@ class TcpSession {
     // Performs a non-blocking send operation.
     virtual bool Send(const u_int8_t *data, size_t size, size_t *sent);
 
+    // Performs a non-blocking scatter-gather send of the buffers. The part
+    // that can't be written right away is queued by reference, without
+    // copying, so the same buffers can be sent on many sessions. Like Send,
+    // returns false if not everything was written, in which case WriteReady
+    // is called once the queued data has been flushed.
+    virtual bool SendBuffers(const TcpSendBufferList &buffers, size_t *sent);
+
+    // Number of bytes queued for write, waiting for the socket.
+    size_t GetWritePendingBytes() const;
+
     // Called by TcpServer to trigger async read.
     virtual bool Connected(Endpoint remote);
     
@@ -130,6 +148,12 @@ class TcpSession {
 
     const TcpServer::SocketStats &GetSocketStats() const { return stats_; }
 
+    // Size of the next read buffer.
+    int read_buffer_size() const {
+        tbb::mutex::scoped_lock lock(mutex_);
+        return buffer_size_;
+    }
+
   protected:
     virtual ~TcpSession();
 
@@ -149,6 +173,7 @@ class TcpSession {
   private:
     typedef boost::intrusive_ptr<TcpSession> TcpSessionPtr;
     friend class TcpServer;
+    friend class TcpMessageReader;
     friend class TcpMessageWriter;
     friend void intrusive_ptr_add_ref(TcpSession *session);
     friend void intrusive_ptr_release(TcpSession *session);
@@ -162,6 +187,9 @@ class TcpSession {
 			  size_t size);
     static void AsyncWriteHandler(TcpSessionPtr session,
                                   const boost::system::error_code &error);
+    static void AsyncWriteBuffersHandler(TcpSessionPtr session,
+                                         TcpSendBufferList buffers,
+                                         const boost::system::error_code &error);
 
     void ReleaseBufferLocked(Buffer buffer);
     void CloseInternal(bool callObserver);
@@ -176,6 +204,7 @@ class TcpSession {
 
     boost::asio::mutable_buffer AllocateBuffer();
     void DeleteBuffer(boost::asio::mutable_buffer buffer);
+    void UpdateBufferSize(size_t size, size_t bytes_transferred);
     void WriteReadyInternal(const boost::system::error_code &);
 
     static int reader_task_id_;
@@ -183,12 +212,14 @@ class TcpSession {
     TcpServer *server_;
     boost::scoped_ptr<Socket> socket_;
     bool read_on_connect_;
-    int buffer_size_;
+    boost::shared_ptr<TcpBufferPool> buffer_pool_;
 
     // Protects session state and buffer queue.
     mutable tbb::mutex mutex_;
 
     /**************** protected by mutex_ ****************/
+    int buffer_size_;           // Size of the next read buffer.
+    int small_reads_;           // Consecutive reads below buffer_size_ / 4
     bool established_;          // In TCP ESTABLISHED state.
     bool closed_;               // Close has been called.
     Endpoint remote_;           // Remote end-point
@@ -255,6 +286,10 @@ private:
     TcpSession *session_;
     ReceiveCallback callback_;
     BufferQueue queue_;
+    // Scratch space for headers and messages that span several reads,
+    // reused from message to message.
+    std::vector<uint8_t> header_;
+    std::vector<uint8_t> data_;
     int offset_;
     int remain_;
 
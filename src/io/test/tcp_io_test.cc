@@ -3,6 +3,7 @@
  */
 
 #include <memory>
+#include <vector>
 
 #include <pthread.h>
 #include <sys/types.h>
@@ -104,6 +105,10 @@ class EchoServer : public TcpServer {
         return session_->Send(data, size, actual);
     }
 
+    bool SendBuffers(const TcpSendBufferList &buffers, size_t *actual) {
+        return session_->SendBuffers(buffers, actual);
+    }
+
     EchoSession *GetSession() const { return session_; }
     void SetSocketOptions() { session_->SetSocketOptions(); }
 
@@ -315,6 +320,99 @@ TEST_F(EchoServerTest, SendAfterClose) {
     TASK_UTIL_ASSERT_NE(0, server_->GetSession()->GetTotal());
 }
 
+//
+// Send the same buffer repeatedly until the socket blocks. The data that is
+// queued must be held by reference and not copied.
+//
+TEST_F(EchoServerTest, SendBuffers) {
+    server_->Initialize(0);
+    task_util::WaitForIdle();
+    thread_->Start();
+    int port = server_->GetPort();
+    ASSERT_LT(0, port);
+
+    client_->CreateSession();
+    client_->EchoServer::ConnectTest(port);
+    client_->SetSocketOptions();
+    task_util::WaitForIdle();
+    TASK_UTIL_ASSERT_TRUE((server_->GetSession() != NULL));
+
+    TcpSendBufferPtr buffer(new TcpSendBuffer(4096));
+    memset(buffer->data(), 0xcd, buffer->size());
+    TcpSendBufferList buffers;
+    buffers.push_back(buffer);
+    buffers.push_back(buffer);
+    const int size = 2 * buffer->size();
+
+    bool res = true;
+    int total = 0;
+    size_t sent = 0;
+    while (res) {
+        res = client_->SendBuffers(buffers, &sent);
+        total += size;
+    }
+    EXPECT_GT((size_t) size, sent);
+    for (int i = 0; i < 5; i++) {
+        res = client_->SendBuffers(buffers, &sent);
+        EXPECT_FALSE(res);
+        EXPECT_EQ(0, sent);
+        total += size;
+    }
+    EXPECT_LE((size_t) 5 * size,
+              client_->GetSession()->GetWritePendingBytes());
+
+    TASK_UTIL_ASSERT_EQ(total, server_->GetSession()->GetTotal());
+    TASK_UTIL_EXPECT_EQ(0, client_->GetSession()->GetWritePendingBytes());
+    TASK_UTIL_EXPECT_TRUE(client_->GetSession()->called);
+
+    const TcpServer::SocketStats &stats =
+        client_->GetSession()->GetSocketStats();
+    EXPECT_EQ(0, stats.write_copies);
+    EXPECT_EQ(0, stats.write_copy_bytes);
+    EXPECT_EQ(total, stats.write_bytes);
+}
+
+TEST(TcpBufferPoolTest, Basic) {
+    TcpBufferPool pool;
+    EXPECT_EQ((size_t) TcpBufferPool::kMinBufferSize,
+              TcpBufferPool::BufferSize(1));
+    EXPECT_EQ(8192, TcpBufferPool::BufferSize(4097));
+    EXPECT_EQ((size_t) TcpBufferPool::kMaxBufferSize,
+              TcpBufferPool::BufferSize(TcpBufferPool::kMaxBufferSize));
+    EXPECT_EQ(100000, TcpBufferPool::BufferSize(100000));
+
+    // Released buffers are reused.
+    uint8_t *data = pool.Allocate(4096);
+    EXPECT_EQ(1, pool.stats().allocs);
+    pool.Release(data, 4096);
+    EXPECT_EQ(4096, pool.stats().cached_bytes);
+    EXPECT_EQ(data, pool.Allocate(4096));
+    EXPECT_EQ(1, pool.stats().hits);
+    EXPECT_EQ(0, pool.stats().cached_bytes);
+    pool.Release(data, 4096);
+
+    // Size classes are separate and large buffers are not pooled.
+    data = pool.Allocate(8192);
+    EXPECT_EQ(2, pool.stats().allocs);
+    pool.Release(data, 8192);
+    data = pool.Allocate(100000);
+    pool.Release(data, 100000);
+    EXPECT_EQ(3, pool.stats().allocs);
+    EXPECT_EQ(1, pool.stats().frees);
+
+    // The free lists are bounded.
+    vector<uint8_t *> buffers;
+    size_t count = TcpBufferPool::kMaxCachedBytes /
+        TcpBufferPool::kMaxBufferSize + 4;
+    for (size_t i = 0; i < count; i++) {
+        buffers.push_back(pool.Allocate(TcpBufferPool::kMaxBufferSize));
+    }
+    for (size_t i = 0; i < count; i++) {
+        pool.Release(buffers[i], TcpBufferPool::kMaxBufferSize);
+    }
+    EXPECT_EQ(5, pool.stats().frees);
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
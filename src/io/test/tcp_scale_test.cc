@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <stdlib.h>
+#include <memory>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <tbb/atomic.h>
+
+#include "testing/gunit.h"
+
+#include "base/logging.h"
+#include "base/task.h"
+#include "base/util.h"
+#include "base/test/task_test_util.h"
+#include "io/event_manager.h"
+#include "io/tcp_server.h"
+#include "io/tcp_session.h"
+#include "io/test/event_manager_test.h"
+#include "io/io_log.h"
+
+using namespace std;
+
+//
+// Connection scaling benchmark for the sharded EventManager.
+//
+// A number of client sessions connect to a server on the same EventManager
+// and each of them sends a stream of messages. The test measures the time
+// it takes for the server to receive everything, for 1, 2 and 4 shards.
+// Every byte carries the sequence number of its message, so that the test
+// also verifies that each session sees its stream in order.
+//
+// The number of sessions and of messages per session can be set with the
+// environment variables TCP_SCALE_TEST_SESSIONS and TCP_SCALE_TEST_MESSAGES.
+//
+
+namespace {
+
+static const int kMessageSize = 1024;
+
+class ScaleServer;
+
+class ScaleSession : public TcpSession {
+public:
+    ScaleSession(TcpServer *server, Socket *socket, ScaleServer *counter)
+        : TcpSession(server, socket), counter_(counter), offset_(0),
+          errors_(0) {
+    }
+
+    int errors() const { return errors_; }
+
+protected:
+    virtual void OnRead(Buffer buffer);
+
+private:
+    ScaleServer *counter_;
+    uint64_t offset_;
+    int errors_;
+};
+
+class ScaleServer : public TcpServer {
+public:
+    explicit ScaleServer(EventManager *evm) : TcpServer(evm) {
+        rx_bytes_ = 0;
+        errors_ = 0;
+    }
+
+    virtual TcpSession *AllocSession(Socket *socket) {
+        return new ScaleSession(this, socket, this);
+    }
+
+    TcpSession *Connect(int port) {
+        TcpSession *session = CreateSession();
+        boost::system::error_code ec;
+        session->socket()->open(boost::asio::ip::tcp::v4(), ec);
+        session->SetSocketOptions();
+        Endpoint remote(boost::asio::ip::address::from_string("127.0.0.1", ec),
+                        port);
+        TcpServer::Connect(session, remote);
+        return session;
+    }
+
+    uint64_t rx_bytes() const { return rx_bytes_; }
+    int errors() const { return errors_; }
+
+private:
+    friend class ScaleSession;
+    tbb::atomic<uint64_t> rx_bytes_;
+    tbb::atomic<int> errors_;
+};
+
+void ScaleSession::OnRead(Buffer buffer) {
+    const uint8_t *data = BufferData(buffer);
+    size_t len = BufferSize(buffer);
+    for (size_t i = 0; i < len; i++, offset_++) {
+        if (data[i] != (uint8_t) (offset_ / kMessageSize)) {
+            errors_++;
+        }
+    }
+    if (errors_) {
+        counter_->errors_ += errors_;
+        errors_ = 0;
+    }
+    counter_->rx_bytes_ += len;
+    ReleaseBuffer(buffer);
+}
+
+class TcpScaleTest : public ::testing::TestWithParam<int> {
+protected:
+    TcpScaleTest() : sessions_(64), messages_(256) {
+        const char *sessions = getenv("TCP_SCALE_TEST_SESSIONS");
+        if (sessions != NULL) {
+            sessions_ = strtoul(sessions, NULL, 0);
+        }
+        const char *messages = getenv("TCP_SCALE_TEST_MESSAGES");
+        if (messages != NULL) {
+            messages_ = strtoul(messages, NULL, 0);
+        }
+    }
+
+    virtual void SetUp() {
+        evm_.reset(new EventManager(GetParam()));
+        server_ = new ScaleServer(evm_.get());
+        client_ = new ScaleServer(evm_.get());
+        thread_.reset(new ServerThread(evm_.get()));
+    }
+
+    virtual void TearDown() {
+        server_->Shutdown();
+        server_->ClearSessions();
+        client_->Shutdown();
+        client_->ClearSessions();
+        task_util::WaitForIdle();
+        TcpServerManager::DeleteServer(server_);
+        TcpServerManager::DeleteServer(client_);
+
+        evm_->Shutdown();
+        thread_->Join();
+        task_util::WaitForIdle();
+    }
+
+    // Send the next message on every session, as far as the sockets take
+    // them. Returns the number of bytes sent.
+    uint64_t SendMessages(vector<TcpSession *> *sessions,
+                          vector<int> *sequence) {
+        uint64_t total = 0;
+        uint8_t msg[kMessageSize];
+        for (size_t i = 0; i < sessions->size(); i++) {
+            if ((*sequence)[i] == messages_)
+                continue;
+            memset(msg, (uint8_t) (*sequence)[i], sizeof(msg));
+            size_t sent;
+            (*sessions)[i]->Send(msg, sizeof(msg), &sent);
+            (*sequence)[i]++;
+            total += sizeof(msg);
+        }
+        return total;
+    }
+
+    int sessions_;
+    int messages_;
+    auto_ptr<EventManager> evm_;
+    auto_ptr<ServerThread> thread_;
+    ScaleServer *server_;
+    ScaleServer *client_;
+};
+
+TEST_P(TcpScaleTest, Throughput) {
+    server_->Initialize(0);
+    task_util::WaitForIdle();
+    thread_->Start();
+    int port = server_->GetPort();
+    ASSERT_LT(0, port);
+    EXPECT_EQ((size_t) GetParam(), evm_->shard_count());
+
+    uint64_t start = UTCTimestampUsec();
+    vector<TcpSession *> sessions;
+    for (int i = 0; i < sessions_; i++) {
+        sessions.push_back(client_->Connect(port));
+    }
+    for (int i = 0; i < sessions_; i++) {
+        TASK_UTIL_EXPECT_TRUE(sessions[i]->IsEstablished());
+    }
+    TASK_UTIL_EXPECT_EQ((size_t) sessions_, server_->GetSessionCount());
+    uint64_t connected = UTCTimestampUsec();
+
+    vector<int> sequence(sessions_, 0);
+    uint64_t total = 0;
+    for (int i = 0; i < messages_; i++) {
+        total += SendMessages(&sessions, &sequence);
+    }
+    TASK_UTIL_EXPECT_EQ(total, server_->rx_bytes());
+    uint64_t received = UTCTimestampUsec();
+    EXPECT_EQ(0, server_->errors());
+
+    LOG(DEBUG, "shards " << GetParam() << " sessions " << sessions_ <<
+        " connect usec " << connected - start << " receive " << total <<
+        " bytes usec " << received - connected);
+}
+
+INSTANTIATE_TEST_CASE_P(Shards, TcpScaleTest, ::testing::Values(1, 2, 4));
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -159,6 +159,22 @@ void KSyncSockNetlink::AsyncSendTo(IoContext *ioc, mutable_buffers_1 buf,
     free(cl.cl_buf);
 }
 
+size_t KSyncSockNetlink::EncodeBulkMsg(IoContext *ioc, char *buf,
+                                       size_t len) {
+    return EncodeNetlinkMsg(ioc, buf, len);
+}
+
+// The messages in buf already carry their netlink headers; the kernel
+// processes each of them in turn and acks them separately.
+void KSyncSockNetlink::AsyncSendBulk(char *buf, size_t len, HandlerCb cb) {
+    boost::asio::netlink::raw::endpoint ep;
+    sock_.async_send_to(buffer(buf, len), ep, cb);
+}
+
+size_t KSyncSockNetlink::GetMsgLen(char *data) {
+    return NetlinkMsgLen(data);
+}
+
 size_t KSyncSockNetlink::SendTo(const_buffers_1 buf) {
     struct nl_client cl;
     unsigned char *nl_buf;
@@ -285,8 +301,22 @@ KSyncSock::KSyncSock() : tx_count_(0), err_count_(0) {
                              boost::bind(&KSyncSock::ProcessKernelData, this, 
                                          _1));
     }
+    tx_queue_ = new WorkQueue<IoContext *>(TaskScheduler::GetInstance()->
+                    GetTaskId(IoContext::io_wq_names[IoContext::DEFAULT_Q_ID]),
+                    0, NULL);
+    bulk_max_msgs_ = 0;
+    const char *bulk_msgs = getenv("KSYNC_BULK_MSGS");
+    if (bulk_msgs != NULL) {
+        bulk_max_msgs_ = strtoul(bulk_msgs, NULL, 0);
+    }
+    if (bulk_max_msgs_ > 0) {
+        tx_queue_->SetBatchCallback(boost::bind(&KSyncSock::SendBulk, this,
+                                                _1), bulk_max_msgs_);
+    }
     rx_buff_ = NULL;
     seqno_ = 0;
+    bulk_send_count_ = 0;
+    bulk_msg_count_ = 0;
 }
 
 KSyncSock::~KSyncSock() {
@@ -301,6 +331,8 @@ KSyncSock::~KSyncSock() {
         work_queue_[i]->Shutdown();
         delete work_queue_[i];
     }
+    tx_queue_->Shutdown();
+    delete tx_queue_;
 }
 
 void KSyncSock::Start() {
@@ -318,6 +350,19 @@ void KSyncSock::SetSockTableEntry(int i, KSyncSock *sock) {
     sock_table_[i] = sock;
 }
 
+void KSyncSock::SetBulkMode(int max_msgs) {
+    for (std::vector<KSyncSock *>::iterator it = sock_table_.begin();
+         it != sock_table_.end(); ++it) {
+        KSyncSock *sock = *it;
+        assert(sock->tx_queue_->IsQueueEmpty());
+        sock->bulk_max_msgs_ = max_msgs;
+        if (max_msgs > 0) {
+            sock->tx_queue_->SetBatchCallback(
+                boost::bind(&KSyncSock::SendBulk, sock, _1), max_msgs);
+        }
+    }
+}
+
 void KSyncSock::Init(int count) {
     sock_table_.resize(count);
     pid_ = getpid();
@@ -356,8 +401,34 @@ void KSyncSock::ReadHandler(const boost::system::error_code& error,
         return;
     }
 
-    ValidateAndEnqueue(rx_buff_);
+    // In bulk mode a buffer may hold several messages, the acks of a bulk
+    // send. Each of them is processed on its own, so split them up.
+    // Otherwise the buffer holds a single message.
+    if (bulk_max_msgs_ > 0 && IsBulkSupported()) {
+        size_t offset = 0;
+        while (offset < bytes_transferred) {
+            size_t len = GetMsgLen(rx_buff_ + offset);
+            if (offset == 0 && (len == 0 || len >= bytes_transferred)) {
+                ValidateAndEnqueue(rx_buff_);
+                rx_buff_ = NULL;
+                break;
+            }
+            if (len == 0 || offset + len > bytes_transferred) {
+                LOG(ERROR, "Invalid message length " << len <<
+                    " at offset " << offset << " of " << bytes_transferred);
+                break;
+            }
+            char *data = new char[kBufLen];
+            memcpy(data, rx_buff_ + offset, std::min(len, (size_t) kBufLen));
+            ValidateAndEnqueue(data);
+            offset += len;
+        }
+    } else {
+        ValidateAndEnqueue(rx_buff_);
+        rx_buff_ = NULL;
+    }
 
+    delete [] rx_buff_;
     rx_buff_ = new char[kBufLen];
     AsyncReceive(boost::asio::buffer(rx_buff_, kBufLen),
                  boost::bind(&KSyncSock::ReadHandler, this,
@@ -478,12 +549,113 @@ void KSyncSock::SendAsyncImpl(int msg_len, char *msg,
         wait_tree_.insert(*ioc);
     }
 
-    AsyncSendTo(ioc, buffer(msg, msg_len),
+    if (bulk_max_msgs_ > 0) {
+        tx_queue_->Enqueue(ioc);
+        return;
+    }
+    AsyncSendOne(ioc);
+}
+
+void KSyncSock::AsyncSendOne(IoContext *ioc) {
+    AsyncSendTo(ioc, buffer(ioc->msg_, ioc->msg_len_),
                 boost::bind(&KSyncSock::WriteHandler, this,
                             placeholders::error,
                             placeholders::bytes_transferred));
 }
 
+// Batch callback of tx_queue_. Packs the messages into as few buffers as
+// possible. Messages that don't fit in an empty buffer are sent on their
+// own. The contexts must not be used once their message is sent, since
+// the ack may already have been processed.
+bool KSyncSock::SendBulk(const std::vector<IoContext *> &list) {
+    if (!IsBulkSupported()) {
+        for (std::vector<IoContext *>::const_iterator it = list.begin();
+             it != list.end(); ++it) {
+            AsyncSendOne(*it);
+        }
+        return true;
+    }
+
+    boost::shared_array<char> buf(new char[kBulkBufLen]);
+    size_t len = 0;
+    for (std::vector<IoContext *>::const_iterator it = list.begin();
+         it != list.end(); ++it) {
+        size_t msg_len = EncodeBulkMsg(*it, buf.get() + len,
+                                       kBulkBufLen - len);
+        if (msg_len == 0 && len != 0) {
+            AsyncSendBulk(buf.get(), len,
+                          boost::bind(&KSyncSock::BulkWriteHandler, this, buf,
+                                      placeholders::error,
+                                      placeholders::bytes_transferred));
+            bulk_send_count_++;
+            buf.reset(new char[kBulkBufLen]);
+            len = 0;
+            msg_len = EncodeBulkMsg(*it, buf.get(), kBulkBufLen);
+        }
+        if (msg_len == 0) {
+            AsyncSendOne(*it);
+            continue;
+        }
+        len += msg_len;
+        bulk_msg_count_++;
+    }
+
+    if (len != 0) {
+        AsyncSendBulk(buf.get(), len,
+                      boost::bind(&KSyncSock::BulkWriteHandler, this, buf,
+                                  placeholders::error,
+                                  placeholders::bytes_transferred));
+        bulk_send_count_++;
+    }
+    return true;
+}
+
+// Holds on to the buffer until the send completes.
+void KSyncSock::BulkWriteHandler(boost::shared_array<char> buf,
+                                 const boost::system::error_code& error,
+                                 size_t bytes_transferred) {
+    WriteHandler(error, bytes_transferred);
+}
+
+size_t KSyncSock::EncodeNetlinkMsg(IoContext *ioc, char *buf, size_t len) {
+    struct nl_client cl;
+    unsigned char *nl_buf;
+    uint32_t nl_buf_len;
+    int ret;
+
+    nl_init_generic_client_req(&cl, GetNetlinkFamilyId());
+
+    if ((ret = nl_build_header(&cl, &nl_buf, &nl_buf_len)) < 0) {
+        LOG(ERROR, "Error creating netlink message. Error : " << ret);
+        free(cl.cl_buf);
+        return 0;
+    }
+
+    uint32_t header_len = cl.cl_buf_offset;
+    nl_update_header(&cl, ioc->msg_len_);
+    struct nlmsghdr *nlh = (struct nlmsghdr *)cl.cl_buf;
+    nlh->nlmsg_pid = KSyncSock::GetPid();
+    nlh->nlmsg_seq = ioc->GetSeqno();
+
+    size_t msg_len = NLMSG_ALIGN(nlh->nlmsg_len);
+    if (msg_len > len || header_len + ioc->msg_len_ > msg_len) {
+        free(cl.cl_buf);
+        return 0;
+    }
+
+    memcpy(buf, cl.cl_buf, header_len);
+    memcpy(buf + header_len, ioc->msg_, ioc->msg_len_);
+    memset(buf + header_len + ioc->msg_len_, 0,
+           msg_len - header_len - ioc->msg_len_);
+    free(cl.cl_buf);
+    return msg_len;
+}
+
+size_t KSyncSock::NetlinkMsgLen(char *data) {
+    struct nlmsghdr *nlh = (struct nlmsghdr *)data;
+    return NLMSG_ALIGN(nlh->nlmsg_len);
+}
+
 KSyncIoContext::KSyncIoContext(KSyncEntry *sync_entry, int msg_len,
                                char *msg, uint32_t seqno,
                                KSyncEntry::KSyncEvent event) :
@@ -11,6 +11,7 @@
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/netlink_protocol.hpp>
 #include <boost/asio/netlink_endpoint.hpp>
+#include <boost/shared_array.hpp>
 #include <tbb/atomic.h>
 #include <tbb/mutex.h>
 #include <base/queue_task.h>
@@ -117,10 +118,23 @@ typedef boost::intrusive::member_hook<IoContext,
         &IoContext::node_> KSyncSockNode;
 typedef boost::intrusive::set<IoContext, KSyncSockNode> Tree;
 
+//
+// Bulk mode: with SetBulkMode(), messages are not sent as they come but
+// queued to the Agent::KSync task. The task packs the queued messages, at
+// most bulk_max_msgs_ of them and kBulkBufLen bytes, into one buffer, each
+// with its own header and sequence number, and sends the buffer with a
+// single call. A burst of sends is thus flushed as soon as the task gets
+// to run, or when the size threshold is reached. The acks are demultiplexed
+// per message on receive, the same way as for single sends.
+//
+// Sockets that can't pack messages (IsBulkSupported() returns false) send
+// the queued messages one at a time.
+//
 class KSyncSock {
 public:
     const static int kMsgGrowSize = 16;
     const static unsigned kBufLen = 4096;
+    const static unsigned kBulkBufLen = 16 * 1024;
 
     typedef boost::function<void(const boost::system::error_code &, size_t)> HandlerCb;
     KSyncSock();
@@ -153,9 +167,27 @@ public:
         agent_sandesh_ctx_ = ctx;
     }
     virtual void Decoder(char *data, SandeshContext *ctxt) = 0;
+
+    // Pack up to max_msgs messages per send on all the sockets. 0 disables
+    // bulk mode. Must be set before messages are sent. The default is the
+    // value of the environment variable KSYNC_BULK_MSGS, or 0.
+    static void SetBulkMode(int max_msgs);
+    int bulk_max_msgs() const { return bulk_max_msgs_; }
+
+    // Debug stats
+    uint64_t bulk_send_count() const { return bulk_send_count_; }
+    uint64_t bulk_msg_count() const { return bulk_msg_count_; }
+
 protected:
     static void Init(int count);
     static void SetSockTableEntry(int i, KSyncSock *sock);
+
+    // Write the message of ioc with a generic netlink header into buf.
+    // Returns the aligned length of the message, or 0 if it doesn't fit.
+    static size_t EncodeNetlinkMsg(IoContext *ioc, char *buf, size_t len);
+    // Length of the netlink message at data.
+    static size_t NetlinkMsgLen(char *data);
+
     // Tree of all KSyncEntries pending ack from Netlink socket
     Tree wait_tree_;
     tbb::mutex mutex_;
@@ -170,10 +202,28 @@ private:
     void WriteHandler(const boost::system::error_code& error,
                       size_t bytes_transferred);
 
+    void BulkWriteHandler(boost::shared_array<char> buf,
+                          const boost::system::error_code& error,
+                          size_t bytes_transferred);
+
     bool ProcessKernelData(char *data);
     virtual bool Validate(char *data) = 0;
     bool ValidateAndEnqueue(char *data);
     void SendAsyncImpl(int msg_len, char *msg, IoContext *ioc);
+    void AsyncSendOne(IoContext *ioc);
+    bool SendBulk(const std::vector<IoContext *> &list);
+
+    // Bulk mode interface. EncodeBulkMsg writes the message of ioc, with
+    // its header, into buf and returns its length, or 0 if it doesn't fit.
+    // AsyncSendBulk sends a buffer of encoded messages.
+    virtual bool IsBulkSupported() const { return false; }
+    virtual size_t EncodeBulkMsg(IoContext *ioc, char *buf, size_t len) {
+        return 0;
+    }
+    virtual void AsyncSendBulk(char *buf, size_t len, HandlerCb cb) { }
+    // Length of the received message at data, if a received buffer may
+    // hold several messages, 0 otherwise.
+    virtual size_t GetMsgLen(char *data) { return 0; }
 
     virtual void AsyncReceive(boost::asio::mutable_buffers_1, HandlerCb) = 0;
     virtual void AsyncSendTo(IoContext *, boost::asio::mutable_buffers_1,
@@ -194,10 +244,16 @@ private:
     char *rx_buff_;
     tbb::atomic<int> seqno_;
 
+    // Queue of the messages to send in bulk mode.
+    WorkQueue<IoContext *> *tx_queue_;
+    int bulk_max_msgs_;
+
     // Debug stats
     int tx_count_;
     int ack_count_;
     int err_count_;
+    tbb::atomic<uint64_t> bulk_send_count_;
+    tbb::atomic<uint64_t> bulk_msg_count_;
 
     DISALLOW_COPY_AND_ASSIGN(KSyncSock);
 };
@@ -218,6 +274,10 @@ public:
                              HandlerCb);
     virtual std::size_t SendTo(boost::asio::const_buffers_1);
     virtual void Receive(boost::asio::mutable_buffers_1);
+    virtual bool IsBulkSupported() const { return true; }
+    virtual size_t EncodeBulkMsg(IoContext *ioc, char *buf, size_t len);
+    virtual void AsyncSendBulk(char *buf, size_t len, HandlerCb cb);
+    virtual size_t GetMsgLen(char *data);
 private:
     boost::asio::netlink::raw::socket sock_;
 };
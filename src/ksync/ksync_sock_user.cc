@@ -329,6 +329,33 @@ void KSyncSockTypeMap::AsyncSendTo(IoContext *ioc, mutable_buffers_1 buf,
     }
 }
 
+size_t KSyncSockTypeMap::EncodeBulkMsg(IoContext *ioc, char *buf,
+                                       size_t len) {
+    return EncodeNetlinkMsg(ioc, buf, len);
+}
+
+//process each netlink message of a bulk send as AsyncSendTo does
+void KSyncSockTypeMap::AsyncSendBulk(char *buf, size_t len, HandlerCb cb) {
+    const size_t header_len = NLMSG_HDRLEN + GENL_HDRLEN + NLA_HDRLEN;
+    size_t offset = 0;
+    while (offset + header_len <= len) {
+        struct nlmsghdr *nlh = (struct nlmsghdr *)(buf + offset);
+        if (nlh->nlmsg_len < header_len || offset + nlh->nlmsg_len > len) {
+            LOG(ERROR, "Invalid bulk message length " << nlh->nlmsg_len);
+            break;
+        }
+        struct nlattr *attr = (struct nlattr *)
+            (buf + offset + NLMSG_HDRLEN + GENL_HDRLEN);
+        KSyncUserSockContext ctx(true, nlh->nlmsg_seq);
+        ProcessSandesh((const uint8_t *)(buf + offset + header_len),
+                       attr->nla_len - NLA_HDRLEN, &ctx);
+        if (ctx.IsResponseReqd()) {
+            SimulateResponse(nlh->nlmsg_seq, 0, 0);
+        }
+        offset += NLMSG_ALIGN(nlh->nlmsg_len);
+    }
+}
+
 //send or store in map
 size_t KSyncSockTypeMap::SendTo(const_buffers_1 buf) {
     KSyncUserSockContext ctx(true, 0);
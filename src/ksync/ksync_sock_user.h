@@ -127,6 +127,9 @@ public:
                              HandlerCb);
     virtual std::size_t SendTo(boost::asio::const_buffers_1);
     virtual void Receive(boost::asio::mutable_buffers_1);
+    virtual bool IsBulkSupported() const { return true; }
+    virtual size_t EncodeBulkMsg(IoContext *ioc, char *buf, size_t len);
+    virtual void AsyncSendBulk(char *buf, size_t len, HandlerCb cb);
 
     static void ProcessSandesh(const uint8_t *, std::size_t, KSyncUserSockContext *);
     static void SimulateResponse(uint32_t, int, int);
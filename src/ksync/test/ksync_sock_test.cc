@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <stdlib.h>
+
+#include <tbb/atomic.h>
+
+#include "base/logging.h"
+#include "base/task.h"
+#include "base/util.h"
+#include "base/test/task_test_util.h"
+#include "io/event_manager.h"
+#include "io/test/event_manager_test.h"
+#include "testing/gunit.h"
+
+#include "ksync/ksync_sock.h"
+#include "ksync/ksync_sock_user.h"
+
+using namespace std;
+
+//
+// Sends interface adds and deletes through the user space KSync socket,
+// one message per send and in bulk mode, and measures the rate at which
+// they are acked. The number of messages can be set with the environment
+// variable KSYNC_SOCK_TEST_MESSAGES.
+//
+
+namespace {
+
+static const int kBufSize = 1024;
+
+class TestIoContext : public IoContext {
+public:
+    TestIoContext(char *msg, uint32_t len, uint32_t seq,
+                  AgentSandeshContext *ctx, tbb::atomic<int> *acks)
+        : IoContext(msg, len, seq, ctx), acks_(acks) {
+    }
+
+    virtual void Handler() { (*acks_)++; }
+    virtual void ErrorHandler(int err) { ADD_FAILURE() << "error " << err; }
+
+private:
+    tbb::atomic<int> *acks_;
+};
+
+class KSyncSockTest : public ::testing::Test {
+protected:
+    KSyncSockTest() : messages_(1000), ctx_(false, 0) {
+        const char *messages = getenv("KSYNC_SOCK_TEST_MESSAGES");
+        if (messages != NULL) {
+            messages_ = strtoul(messages, NULL, 0);
+        }
+        acks_ = 0;
+    }
+
+    // The socket is shared by the tests, KSyncSockTypeMap is a singleton.
+    static void SetUpTestCase() {
+        evm_ = new EventManager();
+        thread_ = new ServerThread(evm_);
+        KSyncSockTypeMap::Init(*evm_->io_service(), 1);
+        KSyncSock::SetNetlinkFamilyId(24);
+        KSyncSock::Start();
+        thread_->Start();
+    }
+
+    static void TearDownTestCase() {
+        task_util::WaitForIdle();
+        KSyncSock::Shutdown();
+        evm_->Shutdown();
+        thread_->Join();
+        delete thread_;
+        delete evm_;
+    }
+
+    virtual void TearDown() {
+        task_util::WaitForIdle();
+        KSyncSock::SetBulkMode(0);
+    }
+
+    void SendInterface(int index, sandesh_op::type op) {
+        KSyncSock *sock = KSyncSock::Get(0);
+        vr_interface_req req;
+        req.set_h_op(op);
+        req.set_vifr_idx(index);
+        req.set_vifr_type(0);
+        req.set_vifr_vrf(0);
+        req.set_vifr_mtu(1500);
+        req.set_vifr_name("vif");
+
+        int error = 0;
+        uint8_t *buf = (uint8_t *) malloc(kBufSize);
+        int len = req.WriteBinary(buf, kBufSize, &error);
+        ASSERT_LT(0, len);
+        sock->GenericSend(len, (char *) buf,
+                          new TestIoContext((char *) buf, len,
+                                            sock->AllocSeqNo(), &ctx_,
+                                            &acks_));
+    }
+
+    // Adds and deletes messages_ interfaces, returns the time it took in
+    // usecs.
+    uint64_t AddDelete() {
+        uint64_t start = ClockMonotonicUsec();
+        for (int i = 0; i < messages_; i++) {
+            SendInterface(i, sandesh_op::ADD);
+        }
+        TASK_UTIL_EXPECT_EQ(messages_, acks_);
+        EXPECT_EQ(messages_, KSyncSockTypeMap::IfCount());
+
+        for (int i = 0; i < messages_; i++) {
+            SendInterface(i, sandesh_op::DELETE);
+        }
+        TASK_UTIL_EXPECT_EQ(2 * messages_, acks_);
+        EXPECT_EQ(0, KSyncSockTypeMap::IfCount());
+        return ClockMonotonicUsec() - start;
+    }
+
+    static EventManager *evm_;
+    static ServerThread *thread_;
+
+    int messages_;
+    KSyncUserSockContext ctx_;
+    tbb::atomic<int> acks_;
+};
+
+EventManager *KSyncSockTest::evm_;
+ServerThread *KSyncSockTest::thread_;
+
+TEST_F(KSyncSockTest, Single) {
+    KSyncSock::SetBulkMode(0);
+    uint64_t usecs = AddDelete();
+    KSyncSock *sock = KSyncSock::Get(0);
+    EXPECT_EQ(0U, sock->bulk_send_count());
+    LOG(DEBUG, "single: " << 2 * messages_ << " messages in " << usecs <<
+        " usecs");
+}
+
+TEST_F(KSyncSockTest, Bulk) {
+    KSyncSock *sock = KSyncSock::Get(0);
+    uint64_t msgs = sock->bulk_msg_count();
+    uint64_t sends = sock->bulk_send_count();
+    KSyncSock::SetBulkMode(32);
+    uint64_t usecs = AddDelete();
+    msgs = sock->bulk_msg_count() - msgs;
+    sends = sock->bulk_send_count() - sends;
+    EXPECT_EQ((uint64_t) 2 * messages_, msgs);
+    EXPECT_LE((uint64_t) 2 * messages_ / 32, sends);
+    EXPECT_GE(msgs, sends);
+    LOG(DEBUG, "bulk: " << msgs << " messages in " << sends << " sends, " <<
+        usecs << " usecs");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -51,6 +51,69 @@ bool PostProcessingQuery::sort_field_comparator(
     return false;
 }
 
+// whether a column value passes the filter
+static bool filter_match_value(const filter_match_t& match,
+                               const std::string& value) {
+    switch(match.op) {
+    case EQUAL:
+        return match.value == value;
+    case NOT_EQUAL:
+        return match.value != value;
+    case LEQ:
+        return atoi(value.c_str()) <= atoi(match.value.c_str());
+    case GEQ:
+        return atoi(value.c_str()) >= atoi(match.value.c_str());
+    case REGEX_MATCH:
+        return boost::regex_match(value, match.match_e);
+    default:
+        // upsupported filter operation
+        QE_ASSERT(0);
+        return false;
+    }
+}
+
+// The filters are evaluated once per distinct value of their column, and
+// the rows are then filtered on the column codes
+void PostProcessingQuery::filter_rows(ResultBatch *batch,
+                                      ResultBatch::Selection *sel) {
+    std::vector<ResultBatch::ColumnFilter> filters;
+    for (size_t j = 0; j < filter_list.size(); j++) {
+        const filter_match_t& match = filter_list[j];
+        filters.push_back(ResultBatch::ColumnFilter(
+            batch->AddColumn(match.name, false), match.ignore_col_absence));
+        ResultBatch::ColumnFilter& filter = filters.back();
+        const std::vector<std::string>& dict =
+            batch->column(filter.column).dict;
+        filter.pass.reserve(dict.size());
+        for (size_t k = 0; k < dict.size(); k++) {
+            filter.pass.push_back(filter_match_value(match, dict[k]));
+        }
+    }
+    batch->Filter(filters, sel);
+}
+
+// Same order as sort_field_comparator
+void PostProcessingQuery::sort_rows(ResultBatch *batch,
+                                    ResultBatch::Selection *sel) {
+    std::vector<size_t> keys;
+    for (std::vector<sort_field_t>::iterator sort_it = sort_fields.begin();
+         sort_it != sort_fields.end(); sort_it++) {
+        bool numeric = ((*sort_it).type == std::string("int") ||
+                        (*sort_it).type == std::string("long") ||
+                        (*sort_it).type == std::string("ipv4"));
+        keys.push_back(batch->AddColumn((*sort_it).name, numeric));
+    }
+    batch->Sort(keys, sorting_type == ASCENDING, sel);
+}
+
+void PostProcessingQuery::sort_result(QEOpServerProxy::BufferT *rows) {
+    ResultBatch batch(rows);
+    ResultBatch::Selection sel;
+    batch.SelectAll(&sel);
+    sort_rows(&batch, &sel);
+    batch.Gather(sel, rows);
+}
+
 bool PostProcessingQuery::flowseries_merge_processing(
         const std::vector<QEOpServerProxy::OutRowT> *raw_result,
         std::vector<QEOpServerProxy::OutRowT> *merged_result, 
@@ -140,6 +203,36 @@ void PostProcessingQuery::fs_tuple_stats_merge_processing(
     }
 }
 
+// Merge the flow class rows of all the inputs at once: the rows are
+// grouped on the flow class id column and the sum columns are added up,
+// then sorted and limited. The rows are moved out of the inputs.
+void PostProcessingQuery::fs_tuple_stats_final_merge_processing(
+const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
+        QEOpServerProxy::BufferT& output) {
+    std::vector<QEOpServerProxy::BufferT *> raw_results;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        raw_results.push_back(inputs[i].get());
+    }
+    ResultBatch batch(raw_results);
+    ResultBatch::Selection sel;
+    batch.SelectAll(&sel);
+
+    std::vector<size_t> sums;
+    sums.push_back(batch.AddColumn(SELECT_SUM_PACKETS, true));
+    sums.push_back(batch.AddColumn(SELECT_SUM_BYTES, true));
+    batch.Aggregate(batch.AddColumn(SELECT_FLOW_CLASS_ID, true), sums, &sel);
+    QE_TRACE(DEBUG, "fs_tuple_stats_final_merge_processing: " << batch.size()
+             << " rows merged into " << sel.size() << " flow classes");
+
+    if (sorted) {
+        sort_rows(&batch, &sel);
+    }
+    if (limit && sel.size() > (size_t)limit) {
+        sel.resize(limit);
+    }
+    batch.Gather(sel, &output);
+}
+
 bool PostProcessingQuery::merge_processing(
         const QEOpServerProxy::BufferT& input, 
         QEOpServerProxy::BufferT& output)
@@ -254,6 +347,14 @@ const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
         return false;
     }
 
+    if (mquery->table == g_viz_constants.FLOW_SERIES_TABLE &&
+        mquery->selectquery_->flowseries_query_type() ==
+            SelectQuery::FS_SELECT_FLOW_TUPLE_STATS) {
+        fs_tuple_stats_final_merge_processing(inputs, output);
+        status_details = 0;
+        return true;
+    }
+
     if (mquery->table == g_viz_constants.FLOW_SERIES_TABLE) {
         fcid_rrow_map_t fcid_rrow_map;
         bool status = false;
@@ -269,19 +370,7 @@ const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
             }
 
             if (sorted) {
-                std::vector<QEOpServerProxy::OutRowT> *merged_result =
-                    &output;
-                if (sorting_type == ASCENDING) {
-                    std::sort(merged_result->begin(), merged_result->end(), 
-                              boost::bind(
-                                &PostProcessingQuery::sort_field_comparator, 
-                                          this, _1, _2)); 
-                } else {
-                    std::sort(merged_result->rbegin(), merged_result->rend(), 
-                              boost::bind(
-                                &PostProcessingQuery::sort_field_comparator,
-                                          this, _1, _2));
-                }
+                sort_result(&output);
             }
             goto limit;
         }
@@ -311,15 +400,7 @@ const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
         QE_TRACE(DEBUG, "Final_Merge_Processing: Done uniquify flow records");
         // Check if the result has to be sorted
         if (sorted) {
-            if (sorting_type == ASCENDING) {
-                std::sort(merged_result->begin(), merged_result->end(), 
-                          boost::bind(&PostProcessingQuery::sort_field_comparator, 
-                                      this, _1, _2)); 
-            } else {
-                std::sort(merged_result->rbegin(), merged_result->rend(), 
-                          boost::bind(&PostProcessingQuery::sort_field_comparator,
-                                      this, _1, _2));
-            }
+            sort_result(merged_result);
         }
     } else {  // For non-flow-record queries
         // Check if the result has to be sorted
@@ -340,25 +421,11 @@ const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
             {
                 std::vector<QEOpServerProxy::OutRowT> *raw_result = 
                     inputs[i].get();
-
-                if (sorting_type == ASCENDING) {
-                    std::vector<QEOpServerProxy::OutRowT>::iterator
-                        current_result_end = merged_result->end();
-                    copy(raw_result->begin(), raw_result->end(), 
-                        std::back_inserter(*merged_result));
-                    std::inplace_merge(merged_result->begin(),
-                    current_result_end, merged_result->end(),
-    boost::bind(&PostProcessingQuery::sort_field_comparator, this, _1, _2)); 
-                } else {
-                    std::vector<QEOpServerProxy::OutRowT>::reverse_iterator
-                        current_result_end = merged_result->rbegin();
-                    copy(raw_result->begin(), raw_result->end(), 
-                        std::back_inserter(*merged_result));
-                    std::inplace_merge(merged_result->rbegin(),
-                    current_result_end, merged_result->rend(),
-    boost::bind(&PostProcessingQuery::sort_field_comparator, this, _1, _2)); 
-                }
+                copy(raw_result->begin(), raw_result->end(), 
+                    std::back_inserter(*merged_result));
             }
+            // One sort of the encoded columns rather than a merge per input
+            sort_result(merged_result);
         }
     }
    
@@ -450,108 +517,22 @@ query_status_t PostProcessingQuery::process_query() {
         QE_TRACE(DEBUG, "# of entries filtered is " << num_filtered);
 
     }
-    if (filter_list.size() != 0)
+    // Filter and sort the rows in their columnar form
+    if (filter_list.size() != 0 || sorted)
     {
-        std::vector<std::map<std::string, std::string> > filtered_table;
-        // do filter operation
-        QE_TRACE(DEBUG, "Doing filter operation");
-        for (size_t i = 0; i < raw_result->size(); i++)
-        {
-            bool delete_row = false;
-            std::map<std::string, std::string> row = (*raw_result)[i];
-
-            for (size_t j = 0; j < filter_list.size(); j++)
-            {
-                std::map<std::string, std::string>::iterator iter;
-                iter = row.find(filter_list[j].name);
-                if (iter == row.end())
-                {
-                    if (!(filter_list[j].ignore_col_absence))
-                        delete_row = true;
-                    break;
-                }
-
-                switch(filter_list[j].op)
-                {
-                    case EQUAL:
-                        if (filter_list[j].value != iter->second)
-                        {
-                            delete_row = true;
-                        }
-                        break;
-
-                    case NOT_EQUAL:
-                        if (filter_list[j].value == iter->second)
-                        {
-                            delete_row = true;
-                        }
-                        break;
-
-                    case LEQ:
-                        {
-                            int filter_value = 
-                                atoi(filter_list[j].value.c_str());
-                            int column_value= atoi(iter->second.c_str());
-                            if (column_value > filter_value)
-                            {
-                                delete_row = true;
-                            }
-                            break;
-                        }
-
-                    case GEQ:
-                        {
-                            int filter_value = 
-                                atoi(filter_list[j].value.c_str());
-                            int column_value= atoi(iter->second.c_str());
-                            if (column_value < filter_value)
-                            {
-                                delete_row = true;
-                            }
-                            break;
-                        }
-
-                    case REGEX_MATCH:
-                        {
-                            if (!boost::regex_match(iter->second, 
-                                        filter_list[j].match_e))
-                            {
-                                delete_row = true;
-                            }
-                            break;
-                        }
-
-                    default:
-                        // upsupported filter operation
-                        QE_ASSERT(0);
-                        break;
-                }
-                if (delete_row == true)
-                    break;
-            }
- 
-            if (delete_row == true)
-            {
-                QE_TRACE(DEBUG, "filter out entry #:" << i);
-            } else {
-                filtered_table.push_back(row);
-            }
+        ResultBatch batch(raw_result);
+        ResultBatch::Selection sel;
+        batch.SelectAll(&sel);
+        if (filter_list.size() != 0) {
+            QE_TRACE(DEBUG, "Doing filter operation");
+            filter_rows(&batch, &sel);
+            QE_TRACE(DEBUG, "filtered out " << raw_result->size() - sel.size()
+                     << " entries");
         }
-
-        *raw_result = filtered_table;
-    }
-
-    // Check if the result has to be sorted
-    if (sorted) {
-        if (sorting_type == ASCENDING) {
-            std::sort(raw_result->begin(), raw_result->end(), 
-                      boost::bind(&PostProcessingQuery::sort_field_comparator, 
-                                  this, _1, _2)); 
-        } else {
-            std::sort(raw_result->rbegin(), raw_result->rend(), 
-                      boost::bind(&PostProcessingQuery::sort_field_comparator,
-                                  this, _1, _2));
+        if (sorted) {
+            sort_rows(&batch, &sel);
         }
+        batch.Gather(sel, raw_result);
     }
 
     // If the flow series query is parallelized, we should apply the limit 
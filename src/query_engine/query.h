@@ -72,6 +72,7 @@
 #include "../analytics/viz_message.h"
 #include "json_parse.h"
 #include "QEOpServerProxy.h"
+#include "result_batch.h"
 #include "base/logging.h"
 #include <sandesh/sandesh_types.h>
 #include <sandesh/sandesh.h>
@@ -706,6 +707,14 @@ private:
                 const std::vector<QEOpServerProxy::OutRowT> *input,
                 std::vector<QEOpServerProxy::OutRowT> *output,
                 fcid_rrow_map_t *fcid_rrow_map = NULL);
+    void fs_tuple_stats_final_merge_processing(
+const std::vector<boost::shared_ptr<QEOpServerProxy::BufferT> >& inputs,
+                QEOpServerProxy::BufferT& output);
+
+    // Filter and sort on the columnar form of the result (result_batch.h)
+    void filter_rows(ResultBatch *batch, ResultBatch::Selection *sel);
+    void sort_rows(ResultBatch *batch, ResultBatch::Selection *sel);
+    void sort_result(QEOpServerProxy::BufferT *rows);
 };
 
 class AnalyticsQuery: public QueryUnit {
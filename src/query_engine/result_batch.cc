@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "result_batch.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <utility>
+#include <boost/unordered_map.hpp>
+
+namespace {
+
+struct DictLess {
+    typedef std::pair<const std::string *, uint32_t> Entry;
+    bool operator()(const Entry &lhs, const Entry &rhs) const {
+        return *lhs.first < *rhs.first;
+    }
+};
+
+// Orders row indexes on the key columns
+struct RowLess {
+    RowLess(const std::vector<const ResultBatch::Column *> &keys,
+            bool ascending) : keys_(keys), ascending_(ascending) {
+    }
+
+    bool operator()(uint32_t lhs, uint32_t rhs) const {
+        if (!ascending_) {
+            std::swap(lhs, rhs);
+        }
+        for (size_t i = 0; i < keys_.size(); i++) {
+            const ResultBatch::Column *col = keys_[i];
+            if (col->numeric) {
+                if (col->values[lhs] < col->values[rhs]) return true;
+                if (col->values[lhs] > col->values[rhs]) return false;
+            } else {
+                if (col->codes[lhs] < col->codes[rhs]) return true;
+                if (col->codes[lhs] > col->codes[rhs]) return false;
+            }
+        }
+        return false;
+    }
+
+    const std::vector<const ResultBatch::Column *> &keys_;
+    bool ascending_;
+};
+
+struct ValueLess {
+    explicit ValueLess(const std::vector<uint64_t> &values) :
+        values_(values) {
+    }
+
+    bool operator()(uint32_t lhs, uint32_t rhs) const {
+        return values_[lhs] < values_[rhs];
+    }
+
+    const std::vector<uint64_t> &values_;
+};
+
+}  // namespace
+
+const uint32_t ResultBatch::kNull;
+
+ResultBatch::ResultBatch(BufferT *rows) {
+    rows_.reserve(rows->size());
+    for (size_t i = 0; i < rows->size(); i++) {
+        rows_.push_back(&(*rows)[i]);
+    }
+}
+
+ResultBatch::ResultBatch(const std::vector<BufferT *> &inputs) {
+    size_t size = 0;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        size += inputs[i]->size();
+    }
+    rows_.reserve(size);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        for (size_t j = 0; j < inputs[i]->size(); j++) {
+            rows_.push_back(&(*inputs[i])[j]);
+        }
+    }
+}
+
+size_t ResultBatch::AddColumn(const std::string &name, bool numeric) {
+    size_t index;
+    for (index = 0; index < columns_.size(); index++) {
+        if (columns_[index].name == name) {
+            break;
+        }
+    }
+
+    if (index == columns_.size()) {
+        columns_.push_back(Column());
+        Column &col = columns_.back();
+        col.name = name;
+
+        // Code the values in the order they are seen
+        typedef boost::unordered_map<std::string, uint32_t> CodeMap;
+        CodeMap code_map;
+        col.codes.reserve(rows_.size());
+        for (size_t i = 0; i < rows_.size(); i++) {
+            OutRowT::const_iterator it = rows_[i]->find(name);
+            if (it == rows_[i]->end()) {
+                col.codes.push_back(kNull);
+                continue;
+            }
+            uint32_t code = code_map.size();
+            std::pair<CodeMap::iterator, bool> ret =
+                code_map.insert(std::make_pair(it->second, code));
+            col.codes.push_back(ret.first->second);
+        }
+
+        // Renumber them in the order of the values
+        std::vector<DictLess::Entry> entries;
+        entries.reserve(code_map.size());
+        for (CodeMap::const_iterator it = code_map.begin();
+             it != code_map.end(); ++it) {
+            entries.push_back(std::make_pair(&it->first, it->second));
+        }
+        std::sort(entries.begin(), entries.end(), DictLess());
+        std::vector<uint32_t> rank(entries.size());
+        col.dict.reserve(entries.size());
+        for (size_t i = 0; i < entries.size(); i++) {
+            rank[entries[i].second] = i;
+            col.dict.push_back(*entries[i].first);
+        }
+        for (size_t i = 0; i < col.codes.size(); i++) {
+            if (col.codes[i] != kNull) {
+                col.codes[i] = rank[col.codes[i]];
+            }
+        }
+    }
+
+    Column &col = columns_[index];
+    if (numeric && !col.numeric) {
+        col.numeric = true;
+        col.dict_values.reserve(col.dict.size());
+        for (size_t i = 0; i < col.dict.size(); i++) {
+            uint64_t value = 0;
+            stringToInteger(col.dict[i], value);
+            col.dict_values.push_back(value);
+        }
+        col.values.reserve(col.codes.size());
+        for (size_t i = 0; i < col.codes.size(); i++) {
+            col.values.push_back(col.codes[i] == kNull ?
+                                 0 : col.dict_values[col.codes[i]]);
+        }
+    }
+    return index;
+}
+
+void ResultBatch::SelectAll(Selection *sel) const {
+    sel->resize(rows_.size());
+    for (size_t i = 0; i < rows_.size(); i++) {
+        (*sel)[i] = i;
+    }
+}
+
+void ResultBatch::Filter(const std::vector<ColumnFilter> &filters,
+                         Selection *sel) const {
+    size_t count = 0;
+    for (size_t i = 0; i < sel->size(); i++) {
+        uint32_t row = (*sel)[i];
+        bool keep = true;
+        for (size_t j = 0; j < filters.size(); j++) {
+            const ColumnFilter &filter = filters[j];
+            uint32_t code = columns_[filter.column].codes[row];
+            if (code == kNull) {
+                keep = filter.ignore_absence;
+                break;
+            }
+            if (!filter.pass[code]) {
+                keep = false;
+                break;
+            }
+        }
+        if (keep) {
+            (*sel)[count++] = row;
+        }
+    }
+    sel->resize(count);
+}
+
+void ResultBatch::Sort(const std::vector<size_t> &keys, bool ascending,
+                       Selection *sel) const {
+    std::vector<const Column *> key_columns;
+    for (size_t i = 0; i < keys.size(); i++) {
+        key_columns.push_back(&columns_[keys[i]]);
+    }
+    std::sort(sel->begin(), sel->end(), RowLess(key_columns, ascending));
+}
+
+void ResultBatch::Aggregate(size_t key, const std::vector<size_t> &sums,
+                            Selection *sel) {
+    const Column &key_col = columns_[key];
+    assert(key_col.numeric);
+    for (size_t j = 0; j < sums.size(); j++) {
+        assert(columns_[sums[j]].numeric);
+        if (std::find(aggregated_.begin(), aggregated_.end(), sums[j]) ==
+            aggregated_.end()) {
+            aggregated_.push_back(sums[j]);
+        }
+    }
+
+    // Stable, so that the first row of a group is the first one in sel
+    std::stable_sort(sel->begin(), sel->end(), ValueLess(key_col.values));
+    size_t count = 0;
+    for (size_t i = 0; i < sel->size(); i++) {
+        uint32_t row = (*sel)[i];
+        if (count == 0 ||
+            key_col.values[(*sel)[count - 1]] != key_col.values[row]) {
+            (*sel)[count++] = row;
+            continue;
+        }
+        uint32_t first = (*sel)[count - 1];
+        for (size_t j = 0; j < sums.size(); j++) {
+            Column &col = columns_[sums[j]];
+            col.values[first] += col.values[row];
+        }
+    }
+    sel->resize(count);
+}
+
+void ResultBatch::Gather(const Selection &sel, BufferT *output) {
+    BufferT result(sel.size());
+    for (size_t i = 0; i < sel.size(); i++) {
+        uint32_t row = sel[i];
+        result[i].swap(*rows_[row]);
+        for (size_t j = 0; j < aggregated_.size(); j++) {
+            const Column &col = columns_[aggregated_[j]];
+            if (col.codes[row] != kNull) {
+                result[i][col.name] = integerToString(col.values[row]);
+            }
+        }
+    }
+    output->swap(result);
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+/*
+ * This file has the columnar form of a query result used by the post
+ * processing and merge stages
+ *
+ * The rows of a QEOpServerProxy::BufferT are maps from column name to the
+ * string value. Filtering, sorting and aggregating them row by row means a
+ * map lookup and a string comparison or conversion per row and column, and
+ * for sorting per comparison. A ResultBatch encodes the columns that a stage
+ * needs once:
+ *
+ * - every column is dictionary encoded: each row holds a 32 bit code into
+ *   the sorted list of the distinct values of the column, so that comparing
+ *   codes orders rows like comparing the strings,
+ * - integer columns also hold the value of every row in a fixed width array.
+ *
+ * The kernels work on a selection, the list of the row indexes still in the
+ * result, and per distinct value work (regex match, string to integer) is
+ * done once per dictionary entry instead of once per row. The rows are only
+ * touched again when the result is gathered, which moves them to the output.
+ */
+
+#ifndef RESULT_BATCH_H_
+#define RESULT_BATCH_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "base/util.h"
+#include "QEOpServerProxy.h"
+
+class ResultBatch {
+public:
+    typedef QEOpServerProxy::OutRowT OutRowT;
+    typedef QEOpServerProxy::BufferT BufferT;
+    // Indexes of the rows in the result, in result order
+    typedef std::vector<uint32_t> Selection;
+
+    // Code of the rows that don't have the column
+    static const uint32_t kNull = 0xffffffff;
+
+    struct Column {
+        Column() : numeric(false) { }
+
+        std::string name;
+        bool numeric;
+        std::vector<uint32_t> codes;        // per row
+        std::vector<std::string> dict;      // per code, sorted
+        std::vector<uint64_t> values;       // per row, if numeric
+        std::vector<uint64_t> dict_values;  // per code, if numeric
+    };
+
+    // Filter on a column, pass has an entry per dictionary code that tells
+    // if rows with the value pass the filter. Rows without the column are
+    // dropped unless ignore_absence is set, in which case the remaining
+    // filters are not checked for the row.
+    struct ColumnFilter {
+        ColumnFilter(size_t col, bool ignore) :
+            column(col), ignore_absence(ignore) {
+        }
+        size_t column;
+        bool ignore_absence;
+        std::vector<char> pass;
+    };
+
+    // The rows must outlive the batch
+    explicit ResultBatch(BufferT *rows);
+    // Batch over the concatenation of several results
+    explicit ResultBatch(const std::vector<BufferT *> &inputs);
+
+    size_t size() const { return rows_.size(); }
+
+    // Encode a column, returns its index. Encoding the same column again
+    // returns the existing index.
+    size_t AddColumn(const std::string &name, bool numeric);
+    const Column &column(size_t index) const { return columns_[index]; }
+
+    // All the rows, in input order
+    void SelectAll(Selection *sel) const;
+
+    // Keep the rows of sel that pass all the filters, in order.
+    void Filter(const std::vector<ColumnFilter> &filters,
+                Selection *sel) const;
+
+    // Sort the rows of sel on the key columns, by value for numeric columns
+    // and by string otherwise. The order of rows with equal keys is
+    // unspecified.
+    void Sort(const std::vector<size_t> &keys, bool ascending,
+              Selection *sel) const;
+
+    // Group the rows of sel by the value of the numeric key column, and add
+    // up the numeric sum columns of each group into its first row. sel is
+    // left with the first row of each group, in ascending key order.
+    void Aggregate(size_t key, const std::vector<size_t> &sums,
+                   Selection *sel);
+
+    // Replace the contents of output with the rows of sel, in order. The
+    // rows are moved, output may be one of the inputs, and the batch can't
+    // be used afterwards. The values of the columns aggregated are written
+    // back to the rows that have them.
+    void Gather(const Selection &sel, BufferT *output);
+
+private:
+    std::vector<OutRowT *> rows_;
+    std::vector<Column> columns_;
+    std::vector<size_t> aggregated_;
+
+    DISALLOW_COPY_AND_ASSIGN(ResultBatch);
+};
+
+#endif
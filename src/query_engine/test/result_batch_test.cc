@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "testing/gunit.h"
+
+#include "base/logging.h"
+#include "base/util.h"
+#include "query_engine/result_batch.h"
+
+using namespace std;
+
+//
+// Filters, sorts and aggregates synthetic flow series records in their
+// columnar form, checks the results against the row by row equivalent and
+// logs the time both take. The number of records can be set with the
+// environment variable RESULT_BATCH_TEST_ROWS.
+//
+
+namespace {
+
+typedef ResultBatch::BufferT BufferT;
+typedef ResultBatch::OutRowT OutRowT;
+
+static const int kVns = 32;
+static const int kFlowClasses = 512;
+
+class ResultBatchTest : public ::testing::Test {
+protected:
+    ResultBatchTest() : rows_(100000) {
+        const char *rows = getenv("RESULT_BATCH_TEST_ROWS");
+        if (rows != NULL) {
+            rows_ = strtoul(rows, NULL, 0);
+        }
+    }
+
+    // Flow series records of kFlowClasses flow classes.
+    void FlowRecords(BufferT *records, int offset) {
+        for (int i = 0; i < rows_; i++) {
+            OutRowT row;
+            int fc = (i * 7 + offset) % kFlowClasses;
+            row["sourcevn"] = "default-domain:admin:vn" +
+                integerToString(fc % kVns);
+            row["destvn"] = "default-domain:admin:vn" +
+                integerToString((fc / kVns) % kVns);
+            row["sourceip"] = integerToString(0x0a000000 + fc);
+            row["protocol"] = integerToString(fc % 2 ? 6 : 17);
+            row["flow_class_id"] = integerToString(fc * 2654435761U);
+            row["sum(packets)"] = integerToString(i % 100 + 1);
+            row["sum(bytes)"] = integerToString((i % 1000 + 1) * 64);
+            records->push_back(row);
+        }
+    }
+
+    static uint64_t Value(const OutRowT &row, const string &name) {
+        uint64_t value = 0;
+        stringToInteger(row.find(name)->second, value);
+        return value;
+    }
+
+    static bool BytesLess(const OutRowT &lhs, const OutRowT &rhs) {
+        return Value(lhs, "sum(bytes)") < Value(rhs, "sum(bytes)");
+    }
+
+    int rows_;
+};
+
+TEST_F(ResultBatchTest, FilterSort) {
+    BufferT records;
+    FlowRecords(&records, 0);
+    BufferT expected;
+    uint64_t start = ClockMonotonicUsec();
+    for (size_t i = 0; i < records.size(); i++) {
+        if (records[i]["sourcevn"] == "default-domain:admin:vn3") {
+            expected.push_back(records[i]);
+        }
+    }
+    stable_sort(expected.rbegin(), expected.rend(), BytesLess);
+    uint64_t row_usecs = ClockMonotonicUsec() - start;
+
+    start = ClockMonotonicUsec();
+    ResultBatch batch(&records);
+    ResultBatch::Selection sel;
+    batch.SelectAll(&sel);
+    vector<ResultBatch::ColumnFilter> filters;
+    filters.push_back(ResultBatch::ColumnFilter(
+        batch.AddColumn("sourcevn", false), false));
+    const vector<string> &dict = batch.column(filters[0].column).dict;
+    EXPECT_EQ((size_t) kVns, dict.size());
+    for (size_t i = 0; i < dict.size(); i++) {
+        filters[0].pass.push_back(dict[i] == "default-domain:admin:vn3");
+    }
+    batch.Filter(filters, &sel);
+    vector<size_t> keys(1, batch.AddColumn("sum(bytes)", true));
+    batch.Sort(keys, false, &sel);
+    BufferT result;
+    batch.Gather(sel, &result);
+    uint64_t batch_usecs = ClockMonotonicUsec() - start;
+
+    ASSERT_EQ(expected.size(), result.size());
+    for (size_t i = 0; i < result.size(); i++) {
+        EXPECT_EQ("default-domain:admin:vn3", result[i]["sourcevn"]);
+        EXPECT_EQ(Value(expected[i], "sum(bytes)"),
+                  Value(result[i], "sum(bytes)"));
+    }
+    LOG(DEBUG, "filter sort " << rows_ << " rows: row usecs " << row_usecs <<
+        " columnar usecs " << batch_usecs);
+}
+
+TEST_F(ResultBatchTest, Aggregate) {
+    BufferT input1, input2;
+    FlowRecords(&input1, 0);
+    FlowRecords(&input2, 3);
+
+    uint64_t start = ClockMonotonicUsec();
+    map<uint64_t, OutRowT> expected;
+    BufferT *inputs[] = { &input1, &input2 };
+    for (int i = 0; i < 2; i++) {
+        for (size_t j = 0; j < inputs[i]->size(); j++) {
+            const OutRowT &row = (*inputs[i])[j];
+            uint64_t fc = Value(row, "flow_class_id");
+            map<uint64_t, OutRowT>::iterator it = expected.find(fc);
+            if (it == expected.end()) {
+                expected.insert(make_pair(fc, row));
+                continue;
+            }
+            it->second["sum(packets)"] = integerToString(
+                Value(it->second, "sum(packets)") +
+                Value(row, "sum(packets)"));
+            it->second["sum(bytes)"] = integerToString(
+                Value(it->second, "sum(bytes)") + Value(row, "sum(bytes)"));
+        }
+    }
+    uint64_t row_usecs = ClockMonotonicUsec() - start;
+
+    start = ClockMonotonicUsec();
+    ResultBatch batch(vector<BufferT *>(inputs, inputs + 2));
+    ResultBatch::Selection sel;
+    batch.SelectAll(&sel);
+    vector<size_t> sums;
+    sums.push_back(batch.AddColumn("sum(packets)", true));
+    sums.push_back(batch.AddColumn("sum(bytes)", true));
+    batch.Aggregate(batch.AddColumn("flow_class_id", true), sums, &sel);
+    BufferT result;
+    batch.Gather(sel, &result);
+    uint64_t batch_usecs = ClockMonotonicUsec() - start;
+
+    ASSERT_EQ(expected.size(), result.size());
+    size_t i = 0;
+    for (map<uint64_t, OutRowT>::iterator it = expected.begin();
+         it != expected.end(); ++it, ++i) {
+        EXPECT_TRUE(it->second == result[i]);
+    }
+    LOG(DEBUG, "aggregate " << 2 * rows_ << " rows: row usecs " <<
+        row_usecs << " columnar usecs " << batch_usecs);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -35,6 +35,7 @@ FlowTableKSyncObject *FlowTableKSyncObject::singleton_;
 
 FlowTableKSyncObject::FlowTableKSyncObject() : 
     KSyncObject(), audit_flow_idx_(0),
+    bulk_audit_(false), bulk_audit_pos_(0), bulk_audit_start_(0),
     audit_timer_(TimerManager::CreateTimer
                  (*(Agent::GetInstance()->GetEventManager())->io_service(),
                   "Flow Audit Timer",
@@ -44,6 +45,7 @@ FlowTableKSyncObject::FlowTableKSyncObject() :
 
 FlowTableKSyncObject::FlowTableKSyncObject(int max_index) :
     KSyncObject(max_index), audit_flow_idx_(0),
+    bulk_audit_(false), bulk_audit_pos_(0), bulk_audit_start_(0),
     audit_timer_(TimerManager::CreateTimer
                  (*(Agent::GetInstance()->GetEventManager())->io_service(),
                   "Flow Audit Timer",
@@ -444,7 +446,51 @@ void FlowTableKSyncObject::UnmapFlowMemTest() {
     KSyncSockTypeMap::FlowMmapFree();
 }
 
+void FlowTableKSyncObject::AddShortFlow(uint32_t flow_idx,
+                                        const FlowKey &key) {
+    FlowEntryPtr flow(FlowTable::GetFlowTableObject()->Allocate(key));
+    flow->flow_handle = flow_idx;
+    flow->short_flow = true;
+    flow->data.source_vn = *FlowHandler::UnknownVn();
+    flow->data.dest_vn = *FlowHandler::UnknownVn();
+    SecurityGroupList empty_sg_id_l;
+    flow->data.source_sg_id_l = empty_sg_id_l;
+    flow->data.dest_sg_id_l = empty_sg_id_l;
+    FlowTable::GetFlowTableObject()->Add(flow.get(), NULL);
+}
+
+// Delete a kernel entry that has no agent flow. The request is the one of
+// FlowTableKSyncEntry::DeleteMsg, a FLOW_SET with no flags.
+void FlowTableKSyncObject::DeleteKernelFlow(uint32_t flow_idx,
+                                            const FlowKey &key) {
+    vr_flow_req req;
+    req.set_fr_op(flow_op::FLOW_SET);
+    req.set_fr_rid(0);
+    req.set_fr_index(flow_idx);
+    req.set_fr_flow_sip(htonl(key.src.ipv4));
+    req.set_fr_flow_dip(htonl(key.dst.ipv4));
+    req.set_fr_flow_proto(key.protocol);
+    req.set_fr_flow_sport(htons(key.src_port));
+    req.set_fr_flow_dport(htons(key.dst_port));
+    req.set_fr_flow_vrf(key.vrf);
+    req.set_fr_flags(0);
+
+    int error;
+    KSyncSock *sock = KSyncSock::Get(0);
+    char *buf = (char *)malloc(KSYNC_DEFAULT_MSG_SIZE);
+    int encode_len = req.WriteBinary((uint8_t *)buf, KSYNC_DEFAULT_MSG_SIZE,
+                                     &error);
+    IoContext *ioc = new IoContext(buf, encode_len, sock->AllocSeqNo(),
+                                   KSyncSock::GetAgentSandeshContext());
+    sock->GenericSend(encode_len, buf, ioc);
+}
+
 bool FlowTableKSyncObject::AuditProcess(FlowTableKSyncObject *obj) {
+    if (obj->bulk_audit_) {
+        obj->BulkAuditProcess();
+        return true;
+    }
+
     uint32_t flow_idx;
     const vr_flow_entry *vflow_entry;
     while (!obj->audit_flow_list_.empty()) {
@@ -453,24 +499,11 @@ bool FlowTableKSyncObject::AuditProcess(FlowTableKSyncObject *obj) {
 
         vflow_entry = obj->GetKernelFlowEntry(flow_idx, false);
         if (vflow_entry && vflow_entry->fe_action == VR_FLOW_ACTION_HOLD) {
-            FlowKey key(vflow_entry->fe_key.key_vrf_id, 
-                        ntohl(vflow_entry->fe_key.key_src_ip), 
-                        ntohl(vflow_entry->fe_key.key_dest_ip),
-                        vflow_entry->fe_key.key_proto,
-                        ntohs(vflow_entry->fe_key.key_src_port),
-                        ntohs(vflow_entry->fe_key.key_dst_port));
-            FlowEntryPtr flow(FlowTable::GetFlowTableObject()->Allocate(key));
-            flow->flow_handle = flow_idx;
-            flow->short_flow = true;
-            flow->data.source_vn = *FlowHandler::UnknownVn();
-            flow->data.dest_vn = *FlowHandler::UnknownVn();
-            SecurityGroupList empty_sg_id_l;
-            flow->data.source_sg_id_l = empty_sg_id_l;
-            flow->data.dest_sg_id_l = empty_sg_id_l;
+            FlowKey key;
+            obj->GetFlowKey(flow_idx, key);
             AGENT_ERROR(FlowLog, flow_idx, "FlowAudit : Converting HOLD entry "
                             " to short flow");
-            FlowTable::GetFlowTableObject()->Add(flow.get(), NULL);
-
+            obj->AddShortFlow(flow_idx, key);
         }
     }
 
@@ -491,6 +524,105 @@ bool FlowTableKSyncObject::AuditProcess(FlowTableKSyncObject *obj) {
     return true;
 }
 
+//
+// Bulk audit
+//
+// The first run copies the active entries of the mmap'd table that the
+// agent has no flow for into bulk_audit_list_, in a single pass over the
+// table. The flow table index gives the agent flow of a key. An entry is
+// known if the agent has a flow for its key, whatever the handle of that
+// flow: the handle may not be set yet, or may be moving to another index.
+// A short flow must never be set up on the key of a live flow. The
+// following runs reconcile up to kBulkAuditBatch of the entries each:
+// - HOLD entries are converted to short flows, which get deleted from the
+//   kernel when they are aged, same as in the periodic audit.
+// - Other entries may carry established traffic, and a short flow would
+//   drop it until aged. They are deleted from the kernel instead, so that
+//   the next packet of the flow is trapped and the flow set up again.
+// An entry that changed or became known since the snapshot is left alone.
+//
+void FlowTableKSyncObject::StartBulkAudit() {
+    bulk_audit_ = true;
+    bulk_audit_list_.clear();
+    bulk_audit_pos_ = 0;
+    bulk_audit_start_ = 0;
+}
+
+bool FlowTableKSyncObject::IsAgentFlow(const FlowKey &key) {
+    return (FlowTable::GetFlowTableObject()->Find(key) != NULL);
+}
+
+void FlowTableKSyncObject::BulkAuditSnapshot() {
+    bulk_audit_start_ = ClockMonotonicUsec();
+    bulk_audit_stats_.audits++;
+    for (uint32_t idx = 0; idx < flow_table_entries_; idx++) {
+        FlowKey key;
+        if (!GetFlowKey(idx, key)) {
+            continue;
+        }
+        bulk_audit_stats_.entries++;
+        if (!IsAgentFlow(key)) {
+            bulk_audit_list_.push_back(AuditEntry(idx, key));
+        }
+    }
+    bulk_audit_stats_.orphans += bulk_audit_list_.size();
+    bulk_audit_pos_ = 0;
+}
+
+void FlowTableKSyncObject::BulkAuditProcess() {
+    if (bulk_audit_start_ == 0) {
+        BulkAuditSnapshot();
+        return;
+    }
+
+    size_t end = std::min(bulk_audit_pos_ + kBulkAuditBatch,
+                          bulk_audit_list_.size());
+    for (; bulk_audit_pos_ < end; bulk_audit_pos_++) {
+        const AuditEntry &entry = bulk_audit_list_[bulk_audit_pos_];
+        FlowKey key;
+        if (!GetFlowKey(entry.index, key) || !key.CompareKey(entry.key) ||
+            IsAgentFlow(key)) {
+            continue;
+        }
+        const vr_flow_entry *kflow = GetKernelFlowEntry(entry.index, false);
+        if (kflow && kflow->fe_action == VR_FLOW_ACTION_HOLD) {
+            AddShortFlow(entry.index, key);
+            bulk_audit_stats_.short_flows++;
+        } else {
+            DeleteKernelFlow(entry.index, key);
+            bulk_audit_stats_.deleted++;
+        }
+    }
+
+    if (bulk_audit_pos_ == bulk_audit_list_.size()) {
+        bulk_audit_stats_.last_audit_usecs =
+            ClockMonotonicUsec() - bulk_audit_start_;
+        AGENT_ERROR(FlowLog, 0, "FlowAudit : Bulk audit found " +
+                    integerToString(bulk_audit_list_.size()) +
+                    " entries unknown to the agent");
+        AuditEntryList empty;
+        bulk_audit_list_.swap(empty);
+        bulk_audit_pos_ = 0;
+        bulk_audit_ = false;
+    }
+}
+
+void FlowBulkAuditStatsReq::HandleRequest() const {
+    FlowTableKSyncObject *obj = FlowTableKSyncObject::GetKSyncObject();
+    const FlowTableKSyncObject::BulkAuditStats &stats =
+        obj->bulk_audit_stats();
+    FlowBulkAuditStatsResp *resp = new FlowBulkAuditStatsResp();
+    resp->set_running(obj->bulk_audit());
+    resp->set_audits(stats.audits);
+    resp->set_entries(stats.entries);
+    resp->set_orphans(stats.orphans);
+    resp->set_short_flows(stats.short_flows);
+    resp->set_deleted(stats.deleted);
+    resp->set_last_audit_usecs(stats.last_audit_usecs);
+    resp->set_context(context());
+    resp->Response();
+}
+
 // Steps to map flow table entry
 // - Query the Flow table parameters from kernel
 // - Create device /dev/flow with major-num and minor-num 
@@ -568,6 +700,7 @@ void FlowTableKSyncObject::MapFlowMem() {
 
     flow_table_entries_ = flow_table_size_ / sizeof(vr_flow_entry);
     audit_yeild_ = AuditYeild;
+    StartBulkAudit();
     singleton_->audit_timer_->Start(AuditTimeout,
                                     boost::bind(&FlowTableKSyncObject::AuditProcess, singleton_));
     return;
@@ -82,6 +82,23 @@ public:
     static const int kTestFlowTableSize = 131072 * sizeof(vr_flow_entry);
     static const uint32_t AuditTimeout = 2000;
     static const int AuditYeild = 1024;
+    static const uint32_t kBulkAuditBatch = 4096;
+
+    struct BulkAuditStats {
+        BulkAuditStats() : audits(0), entries(0), orphans(0), short_flows(0),
+            deleted(0), last_audit_usecs(0) {
+        }
+
+        uint64_t audits;
+        // Active kernel entries in the snapshots and those unknown to the
+        // agent. The HOLD orphans get a short flow, the others are deleted
+        // from the kernel.
+        uint64_t entries;
+        uint64_t orphans;
+        uint64_t short_flows;
+        uint64_t deleted;
+        uint64_t last_audit_usecs;
+    };
 
     FlowTableKSyncObject();
     FlowTableKSyncObject(int max_index);
@@ -95,6 +112,14 @@ public:
 
     uint32_t GetFlowTableSize() { return flow_table_entries_; }
     static bool AuditProcess(FlowTableKSyncObject *obj);
+    // Audit the whole table with the next runs of AuditProcess, started at
+    // agent restart when the kernel table may hold flows that the agent
+    // does not know about.
+    void StartBulkAudit();
+    bool bulk_audit() const { return bulk_audit_; }
+    const BulkAuditStats &bulk_audit_stats() const {
+        return bulk_audit_stats_;
+    }
     void MapFlowMem();
     void MapFlowMemTest();
     void UnmapFlowMemTest();
@@ -124,6 +149,20 @@ public:
 
 private:
     friend class KSyncSandeshContext;
+
+    struct AuditEntry {
+        AuditEntry(uint32_t idx, const FlowKey &k) : index(idx), key(k) { }
+        uint32_t index;
+        FlowKey key;
+    };
+    typedef std::vector<AuditEntry> AuditEntryList;
+
+    void AddShortFlow(uint32_t flow_idx, const FlowKey &key);
+    void DeleteKernelFlow(uint32_t flow_idx, const FlowKey &key);
+    bool IsAgentFlow(const FlowKey &key);
+    void BulkAuditSnapshot();
+    void BulkAuditProcess();
+
     static FlowTableKSyncObject *singleton_;
     int major_devid_;
     int flow_table_size_;
@@ -133,6 +172,12 @@ private:
     int audit_yeild_;
     uint32_t audit_flow_idx_;
     std::list<uint32_t> audit_flow_list_;
+    // Entries of the bulk audit snapshot left to reconcile.
+    bool bulk_audit_;
+    AuditEntryList bulk_audit_list_;
+    size_t bulk_audit_pos_;
+    uint64_t bulk_audit_start_;
+    BulkAuditStats bulk_audit_stats_;
     Timer *audit_timer_;
     DISALLOW_COPY_AND_ASSIGN(FlowTableKSyncObject);
 };
@@ -2,9 +2,11 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <algorithm>
 #include <vector>
 #include <bitset>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/functional/hash.hpp>
 #include <sandesh/sandesh_types.h>
 #include <sandesh/sandesh.h>
 #include <sandesh/sandesh_trace.h>
@@ -39,6 +41,7 @@
 #include "pkt/pkt_sandesh_flow.h"
 
 FlowTable* FlowTable::singleton_;
+FlowEntryPool FlowEntry::pool_(sizeof(FlowEntry));
 boost::uuids::random_generator FlowTable::rand_gen_ = boost::uuids::random_generator();
 tbb::atomic<int> FlowEntry::alloc_count_;
 
@@ -109,6 +112,196 @@ uint32_t FlowEntry::MatchAcl(const PacketHeader &hdr, MatchPolicy *policy,
 }
 
 // Recompute FlowEntry action
+FlowEntryPool::FlowEntryPool(size_t entry_size)
+    : entry_size_(std::max(entry_size, sizeof(FreeEntry))), free_list_(NULL),
+      capacity_(0), free_count_(0) {
+}
+
+FlowEntryPool::~FlowEntryPool() {
+    for (std::vector<char *>::iterator it = slabs_.begin();
+         it != slabs_.end(); ++it) {
+        delete [] *it;
+    }
+}
+
+void FlowEntryPool::AddSlab() {
+    char *slab = new char[kSlabEntries * entry_size_];
+    slabs_.push_back(slab);
+    for (size_t i = 0; i < kSlabEntries; i++) {
+        FreeEntry *entry = reinterpret_cast<FreeEntry *>(slab + i * entry_size_);
+        entry->next = free_list_;
+        free_list_ = entry;
+    }
+    capacity_ += kSlabEntries;
+    free_count_ += kSlabEntries;
+}
+
+void FlowEntryPool::Reserve(size_t count) {
+    tbb::spin_mutex::scoped_lock lock(mutex_);
+    while (capacity_ < count) {
+        AddSlab();
+    }
+}
+
+void *FlowEntryPool::Allocate() {
+    tbb::spin_mutex::scoped_lock lock(mutex_);
+    if (free_list_ == NULL) {
+        AddSlab();
+    }
+    FreeEntry *entry = free_list_;
+    free_list_ = entry->next;
+    free_count_--;
+    return entry;
+}
+
+void FlowEntryPool::Free(void *entry) {
+    tbb::spin_mutex::scoped_lock lock(mutex_);
+    FreeEntry *free_entry = static_cast<FreeEntry *>(entry);
+    free_entry->next = free_list_;
+    free_list_ = free_entry;
+    free_count_++;
+}
+
+void *FlowEntry::operator new(size_t size) {
+    if (size != sizeof(FlowEntry)) {
+        return ::operator new(size);
+    }
+    return pool_.Allocate();
+}
+
+void FlowEntry::operator delete(void *entry, size_t size) {
+    if (entry == NULL) {
+        return;
+    }
+    if (size != sizeof(FlowEntry)) {
+        ::operator delete(entry);
+        return;
+    }
+    pool_.Free(entry);
+}
+
+FlowEntryIndex::FlowEntryIndex()
+    : slots_(kMinSize, static_cast<FlowEntry *>(NULL)), count_(0),
+      deleted_(0) {
+}
+
+size_t FlowEntryIndex::Hash(const FlowKey &key) {
+    size_t hash = 0;
+    boost::hash_combine(hash, key.vrf);
+    boost::hash_combine(hash, key.src.ipv4);
+    boost::hash_combine(hash, key.dst.ipv4);
+    boost::hash_combine(hash, key.protocol);
+    boost::hash_combine(hash, key.src_port);
+    boost::hash_combine(hash, key.dst_port);
+    return hash;
+}
+
+void FlowEntryIndex::Reserve(size_t count) {
+    size_t size = slots_.size();
+    while (size < 2 * count) {
+        size <<= 1;
+    }
+    if (size > slots_.size()) {
+        Resize(size);
+    }
+}
+
+void FlowEntryIndex::Resize(size_t size) {
+    std::vector<FlowEntry *> slots(size, static_cast<FlowEntry *>(NULL));
+    slots_.swap(slots);
+    count_ = 0;
+    deleted_ = 0;
+    for (std::vector<FlowEntry *>::iterator it = slots.begin();
+         it != slots.end(); ++it) {
+        if (*it != NULL && *it != Deleted()) {
+            Insert(*it);
+        }
+    }
+}
+
+FlowEntry *FlowEntryIndex::Find(const FlowKey &key) const {
+    size_t mask = slots_.size() - 1;
+    for (size_t i = Hash(key) & mask; ; i = (i + 1) & mask) {
+        FlowEntry *flow = slots_[i];
+        if (flow == NULL) {
+            return NULL;
+        }
+        if (flow != Deleted() && flow->key.CompareKey(key)) {
+            return flow;
+        }
+    }
+}
+
+bool FlowEntryIndex::Insert(FlowEntry *flow) {
+    if ((count_ + deleted_ + 1) * 2 > slots_.size()) {
+        // Grow if the live flows take the space, else just drop the
+        // deleted slots.
+        if ((count_ + 1) * 4 > slots_.size()) {
+            Resize(slots_.size() * 2);
+        } else {
+            Resize(slots_.size());
+        }
+    }
+
+    size_t mask = slots_.size() - 1;
+    size_t free_slot = slots_.size();
+    size_t i;
+    for (i = Hash(flow->key) & mask; slots_[i] != NULL; i = (i + 1) & mask) {
+        if (slots_[i] == Deleted()) {
+            if (free_slot == slots_.size()) {
+                free_slot = i;
+            }
+        } else if (slots_[i]->key.CompareKey(flow->key)) {
+            return false;
+        }
+    }
+    if (free_slot == slots_.size()) {
+        free_slot = i;
+    } else {
+        deleted_--;
+    }
+    slots_[free_slot] = flow;
+    count_++;
+    return true;
+}
+
+bool FlowEntryIndex::Remove(FlowEntry *flow) {
+    size_t mask = slots_.size() - 1;
+    for (size_t i = Hash(flow->key) & mask; slots_[i] != NULL;
+         i = (i + 1) & mask) {
+        if (slots_[i] == flow) {
+            slots_[i] = Deleted();
+            count_--;
+            deleted_++;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Secondary index lists hold a reference to their flows.
+template <typename List>
+static void FlowListLink(List *list, FlowEntry *fe) {
+    intrusive_ptr_add_ref(fe);
+    list->push_back(*fe);
+}
+
+template <typename List>
+static void FlowListUnlink(List *list, FlowEntry *fe) {
+    list->erase(list->iterator_to(*fe));
+    intrusive_ptr_release(fe);
+}
+
+// Copy of a list that stays valid while the flows are relinked or deleted.
+template <typename List>
+static void FlowListCopy(const List &list, FlowTable::FlowEntryList *copy) {
+    copy->reserve(copy->size() + list.size());
+    for (typename List::const_iterator it = list.begin(); it != list.end();
+         ++it) {
+        copy->push_back(FlowEntryPtr(const_cast<FlowEntry *>(&(*it))));
+    }
+}
+
 bool FlowEntry::ActionRecompute(MatchPolicy *policy) {
     uint32_t action = 0;
 
@@ -558,33 +751,31 @@ void FlowEntry::FillFlowInfo(FlowInfo &info) {
 }
 
 FlowEntry *FlowTable::Allocate(const FlowKey &key) {
-    FlowEntry *flow = new FlowEntry(key);
-    std::pair<FlowEntryMap::iterator, bool> ret;
-    ret = flow_entry_map_.insert(std::pair<FlowKey, FlowEntry*>(key, flow));
-    if (ret.second == false) {
-        delete flow;
-        flow = ret.first->second;
+    FlowEntry *flow = flow_index_.Find(key);
+    if (flow != NULL) {
         DeleteFlowInfo(flow);
-    } else {
-        flow->flow_uuid = FlowTable::rand_gen_();
-        flow->egress_uuid = FlowTable::rand_gen_();
-        flow->setup_time = UTCTimestampUsec();
-        AgentStats::GetInstance()->IncrFlowActive();
-        AgentStats::GetInstance()->IncrFlowCreated();
+        return flow;
     }
 
+    flow = new FlowEntry(key);
+    flow_entry_map_.insert(std::pair<FlowKey, FlowEntry*>(key, flow));
+    flow_index_.Insert(flow);
+    flow->flow_uuid = FlowTable::rand_gen_();
+    flow->egress_uuid = FlowTable::rand_gen_();
+    flow->setup_time = UTCTimestampUsec();
+    AgentStats::GetInstance()->IncrFlowActive();
+    AgentStats::GetInstance()->IncrFlowCreated();
+
     return flow;
 }
 
 FlowEntry *FlowTable::Find(const FlowKey &key) {
-    FlowEntryMap::iterator it;
+    return flow_index_.Find(key);
+}
 
-    it = flow_entry_map_.find(key);
-    if (it != flow_entry_map_.end()) {
-        return it->second;
-    } else {
-        return NULL;
-    }
+void FlowTable::Reserve(size_t count) {
+    FlowEntry::pool()->Reserve(count);
+    flow_index_.Reserve(count);
 }
 
 void FlowTable::DeleteInternal(FlowEntryMap::iterator &it)
@@ -606,6 +797,7 @@ void FlowTable::DeleteInternal(FlowEntryMap::iterator &it)
     fe->data.reverse_flow = NULL;
 
     DeleteFlowInfo(fe);
+    flow_index_.Remove(fe);
     flow_entry_map_.erase(it);
 
     FlowTableKSyncEntry *ksync_entry = 
@@ -757,6 +949,12 @@ void FlowTable::Init() {
     assert(singleton_ == NULL);
     singleton_ = new FlowTable;
 
+    // Room for as many flows as the kernel flow table holds
+    FlowTableKSyncObject *ksync_obj = FlowTableKSyncObject::GetKSyncObject();
+    if (ksync_obj) {
+        singleton_->Reserve(ksync_obj->GetFlowTableSize());
+    }
+
     singleton_->acl_listener_id_ = Agent::GetInstance()->GetAclTable()->Register
         (boost::bind(&FlowTable::AclNotify, singleton_, _1, _2));
 
@@ -1110,12 +1308,10 @@ void FlowTable::ResyncVnFlows(const VnEntry *vn) {
         return;
     }
 
-    FlowEntryTree fet = vn_it->second->fet;
-    FlowEntryTree::iterator fet_it, it;
-    it = fet.begin();
-    while (it != fet.end()) {
-        fet_it = it++;
-        FlowEntry *fe = (*fet_it).get();
+    FlowEntryList fel;
+    FlowListCopy(vn_it->second->flow_list, &fel);
+    for (FlowEntryList::iterator it = fel.begin(); it != fel.end(); ++it) {
+        FlowEntry *fe = (*it).get();
         DeleteFlowInfo(fe);
         MatchPolicy policy;
         fe->GetPolicy(vn, &policy);
@@ -1136,12 +1332,11 @@ void FlowTable::ResyncAclFlows(const AclDBEntry *acl)
         return;
     }
 
-    FlowEntryTree fet = acl_it->second->fet;
-    FlowEntryTree::iterator fet_it, it;
-    it = fet.begin();
-    while (it != fet.end()) {
-        fet_it = it++;
-        FlowEntry *fe = (*fet_it).get();
+    // Copy of the set that stays valid while the flows are relinked.
+    const FlowEntryTree &fet = acl_it->second->fet;
+    FlowEntryList fel(fet.begin(), fet.end());
+    for (FlowEntryList::iterator it = fel.begin(); it != fel.end(); ++it) {
+        FlowEntry *fe = (*it).get();
         DeleteFlowInfo(fe);
         MatchPolicy policy;
         fe->GetPolicy(fe->data.vn_entry.get(), &policy);
@@ -1161,12 +1356,10 @@ void FlowTable::TrapReverseEcmpFlow(RouteFlowKey &key, uint32_t index,
     if (rf_it == route_flow_tree_.end()) {
         return;
     }
-    FlowEntryTree fet = rf_it->second->fet;
-    FlowEntryTree::iterator fet_it, it;
-    it = fet.begin();
-    while (it != fet.end()) {
-        fet_it = it++;
-        FlowEntry *fe = (*fet_it).get();
+    FlowEntryList fel;
+    GetRouteFlows(rf_it->second, &fel);
+    for (FlowEntryList::iterator it = fel.begin(); it != fel.end(); ++it) {
+        FlowEntry *fe = (*it).get();
         //Check only for flows whose destination matches
         //given route
         if (fe->data.flow_dest_vrf != key.vrf) {
@@ -1202,12 +1395,10 @@ void FlowTable::ResyncRouteFlows(RouteFlowKey &key, SecurityGroupList &sg_l)
     if (rf_it == route_flow_tree_.end()) {
         return;
     }
-    FlowEntryTree fet = rf_it->second->fet;
-    FlowEntryTree::iterator fet_it, it;
-    it = fet.begin();
-    while (it != fet.end()) {
-        fet_it = it++;
-        FlowEntry *fe = (*fet_it).get();
+    FlowEntryList fel;
+    GetRouteFlows(rf_it->second, &fel);
+    for (FlowEntryList::iterator it = fel.begin(); it != fel.end(); ++it) {
+        FlowEntry *fe = (*it).get();
         DeleteFlowInfo(fe);
         MatchPolicy policy;
         fe->GetPolicy(fe->data.vn_entry.get(), &policy);
@@ -1238,12 +1429,10 @@ void FlowTable::ResyncVmPortFlows(const VmPortInterface *intf) {
         return;
     }
 
-    FlowEntryTree fet = intf_it->second->fet;
-    FlowEntryTree::iterator fet_it, it;
-    it = fet.begin();
-    while (it != fet.end()) {
-        fet_it = it++;
-        FlowEntry *fe = (*fet_it).get();
+    FlowEntryList fel;
+    FlowListCopy(intf_it->second->flow_list, &fel);
+    for (FlowEntryList::iterator it = fel.begin(); it != fel.end(); ++it) {
+        FlowEntry *fe = (*it).get();
         DeleteFlowInfo(fe);
         MatchPolicy policy;
         fe->GetPolicy(intf->GetVnEntry(), &policy);
@@ -1265,18 +1454,18 @@ void FlowTable::DeleteRouteFlows(const RouteFlowKey &key)
         return;
     }
     FLOW_TRACE(ModuleInfo, "Delete Route flows");
-    FlowEntryTree fet = rf_it->second->fet;
-    FlowEntryTree::iterator fet_it, it;
-    it = fet.begin();
-    while (it != fet.end()) {
-        fet_it = it++;
-        FlowEntry *fe = (*fet_it).get();
+    FlowEntryList fel;
+    GetRouteFlows(rf_it->second, &fel);
+    for (FlowEntryList::iterator it = fel.begin(); it != fel.end(); ++it) {
+        FlowEntry *fe = (*it).get();
         DeleteNatFlow(fe->key, true);
     }
 }
 
 void FlowTable::DeleteFlowInfo(FlowEntry *fe) 
 {
+    // Unlinking from the lists may drop the last reference
+    FlowEntryPtr fe_ref(fe);
     FlowUve::GetInstance()->DeleteFlow(fe);
     // Remove from AclFlowTree
     // Go to all matched ACL list and remove from all acls
@@ -1325,20 +1514,16 @@ void FlowTable::DeleteFlowInfo(FlowEntry *fe)
 
 void FlowTable::DeleteVnFlowInfo(FlowEntry *fe)
 {
-    VnFlowTree::iterator vn_it;
-    if (fe->data.vn_entry) {
-        vn_it = vn_flow_tree_.find(fe->data.vn_entry.get());
-        if (vn_it != vn_flow_tree_.end()) {
-            VnFlowInfo *vn_flow_info = vn_it->second;
-            int count = vn_flow_info->fet.erase(fe);
-            if (count > 0) {
-                DecrVnFlowCounter(vn_flow_info, fe);
-            }
-            if (vn_flow_info->fet.empty()) {
-                delete vn_flow_info;
-                vn_flow_tree_.erase(vn_it);
-            }
-        }
+    VnFlowInfo *vn_flow_info = fe->vn_flow_info_;
+    if (vn_flow_info == NULL) {
+        return;
+    }
+    DecrVnFlowCounter(vn_flow_info, fe);
+    fe->vn_flow_info_ = NULL;
+    FlowListUnlink(&vn_flow_info->flow_list, fe);
+    if (vn_flow_info->flow_list.empty()) {
+        vn_flow_tree_.erase(vn_flow_info->vn_entry.get());
+        delete vn_flow_info;
     }
 }
 
@@ -1365,59 +1550,63 @@ void FlowTable::DeleteAclFlowInfo(const AclDBEntry *acl, FlowEntry* flow, AclEnt
 
 void FlowTable::DeleteIntfFlowInfo(FlowEntry *fe)
 {
-    IntfFlowTree::iterator intf_it;
-    if (fe->data.intf_entry) {
-        intf_it = intf_flow_tree_.find(fe->data.intf_entry.get());
-        if (intf_it != intf_flow_tree_.end()) {
-            IntfFlowInfo *intf_flow_info = intf_it->second;
-            intf_flow_info->fet.erase(fe);
-            if (intf_flow_info->fet.empty()) {
-                delete intf_flow_info;
-                intf_flow_tree_.erase(intf_it);
-            }
-        }
+    IntfFlowInfo *intf_flow_info = fe->intf_flow_info_;
+    if (intf_flow_info == NULL) {
+        return;
+    }
+    fe->intf_flow_info_ = NULL;
+    FlowListUnlink(&intf_flow_info->flow_list, fe);
+    if (intf_flow_info->flow_list.empty()) {
+        intf_flow_tree_.erase(intf_flow_info->intf_entry.get());
+        delete intf_flow_info;
     }
 }
 
 void FlowTable::DeleteVmFlowInfo(FlowEntry *fe)
 {
-    VmFlowTree::iterator vm_it;
-    if (fe->data.vm_entry) {
-        vm_it = vm_flow_tree_.find(fe->data.vm_entry.get());
-        if (vm_it != vm_flow_tree_.end()) {
-            VmFlowInfo *vm_flow_info = vm_it->second;
-            vm_flow_info->fet.erase(fe);
-            if (vm_flow_info->fet.empty()) {
-                delete vm_flow_info;
-                vm_flow_tree_.erase(vm_it);
-            }
-        }
+    VmFlowInfo *vm_flow_info = fe->vm_flow_info_;
+    if (vm_flow_info == NULL) {
+        return;
+    }
+    fe->vm_flow_info_ = NULL;
+    FlowListUnlink(&vm_flow_info->flow_list, fe);
+    if (vm_flow_info->flow_list.empty()) {
+        vm_flow_tree_.erase(vm_flow_info->vm_entry.get());
+        delete vm_flow_info;
     }
 }
 
 void FlowTable::DeleteRouteFlowInfo (FlowEntry *fe)
 {
-    RouteFlowTree::iterator rf_it;
-    RouteFlowKey skey(fe->data.flow_source_vrf, fe->key.src.ipv4);
-    rf_it = route_flow_tree_.find(skey);
-    RouteFlowInfo *route_flow_info;
-    if (rf_it != route_flow_tree_.end()) {
-        route_flow_info = rf_it->second;
-        route_flow_info->fet.erase(fe);
-        if (route_flow_info->fet.empty()) {
+    RouteFlowInfo *route_flow_info = fe->src_route_flow_info_;
+    if (route_flow_info) {
+        fe->src_route_flow_info_ = NULL;
+        FlowListUnlink(&route_flow_info->src_flow_list, fe);
+        if (route_flow_info->empty()) {
+            route_flow_tree_.erase(route_flow_info->key);
             delete route_flow_info;
-            route_flow_tree_.erase(rf_it);
         }
     }
 
-    RouteFlowKey dkey(fe->data.flow_dest_vrf, fe->key.dst.ipv4);
-    rf_it = route_flow_tree_.find(dkey);
-    if (rf_it != route_flow_tree_.end()) {
-        route_flow_info = rf_it->second;
-        route_flow_info->fet.erase(fe);
-        if (route_flow_info->fet.empty()) {
+    route_flow_info = fe->dst_route_flow_info_;
+    if (route_flow_info) {
+        fe->dst_route_flow_info_ = NULL;
+        FlowListUnlink(&route_flow_info->dst_flow_list, fe);
+        if (route_flow_info->empty()) {
+            route_flow_tree_.erase(route_flow_info->key);
             delete route_flow_info;
-            route_flow_tree_.erase(rf_it);
+        }
+    }
+}
+
+// Flows whose source and destination are both on the route are on both
+// lists, they are returned once.
+void FlowTable::GetRouteFlows(const RouteFlowInfo *info, FlowEntryList *list) {
+    FlowListCopy(info->src_flow_list, list);
+    for (FlowDstRouteList::const_iterator it = info->dst_flow_list.begin();
+         it != info->dst_flow_list.end(); ++it) {
+        if (it->src_route_flow_info_ != info) {
+            list->push_back(FlowEntryPtr(const_cast<FlowEntry *>(&(*it))));
         }
     }
 }
@@ -1509,19 +1698,24 @@ void FlowTable::AddIntfFlowInfo (FlowEntry *fe)
     if (!fe->data.intf_entry) {
         return;
     }
+    IntfFlowInfo *intf_flow_info = fe->intf_flow_info_;
+    if (intf_flow_info) {
+        if (intf_flow_info->intf_entry == fe->data.intf_entry) {
+            return;
+        }
+        DeleteIntfFlowInfo(fe);
+    }
     IntfFlowTree::iterator it;
     it = intf_flow_tree_.find(fe->data.intf_entry.get());
-    IntfFlowInfo *intf_flow_info;
     if (it == intf_flow_tree_.end()) {
         intf_flow_info = new IntfFlowInfo();
         intf_flow_info->intf_entry = fe->data.intf_entry;
-        intf_flow_info->fet.insert(fe);
         intf_flow_tree_.insert(IntfFlowPair(fe->data.intf_entry.get(), intf_flow_info));
     } else {
         intf_flow_info = it->second;
-        /* fe can already exist. In that case it won't be inserted */
-        intf_flow_info->fet.insert(fe);
     }
+    FlowListLink(&intf_flow_info->flow_list, fe);
+    fe->intf_flow_info_ = intf_flow_info;
 }
 
 void FlowTable::AddVmFlowInfo (FlowEntry *fe)
@@ -1529,19 +1723,24 @@ void FlowTable::AddVmFlowInfo (FlowEntry *fe)
     if (!fe->data.vm_entry) {
         return;
     }
+    VmFlowInfo *vm_flow_info = fe->vm_flow_info_;
+    if (vm_flow_info) {
+        if (vm_flow_info->vm_entry == fe->data.vm_entry) {
+            return;
+        }
+        DeleteVmFlowInfo(fe);
+    }
     VmFlowTree::iterator it;
     it = vm_flow_tree_.find(fe->data.vm_entry.get());
-    VmFlowInfo *vm_flow_info;
     if (it == vm_flow_tree_.end()) {
         vm_flow_info = new VmFlowInfo();
         vm_flow_info->vm_entry = fe->data.vm_entry;
-        vm_flow_info->fet.insert(fe);
         vm_flow_tree_.insert(VmFlowPair(fe->data.vm_entry.get(), vm_flow_info));
     } else {
         vm_flow_info = it->second;
-        /* fe can already exist. In that case it won't be inserted */
-        vm_flow_info->fet.insert(fe);
     }
+    FlowListLink(&vm_flow_info->flow_list, fe);
+    fe->vm_flow_info_ = vm_flow_info;
 }
 
 void FlowTable::IncrVnFlowCounter(VnFlowInfo *vn_flow_info, 
@@ -1577,24 +1776,25 @@ void FlowTable::AddVnFlowInfo (FlowEntry *fe)
     if (!fe->data.vn_entry) {
         return;
     }    
+    VnFlowInfo *vn_flow_info = fe->vn_flow_info_;
+    if (vn_flow_info) {
+        if (vn_flow_info->vn_entry == fe->data.vn_entry) {
+            return;
+        }
+        DeleteVnFlowInfo(fe);
+    }
     VnFlowTree::iterator it;
     it = vn_flow_tree_.find(fe->data.vn_entry.get());
-    VnFlowInfo *vn_flow_info;
     if (it == vn_flow_tree_.end()) {
         vn_flow_info = new VnFlowInfo();
         vn_flow_info->vn_entry = fe->data.vn_entry;
-        vn_flow_info->fet.insert(fe);
-        IncrVnFlowCounter(vn_flow_info, fe);
         vn_flow_tree_.insert(VnFlowPair(fe->data.vn_entry.get(), vn_flow_info));
     } else {
         vn_flow_info = it->second;
-        /* fe can already exist. In that case it won't be inserted */
-        pair<FlowTable::FlowEntryTree::iterator, bool> ret = 
-                                            vn_flow_info->fet.insert(fe);
-        if (ret.second) {
-            IncrVnFlowCounter(vn_flow_info, fe);
-        }
     }
+    FlowListLink(&vn_flow_info->flow_list, fe);
+    fe->vn_flow_info_ = vn_flow_info;
+    IncrVnFlowCounter(vn_flow_info, fe);
 }
 
 void FlowTable::VnFlowCounters(const VnEntry *vn, uint32_t *in_count, 
@@ -1615,30 +1815,32 @@ void FlowTable::AddRouteFlowInfo (FlowEntry *fe)
 {
     RouteFlowTree::iterator it;
     RouteFlowInfo *route_flow_info;
-    if (fe->data.flow_source_vrf != VrfEntry::kInvalidIndex) {
+    if (fe->data.flow_source_vrf != VrfEntry::kInvalidIndex &&
+        fe->src_route_flow_info_ == NULL) {
         RouteFlowKey skey(fe->data.flow_source_vrf, fe->key.src.ipv4);
         it = route_flow_tree_.find(skey);
         if (it == route_flow_tree_.end()) {
-            route_flow_info = new RouteFlowInfo();
-            route_flow_info->fet.insert(fe);
+            route_flow_info = new RouteFlowInfo(skey);
             route_flow_tree_.insert(RouteFlowPair(skey, route_flow_info));
         } else {
             route_flow_info = it->second;
-            route_flow_info->fet.insert(fe);
         }
+        FlowListLink(&route_flow_info->src_flow_list, fe);
+        fe->src_route_flow_info_ = route_flow_info;
     }
 
-    if (fe->data.flow_dest_vrf != VrfEntry::kInvalidIndex) {
+    if (fe->data.flow_dest_vrf != VrfEntry::kInvalidIndex &&
+        fe->dst_route_flow_info_ == NULL) {
         RouteFlowKey dkey(fe->data.flow_dest_vrf, fe->key.dst.ipv4);
         it = route_flow_tree_.find(dkey);
         if (it == route_flow_tree_.end()) {
-            route_flow_info = new RouteFlowInfo();
-            route_flow_info->fet.insert(fe);
+            route_flow_info = new RouteFlowInfo(dkey);
             route_flow_tree_.insert(RouteFlowPair(dkey, route_flow_info));
         } else {
             route_flow_info = it->second;
-            route_flow_info->fet.insert(fe);
         }
+        FlowListLink(&route_flow_info->dst_flow_list, fe);
+        fe->dst_route_flow_info_ = route_flow_info;
     }
 }
 
@@ -1693,10 +1895,10 @@ void FlowTable::DeleteVnFlows(const VnEntry *vn)
         return;
     }
     FLOW_TRACE(ModuleInfo, "Delete Vn Flows");
-    FlowEntryTree fet = vn_it->second->fet;
-    FlowEntryTree::iterator fet_it;
-    for (fet_it = fet.begin(); fet_it != fet.end(); ++fet_it) {
-        DeleteNatFlow((*fet_it)->key, true);
+    FlowEntryList fel;
+    FlowListCopy(vn_it->second->flow_list, &fel);
+    for (FlowEntryList::iterator it = fel.begin(); it != fel.end(); ++it) {
+        DeleteNatFlow((*it)->key, true);
     }
 }
 
@@ -1708,10 +1910,10 @@ void FlowTable::DeleteVmFlows(const VmEntry *vm)
         return;
     }
     FLOW_TRACE(ModuleInfo, "Delete VM flows");
-    FlowEntryTree fet = vm_it->second->fet;
-    FlowEntryTree::iterator fet_it;
-    for (fet_it = fet.begin(); fet_it != fet.end(); ++fet_it) {
-        DeleteNatFlow((*fet_it)->key, true);
+    FlowEntryList fel;
+    FlowListCopy(vm_it->second->flow_list, &fel);
+    for (FlowEntryList::iterator it = fel.begin(); it != fel.end(); ++it) {
+        DeleteNatFlow((*it)->key, true);
     }
 }
 
@@ -1723,10 +1925,10 @@ void FlowTable::DeleteVmIntfFlows(const Interface *intf)
         return;
     }
     FLOW_TRACE(ModuleInfo, "Delete Interface Flows");
-    FlowEntryTree fet = intf_it->second->fet;
-    FlowEntryTree::iterator fet_it;
-    for (fet_it = fet.begin(); fet_it != fet.end(); ++fet_it) {
-        DeleteNatFlow((*fet_it)->key, true);
+    FlowEntryList fel;
+    FlowListCopy(intf_it->second->flow_list, &fel);
+    for (FlowEntryList::iterator it = fel.begin(); it != fel.end(); ++it) {
+        DeleteNatFlow((*it)->key, true);
     }
 }
 
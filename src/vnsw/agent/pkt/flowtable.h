@@ -6,11 +6,14 @@
 #define __AGENT_FLOW_TABLE_H__
 
 #include <map>
+#include <vector>
 #include <boost/uuid/random_generator.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <boost/intrusive/list.hpp>
 #include <tbb/atomic.h>
 #include <tbb/mutex.h>
+#include <tbb/spin_mutex.h>
 #include <base/util.h>
 #include <cmn/agent_cmn.h>
 #include <oper/mirror_table.h>
@@ -192,7 +195,7 @@ struct FlowKey {
     uint16_t src_port;
     uint16_t dst_port;
     uint8_t protocol;
-    bool CompareKey(const FlowKey &key) {
+    bool CompareKey(const FlowKey &key) const {
         return (key.vrf == vrf &&
                 key.src.ipv4 == src.ipv4 &&
                 key.dst.ipv4 == dst.ipv4 &&
@@ -275,6 +278,49 @@ struct FlowData {
     NextHopConstRef nh;
 };
 
+//
+// Preallocated storage for the FlowEntry objects. Entries are carved out of
+// slabs and recycled through a free list, so that flow setup and teardown
+// don't go through the heap. Reserve() allocates the slabs up front; the
+// flow table reserves as many entries as the kernel flow table holds.
+//
+// Concurrency: flows are released from several tasks, so Allocate and Free
+// are protected by a spin lock.
+//
+class FlowEntryPool {
+public:
+    static const size_t kSlabEntries = 1024;
+
+    explicit FlowEntryPool(size_t entry_size);
+    ~FlowEntryPool();
+
+    // Make sure that count entries can be allocated without growing.
+    void Reserve(size_t count);
+    void *Allocate();
+    void Free(void *entry);
+
+    size_t capacity() const { return capacity_; }
+    size_t free_count() const { return free_count_; }
+
+private:
+    struct FreeEntry {
+        FreeEntry *next;
+    };
+
+    void AddSlab();
+
+    tbb::spin_mutex mutex_;
+    size_t entry_size_;
+    std::vector<char *> slabs_;
+    FreeEntry *free_list_;
+    size_t capacity_;
+    size_t free_count_;
+
+    DISALLOW_COPY_AND_ASSIGN(FlowEntryPool);
+};
+
+typedef boost::intrusive::list_member_hook<> FlowEntryListNode;
+
 class FlowEntry {
   public:
     static const uint32_t kInvalidFlowHandle=0xFFFFFFFF;
@@ -291,7 +337,9 @@ class FlowEntry {
         key(), data(), intf_in(0), flow_handle(kInvalidFlowHandle), nat(false),
         local_flow(false), short_flow(false), mdata_flow(false), 
         is_reverse_flow(false), setup_time(0), teardown_time(0),
-        last_modified_time(0) {
+        last_modified_time(0), vn_flow_info_(NULL), intf_flow_info_(NULL),
+        vm_flow_info_(NULL), src_route_flow_info_(NULL),
+        dst_route_flow_info_(NULL) {
         flow_uuid = nil_uuid(); 
         egress_uuid = nil_uuid(); 
         refcount_ = 0;
@@ -301,7 +349,9 @@ class FlowEntry {
         key(k), data(), intf_in(0), flow_handle(kInvalidFlowHandle), nat(false),
         local_flow(false), short_flow(false), mdata_flow(false),
         is_reverse_flow(false), setup_time(0), teardown_time(0),
-        last_modified_time(0) {
+        last_modified_time(0), vn_flow_info_(NULL), intf_flow_info_(NULL),
+        vm_flow_info_(NULL), src_route_flow_info_(NULL),
+        dst_route_flow_info_(NULL) {
         flow_uuid = nil_uuid(); 
         egress_uuid = nil_uuid(); 
         refcount_ = 0;
@@ -311,6 +361,11 @@ class FlowEntry {
         alloc_count_.fetch_and_decrement();
     };
 
+    // FlowEntry objects come from pool_.
+    static void *operator new(size_t size);
+    static void operator delete(void *entry, size_t size);
+    static FlowEntryPool *pool() { return &pool_; }
+
     FlowKey key;
     FlowData data;
     uuid flow_uuid;
@@ -330,6 +385,20 @@ class FlowEntry {
     uint64_t teardown_time;
     uint64_t last_modified_time; //used for aging
 
+    // Secondary indexes: the flow is linked on the list of the VN,
+    // interface and VM it refers to, and on the lists of its source and
+    // destination routes. The info pointers are set while it is linked.
+    FlowEntryListNode vn_node_;
+    FlowEntryListNode intf_node_;
+    FlowEntryListNode vm_node_;
+    FlowEntryListNode src_route_node_;
+    FlowEntryListNode dst_route_node_;
+    VnFlowInfo *vn_flow_info_;
+    IntfFlowInfo *intf_flow_info_;
+    VmFlowInfo *vm_flow_info_;
+    RouteFlowInfo *src_route_flow_info_;
+    RouteFlowInfo *dst_route_flow_info_;
+
     bool ActionRecompute(MatchPolicy *policy);
     void CompareAndModify(const MatchPolicy &m_policy, bool create);
     void UpdateKSync(FlowTableKSyncEntry *entry, bool create);
@@ -359,6 +428,7 @@ private:
     friend void intrusive_ptr_add_ref(FlowEntry *fe);
     friend void intrusive_ptr_release(FlowEntry *fe);
     static tbb::atomic<int> alloc_count_;
+    static FlowEntryPool pool_;
     // atomic refcount
     tbb::atomic<int> refcount_;
 };
@@ -382,6 +452,40 @@ struct FlowEntryCmp {
     }
 };
 
+//
+// Open addressing hash index of the flows on their FlowKey, with linear
+// probing. The slots hold the FlowEntry pointers, so a lookup touches a
+// single array in the common case. Deleted slots are marked and reused;
+// the table is rebuilt when live and deleted slots fill half of it.
+//
+class FlowEntryIndex {
+public:
+    static const size_t kMinSize = 1024;
+
+    FlowEntryIndex();
+
+    // Size the table for count flows.
+    void Reserve(size_t count);
+    FlowEntry *Find(const FlowKey &key) const;
+    // Returns false if a flow with the same key is already present.
+    bool Insert(FlowEntry *flow);
+    bool Remove(FlowEntry *flow);
+
+    size_t size() const { return count_; }
+    size_t capacity() const { return slots_.size(); }
+
+private:
+    static size_t Hash(const FlowKey &key);
+    static FlowEntry *Deleted() { return reinterpret_cast<FlowEntry *>(1); }
+    void Resize(size_t size);
+
+    std::vector<FlowEntry *> slots_;
+    size_t count_;
+    size_t deleted_;
+
+    DISALLOW_COPY_AND_ASSIGN(FlowEntryIndex);
+};
+
 class FlowTable {
 public:
     static const int MaxResponses = 100;
@@ -405,6 +509,27 @@ public:
     typedef std::map<RouteFlowKey, RouteFlowInfo *, RouteFlowKeyCmp> RouteFlowTree;
     typedef std::pair<RouteFlowKey, RouteFlowInfo *> RouteFlowPair;
 
+    // Lists of the secondary indexes. A list holds a reference to each of
+    // its flows.
+    typedef boost::intrusive::member_hook<FlowEntry, FlowEntryListNode,
+            &FlowEntry::vn_node_> FlowVnNode;
+    typedef boost::intrusive::list<FlowEntry, FlowVnNode> FlowVnList;
+    typedef boost::intrusive::member_hook<FlowEntry, FlowEntryListNode,
+            &FlowEntry::intf_node_> FlowIntfNode;
+    typedef boost::intrusive::list<FlowEntry, FlowIntfNode> FlowIntfList;
+    typedef boost::intrusive::member_hook<FlowEntry, FlowEntryListNode,
+            &FlowEntry::vm_node_> FlowVmNode;
+    typedef boost::intrusive::list<FlowEntry, FlowVmNode> FlowVmList;
+    typedef boost::intrusive::member_hook<FlowEntry, FlowEntryListNode,
+            &FlowEntry::src_route_node_> FlowSrcRouteNode;
+    typedef boost::intrusive::list<FlowEntry, FlowSrcRouteNode>
+        FlowSrcRouteList;
+    typedef boost::intrusive::member_hook<FlowEntry, FlowEntryListNode,
+            &FlowEntry::dst_route_node_> FlowDstRouteNode;
+    typedef boost::intrusive::list<FlowEntry, FlowDstRouteNode>
+        FlowDstRouteList;
+    typedef std::vector<FlowEntryPtr> FlowEntryList;
+
     struct VnFlowHandlerState : public DBState {
         AclDBEntryConstRef acl_;
         AclDBEntryConstRef macl_;
@@ -448,6 +573,8 @@ public:
     FlowEntry *Allocate(const FlowKey &key);
     void Add(FlowEntry *flow, FlowEntry *rflow);
     FlowEntry *Find(const FlowKey &key);
+    // Preallocate flow entries and index slots for count flows.
+    void Reserve(size_t count);
 
     bool DeleteNatFlow(FlowKey &key, bool del_nat_flow);
     bool DeleteRevFlow(FlowKey &key, bool del_reverse_flow);
@@ -481,7 +608,10 @@ public:
     friend class NhState;
 private:
     static FlowTable* singleton_;
+    // Flows in key order, for the walks that resume from a key. Lookups go
+    // through flow_index_.
     FlowEntryMap flow_entry_map_;
+    FlowEntryIndex flow_index_;
 
     AclFlowTree acl_flow_tree_;
     VnFlowTree vn_flow_tree_;
@@ -517,6 +647,7 @@ private:
     void DeleteVmFlowInfo(FlowEntry *fe);
     void DeleteIntfFlowInfo(FlowEntry *fe);
     void DeleteRouteFlowInfo(FlowEntry *fe);
+    void GetRouteFlows(const RouteFlowInfo *info, FlowEntryList *list);
     void DeleteAclFlowInfo(const AclDBEntry *acl, FlowEntry* flow, AclEntryIDList &id_list);
 
     void DeleteVnFlows(const VnEntry *vn);
@@ -604,7 +735,7 @@ struct VnFlowInfo {
     ~VnFlowInfo() {};
 
     VnEntryConstRef vn_entry;
-    FlowTable::FlowEntryTree fet;
+    FlowTable::FlowVnList flow_list;
     uint32_t ingress_flow_count;
     uint32_t egress_flow_count;
 };
@@ -614,7 +745,7 @@ struct IntfFlowInfo {
     ~IntfFlowInfo() {};
 
     InterfaceConstRef intf_entry;
-    FlowTable::FlowEntryTree fet;
+    FlowTable::FlowIntfList flow_list;
 };
 
 struct VmFlowInfo {
@@ -622,13 +753,18 @@ struct VmFlowInfo {
     ~VmFlowInfo() {};
 
     VmEntryConstRef vm_entry;
-    FlowTable::FlowEntryTree fet;
+    FlowTable::FlowVmList flow_list;
 };
 
 struct RouteFlowInfo {
-    RouteFlowInfo() {};
+    RouteFlowInfo(const RouteFlowKey &k) : key(k) {};
     ~RouteFlowInfo() {};
-    FlowTable::FlowEntryTree fet;
+    bool empty() const { return src_flow_list.empty() && dst_flow_list.empty(); }
+
+    RouteFlowKey key;
+    // Flows whose source and destination are on the route.
+    FlowTable::FlowSrcRouteList src_flow_list;
+    FlowTable::FlowDstRouteList dst_flow_list;
 };
 
 extern SandeshTraceBufferPtr FlowTraceBuf;
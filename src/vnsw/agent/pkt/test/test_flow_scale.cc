@@ -74,6 +74,30 @@ TEST_F(FlowTest, FlowScaling_1) {
              (count == flow_count + (int) FlowTable::GetFlowTableObject()->Size()));
 }
 
+// Flow setup rate: time from the first packet until all the flows are
+// in the flow table.
+TEST_F(FlowTest, FlowSetupRate) {
+    int count = 1000;
+    if (getenv("AGENT_FLOW_SCALE_COUNT")) {
+        count = strtoul(getenv("AGENT_FLOW_SCALE_COUNT"), NULL, 0);
+    }
+    int flow_count = FlowTable::GetFlowTableObject()->Size();
+
+    uint64_t start = ClockMonotonicUsec();
+    for (int i = 0; i < count; i++) {
+        Ip4Address addr(0x05000000 + i);
+        TxIpPacket(vnet->GetInterfaceId(), vnet_addr,
+                   addr.to_string().c_str(), 1);
+    }
+    WAIT_FOR(count * 10, 1000,
+             (2 * count == (int) FlowTable::GetFlowTableObject()->Size() -
+              flow_count));
+    uint64_t usecs = ClockMonotonicUsec() - start;
+
+    LOG(DEBUG, "Setup " << count << " flows in " << usecs << " usecs, " <<
+        (usecs ? (count * 1000000ULL / usecs) : 0) << " flows/sec");
+}
+
 int main(int argc, char *argv[]) {
     int ret = 0;
 
@@ -380,6 +380,59 @@ TEST_F(FlowTableTest, FlowAdd_non_local_1) {
     EXPECT_TRUE(ValidateFlow(key2, key2_r, (1 << TrafficAction::DROP)));
 }
 
+TEST(FlowEntryIndexTest, InsertFindRemove) {
+    const int kCount = 5000;
+    FlowEntryIndex index;
+    std::vector<FlowEntryPtr> flows;
+    for (int i = 0; i < kCount; i++) {
+        FlowEntry *fe = new FlowEntry(FlowKey(1, 0x01010101 + i, 0x02020202,
+                                              IPPROTO_TCP, 1000 + i, 80));
+        flows.push_back(fe);
+        EXPECT_TRUE(index.Insert(fe));
+        EXPECT_FALSE(index.Insert(fe));
+    }
+    EXPECT_EQ((size_t) kCount, index.size());
+    EXPECT_GE(index.capacity(), (size_t) 2 * kCount);
+
+    for (int i = 0; i < kCount; i++) {
+        EXPECT_EQ(flows[i].get(), index.Find(flows[i]->key));
+    }
+    EXPECT_TRUE(index.Find(FlowKey(2, 0x01010101, 0x02020202, IPPROTO_TCP,
+                                   1000, 80)) == NULL);
+
+    // Removed slots are reused and don't hide the flows behind them
+    for (int i = 0; i < kCount; i += 2) {
+        EXPECT_TRUE(index.Remove(flows[i].get()));
+        EXPECT_FALSE(index.Remove(flows[i].get()));
+    }
+    for (int i = 0; i < kCount; i++) {
+        FlowEntry *fe = index.Find(flows[i]->key);
+        EXPECT_EQ((i % 2) ? flows[i].get() : NULL, fe);
+    }
+    for (int i = 0; i < kCount; i += 2) {
+        EXPECT_TRUE(index.Insert(flows[i].get()));
+    }
+    EXPECT_EQ((size_t) kCount, index.size());
+    for (int i = 0; i < kCount; i++) {
+        EXPECT_TRUE(index.Remove(flows[i].get()));
+    }
+    EXPECT_EQ(0U, index.size());
+}
+
+TEST(FlowEntryPoolTest, Reuse) {
+    FlowEntryPool pool(sizeof(FlowEntry));
+    pool.Reserve(FlowEntryPool::kSlabEntries + 1);
+    EXPECT_EQ((size_t) 2 * FlowEntryPool::kSlabEntries, pool.capacity());
+    EXPECT_EQ(pool.capacity(), pool.free_count());
+
+    void *entry = pool.Allocate();
+    EXPECT_EQ(pool.capacity() - 1, pool.free_count());
+    pool.Free(entry);
+    EXPECT_EQ(entry, pool.Allocate());
+    pool.Free(entry);
+    EXPECT_EQ(pool.capacity(), pool.free_count());
+}
+
 int main(int argc, char *argv[]) {
     GETUSERARGS();
 
@@ -141,6 +141,13 @@ public:
 
     static bool KFlowHoldAdd(uint32_t hash_id, int vrf, const char *sip, 
                              const char *dip, int proto, int sport, int dport) {
+        return KFlowAdd(hash_id, vrf, sip, dip, proto, sport, dport,
+                        VR_FLOW_ACTION_HOLD);
+    }
+
+    static bool KFlowAdd(uint32_t hash_id, int vrf, const char *sip, 
+                         const char *dip, int proto, int sport, int dport,
+                         int action) {
         if (hash_id >= 
                 FlowTableKSyncObject::GetKSyncObject()->GetFlowTableSize()) {
             return false;
@@ -160,7 +167,7 @@ public:
         req.set_fr_flow_dport(htons(dport));
         req.set_fr_flow_vrf(vrf);
 
-        vr_flow->fe_action = VR_FLOW_ACTION_HOLD;
+        vr_flow->fe_action = action;
         KSyncSockTypeMap::SetFlowEntry(&req, true);
 
         return true;
@@ -795,6 +802,71 @@ TEST_F(FlowTest, FlowAge_1) {
         GetFlowStatsCollector()->SetFlowAgeTime(bkp_age_time);
 }
 
+// Budgeted sweep of the kernel flow table
+TEST_F(FlowTest, FlowAge_Sweep) {
+    FlowStatsCollector *collector =
+        AgentUve::GetInstance()->GetFlowStatsCollector();
+    int tmp_age_time = 10 * 1000;
+    uint64_t bkp_age_time = collector->GetFlowAgeTime();
+
+    TestFlow flow[] = {
+        {
+            TestFlowPkt(vm1_ip, vm2_ip, 1, 0, 0, "vrf5", 
+                    flow0->GetInterfaceId(), 1),
+            { 
+                new VerifyVn("vn5", "vn5"),
+            }
+        },
+        {
+            TestFlowPkt(vm2_ip, vm1_ip, 1, 0, 0, "vrf5", 
+                    flow1->GetInterfaceId(), 2),
+            { 
+                new VerifyVn("vn5", "vn5"),
+            }
+        }
+    };
+
+    CreateFlow(flow, 2);
+    EXPECT_EQ(2U, FlowTable::GetFlowTableObject()->Size());
+
+    // Finish the sweep in progress
+    client->EnqueueFlowAge();
+    client->WaitForIdle();
+    uint64_t sweeps = collector->sweep_stats().sweeps;
+    uint64_t aged = collector->sweep_stats().flows_aged;
+
+    // The default sweep time is well below the age time
+    uint64_t bkp_sweep_time = collector->GetFlowSweepTime();
+    EXPECT_EQ(bkp_age_time / FlowStatsCollector::kSweepsPerAgeTime,
+              bkp_sweep_time);
+
+    // With a sweep time of an hour a run still sweeps until it has seen
+    // FlowCountPerPass flows, which with two flows is the whole table
+    collector->SetFlowSweepTime(3600ULL * 1000 * 1000);
+    client->EnqueueFlowAge();
+    client->WaitForIdle();
+    EXPECT_EQ(sweeps + 1, collector->sweep_stats().sweeps);
+
+    // A sweep time of 0 sweeps the whole table
+    collector->SetFlowSweepTime(0);
+    client->EnqueueFlowAge();
+    client->WaitForIdle();
+    EXPECT_EQ(sweeps + 2, collector->sweep_stats().sweeps);
+    EXPECT_LE(2U, collector->sweep_stats().last_sweep_flows);
+    EXPECT_EQ(2U, FlowTable::GetFlowTableObject()->Size());
+    collector->SetFlowSweepTime(bkp_sweep_time);
+
+    // Both flows are aged by the next sweep
+    collector->SetFlowAgeTime(tmp_age_time);
+    usleep(tmp_age_time + 10);
+    client->EnqueueFlowAge();
+    client->WaitForIdle();
+    WAIT_FOR(100, 1, (0U == FlowTable::GetFlowTableObject()->Size()));
+    EXPECT_EQ(aged + 2, collector->sweep_stats().flows_aged);
+
+    collector->SetFlowAgeTime(bkp_age_time);
+}
+
 // Aging with more than 2 entries
 TEST_F(FlowTest, FlowAge_3) {
     int tmp_age_time = 10 * 1000;
@@ -1475,6 +1547,112 @@ TEST_F(FlowTest, FlowAudit) {
     KFlowPurgeHold();
 }
 
+// Bulk audit of a kernel flow table holding flows unknown to the agent
+TEST_F(FlowTest, FlowBulkAudit) {
+    if (ksync_init_) {
+        return;
+    }
+    const int kFlows = 200;
+    const int kBaseIndex = 1000;
+    FlowTableKSyncObject *obj = FlowTableKSyncObject::GetKSyncObject();
+    uint64_t orphans = obj->bulk_audit_stats().orphans;
+    uint64_t short_flows = obj->bulk_audit_stats().short_flows;
+    uint64_t deleted = obj->bulk_audit_stats().deleted;
+
+    // Every other one is on hold
+    for (int i = 0; i < kFlows; i++) {
+        Ip4Address sip(0x0a010000 + i);
+        EXPECT_TRUE(KFlowAdd(kBaseIndex + i, 1, sip.to_string().c_str(),
+                             "20.1.1.1", 17, 1000 + i, 53,
+                             (i % 2) ? VR_FLOW_ACTION_HOLD :
+                             VR_FLOW_ACTION_FORWARD));
+    }
+
+    // The first run takes the snapshot, the next ones add the short flows
+    // for the HOLD entries and delete the others from the kernel
+    obj->StartBulkAudit();
+    FlowTableKSyncObject::AuditProcess(obj);
+    EXPECT_EQ(orphans + kFlows, obj->bulk_audit_stats().orphans);
+    while (obj->bulk_audit()) {
+        FlowTableKSyncObject::AuditProcess(obj);
+    }
+    client->WaitForIdle();
+    EXPECT_TRUE(FlowTableWait(kFlows / 2));
+    EXPECT_EQ(short_flows + kFlows / 2, obj->bulk_audit_stats().short_flows);
+    EXPECT_EQ(deleted + kFlows / 2, obj->bulk_audit_stats().deleted);
+    for (int i = 0; i < kFlows; i += 2) {
+        vr_flow_entry *kflow = KSyncSockTypeMap::GetFlowEntry(kBaseIndex + i);
+        EXPECT_FALSE(kflow->fe_flags & VR_FLOW_FLAG_ACTIVE);
+    }
+
+    // The agent knows all the flows left now
+    obj->StartBulkAudit();
+    while (obj->bulk_audit()) {
+        FlowTableKSyncObject::AuditProcess(obj);
+    }
+    EXPECT_EQ(orphans + kFlows, obj->bulk_audit_stats().orphans);
+    EXPECT_TRUE(FlowTableWait(kFlows / 2));
+
+    // The short flows are deleted when aged
+    client->EnqueueFlowAge();
+    client->WaitForIdle();
+    EXPECT_TRUE(FlowTableWait(0));
+    for (int i = 0; i < kFlows; i++) {
+        vr_flow_req req;
+        req.set_fr_index(kBaseIndex + i);
+        KSyncSockTypeMap::SetFlowEntry(&req, false);
+    }
+}
+
+// Bulk audit of kernel entries whose key has an agent flow with another
+// handle: the forward flow has handle 5 and the reverse flow has none yet.
+// Both are live flows and must be left alone.
+TEST_F(FlowTest, FlowBulkAuditHandleMismatch) {
+    if (ksync_init_) {
+        return;
+    }
+    const int kBaseIndex = 1000;
+    FlowTableKSyncObject *obj = FlowTableKSyncObject::GetKSyncObject();
+    uint64_t orphans = obj->bulk_audit_stats().orphans;
+    uint64_t short_flows = obj->bulk_audit_stats().short_flows;
+
+    FlowAdd(5, 1, "1.1.1.1", "2.2.2.2", 1, 0, 0, "3.3.3.3", "2.2.2.2", 1);
+    EXPECT_TRUE(FlowTableWait(2));
+    EXPECT_TRUE(KFlowAdd(kBaseIndex, 1, "1.1.1.1", "2.2.2.2", 1, 0, 0,
+                         VR_FLOW_ACTION_FORWARD));
+    EXPECT_TRUE(KFlowAdd(kBaseIndex + 1, 1, "2.2.2.2", "3.3.3.3", 1, 0, 0,
+                         VR_FLOW_ACTION_HOLD));
+
+    obj->StartBulkAudit();
+    while (obj->bulk_audit()) {
+        FlowTableKSyncObject::AuditProcess(obj);
+    }
+    EXPECT_EQ(orphans, obj->bulk_audit_stats().orphans);
+    EXPECT_EQ(short_flows, obj->bulk_audit_stats().short_flows);
+    EXPECT_TRUE(FlowTableWait(2));
+
+    FlowKey key(1, ntohl(inet_addr("1.1.1.1")), ntohl(inet_addr("2.2.2.2")),
+                1, 0, 0);
+    FlowEntry *flow = FlowTable::GetFlowTableObject()->Find(key);
+    ASSERT_TRUE(flow != NULL);
+    EXPECT_EQ(5U, flow->flow_handle);
+    EXPECT_FALSE(flow->short_flow);
+    EXPECT_EQ("svn", flow->data.source_vn);
+    EXPECT_TRUE(flow->data.reverse_flow.get() != NULL);
+
+    for (int i = 0; i < 2; i++) {
+        vr_flow_req req;
+        req.set_fr_index(kBaseIndex + i);
+        KSyncSockTypeMap::SetFlowEntry(&req, false);
+    }
+    client->EnqueueFlowAge();
+    client->WaitForIdle();
+    usleep(500);
+    client->EnqueueFlowAge();
+    client->WaitForIdle();
+    EXPECT_TRUE(FlowTableWait(0));
+}
+
 //Test flow deletion on ACL deletion
 TEST_F(FlowTest, AclDelete) {
     AddAcl("acl1", 1, "vn5" , "vn5");
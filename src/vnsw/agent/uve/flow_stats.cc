@@ -37,6 +37,23 @@
 #include <algorithm>
 #include <pkt/pkt_flow.h>
 
+FlowStatsCollector::FlowStatsCollector(boost::asio::io_service &io,
+                                       int intvl) :
+    StatsCollector(TaskScheduler::GetInstance()->GetTaskId
+                   ("Agent::StatsCollector"),
+                   StatsCollector::FlowStatsCollector, 
+                   io, intvl, "Flow stats collector"),
+    flow_age_time_intvl_(FlowAgeTime),
+    flow_sweep_time_intvl_(FlowAgeTime / kSweepsPerAgeTime),
+    flow_default_interval_(intvl), sweep_index_(0), sweep_start_time_(0),
+    sweep_flows_(0), sweep_aged_(0) {
+    flow_iteration_key_.Reset();
+    const char *sweep_time = getenv("AGENT_FLOW_SWEEP_MSEC");
+    if (sweep_time != NULL) {
+        flow_sweep_time_intvl_ = strtoull(sweep_time, NULL, 0) * 1000;
+    }
+}
+
 /* For ingress flows, change the SIP as Nat-IP instead of Native IP */
 void FlowStatsCollector::SourceIpOverride(FlowEntry *flow, FlowDataIpv4 &s_flow) {
     FlowEntry *rev_flow = flow->data.reverse_flow.get();
@@ -157,130 +174,212 @@ uint64_t FlowStatsCollector::GetUpdatedFlowPackets(const FlowEntry *fe,
     return (oflow_pkts |= k_flow_pkts);
 }
 
-bool FlowStatsCollector::Run() {
-    FlowTable::FlowEntryMap::iterator it;
-    FlowEntry *entry = NULL, *reverse_flow;
-    uint32_t count = 0;
-    bool key_updation_reqd = true, deleted;
-    uint64_t diff_bytes, diff_pkts;
-    FlowTable *flow_obj = FlowTable::GetFlowTableObject();
-  
-    run_counter_++;
-    if (!flow_obj->Size()) {
-        return true;
-    }
-    uint64_t curr_time = UTCTimestampUsec();
-    it = flow_obj->flow_entry_map_.upper_bound(flow_iteration_key_);
-    if (it == flow_obj->flow_entry_map_.end()) {
-        it = flow_obj->flow_entry_map_.begin();
+void FlowStatsCollector::UpdateFlowStats(FlowEntry *entry,
+                                         const vr_flow_entry *k_flow,
+                                         uint64_t curr_time) {
+    if (entry->data.bytes == k_flow->fe_stats.flow_bytes) {
+        return;
     }
 
-    while (it != flow_obj->flow_entry_map_.end()) {
-        entry = it->second;
-        it++;
-        assert(entry);
-        deleted = false;
+    uint64_t flow_bytes, flow_packets;
+    flow_bytes = GetFlowStats(k_flow->fe_stats.flow_bytes_oflow, 
+                              k_flow->fe_stats.flow_bytes);
+    flow_packets = GetFlowStats(k_flow->fe_stats.flow_packets_oflow,
+                                k_flow->fe_stats.flow_packets);
+    flow_bytes = GetUpdatedFlowBytes(entry, flow_bytes);
+    flow_packets = GetUpdatedFlowPackets(entry, flow_packets);
+    uint64_t diff_bytes = flow_bytes - entry->data.bytes;
+    uint64_t diff_pkts = flow_packets - entry->data.packets;
+    //Update Inter-VN stats
+    AgentUve::GetInstance()->GetInterVnStatsCollector()->UpdateVnStats(entry, 
+                                                        diff_bytes, diff_pkts);
+    entry->data.bytes = flow_bytes;
+    entry->data.packets = flow_packets;
+    entry->last_modified_time = curr_time;
+    FlowExport(entry, diff_bytes, diff_pkts);
+}
 
-        flow_iteration_key_ = entry->key;
-        const vr_flow_entry *k_flow = 
+// Ages the flow or updates its stats. Flows to be deleted are added to the
+// delete_list_, a flow is aged together with its reverse flow once both can
+// be aged.
+void FlowStatsCollector::ProcessFlow(FlowEntry *entry,
+                                     const vr_flow_entry *k_flow,
+                                     uint64_t curr_time) {
+    sweep_flows_++;
+    if (ShouldBeAged(entry, k_flow, curr_time)) {
+        FlowEntry *reverse_flow = entry->data.reverse_flow.get();
+        if (reverse_flow == NULL) {
+            delete_list_.push_back(FlowDelete(entry->key, false));
+            return;
+        }
+        const vr_flow_entry *k_flow_rev =
             FlowTableKSyncObject::GetKSyncObject()->GetKernelFlowEntry
-            (entry->flow_handle, false);
-        // Can the flow be aged?
-        if (ShouldBeAged(entry, k_flow, curr_time)) {
-            reverse_flow = entry->data.reverse_flow.get();
-            // If reverse_flow is present, wait till both are aged
-            if (reverse_flow) {
-                const vr_flow_entry *k_flow_rev;
-                k_flow_rev = 
-                    FlowTableKSyncObject::GetKSyncObject()->GetKernelFlowEntry
-                    (reverse_flow->flow_handle, false);
-                if (ShouldBeAged(reverse_flow, k_flow_rev, curr_time)) {
-                    deleted = true;
-                }
-            } else {
-                deleted = true;
-            }
+            (reverse_flow->flow_handle, false);
+        if (ShouldBeAged(reverse_flow, k_flow_rev, curr_time)) {
+            delete_list_.push_back(FlowDelete(entry->key, true));
+            return;
         }
+    }
 
-        if (deleted == true) {
-            if (it != flow_obj->flow_entry_map_.end()) {
-                if (it->second == reverse_flow) {
-                    it++;
-                }
-            }
-            FlowTable::GetFlowTableObject()->DeleteRevFlow
-                (entry->key, reverse_flow != NULL? true : false);
-            entry = NULL;
-            if (reverse_flow) {
-                count++;
-                if (count == flow_count_per_pass_) {
-                    break;
-                }
-            }
+    if (k_flow) {
+        UpdateFlowStats(entry, k_flow, curr_time);
+    }
+
+    if (entry->ShortFlow()) {
+        delete_list_.push_back(FlowDelete(entry->key, false));
+    }
+}
+
+// Returns true if the flow has an active kernel entry, which the sweep of
+// the kernel flow table processes.
+bool FlowStatsCollector::IsKernelFlow(const FlowEntry *entry) {
+    FlowKey key;
+    if (entry->flow_handle == FlowEntry::kInvalidFlowHandle ||
+        !FlowTableKSyncObject::GetKSyncObject()->GetFlowKey
+        (entry->flow_handle, key)) {
+        return false;
+    }
+    return key.CompareKey(entry->key);
+}
+
+void FlowStatsCollector::DeleteFlows() {
+    FlowTable *flow_obj = FlowTable::GetFlowTableObject();
+    for (std::vector<FlowDelete>::iterator it = delete_list_.begin();
+         it != delete_list_.end(); ++it) {
+        // Both flows of a pair may be on the list
+        if (flow_obj->DeleteRevFlow(it->first, it->second)) {
+            uint32_t count = it->second ? 2 : 1;
+            sweep_aged_ += count;
+            sweep_stats_.flows_aged += count;
         }
+    }
+    delete_list_.clear();
+}
+
+// Entries of the kernel flow table to sweep in this run, spreads what is
+// left of the sweep over the runs left until the sweep time.
+uint32_t FlowStatsCollector::SweepBudget(uint32_t table_size,
+                                         uint64_t curr_time) {
+    uint32_t remaining = table_size - sweep_index_;
+    uint64_t sweep_time = std::min(flow_sweep_time_intvl_,
+                                   flow_age_time_intvl_ / kSweepsPerAgeTime);
+    uint64_t elapsed = curr_time - sweep_start_time_;
+    uint64_t interval = (uint64_t) GetExpiryTime() * 1000;
+    uint64_t runs = 1;
+    if (sweep_time > elapsed && interval > 0) {
+        runs = std::max((sweep_time - elapsed) / interval, (uint64_t) 1);
+    }
+
+    uint64_t budget = (remaining + runs - 1) / runs;
+    budget = ((budget + kSweepChunk - 1) / kSweepChunk) * kSweepChunk;
+    return std::min(budget, (uint64_t) remaining);
+}
 
-        if (deleted == false && k_flow) {
-            if (entry->data.bytes != k_flow->fe_stats.flow_bytes) {
-                uint64_t flow_bytes, flow_packets;
-                
-                flow_bytes = GetFlowStats(k_flow->fe_stats.flow_bytes_oflow, 
-                                          k_flow->fe_stats.flow_bytes);
-                flow_packets = GetFlowStats(k_flow->fe_stats.flow_packets_oflow
-                                            , k_flow->fe_stats.flow_packets);
-                flow_bytes = GetUpdatedFlowBytes(entry, flow_bytes);
-                flow_packets = GetUpdatedFlowPackets(entry, flow_packets);
-                diff_bytes = flow_bytes - entry->data.bytes;
-                diff_pkts = flow_packets - entry->data.packets;
-                //Update Inter-VN stats
-                AgentUve::GetInstance()->GetInterVnStatsCollector()->UpdateVnStats(entry, 
-                                                                    diff_bytes, diff_pkts);
-                entry->data.bytes = flow_bytes;
-                entry->data.packets = flow_packets;
-                entry->last_modified_time = curr_time;
-                FlowExport(entry, diff_bytes, diff_pkts);
+// Sweeps budget entries, and more chunks until FlowCountPerPass flows were
+// processed or the end of the table is reached.
+void FlowStatsCollector::SweepKernelFlows(uint32_t budget, uint32_t table_size,
+                                          uint64_t curr_time) {
+    FlowTableKSyncObject *ksync_obj = FlowTableKSyncObject::GetKSyncObject();
+    FlowTable *flow_obj = FlowTable::GetFlowTableObject();
+    uint32_t end = sweep_index_ + budget;
+    uint64_t flows = sweep_flows_ + FlowCountPerPass;
+
+    while (sweep_index_ < end ||
+           (sweep_index_ < table_size && sweep_flows_ < flows)) {
+        uint32_t chunk_end = std::min(sweep_index_ + kSweepChunk, table_size);
+        if (sweep_index_ < end) {
+            chunk_end = std::min(chunk_end, end);
+        }
+        for (; sweep_index_ < chunk_end; sweep_index_++) {
+            FlowKey key;
+            if (!ksync_obj->GetFlowKey(sweep_index_, key)) {
+                continue;
             }
+            FlowEntry *entry = flow_obj->Find(key);
+            if (entry == NULL || entry->flow_handle != sweep_index_) {
+                continue;
+            }
+            ProcessFlow(entry,
+                        ksync_obj->GetKernelFlowEntry(sweep_index_, false),
+                        curr_time);
         }
+        DeleteFlows();
+    }
+}
 
-        if ((!deleted) && entry->ShortFlow()) {
-            deleted = true;
-            FlowTable::GetFlowTableObject()->DeleteRevFlow(entry->key, false);
-        }
+// Walks the flow table from flow_iteration_key_ for the flows without an
+// active kernel entry.
+void FlowStatsCollector::SweepAgentFlows(uint32_t budget, uint64_t curr_time) {
+    FlowTable *flow_obj = FlowTable::GetFlowTableObject();
+    FlowTable::FlowEntryMap::iterator it;
+    it = flow_obj->flow_entry_map_.upper_bound(flow_iteration_key_);
+    if (it == flow_obj->flow_entry_map_.end()) {
+        it = flow_obj->flow_entry_map_.begin();
+    }
 
+    uint32_t count = 0;
+    while (it != flow_obj->flow_entry_map_.end() && count < budget) {
+        FlowEntry *entry = it->second;
+        it++;
         count++;
-        if (count == flow_count_per_pass_) {
-            break;
-        }
-    }
-    
-    if (count == flow_count_per_pass_) {
-        if (it != flow_obj->flow_entry_map_.end()) {
-            key_updation_reqd = false;
+        flow_iteration_key_ = entry->key;
+        if (!IsKernelFlow(entry)) {
+            ProcessFlow(entry, NULL, curr_time);
         }
     }
 
     /* Reset the iteration key if we are done with all the elements */
-    if (key_updation_reqd) {
+    if (it == flow_obj->flow_entry_map_.end()) {
         flow_iteration_key_.Reset();
     }
-    /* Update the flow_timer_interval and flow_count_per_pass_ based on 
-     * total flows that we have
-     */
-    uint32_t total_flows = flow_obj->Size();
-    uint32_t flow_timer_interval;
+    DeleteFlows();
+}
 
-    uint32_t age_time_millisec = GetFlowAgeTime() / 1000;
+void FlowStatsCollector::UpdateTimerInterval() {
+    uint32_t interval = GetFlowAgeTime() / 1000 / kTicksPerAgeTime;
+    interval = std::min(interval, flow_default_interval_);
+    interval = std::max(interval, (uint32_t) FlowStatsMinInterval);
+    SetExpiryTime(interval);
+}
 
-    if (total_flows > 0) {
-        flow_timer_interval = std::min((age_time_millisec * flow_multiplier_)/total_flows, 1000U);
-    } else {
-        flow_timer_interval = flow_default_interval_;
+uint64_t FlowStatsCollector::AgedPerSecond() const {
+    if (sweep_stats_.last_sweep_usecs == 0) {
+        return 0;
     }
+    return sweep_stats_.last_sweep_aged * 1000000 /
+        sweep_stats_.last_sweep_usecs;
+}
 
-    if (age_time_millisec > 0) {
-        flow_count_per_pass_ = std::max((flow_timer_interval * total_flows)/age_time_millisec, 100U);
-    } else {
-        flow_count_per_pass_ = 100U;
+bool FlowStatsCollector::Run() {
+    FlowTableKSyncObject *ksync_obj = FlowTableKSyncObject::GetKSyncObject();
+    FlowTable *flow_obj = FlowTable::GetFlowTableObject();
+
+    run_counter_++;
+    UpdateTimerInterval();
+    uint32_t table_size = ksync_obj->GetFlowTableSize();
+    uint64_t curr_time = UTCTimestampUsec();
+    if (sweep_index_ == 0) {
+        sweep_start_time_ = curr_time;
+    }
+    if (!flow_obj->Size() || table_size == 0) {
+        return true;
+    }
+
+    uint32_t budget = SweepBudget(table_size, curr_time);
+    // Walk the flow table at the pace of the sweep
+    uint64_t agent_budget = (uint64_t) flow_obj->Size() * budget / table_size;
+    SweepKernelFlows(budget, table_size, curr_time);
+    SweepAgentFlows(std::max(agent_budget + 1, (uint64_t) FlowCountPerPass),
+                    curr_time);
+
+    if (sweep_index_ >= table_size) {
+        sweep_index_ = 0;
+        sweep_stats_.sweeps++;
+        sweep_stats_.last_sweep_usecs = UTCTimestampUsec() - sweep_start_time_;
+        sweep_stats_.last_sweep_flows = sweep_flows_;
+        sweep_stats_.last_sweep_aged = sweep_aged_;
+        sweep_flows_ = 0;
+        sweep_aged_ = 0;
     }
-    SetExpiryTime(flow_timer_interval);
     return true;
 }
@@ -15,6 +15,21 @@ struct FlowEntry;
 struct PktInfo;
 struct FlowKey;
 
+//
+// FlowStatsCollector
+//
+// Updates the stats of the flows from the kernel flow table and ages them.
+// Every timer tick sweeps the next part of the mmap'd kernel flow table in
+// index order, in chunks of kSweepChunk entries, and processes the flows
+// whose kernel entries are active. The number of entries swept per tick is
+// adapted so that a full sweep takes the sweep time, which is at most a
+// kSweepsPerAgeTime part of the flow age time. A tick goes on sweeping
+// until it has processed FlowCountPerPass flows, so a sparse table is not
+// swept slower than the flows were walked before. Flows that have no active
+// kernel entry are aged from a
+// walk of the flow table that keeps pace with the sweep. The flows to be
+// deleted are collected and deleted in a batch at the end of each chunk.
+//
 class FlowStatsCollector : public StatsCollector {
 public:
     static const uint64_t FlowAgeTime = 1000000 * 180;
@@ -22,48 +37,78 @@ public:
     static const uint32_t FlowStatsInterval = (1000); // time in milliseconds
     static const uint32_t FlowStatsMinInterval = (100); // time in milliseconds
     static const uint32_t MaxFlows= (256 * 1024); // time in milliseconds
+    static const uint32_t kSweepChunk = 1024;
+    // Ticks per flow age time, bounded by the intervals above.
+    static const uint32_t kTicksPerAgeTime = 16;
+    // Full sweeps per flow age time at least.
+    static const uint32_t kSweepsPerAgeTime = 4;
 
-    FlowStatsCollector(boost::asio::io_service &io, int intvl) :
-        StatsCollector(TaskScheduler::GetInstance()->GetTaskId
-                       ("Agent::StatsCollector"),
-                       StatsCollector::FlowStatsCollector, 
-                       io, intvl, "Flow stats collector") {
-        flow_iteration_key_.Reset();
-        flow_default_interval_ = intvl;
-        flow_age_time_intvl_ = FlowAgeTime;
-        flow_count_per_pass_ = FlowCountPerPass;
-        UpdateFlowMultiplier();
-    }
-    virtual ~FlowStatsCollector() { };
-    void UpdateFlowMultiplier() {
-        uint32_t age_time_millisec = flow_age_time_intvl_ / 1000;
-        if (age_time_millisec == 0) {
-            age_time_millisec = 1;
+    struct SweepStats {
+        SweepStats() : sweeps(0), flows_aged(0), last_sweep_usecs(0),
+            last_sweep_flows(0), last_sweep_aged(0) {
         }
-        uint64_t default_age_time_millisec = FlowAgeTime / 1000;
-        uint64_t max_flows = (MaxFlows * age_time_millisec) / default_age_time_millisec;
-        flow_multiplier_ = (max_flows * FlowStatsMinInterval)/age_time_millisec;
-    }
+
+        uint64_t sweeps;
+        uint64_t flows_aged;
+        // Duration of the last full sweep, and the flows it processed and
+        // aged.
+        uint64_t last_sweep_usecs;
+        uint64_t last_sweep_flows;
+        uint64_t last_sweep_aged;
+    };
+
+    FlowStatsCollector(boost::asio::io_service &io, int intvl);
+    virtual ~FlowStatsCollector() { };
 
     static void FlowExport(FlowEntry *flow, uint64_t diff_bytes, uint64_t diff_pkts);
     bool Run();
     uint64_t GetFlowAgeTime() { return flow_age_time_intvl_; }
     void SetFlowAgeTime(uint64_t usecs) { 
         flow_age_time_intvl_ = usecs; 
-        UpdateFlowMultiplier();
     }
+
+    // Target time of a full sweep, 0 sweeps the whole table on every run.
+    // The default is a kSweepsPerAgeTime part of the flow age time, and can
+    // be set with the environment variable AGENT_FLOW_SWEEP_MSEC.
+    uint64_t GetFlowSweepTime() const { return flow_sweep_time_intvl_; }
+    void SetFlowSweepTime(uint64_t usecs) { flow_sweep_time_intvl_ = usecs; }
+
+    const SweepStats &sweep_stats() const { return sweep_stats_; }
+    // Flows aged per second during the last full sweep.
+    uint64_t AgedPerSecond() const;
+
 private:
+    typedef std::pair<FlowKey, bool> FlowDelete;
+
     uint64_t GetFlowStats(const uint16_t &oflow_data, const uint32_t &data);
     bool ShouldBeAged(FlowEntry *entry, const vr_flow_entry *k_flow,
                       uint64_t curr_time);
     static void SourceIpOverride(FlowEntry *flow, FlowDataIpv4 &s_flow);
     uint64_t GetUpdatedFlowPackets(const FlowEntry *fe, uint64_t k_flow_pkts);
     uint64_t GetUpdatedFlowBytes(const FlowEntry *fe, uint64_t k_flow_bytes);
+    void UpdateFlowStats(FlowEntry *entry, const vr_flow_entry *k_flow,
+                         uint64_t curr_time);
+    void ProcessFlow(FlowEntry *entry, const vr_flow_entry *k_flow,
+                     uint64_t curr_time);
+    static bool IsKernelFlow(const FlowEntry *entry);
+    uint32_t SweepBudget(uint32_t table_size, uint64_t curr_time);
+    void SweepKernelFlows(uint32_t budget, uint32_t table_size,
+                          uint64_t curr_time);
+    void SweepAgentFlows(uint32_t budget, uint64_t curr_time);
+    void DeleteFlows();
+    void UpdateTimerInterval();
+
     FlowKey flow_iteration_key_;
     uint64_t flow_age_time_intvl_;
-    uint32_t flow_count_per_pass_;
-    uint32_t flow_multiplier_;
+    uint64_t flow_sweep_time_intvl_;
     uint32_t flow_default_interval_;
+    // Next kernel flow table index to sweep, and start of the sweep.
+    uint32_t sweep_index_;
+    uint64_t sweep_start_time_;
+    uint64_t sweep_flows_;
+    uint64_t sweep_aged_;
+    std::vector<FlowDelete> delete_list_;
+    SweepStats sweep_stats_;
     DISALLOW_COPY_AND_ASSIGN(FlowStatsCollector);
 };
 
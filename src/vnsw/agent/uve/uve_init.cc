@@ -102,6 +102,23 @@ void GetStatsInterval::HandleRequest() const {
     return;
 }
 
+void GetFlowSweepStats::HandleRequest() const {
+    FlowStatsCollector *collector =
+        AgentUve::GetInstance()->GetFlowStatsCollector();
+    const FlowStatsCollector::SweepStats &stats = collector->sweep_stats();
+    FlowSweepStatsResp *resp = new FlowSweepStatsResp();
+    resp->set_sweep_time_usecs(collector->GetFlowSweepTime());
+    resp->set_sweeps(stats.sweeps);
+    resp->set_flows_aged(stats.flows_aged);
+    resp->set_last_sweep_usecs(stats.last_sweep_usecs);
+    resp->set_last_sweep_flows(stats.last_sweep_flows);
+    resp->set_last_sweep_aged(stats.last_sweep_aged);
+    resp->set_aged_per_second(collector->AgedPerSecond());
+    resp->set_context(context());
+    resp->Response();
+    return;
+}
+
 void AgentUve::Init() {
     UveClient::Init();
 }
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "xml/xml_pull_parser.h"
+
+#include <fstream>
+
+#include "base/logging.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+class XmlPullParserTest : public ::testing::Test {
+protected:
+    string FileRead(const string &filename) {
+        string content;
+        fstream file(filename.c_str(), fstream::in);
+        while (!file.eof()) {
+            char piece[256];
+            file.read(piece, sizeof(piece));
+            content.append(piece, file.gcount());
+        }
+        file.close();
+        return content;
+    }
+
+    // Advance to the next START_ELEMENT and verify its name.
+    void NextStart(XmlPullParser *parser, const char *name) {
+        XmlPullParser::Event event;
+        do {
+            event = parser->Next();
+        } while (event == XmlPullParser::TEXT);
+        ASSERT_EQ(XmlPullParser::START_ELEMENT, event);
+        ASSERT_EQ(string(name), parser->name().ToString());
+    }
+};
+
+namespace {
+
+TEST_F(XmlPullParserTest, Events) {
+    string xml = "<?xml version='1.0'?><a x='1'><b>text</b><c/></a>";
+    XmlPullParser parser(xml.data(), xml.size());
+
+    EXPECT_EQ(XmlPullParser::START_ELEMENT, parser.Next());
+    EXPECT_TRUE(parser.NameIs("a"));
+    EXPECT_EQ(1, parser.depth());
+    EXPECT_EQ(XmlPullParser::START_ELEMENT, parser.Next());
+    EXPECT_TRUE(parser.NameIs("b"));
+    EXPECT_EQ(2, parser.depth());
+    EXPECT_EQ(XmlPullParser::TEXT, parser.Next());
+    EXPECT_EQ("text", parser.text().ToString());
+    EXPECT_EQ(XmlPullParser::END_ELEMENT, parser.Next());
+    EXPECT_TRUE(parser.NameIs("b"));
+    EXPECT_EQ(2, parser.depth());
+    EXPECT_EQ(XmlPullParser::START_ELEMENT, parser.Next());
+    EXPECT_TRUE(parser.NameIs("c"));
+    EXPECT_EQ(XmlPullParser::END_ELEMENT, parser.Next());
+    EXPECT_TRUE(parser.NameIs("c"));
+    EXPECT_EQ(XmlPullParser::END_ELEMENT, parser.Next());
+    EXPECT_TRUE(parser.NameIs("a"));
+    EXPECT_EQ(1, parser.depth());
+    EXPECT_EQ(XmlPullParser::END_DOCUMENT, parser.Next());
+    EXPECT_EQ(XmlPullParser::END_DOCUMENT, parser.Next());
+}
+
+// Names that are a prefix of the other, or longer than the token.
+TEST_F(XmlPullParserTest, TokenEquals) {
+    string data = "item";
+    XmlPullParser::Token token(data.data(), 3);
+    EXPECT_TRUE(token.Equals("ite"));
+    EXPECT_FALSE(token.Equals("it"));
+    EXPECT_FALSE(token.Equals("item"));
+    EXPECT_FALSE(token.Equals(""));
+    XmlPullParser::Token empty(data.data(), 0);
+    EXPECT_TRUE(empty.Equals(""));
+    EXPECT_FALSE(empty.Equals("i"));
+}
+
+TEST_F(XmlPullParserTest, Attributes) {
+    string xml = "<a x='1' y = \"two\" z='a&lt;b&amp;c' w='>'/>";
+    XmlPullParser parser(xml.data(), xml.size());
+    EXPECT_EQ(XmlPullParser::START_ELEMENT, parser.Next());
+
+    XmlPullParser::Token token;
+    EXPECT_TRUE(parser.GetAttribute("x", &token));
+    EXPECT_EQ("1", token.ToString());
+    EXPECT_TRUE(parser.GetAttribute("y", &token));
+    EXPECT_EQ("two", token.ToString());
+    EXPECT_TRUE(parser.GetAttribute("z", &token));
+    EXPECT_EQ("a&lt;b&amp;c", token.ToString());
+    string value;
+    EXPECT_TRUE(parser.GetAttribute("z", &value));
+    EXPECT_EQ("a<b&c", value);
+    EXPECT_TRUE(parser.GetAttribute("w", &value));
+    EXPECT_EQ(">", value);
+    EXPECT_FALSE(parser.GetAttribute("v", &token));
+
+    EXPECT_EQ(XmlPullParser::END_ELEMENT, parser.Next());
+    EXPECT_FALSE(parser.GetAttribute("x", &token));
+    EXPECT_EQ(XmlPullParser::END_DOCUMENT, parser.Next());
+}
+
+TEST_F(XmlPullParserTest, Text) {
+    string xml =
+        "<a><b>1<!-- c -->2</b><c>&#65;&#x42;&quot;</c><d><![CDATA[<&>]]></d>"
+        "<e/><f>99</f></a>";
+    XmlPullParser parser(xml.data(), xml.size());
+    string text;
+    XmlPullParser::Token token;
+
+    NextStart(&parser, "a");
+    NextStart(&parser, "b");
+    EXPECT_TRUE(parser.ReadText(&text));
+    EXPECT_EQ("12", text);
+    NextStart(&parser, "c");
+    EXPECT_TRUE(parser.ReadText(&text));
+    EXPECT_EQ("AB\"", text);
+    NextStart(&parser, "d");
+    EXPECT_TRUE(parser.ReadText(&text));
+    EXPECT_EQ("<&>", text);
+    NextStart(&parser, "e");
+    EXPECT_TRUE(parser.ReadRawText(&token));
+    EXPECT_TRUE(token.empty());
+    NextStart(&parser, "f");
+    EXPECT_TRUE(parser.ReadRawText(&token));
+    EXPECT_EQ("99", token.ToString());
+    EXPECT_TRUE(parser.NameIs("f"));
+    EXPECT_EQ(XmlPullParser::END_ELEMENT, parser.Next());
+    EXPECT_EQ(XmlPullParser::END_DOCUMENT, parser.Next());
+}
+
+TEST_F(XmlPullParserTest, SkipElement) {
+    string xml = "<a><b><c><d/></c><c/></b><e/></a>";
+    XmlPullParser parser(xml.data(), xml.size());
+
+    NextStart(&parser, "a");
+    NextStart(&parser, "b");
+    EXPECT_TRUE(parser.SkipElement());
+    EXPECT_TRUE(parser.NameIs("b"));
+    NextStart(&parser, "e");
+    EXPECT_TRUE(parser.SkipElement());
+    EXPECT_TRUE(parser.NameIs("e"));
+    EXPECT_EQ(XmlPullParser::END_ELEMENT, parser.Next());
+    EXPECT_EQ(XmlPullParser::END_DOCUMENT, parser.Next());
+}
+
+TEST_F(XmlPullParserTest, Errors) {
+    const char *docs[] = {
+        "<a>",
+        "<a><b></a",
+        "<a x='1></a>",
+        "<>",
+        "</a>",
+        "<a><!-- </a>",
+        "<!DOCTYPE a><a/>",
+        "<a><b></a></b>",
+        "<a></b>",
+        "<a><ab></a></ab>",
+        "<a><b/></ab>",
+    };
+    for (size_t i = 0; i < sizeof(docs) / sizeof(docs[0]); i++) {
+        XmlPullParser parser(docs[i], strlen(docs[i]));
+        XmlPullParser::Event event;
+        do {
+            event = parser.Next();
+        } while (event != XmlPullParser::END_DOCUMENT &&
+                 event != XmlPullParser::ERROR);
+        EXPECT_TRUE(parser.error()) << docs[i];
+    }
+
+    string text;
+    EXPECT_FALSE(XmlPullParser::Decode(XmlPullParser::Token("&foo;", 5),
+                                       &text));
+    EXPECT_FALSE(XmlPullParser::Decode(XmlPullParser::Token("&amp", 4),
+                                       &text));
+    const char *references[] = { "&#x;", "&#;", "&#xg;", "&#-1;", "&# 65;",
+                                 "&#x-41;", "&#65a;" };
+    for (size_t i = 0; i < sizeof(references) / sizeof(references[0]); i++) {
+        XmlPullParser::Token token(references[i], strlen(references[i]));
+        EXPECT_FALSE(XmlPullParser::Decode(token, &text)) << references[i];
+    }
+}
+
+TEST_F(XmlPullParserTest, XmppPublish) {
+    string xml = FileRead("src/xml/testdata/xmpp_l3_vpn.xml");
+    XmlPullParser parser(xml.data(), xml.size());
+    string value;
+
+    NextStart(&parser, "iq");
+    EXPECT_TRUE(parser.GetAttribute("type", &value));
+    EXPECT_EQ("set", value);
+    EXPECT_TRUE(parser.GetAttribute("from", &value));
+    EXPECT_EQ("01020304abcd@domain.org", value);
+    NextStart(&parser, "pubsub");
+    NextStart(&parser, "publish");
+    EXPECT_TRUE(parser.GetAttribute("node", &value));
+    EXPECT_EQ("01020304abcd:vpn-ip-address/32", value);
+    NextStart(&parser, "item");
+    NextStart(&parser, "entry");
+    NextStart(&parser, "nlri");
+    EXPECT_TRUE(parser.GetAttribute("af", &value));
+    EXPECT_EQ("1", value);
+    EXPECT_TRUE(parser.ReadText(&value));
+    EXPECT_EQ("10.1.2.1/32", value);
+    NextStart(&parser, "next-hop");
+    EXPECT_TRUE(parser.SkipElement());
+    NextStart(&parser, "version");
+    EXPECT_TRUE(parser.GetAttribute("id", &value));
+    EXPECT_EQ("1", value);
+    EXPECT_TRUE(parser.SkipElement());
+    NextStart(&parser, "label");
+    XmlPullParser::Token label;
+    EXPECT_TRUE(parser.ReadRawText(&label));
+    EXPECT_EQ("10000", label.ToString());
+
+    XmlPullParser::Event event;
+    do {
+        event = parser.Next();
+    } while (event != XmlPullParser::END_DOCUMENT &&
+             event != XmlPullParser::ERROR);
+    EXPECT_FALSE(parser.error());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "xml/xml_pull_parser.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+
+using namespace std;
+
+XmlPullParser::XmlPullParser(const char *data, size_t size)
+    : begin_(data), end_(data + size), pos_(data), event_(TEXT),
+      depth_(0), empty_element_(false), cdata_(false) {
+    open_.reserve(kInitialDepth);
+}
+
+bool XmlPullParser::IsNameChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' ||
+           c == ':' || (c & 0x80);
+}
+
+//
+// Find the string starting at the current position. Returns NULL if it is
+// not present in the rest of the buffer.
+//
+const char *XmlPullParser::FindString(const char *str) const {
+    size_t len = strlen(str);
+    for (const char *p = pos_; p + len <= end_; p++) {
+        p = static_cast<const char *>(memchr(p, str[0], end_ - p));
+        if (p == NULL || p + len > end_)
+            return NULL;
+        if (memcmp(p, str, len) == 0)
+            return p;
+    }
+    return NULL;
+}
+
+//
+// Skip markup that starts with the start string and ends with the end string
+// e.g. comments and processing instructions.
+//
+bool XmlPullParser::SkipMarkup(const char *start, const char *end) {
+    pos_ += strlen(start);
+    const char *p = FindString(end);
+    if (p == NULL)
+        return false;
+    pos_ = p + strlen(end);
+    return true;
+}
+
+XmlPullParser::Event XmlPullParser::ParseStartElement() {
+    const char *p = pos_ + 1;
+    const char *name = p;
+    while (p < end_ && IsNameChar(*p))
+        p++;
+    if (p == name)
+        return SetError();
+    name_ = Token(name, p - name);
+
+    // Find the end of the tag, skipping over quoted attribute values.
+    const char *attributes = p;
+    char quote = '\0';
+    for (; p < end_; p++) {
+        if (quote) {
+            if (*p == quote)
+                quote = '\0';
+        } else if (*p == '"' || *p == '\'') {
+            quote = *p;
+        } else if (*p == '>') {
+            break;
+        }
+    }
+    if (p == end_)
+        return SetError();
+
+    empty_element_ = (p[-1] == '/');
+    const char *attributes_end = empty_element_ ? p - 1 : p;
+    if (attributes_end < attributes)
+        return SetError();
+    attributes_ = Token(attributes, attributes_end - attributes);
+
+    pos_ = p + 1;
+    open_.push_back(name_);
+    depth_ = open_.size();
+    event_ = START_ELEMENT;
+    return event_;
+}
+
+XmlPullParser::Event XmlPullParser::ParseEndElement() {
+    const char *p = pos_ + 2;
+    const char *name = p;
+    while (p < end_ && IsNameChar(*p))
+        p++;
+    if (p == name)
+        return SetError();
+    name_ = Token(name, p - name);
+    while (p < end_ && IsSpace(*p))
+        p++;
+    if (p == end_ || *p != '>' || open_.empty())
+        return SetError();
+
+    // The end tag must close the innermost open element.
+    const Token &open_name = open_.back();
+    if (open_name.size != name_.size ||
+        memcmp(open_name.data, name_.data, name_.size) != 0)
+        return SetError();
+
+    pos_ = p + 1;
+    depth_ = open_.size();
+    open_.pop_back();
+    event_ = END_ELEMENT;
+    return event_;
+}
+
+XmlPullParser::Event XmlPullParser::Next() {
+    if (event_ == ERROR || event_ == END_DOCUMENT)
+        return event_;
+
+    if (empty_element_) {
+        empty_element_ = false;
+        depth_ = open_.size();
+        open_.pop_back();
+        event_ = END_ELEMENT;
+        return event_;
+    }
+
+    while (true) {
+        if (pos_ >= end_) {
+            if (!open_.empty())
+                return SetError();
+            event_ = END_DOCUMENT;
+            return event_;
+        }
+
+        if (*pos_ != '<') {
+            const char *p =
+                static_cast<const char *>(memchr(pos_, '<', end_ - pos_));
+            if (p == NULL)
+                p = end_;
+            text_ = Token(pos_, p - pos_);
+            pos_ = p;
+
+            // Ignore text outside of the document element.
+            if (open_.empty())
+                continue;
+            cdata_ = false;
+            event_ = TEXT;
+            return event_;
+        }
+
+        size_t left = end_ - pos_;
+        if (left >= 2 && pos_[1] == '?') {
+            if (!SkipMarkup("<?", "?>"))
+                return SetError();
+        } else if (left >= 4 && memcmp(pos_, "<!--", 4) == 0) {
+            if (!SkipMarkup("<!--", "-->"))
+                return SetError();
+        } else if (left >= 9 && memcmp(pos_, "<![CDATA[", 9) == 0) {
+            if (open_.empty())
+                return SetError();
+            const char *start = pos_ + 9;
+            if (!SkipMarkup("<![CDATA[", "]]>"))
+                return SetError();
+            text_ = Token(start, pos_ - 3 - start);
+            cdata_ = true;
+            event_ = TEXT;
+            return event_;
+        } else if (left >= 2 && pos_[1] == '!') {
+            return SetError();
+        } else if (left >= 2 && pos_[1] == '/') {
+            return ParseEndElement();
+        } else {
+            return ParseStartElement();
+        }
+    }
+}
+
+bool XmlPullParser::GetAttribute(const char *name, Token *value) const {
+    if (event_ != START_ELEMENT)
+        return false;
+
+    const char *p = attributes_.data;
+    const char *end = attributes_.data + attributes_.size;
+    while (p < end) {
+        while (p < end && IsSpace(*p))
+            p++;
+        const char *attr = p;
+        while (p < end && IsNameChar(*p))
+            p++;
+        Token attr_name(attr, p - attr);
+        if (attr_name.empty())
+            return false;
+        while (p < end && IsSpace(*p))
+            p++;
+        if (p == end || *p != '=')
+            return false;
+        p++;
+        while (p < end && IsSpace(*p))
+            p++;
+        if (p == end || (*p != '"' && *p != '\''))
+            return false;
+        char quote = *p++;
+        const char *attr_value = p;
+        p = static_cast<const char *>(memchr(p, quote, end - p));
+        if (p == NULL)
+            return false;
+        if (attr_name.Equals(name)) {
+            *value = Token(attr_value, p - attr_value);
+            return true;
+        }
+        p++;
+    }
+    return false;
+}
+
+bool XmlPullParser::GetAttribute(const char *name, string *value) const {
+    Token token;
+    if (!GetAttribute(name, &token))
+        return false;
+    value->clear();
+    return Decode(token, value);
+}
+
+bool XmlPullParser::SkipElement() {
+    if (event_ != START_ELEMENT)
+        return false;
+    int depth = depth_;
+    while (true) {
+        switch (Next()) {
+        case END_ELEMENT:
+            if (depth_ == depth)
+                return true;
+            break;
+        case ERROR:
+        case END_DOCUMENT:
+            return false;
+        default:
+            break;
+        }
+    }
+}
+
+bool XmlPullParser::ReadRawText(Token *text) {
+    if (event_ != START_ELEMENT)
+        return false;
+    *text = Token(pos_, 0);
+    Event event = Next();
+    if (event == END_ELEMENT)
+        return true;
+    if (event != TEXT || cdata_ ||
+        memchr(text_.data, '&', text_.size) != NULL)
+        return false;
+    *text = text_;
+    return (Next() == END_ELEMENT);
+}
+
+bool XmlPullParser::ReadText(string *text) {
+    if (event_ != START_ELEMENT)
+        return false;
+    text->clear();
+    while (true) {
+        switch (Next()) {
+        case TEXT:
+            if (cdata_) {
+                text->append(text_.data, text_.size);
+            } else if (!Decode(text_, text)) {
+                return false;
+            }
+            break;
+        case END_ELEMENT:
+            return true;
+        default:
+            return false;
+        }
+    }
+}
+
+//
+// Append the UTF-8 encoding of the code point to str.
+//
+static void AppendCodePoint(unsigned long code, string *str) {
+    if (code < 0x80) {
+        str->push_back(code);
+    } else if (code < 0x800) {
+        str->push_back(0xc0 | (code >> 6));
+        str->push_back(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        str->push_back(0xe0 | (code >> 12));
+        str->push_back(0x80 | ((code >> 6) & 0x3f));
+        str->push_back(0x80 | (code & 0x3f));
+    } else {
+        str->push_back(0xf0 | (code >> 18));
+        str->push_back(0x80 | ((code >> 12) & 0x3f));
+        str->push_back(0x80 | ((code >> 6) & 0x3f));
+        str->push_back(0x80 | (code & 0x3f));
+    }
+}
+
+bool XmlPullParser::Decode(const Token &value, string *str) {
+    const char *p = value.data;
+    const char *end = value.data + value.size;
+    while (p < end) {
+        const char *amp = static_cast<const char *>(memchr(p, '&', end - p));
+        if (amp == NULL) {
+            str->append(p, end - p);
+            break;
+        }
+        str->append(p, amp - p);
+        const char *semi =
+            static_cast<const char *>(memchr(amp, ';', end - amp));
+        if (semi == NULL)
+            return false;
+        Token entity(amp + 1, semi - amp - 1);
+        if (entity.Equals("lt")) {
+            str->push_back('<');
+        } else if (entity.Equals("gt")) {
+            str->push_back('>');
+        } else if (entity.Equals("amp")) {
+            str->push_back('&');
+        } else if (entity.Equals("quot")) {
+            str->push_back('"');
+        } else if (entity.Equals("apos")) {
+            str->push_back('\'');
+        } else if (entity.size > 1 && entity.data[0] == '#') {
+            const char *digits = entity.data + 1;
+            int base = 10;
+            if (*digits == 'x') {
+                digits++;
+                base = 16;
+            }
+            // strtoul would accept leading spaces and signs.
+            if (digits == semi ||
+                !(base == 16 ? isxdigit(*digits) : isdigit(*digits)))
+                return false;
+            char *digits_end;
+            unsigned long code = strtoul(digits, &digits_end, base);
+            if (digits_end != semi || code > 0x10ffff)
+                return false;
+            AppendCodePoint(code, str);
+        } else {
+            return false;
+        }
+        p = semi + 1;
+    }
+    return true;
+}
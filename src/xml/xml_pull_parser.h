@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef __XML_PULL_PARSER_H__
+#define __XML_PULL_PARSER_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+//
+// Streaming, non-validating xml parser that works directly on a contiguous
+// buffer. Unlike XmlPugi, it does not build a document tree. The caller pulls
+// events one at a time and all names, attribute values and text returned by
+// the parser point into the original buffer, so parsing does not allocate any
+// memory. Entities are only decoded when the caller asks for a std::string.
+// The only allocation is the stack of the names of the open elements, used to
+// check that the end tags match.
+//
+// The parser handles the subset of xml used by xmpp stanzas: elements,
+// attributes, text, CDATA, comments and processing instructions. DTDs are not
+// supported.
+//
+class XmlPullParser {
+public:
+    enum Event {
+        START_ELEMENT,
+        END_ELEMENT,
+        TEXT,
+        END_DOCUMENT,
+        ERROR
+    };
+
+    // Slice of the buffer being parsed.
+    struct Token {
+        Token() : data(NULL), size(0) { }
+        Token(const char *data, size_t size) : data(data), size(size) { }
+        bool empty() const { return size == 0; }
+        bool Equals(const char *str) const {
+            return strlen(str) == size && memcmp(data, str, size) == 0;
+        }
+        std::string ToString() const { return std::string(data, size); }
+        const char *data;
+        size_t size;
+    };
+
+    XmlPullParser(const char *data, size_t size);
+
+    // Advance to the next event. An empty element i.e. <a/> generates both
+    // a START_ELEMENT and an END_ELEMENT event.
+    Event Next();
+
+    // Name of the current element. Valid for START_ELEMENT and END_ELEMENT.
+    const Token &name() const { return name_; }
+    bool NameIs(const char *name) const { return name_.Equals(name); }
+
+    // Raw text of the current TEXT event.
+    const Token &text() const { return text_; }
+
+    // Nesting level of the current element. The document element is at
+    // depth 1.
+    int depth() const { return depth_; }
+
+    bool error() const { return event_ == ERROR; }
+
+    // Find an attribute of the current START_ELEMENT. The raw value is
+    // returned, without decoding entities.
+    bool GetAttribute(const char *name, Token *value) const;
+    bool GetAttribute(const char *name, std::string *value) const;
+
+    // Skip the rest of the current element, including all its children.
+    // Must be called at a START_ELEMENT. On return, the parser is positioned
+    // at the matching END_ELEMENT.
+    bool SkipElement();
+
+    // Read the text content of the current element, which must not have any
+    // child elements. Must be called at a START_ELEMENT. On return, the
+    // parser is positioned at the matching END_ELEMENT. The raw variant fails
+    // if the text is split by comments or CDATA sections, or contains any
+    // entity references.
+    bool ReadRawText(Token *text);
+    bool ReadText(std::string *text);
+
+    // Append the value to str, decoding entity and character references.
+    static bool Decode(const Token &value, std::string *str);
+
+private:
+    static const size_t kInitialDepth = 16;
+
+    Event SetError() { event_ = ERROR; return event_; }
+    Event ParseStartElement();
+    Event ParseEndElement();
+    bool SkipMarkup(const char *start, const char *end);
+    const char *FindString(const char *str) const;
+    static bool IsNameChar(char c);
+    static bool IsSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    const char *begin_;
+    const char *end_;
+    const char *pos_;
+    Event event_;
+    Token name_;
+    Token text_;
+    Token attributes_;
+    int depth_;
+    std::vector<Token> open_;   // Names of the open elements
+    bool empty_element_;
+    bool cdata_;
+};
+
+#endif
@@ -40,7 +40,7 @@ XmppConnection::XmppConnection(TcpServer *server,
       session_(NULL),
       state_machine_(new XmppStateMachine(this, config->ClientOnly())),
       keepalive_timer_(TimerManager::CreateTimer(
-                           *server->event_manager()->io_service(),
+                           *server->event_manager()->NextIoService(),
                            "Xmpp keepalive timer")),
       log_uve_(config->logUVE),
       admin_down_(false), 
@@ -374,7 +374,10 @@ void XmppConnection::ReceiveMsg(XmppSession *session, const string &msg) {
 }
 
 XmppStanza::XmppMessage *XmppConnection::XmppDecode(const string &msg) {
-    auto_ptr<XmppStanza::XmppMessage> minfo(XmppProto::Decode(msg));
+    bool streaming_publish = !IsClient() &&
+        static_cast<XmppServer *>(server_)->streaming_publish();
+    auto_ptr<XmppStanza::XmppMessage> minfo(
+        XmppProto::Decode(msg, streaming_publish));
     if (minfo.get() == NULL) {
         return NULL;
     }
@@ -396,9 +399,13 @@ XmppStanza::XmppMessage *XmppConnection::XmppDecode(const string &msg) {
 
                 if (last_iq->node.compare(iq->as_node) == 0) {
                     XmlBase *impl = last_iq->dom.get();
-                    impl->ReadNode("publish");
-                    impl->ModifyAttribute("node", iq->node);
-                    last_iq->node = impl->ReadAttrib("node");
+                    if (impl) {
+                        impl->ReadNode("publish");
+                        impl->ModifyAttribute("node", iq->node);
+                        last_iq->node = impl->ReadAttrib("node");
+                    } else {
+                        last_iq->node = iq->node;
+                    }
                     last_iq->is_as_node = iq->is_as_node;
                     //Save the complete ass/dissociate node
                     last_iq->as_node = iq->as_node;
@@ -11,6 +11,7 @@
 #include "xmpp/xmpp_log.h"
 #include "xmpp/xmpp_session.h"
 #include "xmpp/xmpp_str.h"
+#include "xml/xml_pull_parser.h"
 
 #include "sandesh/sandesh_types.h"
 #include "sandesh/sandesh.h"
@@ -155,7 +156,13 @@ int XmppProto::EncodeOpen(uint8_t *buf, string &to, string &from) {
     return len;
 }
 
-XmppStanza::XmppMessage *XmppProto::Decode(const string &ts) {
+XmppStanza::XmppMessage *XmppProto::Decode(const string &ts,
+                                            bool streaming_publish) {
+    if (streaming_publish && ts.find(sXMPP_IQ) != string::npos) {
+        XmppStanza::XmppMessage *msg = DecodePublish(ts);
+        if (msg) return msg;
+    }
+
     XmlBase *impl = XmppStanza::AllocXmppXmlImpl();
     if (impl == NULL) {
         return NULL;
@@ -169,6 +176,43 @@ XmppStanza::XmppMessage *XmppProto::Decode(const string &ts) {
     return msg;
 }
 
+//
+// Decode the header of a publish iq without loading the stanza into a dom.
+// Returns NULL if the stanza is not a publish iq, in which case the caller
+// falls back to the dom based decoder.
+//
+XmppStanza::XmppMessage *XmppProto::DecodePublish(const string &ts) {
+    XmlPullParser parser(ts.data(), ts.size());
+    if (parser.Next() != XmlPullParser::START_ELEMENT || !parser.NameIs("iq"))
+        return NULL;
+
+    string type;
+    if (!parser.GetAttribute("type", &type) || type != "set")
+        return NULL;
+    auto_ptr<XmppStanza::XmppMessageIq> msg(new XmppStanza::XmppMessageIq);
+    msg->iq_type = type;
+    parser.GetAttribute("to", &msg->to);
+    parser.GetAttribute("from", &msg->from);
+    parser.GetAttribute("id", &msg->id);
+
+    // The first child of pubsub must be the publish element.
+    const char *path[] = { "pubsub", "publish" };
+    for (size_t i = 0; i < sizeof(path) / sizeof(path[0]); i++) {
+        XmlPullParser::Event event;
+        while ((event = parser.Next()) == XmlPullParser::TEXT)
+            continue;
+        if (event != XmlPullParser::START_ELEMENT || !parser.NameIs(path[i]))
+            return NULL;
+    }
+    msg->action = "publish";
+    parser.GetAttribute("node", &msg->node);
+    msg->data = ts;
+
+    XMPP_UTDEBUG(XmppIqMessageProcess, msg->node, msg->action,
+                 msg->from, msg->to, msg->id, msg->iq_type);
+    return msg.release();
+}
+
 XmppStanza::XmppMessage *XmppProto::DecodeInternal(const string &ts, 
                                                    XmlBase *impl) {
     XmppStanza::XmppMessage *ret = NULL;
@@ -144,6 +144,8 @@ public:
         std::string action;
         std::string as_node;
         bool is_as_node;
+        // Raw stanza for publish messages that are decoded without a dom.
+        std::string data;
     };
 
     XmppStanza();
@@ -162,7 +164,11 @@ private:
 class XmppProto : public XmppStanza {
 public:
 
-    static XmppStanza::XmppMessage *Decode(const std::string &ts);
+    // If streaming_publish is set, publish iq messages are not loaded into
+    // a dom. The message carries the raw stanza instead and the receiver is
+    // expected to parse the items itself.
+    static XmppStanza::XmppMessage *Decode(const std::string &ts,
+                                           bool streaming_publish = false);
     static int EncodeStream(const XmppStreamMessage &str, std::string &to, 
                             std::string &from, uint8_t *data, size_t size);
     static int EncodeStream(const XmppMessage &str, uint8_t *data, size_t size);
@@ -190,6 +196,7 @@ private:
 
     static XmppStanza::XmppMessage *DecodeInternal(const std::string &ts,
                                                    XmlBase *impl); 
+    static XmppStanza::XmppMessage *DecodePublish(const std::string &ts);
 
     static std::auto_ptr<XmlBase> open_doc_;
 
@@ -49,6 +49,7 @@ XmppServer::XmppServer(EventManager *evm, const string &server_addr)
                   boost::bind(&XmppServer::DequeueSession, this, _1)) {
     server_addr_ = server_addr;
     log_uve_ = false;
+    streaming_publish_ = false;
 }
 
 XmppServer::XmppServer(EventManager *evm) 
@@ -58,6 +59,7 @@ XmppServer::XmppServer(EventManager *evm)
       work_queue_(TaskScheduler::GetInstance()->GetTaskId("bgp::Config"), 0,
                   boost::bind(&XmppServer::DequeueSession, this, _1)) {
     log_uve_ = false;
+    streaming_publish_ = false;
 }
 
 bool XmppServer::IsPeerCloseGraceful() {
@@ -49,6 +49,11 @@ public:
                              
     const std::string &ServerAddr() const { return server_addr_; }
     size_t ConnectionsCount() { return connection_map_.size(); }
+
+    // Deliver publish messages received by the server without a dom. See
+    // XmppProto::Decode.
+    bool streaming_publish() const { return streaming_publish_; }
+    void set_streaming_publish(bool enable) { streaming_publish_ = enable; }
 protected:
     virtual TcpSession *AllocSession(Socket *socket);
     virtual bool AcceptSession(TcpSession *session);
@@ -77,6 +82,7 @@ private:
     ConnectionEventCbMap connection_event_map_;
     std::string server_addr_; // xmpp server addr
     bool log_uve_;
+    bool streaming_publish_;
     bool DequeueSession(XmppConnection *connection);
     WorkQueue<XmppConnection *> work_queue_;
 
@@ -665,11 +665,11 @@ XmppStateMachine::XmppStateMachine(XmppConnection *connection, bool active)
                   connection->GetIndex(),
                   boost::bind(&XmppStateMachine::DequeueEvent, this, _1)),
       connection_(connection), session_(NULL),
-      connect_timer_(TimerManager::CreateTimer(*connection->server()->event_manager()->io_service(), "Connect timer",
+      connect_timer_(TimerManager::CreateTimer(*connection->server()->event_manager()->NextIoService(), "Connect timer",
              TaskScheduler::GetInstance()->GetTaskId("xmpp::StateMachine"), 0)),
-      open_timer_(TimerManager::CreateTimer(*connection->server()->event_manager()->io_service(), "Open timer",
+      open_timer_(TimerManager::CreateTimer(*connection->server()->event_manager()->NextIoService(), "Open timer",
              TaskScheduler::GetInstance()->GetTaskId("xmpp::StateMachine"), 0)),
-      hold_timer_(TimerManager::CreateTimer(*connection->server()->event_manager()->io_service(), "Hold timer",
+      hold_timer_(TimerManager::CreateTimer(*connection->server()->event_manager()->NextIoService(), "Hold timer",
              TaskScheduler::GetInstance()->GetTaskId("xmpp::StateMachine"), 0)),
       attempts_(0),
       deleted_(false),